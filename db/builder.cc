@@ -6,6 +6,7 @@
 
 #include "db/filename.h"
 #include "db/dbformat.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -14,31 +15,62 @@
 
 namespace leveldb {
 
+Status NewTableFile(Env* env,
+                    const Options& options,
+                    const std::string& fname,
+                    WritableFile** result)
+{
+  // Only pass options when one is set, so that Envs which wrap just
+  // NewWritableFile() keep seeing every table file.
+  if (!options.use_direct_io_for_flush_and_compaction &&
+      !options.use_direct_reads && !options.use_dsync_writes)
+  {
+    return env->NewWritableFile(fname, result);
+  }
+  FileOptions file_options;
+  file_options.use_direct_io = options.use_direct_io_for_flush_and_compaction;
+  file_options.use_dsync = options.use_dsync_writes;
+  // With direct reads the page cache copy would never be read
+  file_options.drop_cache_on_close = options.use_direct_reads;
+  return env->NewWritableFileWithOptions(fname, file_options, result);
+}
+
 Status BuildTable(const std::string& dbname,
                   Env* env,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
+                  Iterator* range_del_iter,
                   FileMetaData* meta) 
 {
   Status s;
   meta->file_size = 0;
+  meta->has_range_deletions = false;
   iter->SeekToFirst();
+  if (range_del_iter != NULL)
+  {
+    range_del_iter->SeekToFirst();
+  }
 
   //.ldb文件
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) 
+  if (iter->Valid() || (range_del_iter != NULL && range_del_iter->Valid())) 
   {
     WritableFile* file;
 	//构成sstable对应的文件
-    s = env->NewWritableFile(fname, &file);
+    s = NewTableFile(env, options, fname, &file);
     if (!s.ok()) 
 	{
       return s;
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    bool empty = true;
+    if (iter->Valid())
+    {
+      meta->smallest.DecodeFrom(iter->key());
+      empty = false;
+    }
     for (; iter->Valid(); iter->Next()) 
 	{
       Slice key = iter->key();
@@ -46,6 +78,28 @@ Status BuildTable(const std::string& dbname,
       builder->Add(key, iter->value());
     }
 
+    // The file's key range must take in the ranges of its tombstones
+    if (range_del_iter != NULL)
+    {
+      for (; range_del_iter->Valid(); range_del_iter->Next())
+      {
+        ParsedInternalKey ikey;
+        if (!ParseInternalKey(range_del_iter->key(), &ikey))
+        {
+          s = Status::Corruption("bad range tombstone");
+          break;
+        }
+        builder->AddRangeDeletion(range_del_iter->key(), range_del_iter->value());
+        ExtendRangeForTombstone(options.comparator, ikey.user_key, range_del_iter->value(), ikey.sequence,
+                                &empty, &meta->smallest, &meta->largest);
+        meta->has_range_deletions = true;
+      }
+      if (s.ok())
+      {
+        s = range_del_iter->status();
+      }
+    }
+
     // Finish and check for builder errors
     if (s.ok())
 	{
@@ -79,7 +133,9 @@ Status BuildTable(const std::string& dbname,
       // Verify that the table is usable
       Iterator* it = table_cache->NewIterator(ReadOptions(),
                                               meta->number,
-                                              meta->file_size);
+                                              meta->file_size,
+                                              NULL,
+                                              0);
       s = it->status();
       delete it;
     }
@@ -13,22 +13,32 @@ struct Options;
 struct FileMetaData;
 
 class Env;
+class WritableFile;
 class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Build a Table file from the contents of *iter and the range tombstones
+// of *range_del_iter (which may be NULL).  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in either iterator, meta->file_size will be set
+// to zero, and no Table file will be produced.
 extern Status BuildTable(const std::string& dbname,
                          Env* env,
                          const Options& options,
                          TableCache* table_cache,
                          Iterator* iter,
+                         Iterator* range_del_iter,
                          FileMetaData* meta);
 
+// Create the table file "fname" for writing, with the direct I/O and
+// O_DSYNC settings from "options".  Used for flush and compaction outputs.
+extern Status NewTableFile(Env* env,
+                           const Options& options,
+                           const std::string& fname,
+                           WritableFile** result);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_DB_BUILDER_H_
@@ -13,6 +13,7 @@
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 
@@ -28,6 +29,9 @@ using leveldb::kMajorVersion;
 using leveldb::kMinorVersion;
 using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
+using leveldb::NewCacheLocalBloomFilterPolicy;
+using leveldb::NewRibbonFilterPolicy;
+using leveldb::NewFixedPrefixTransform;
 using leveldb::NewLRUCache;
 using leveldb::Options;
 using leveldb::RandomAccessFile;
@@ -35,6 +39,7 @@ using leveldb::Range;
 using leveldb::ReadOptions;
 using leveldb::SequentialFile;
 using leveldb::Slice;
+using leveldb::SliceTransform;
 using leveldb::Snapshot;
 using leveldb::Status;
 using leveldb::WritableFile;
@@ -47,7 +52,11 @@ struct leveldb_t              { DB*               rep; };
 struct leveldb_iterator_t     { Iterator*         rep; };
 struct leveldb_writebatch_t   { WriteBatch        rep; };
 struct leveldb_snapshot_t     { const Snapshot*   rep; };
-struct leveldb_readoptions_t  { ReadOptions       rep; };
+struct leveldb_readoptions_t {
+  ReadOptions rep;
+  std::string upper_bound;    // Backing store for rep.iterate_upper_bound
+  Slice upper_bound_slice;
+};
 struct leveldb_writeoptions_t { WriteOptions      rep; };
 struct leveldb_options_t      { Options           rep; };
 struct leveldb_cache_t        { Cache*            rep; };
@@ -56,6 +65,7 @@ struct leveldb_randomfile_t   { RandomAccessFile* rep; };
 struct leveldb_writablefile_t { WritableFile*     rep; };
 struct leveldb_logger_t       { Logger*           rep; };
 struct leveldb_filelock_t     { FileLock*         rep; };
+struct leveldb_slicetransform_t { const SliceTransform* rep; };
 
 struct leveldb_comparator_t : public Comparator {
   void* state_;
@@ -185,6 +195,16 @@ void leveldb_delete(
   SaveError(errptr, db->rep->Delete(options->rep, Slice(key, keylen)));
 }
 
+void leveldb_delete_range(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    const char* begin, size_t beginlen,
+    const char* end, size_t endlen,
+    char** errptr) {
+  SaveError(errptr, db->rep->DeleteRange(options->rep, Slice(begin, beginlen),
+                                         Slice(end, endlen)));
+}
+
 
 void leveldb_write(
     leveldb_t* db,
@@ -215,6 +235,37 @@ char* leveldb_get(
   return result;
 }
 
+void leveldb_multi_get(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    size_t num_keys,
+    const char* const* keys_list,
+    const size_t* keys_list_sizes,
+    char** values_list,
+    size_t* values_list_sizes,
+    char** errs) {
+  std::vector<Slice> keys(num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    keys[i] = Slice(keys_list[i], keys_list_sizes[i]);
+  }
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  db->rep->MultiGet(options->rep, keys, &values, &statuses);
+  for (size_t i = 0; i < num_keys; i++) {
+    errs[i] = NULL;
+    if (statuses[i].ok()) {
+      values_list[i] = CopyString(values[i]);
+      values_list_sizes[i] = values[i].size();
+    } else {
+      values_list[i] = NULL;
+      values_list_sizes[i] = 0;
+      if (!statuses[i].IsNotFound()) {
+        SaveError(&errs[i], statuses[i]);
+      }
+    }
+  }
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options) {
@@ -249,6 +300,10 @@ char* leveldb_property_value(
   }
 }
 
+void leveldb_reset_stats(leveldb_t* db) {
+  db->rep->ResetStats();
+}
+
 void leveldb_approximate_sizes(
     leveldb_t* db,
     int num_ranges,
@@ -359,6 +414,13 @@ void leveldb_writebatch_delete(
   b->rep.Delete(Slice(key, klen));
 }
 
+void leveldb_writebatch_delete_range(
+    leveldb_writebatch_t* b,
+    const char* begin, size_t beginlen,
+    const char* end, size_t endlen) {
+  b->rep.DeleteRange(Slice(begin, beginlen), Slice(end, endlen));
+}
+
 void leveldb_writebatch_iterate(
     leveldb_writebatch_t* b,
     void* state,
@@ -403,6 +465,43 @@ void leveldb_options_set_filter_policy(
   opt->rep.filter_policy = policy;
 }
 
+void leveldb_options_set_full_table_filter(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.full_table_filter = v;
+}
+
+void leveldb_options_set_prefix_extractor(
+    leveldb_options_t* opt,
+    leveldb_slicetransform_t* prefix_extractor) {
+  opt->rep.prefix_extractor = (prefix_extractor ? prefix_extractor->rep : NULL);
+}
+
+void leveldb_options_set_partition_index_and_filters(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.partition_index_and_filters = v;
+}
+
+void leveldb_options_set_metadata_block_size(
+    leveldb_options_t* opt, size_t s) {
+  opt->rep.metadata_block_size = s;
+}
+
+void leveldb_options_set_cache_index_and_filter_blocks(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.cache_index_and_filter_blocks = v;
+}
+
+void leveldb_options_set_pin_l0_filter_and_index_blocks_in_cache(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.pin_l0_filter_and_index_blocks_in_cache = v;
+}
+
+void leveldb_options_set_secondary_cache(
+    leveldb_options_t* opt, const char* path, size_t capacity) {
+  opt->rep.secondary_cache_path = path;
+  opt->rep.secondary_cache_size = capacity;
+}
+
 void leveldb_options_set_create_if_missing(
     leveldb_options_t* opt, unsigned char v) {
   opt->rep.create_if_missing = v;
@@ -430,10 +529,33 @@ void leveldb_options_set_write_buffer_size(leveldb_options_t* opt, size_t s) {
   opt->rep.write_buffer_size = s;
 }
 
+void leveldb_options_set_allow_concurrent_memtable_write(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.allow_concurrent_memtable_write = v;
+}
+
+void leveldb_options_set_enable_pipelined_write(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.enable_pipelined_write = v;
+}
+
+void leveldb_options_set_enable_log_flusher(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.enable_log_flusher = v;
+}
+
 void leveldb_options_set_max_open_files(leveldb_options_t* opt, int n) {
   opt->rep.max_open_files = n;
 }
 
+void leveldb_options_set_max_background_compactions(leveldb_options_t* opt, int n) {
+  opt->rep.max_background_compactions = n;
+}
+
+void leveldb_options_set_max_subcompactions(leveldb_options_t* opt, int n) {
+  opt->rep.max_subcompactions = n;
+}
+
 void leveldb_options_set_cache(leveldb_options_t* opt, leveldb_cache_t* c) {
   opt->rep.block_cache = c->rep;
 }
@@ -450,6 +572,43 @@ void leveldb_options_set_compression(leveldb_options_t* opt, int t) {
   opt->rep.compression = static_cast<CompressionType>(t);
 }
 
+void leveldb_options_set_zstd_compression_level(leveldb_options_t* opt, int n) {
+  opt->rep.zstd_compression_level = n;
+}
+
+void leveldb_options_set_zstd_dictionary_size(leveldb_options_t* opt, size_t n) {
+  opt->rep.zstd_dictionary_size = n;
+}
+
+void leveldb_options_set_zstd_max_train_bytes(leveldb_options_t* opt, size_t n) {
+  opt->rep.zstd_max_train_bytes = n;
+}
+
+void leveldb_options_set_use_direct_reads(leveldb_options_t* opt,
+                                          unsigned char v) {
+  opt->rep.use_direct_reads = v;
+}
+
+void leveldb_options_set_use_direct_io_for_flush_and_compaction(
+    leveldb_options_t* opt, unsigned char v) {
+  opt->rep.use_direct_io_for_flush_and_compaction = v;
+}
+
+void leveldb_options_set_use_dsync_writes(leveldb_options_t* opt,
+                                          unsigned char v) {
+  opt->rep.use_dsync_writes = v;
+}
+
+void leveldb_options_set_compression_per_level(leveldb_options_t* opt,
+                                               const int* levels,
+                                               size_t num_levels) {
+  opt->rep.compression_per_level.clear();
+  for (size_t i = 0; i < num_levels; i++) {
+    opt->rep.compression_per_level.push_back(
+        static_cast<CompressionType>(levels[i]));
+  }
+}
+
 leveldb_comparator_t* leveldb_comparator_create(
     void* state,
     void (*destructor)(void*),
@@ -496,10 +655,10 @@ void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t* filter) {
   delete filter;
 }
 
-leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(int bits_per_key) {
-  // Make a leveldb_filterpolicy_t, but override all of its methods so
-  // they delegate to a NewBloomFilterPolicy() instead of user
-  // supplied C functions.
+// Make a leveldb_filterpolicy_t, but override all of its methods so
+// they delegate to a built-in policy instead of user supplied C
+// functions.
+static leveldb_filterpolicy_t* WrapFilterPolicy(const FilterPolicy* rep) {
   struct Wrapper : public leveldb_filterpolicy_t {
     const FilterPolicy* rep_;
     ~Wrapper() { delete rep_; }
@@ -513,12 +672,37 @@ leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(int bits_per_key) {
     static void DoNothing(void*) { }
   };
   Wrapper* wrapper = new Wrapper;
-  wrapper->rep_ = NewBloomFilterPolicy(bits_per_key);
+  wrapper->rep_ = rep;
   wrapper->state_ = NULL;
   wrapper->destructor_ = &Wrapper::DoNothing;
   return wrapper;
 }
 
+leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(int bits_per_key) {
+  return WrapFilterPolicy(NewBloomFilterPolicy(bits_per_key));
+}
+
+leveldb_filterpolicy_t* leveldb_filterpolicy_create_cache_local_bloom(
+    int bits_per_key) {
+  return WrapFilterPolicy(NewCacheLocalBloomFilterPolicy(bits_per_key));
+}
+
+leveldb_filterpolicy_t* leveldb_filterpolicy_create_ribbon(int bits_per_key) {
+  return WrapFilterPolicy(NewRibbonFilterPolicy(bits_per_key));
+}
+
+leveldb_slicetransform_t* leveldb_slicetransform_create_fixed_prefix(
+    size_t prefix_len) {
+  leveldb_slicetransform_t* result = new leveldb_slicetransform_t;
+  result->rep = NewFixedPrefixTransform(prefix_len);
+  return result;
+}
+
+void leveldb_slicetransform_destroy(leveldb_slicetransform_t* prefix_extractor) {
+  delete prefix_extractor->rep;
+  delete prefix_extractor;
+}
+
 leveldb_readoptions_t* leveldb_readoptions_create() {
   return new leveldb_readoptions_t;
 }
@@ -544,6 +728,23 @@ void leveldb_readoptions_set_snapshot(
   opt->rep.snapshot = (snap ? snap->rep : NULL);
 }
 
+void leveldb_readoptions_set_prefix_same_as_start(
+    leveldb_readoptions_t* opt, unsigned char v) {
+  opt->rep.prefix_same_as_start = v;
+}
+
+void leveldb_readoptions_set_iterate_upper_bound(
+    leveldb_readoptions_t* opt,
+    const char* key, size_t keylen) {
+  if (key == NULL) {
+    opt->rep.iterate_upper_bound = NULL;
+  } else {
+    opt->upper_bound.assign(key, keylen);
+    opt->upper_bound_slice = opt->upper_bound;
+    opt->rep.iterate_upper_bound = &opt->upper_bound_slice;
+  }
+}
+
 leveldb_writeoptions_t* leveldb_writeoptions_create() {
   return new leveldb_writeoptions_t;
 }
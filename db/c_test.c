@@ -13,6 +13,7 @@
 
 const char* phase = "";
 static char dbname[200];
+static char secondary_cache_path[200];
 
 static void StartPhase(const char* name) {
   fprintf(stderr, "=== Test %s\n", name);
@@ -173,6 +174,10 @@ int main(int argc, char** argv) {
            "%s/leveldb_c_test-%d",
            GetTempDir(),
            ((int) geteuid()));
+  snprintf(secondary_cache_path, sizeof(secondary_cache_path),
+           "%s/leveldb_c_test_secondary_cache-%d",
+           GetTempDir(),
+           ((int) geteuid()));
 
   StartPhase("create_objects");
   cmp = leveldb_comparator_create(NULL, CmpDestroy, CmpCompare, CmpName);
@@ -187,10 +192,25 @@ int main(int argc, char** argv) {
   leveldb_options_set_info_log(options, NULL);
   leveldb_options_set_write_buffer_size(options, 100000);
   leveldb_options_set_paranoid_checks(options, 1);
+  leveldb_options_set_allow_concurrent_memtable_write(options, 1);
+  leveldb_options_set_enable_pipelined_write(options, 1);
+  leveldb_options_set_enable_log_flusher(options, 1);
   leveldb_options_set_max_open_files(options, 10);
+  leveldb_options_set_max_background_compactions(options, 2);
+  leveldb_options_set_max_subcompactions(options, 2);
   leveldb_options_set_block_size(options, 1024);
+  leveldb_options_set_metadata_block_size(options, 256);
   leveldb_options_set_block_restart_interval(options, 8);
   leveldb_options_set_compression(options, leveldb_no_compression);
+  leveldb_options_set_zstd_compression_level(options, 3);
+  leveldb_options_set_zstd_dictionary_size(options, 0);
+  leveldb_options_set_use_direct_reads(options, 1);
+  leveldb_options_set_use_direct_io_for_flush_and_compaction(options, 1);
+  leveldb_options_set_secondary_cache(options, secondary_cache_path, 1 << 20);
+  {
+    const int per_level[2] = { leveldb_no_compression, leveldb_no_compression };
+    leveldb_options_set_compression_per_level(options, per_level, 2);
+  }
 
   roptions = leveldb_readoptions_create();
   leveldb_readoptions_set_verify_checksums(roptions, 1);
@@ -252,6 +272,26 @@ int main(int argc, char** argv) {
     leveldb_writebatch_destroy(wb);
   }
 
+  StartPhase("multiget");
+  {
+    const char* keys[3] = { "box", "bar", "foo" };
+    size_t keys_sizes[3] = { 3, 3, 3 };
+    char* vals[3];
+    size_t vals_sizes[3];
+    char* errs[3];
+    int i;
+    leveldb_multi_get(db, roptions, 3, keys, keys_sizes, vals, vals_sizes, errs);
+    for (i = 0; i < 3; i++) {
+      CheckNoError(errs[i]);
+    }
+    CheckEqual("c", vals[0], vals_sizes[0]);
+    CheckEqual(NULL, vals[1], vals_sizes[1]);
+    CheckEqual("hello", vals[2], vals_sizes[2]);
+    for (i = 0; i < 3; i++) {
+      Free(&vals[i]);
+    }
+  }
+
   StartPhase("iter");
   {
     leveldb_iterator_t* iter = leveldb_create_iterator(db, roptions);
@@ -272,6 +312,19 @@ int main(int argc, char** argv) {
     leveldb_iter_get_error(iter, &err);
     CheckNoError(err);
     leveldb_iter_destroy(iter);
+
+    // Iteration stops before the upper bound
+    leveldb_readoptions_t* bounded_roptions = leveldb_readoptions_create();
+    leveldb_readoptions_set_iterate_upper_bound(bounded_roptions, "c", 1);
+    iter = leveldb_create_iterator(db, bounded_roptions);
+    leveldb_iter_seek_to_first(iter);
+    CheckIter(iter, "box", "c");
+    leveldb_iter_next(iter);
+    CheckCondition(!leveldb_iter_valid(iter));
+    leveldb_iter_seek_to_last(iter);
+    CheckIter(iter, "box", "c");
+    leveldb_iter_destroy(iter);
+    leveldb_readoptions_destroy(bounded_roptions);
   }
 
   StartPhase("approximate_sizes");
@@ -305,6 +358,10 @@ int main(int argc, char** argv) {
     prop = leveldb_property_value(db, "leveldb.stats");
     CheckCondition(prop != NULL);
     Free(&prop);
+    prop = leveldb_property_value(db, "leveldb.histograms");
+    CheckCondition(prop != NULL);
+    Free(&prop);
+    leveldb_reset_stats(db);
   }
 
   StartPhase("snapshot");
@@ -320,6 +377,25 @@ int main(int argc, char** argv) {
     leveldb_release_snapshot(db, snap);
   }
 
+  StartPhase("deleterange");
+  {
+    leveldb_put(db, woptions, "bat", 3, "x", 1, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "baz", 3, "y", 1, &err);
+    CheckNoError(err);
+    leveldb_delete_range(db, woptions, "bat", 3, "baz", 3, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "bat", NULL);
+    CheckGet(db, roptions, "baz", "y");
+    leveldb_writebatch_t* wb = leveldb_writebatch_create();
+    leveldb_writebatch_delete_range(wb, "baz", 3, "bb", 2);
+    leveldb_write(db, woptions, wb, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "baz", NULL);
+    CheckGet(db, roptions, "box", "c");
+    leveldb_writebatch_destroy(wb);
+  }
+
   StartPhase("repair");
   {
     leveldb_close(db);
@@ -332,26 +408,38 @@ int main(int argc, char** argv) {
     CheckGet(db, roptions, "foo", NULL);
     CheckGet(db, roptions, "bar", NULL);
     CheckGet(db, roptions, "box", "c");
+    CheckGet(db, roptions, "baz", NULL);
     leveldb_options_set_create_if_missing(options, 1);
     leveldb_options_set_error_if_exists(options, 1);
   }
 
   StartPhase("filter");
-  for (run = 0; run < 2; run++) {
-    // First run uses custom filter, second run uses bloom filter
+  for (run = 0; run < 4; run++) {
+    // First run uses custom filter, the others use the built-in filters
     CheckNoError(err);
     leveldb_filterpolicy_t* policy;
+    leveldb_slicetransform_t* prefix_extractor = NULL;
     if (run == 0) {
       policy = leveldb_filterpolicy_create(
           NULL, FilterDestroy, FilterCreate, FilterKeyMatch, FilterName);
-    } else {
+    } else if (run == 1) {
       policy = leveldb_filterpolicy_create_bloom(10);
+    } else if (run == 2) {
+      policy = leveldb_filterpolicy_create_cache_local_bloom(10);
+    } else {
+      policy = leveldb_filterpolicy_create_ribbon(10);
+      prefix_extractor = leveldb_slicetransform_create_fixed_prefix(2);
     }
 
     // Create new database
     leveldb_close(db);
     leveldb_destroy_db(options, dbname, &err);
     leveldb_options_set_filter_policy(options, policy);
+    leveldb_options_set_full_table_filter(options, run == 3);
+    leveldb_options_set_prefix_extractor(options, prefix_extractor);
+    leveldb_options_set_partition_index_and_filters(options, run == 2);
+    leveldb_options_set_cache_index_and_filter_blocks(options, run == 1);
+    leveldb_options_set_pin_l0_filter_and_index_blocks_in_cache(options, run == 1);
     db = leveldb_open(options, dbname, &err);
     CheckNoError(err);
     leveldb_put(db, woptions, "foo", 3, "foovalue", 8, &err);
@@ -373,8 +461,31 @@ int main(int argc, char** argv) {
       CheckGet(db, roptions, "foo", "foovalue");
       CheckGet(db, roptions, "bar", "barvalue");
     }
+    if (prefix_extractor != NULL) {
+      // Iteration stops at the end of the prefix of the target
+      leveldb_readoptions_t* prefix_roptions = leveldb_readoptions_create();
+      leveldb_readoptions_set_prefix_same_as_start(prefix_roptions, 1);
+      leveldb_iterator_t* iter = leveldb_create_iterator(db, prefix_roptions);
+      leveldb_iter_seek(iter, "ba", 2);
+      CheckCondition(leveldb_iter_valid(iter));
+      CheckIter(iter, "bar", "barvalue");
+      leveldb_iter_next(iter);
+      CheckCondition(!leveldb_iter_valid(iter));
+      leveldb_iter_seek(iter, "fa", 2);
+      CheckCondition(!leveldb_iter_valid(iter));
+      leveldb_iter_destroy(iter);
+      leveldb_readoptions_destroy(prefix_roptions);
+    }
     leveldb_options_set_filter_policy(options, NULL);
+    leveldb_options_set_full_table_filter(options, 0);
+    leveldb_options_set_prefix_extractor(options, NULL);
+    leveldb_options_set_partition_index_and_filters(options, 0);
+    leveldb_options_set_cache_index_and_filter_blocks(options, 0);
+    leveldb_options_set_pin_l0_filter_and_index_blocks_in_cache(options, 0);
     leveldb_filterpolicy_destroy(policy);
+    if (prefix_extractor != NULL) {
+      leveldb_slicetransform_destroy(prefix_extractor);
+    }
   }
 
   StartPhase("cleanup");
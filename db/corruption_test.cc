@@ -260,6 +260,42 @@ TEST(CorruptionTest, TableFileRepair) {
   Check(95, 99);
 }
 
+TEST(CorruptionTest, TableFileMultiGet) {
+  options_.block_size = 2 * kValueSize;  // Limit scope of corruption
+  Reopen();
+  Build(100);
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+  dbi->TEST_CompactMemTable();
+
+  Corrupt(kTableFile, 100, 1);
+
+  // Only the keys in the corrupted block fail; the rest of the batch,
+  // which was read from the same table, must still be found.
+  std::vector<std::string> key_space(100);
+  std::vector<Slice> keys;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(Key(i, &key_space[i]));
+  }
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  ReadOptions read_options;
+  read_options.verify_checksums = true;
+  db_->MultiGet(read_options, keys, &values, &statuses);
+  ASSERT_EQ(100u, statuses.size());
+  int failed = 0;
+  std::string value_space;
+  for (int i = 0; i < 100; i++) {
+    if (statuses[i].ok()) {
+      ASSERT_EQ(Value(i, &value_space).ToString(), values[i]);
+    } else {
+      ASSERT_TRUE(statuses[i].IsCorruption()) << statuses[i].ToString();
+      failed++;
+    }
+  }
+  ASSERT_GE(failed, 1);
+  ASSERT_LE(failed, 3);
+}
+
 TEST(CorruptionTest, TableFileIndexData) {
   Build(10000);  // Enough to build multiple Tables
   DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
@@ -33,13 +33,27 @@
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
+//      readseqoverlap -- fill a fresh DB in random order with many
+//                       overlapping tables, most in level-0, and read it
+//                       sequentially (single-threaded)
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      crc32cimpls   -- GB/s of each crc32c implementation on 4K and 64K
+//                       buffers (* marks the one crc32c uses)
 //      acquireload   -- load N*1000 times
+//      snappycomp    -- compress 1G of 4K blocks with snappy
+//      snappyuncomp  -- uncompress 1G of 4K blocks with snappy
+//      zstdcomp, zstduncomp, lz4comp, lz4uncomp
+//                    -- the same for zstd (--zstd_compression_level) and lz4
+//      zstddictcomp  -- zstd on 4K blocks of small JSON-like records, with
+//                       and without a dictionary (--zstd_dictionary_size)
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
+//      secondarycachestats -- Print secondary block cache counters
+//      readstats   -- Print read counters (filters, block cache, levels)
+//      histograms  -- Print latency histograms kept by the DB
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks =
     "fillseq,"
@@ -56,6 +70,7 @@ static const char* FLAGS_benchmarks =
     "readreverse,"
     "fill100K,"
     "crc32c,"
+    "crc32cimpls,"
     "snappycomp,"
     "snappyuncomp,"
     "acquireload,"
@@ -84,17 +99,94 @@ static bool FLAGS_histogram = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Let the writers of a group insert their batches into the memtable in
+// parallel (initialized to default value by "main")
+static bool FLAGS_allow_concurrent_memtable_write = false;
+
+// Overlap the log write of one writer group with the memtable insert of
+// the previous one (initialized to default value by "main")
+static bool FLAGS_enable_pipelined_write = false;
+
+// Write and sync the log from a dedicated thread, sharing each sync
+// between writer groups (initialized to default value by "main")
+static bool FLAGS_enable_log_flusher = false;
+
 // Number of bytes to use as a cache of uncompressed data.
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Fraction of the cache kept for index and filter blocks and for data
+// blocks that were read more than once.  Zero means a plain LRU cache.
+static double FLAGS_cache_high_pri_pool_ratio = 0;
+
+// Block cache implementation: "lru" or "clock".
+static const char* FLAGS_cache_type = "lru";
+
+// Block cache shards are 2^cache_numshardbits (clock cache only).
+static int FLAGS_cache_numshardbits = 4;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// Maximum number of concurrent background compactions
+static int FLAGS_max_background_compactions = 0;
+
+// Maximum number of threads one compaction may be split across
+static int FLAGS_max_subcompactions = 0;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// Filter built with FLAGS_bloom_bits: "bloom", "cache_local_bloom" or
+// "ribbon".
+static const char* FLAGS_filter_policy = "bloom";
+
+// Build one filter per table instead of one per 2KB of data blocks
+static bool FLAGS_full_table_filter = false;
+
+// Split table index and filter blocks into partitions of this many
+// bytes, loaded through the block cache.  Zero means do not partition.
+static int FLAGS_metadata_block_size = 0;
+
+// Keep table index and filter blocks in the block cache, charged
+// against its capacity, instead of outside of it.
+static bool FLAGS_cache_index_and_filter_blocks = false;
+
+// With --cache_index_and_filter_blocks, pin those of level-0 tables.
+static bool FLAGS_pin_l0_filter_and_index_blocks_in_cache = false;
+
+// If non-NULL, keep compressed blocks in a secondary cache tier of
+// --secondary_cache_size bytes under this directory.
+static const char* FLAGS_secondary_cache_path = NULL;
+static int FLAGS_secondary_cache_size = 1 << 30;
+
+// Block compression: "none", "snappy", "zstd" or "lz4".
+// NULL means use default settings.
+static const char* FLAGS_compression = NULL;
+
+// Comma separated compression type per level, e.g. "lz4,lz4,zstd".
+// NULL means use FLAGS_compression for every level.
+static const char* FLAGS_compression_per_level = NULL;
+
+// Compression level for zstd blocks
+static int FLAGS_zstd_compression_level = 0;
+
+// Maximum size of the zstd dictionary trained per table (0 = none)
+static int FLAGS_zstd_dictionary_size = 0;
+
+// Bytes sampled per table to train the zstd dictionary (0 = default)
+static int FLAGS_zstd_max_train_bytes = 0;
+
+// Read tables with O_DIRECT
+static bool FLAGS_use_direct_reads = false;
+
+// Write flush and compaction outputs with O_DIRECT
+static bool FLAGS_use_direct_io_for_flush_and_compaction = false;
+
+// Open log and table files with O_DSYNC
+static bool FLAGS_use_dsync_writes = false;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -110,6 +202,44 @@ namespace leveldb {
 
 namespace {
 
+// Parse a --compression style name.  Exits on unknown names.
+static CompressionType ParseCompressionType(const Slice& name) {
+  if (name == Slice("none")) {
+    return kNoCompression;
+  } else if (name == Slice("snappy")) {
+    return kSnappyCompression;
+  } else if (name == Slice("zstd")) {
+    return kZstdCompression;
+  } else if (name == Slice("lz4")) {
+    return kLZ4Compression;
+  }
+  fprintf(stderr, "unknown compression type '%s'\n", name.ToString().c_str());
+  exit(1);
+}
+
+static const FilterPolicy* NewFilterPolicy(const Slice& name, int bits) {
+  if (name == Slice("bloom")) {
+    return NewBloomFilterPolicy(bits);
+  } else if (name == Slice("cache_local_bloom")) {
+    return NewCacheLocalBloomFilterPolicy(bits);
+  } else if (name == Slice("ribbon")) {
+    return NewRibbonFilterPolicy(bits);
+  }
+  fprintf(stderr, "unknown filter policy '%s'\n", name.ToString().c_str());
+  exit(1);
+}
+
+static Cache* NewBlockCache() {
+  if (strcmp(FLAGS_cache_type, "lru") == 0) {
+    return NewLRUCache(FLAGS_cache_size, FLAGS_cache_high_pri_pool_ratio);
+  } else if (strcmp(FLAGS_cache_type, "clock") == 0) {
+    // Sized for blocks of the default 4K
+    return NewClockCache(FLAGS_cache_size, FLAGS_cache_numshardbits, 4096);
+  }
+  fprintf(stderr, "unknown cache type '%s'\n", FLAGS_cache_type);
+  exit(1);
+}
+
 // Helper for quickly generating random data.
 class RandomGenerator {
  private:
@@ -393,9 +523,9 @@ class Benchmark {
 
  public:
   Benchmark()
-  : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : NULL),
+  : cache_(FLAGS_cache_size >= 0 ? NewBlockCache() : NULL),
     filter_policy_(FLAGS_bloom_bits >= 0
-                   ? NewBloomFilterPolicy(FLAGS_bloom_bits)
+                   ? NewFilterPolicy(FLAGS_filter_policy, FLAGS_bloom_bits)
                    : NULL),
     db_(NULL),
     num_(FLAGS_num),
@@ -485,6 +615,9 @@ class Benchmark {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
         method = &Benchmark::SeekRandom;
+      } else if (name == Slice("readseqoverlap")) {
+        fresh_db = true;
+        method = &Benchmark::ReadSequentialOverlapping;
       } else if (name == Slice("readhot")) {
         method = &Benchmark::ReadHot;
       } else if (name == Slice("readrandomsmall")) {
@@ -501,18 +634,36 @@ class Benchmark {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
+      } else if (name == Slice("crc32cimpls")) {
+        method = &Benchmark::Crc32cImplementations;
       } else if (name == Slice("acquireload")) {
         method = &Benchmark::AcquireLoad;
       } else if (name == Slice("snappycomp")) {
         method = &Benchmark::SnappyCompress;
       } else if (name == Slice("snappyuncomp")) {
         method = &Benchmark::SnappyUncompress;
+      } else if (name == Slice("zstdcomp")) {
+        method = &Benchmark::ZstdCompress;
+      } else if (name == Slice("zstduncomp")) {
+        method = &Benchmark::ZstdUncompress;
+      } else if (name == Slice("lz4comp")) {
+        method = &Benchmark::LZ4Compress;
+      } else if (name == Slice("lz4uncomp")) {
+        method = &Benchmark::LZ4Uncompress;
+      } else if (name == Slice("zstddictcomp")) {
+        method = &Benchmark::ZstdDictionaryCompress;
       } else if (name == Slice("heapprofile")) {
         HeapProfile();
       } else if (name == Slice("stats")) {
         PrintStats("leveldb.stats");
       } else if (name == Slice("sstables")) {
         PrintStats("leveldb.sstables");
+      } else if (name == Slice("secondarycachestats")) {
+        PrintStats("leveldb.secondary-cache-stats");
+      } else if (name == Slice("readstats")) {
+        PrintStats("leveldb.stats.json");
+      } else if (name == Slice("histograms")) {
+        PrintStats("leveldb.histograms");
       } else {
         if (name != Slice()) {  // No error message for empty name
           fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
@@ -634,6 +785,42 @@ class Benchmark {
     thread->stats.AddMessage(label);
   }
 
+  void Crc32cImplementations(ThreadState* thread) {
+    // Crc32c() uses the fastest implementation the CPU supports; time
+    // each one on its own, on 4K and 64K buffers, so they can be compared.
+    const int size = 4096;
+    std::string big(64 * 1024, 'x');
+    int64_t bytes = 0;
+    uint32_t crc = 0;
+    for (int i = 0; i < crc32c::kNumImplementations; i++) {
+      crc32c::Implementation impl = static_cast<crc32c::Implementation>(i);
+      if (!crc32c::IsSupported(impl)) {
+        continue;
+      }
+      const int sizes[2] = { size, static_cast<int>(big.size()) };
+      for (int j = 0; j < 2; j++) {
+        const uint64_t start = Env::Default()->NowMicros();
+        int64_t done = 0;
+        while (done < 200 * 1048576) {
+          crc = crc32c::ExtendWith(impl, crc, big.data(), sizes[j]);
+          done += sizes[j];
+        }
+        const uint64_t micros = Env::Default()->NowMicros() - start;
+        bytes += done;
+        thread->stats.FinishedSingleOp();
+        char buf[100];
+        snprintf(buf, sizeof(buf), "%s%s %dK: %.2f GB/s;",
+                 (impl == crc32c::DefaultImplementation() ? "*" : ""),
+                 crc32c::ImplementationName(impl), sizes[j] / 1024,
+                 done / 1073741824.0 / ((micros > 0 ? micros : 1) * 1e-6));
+        thread->stats.AddMessage(buf);
+      }
+    }
+    // Print so result is not dead
+    fprintf(stderr, "... crc=0x%x\r", static_cast<unsigned int>(crc));
+    thread->stats.AddBytes(bytes);
+  }
+
   void AcquireLoad(ThreadState* thread) {
     int dummy;
     port::AtomicPointer ap(&dummy);
@@ -650,7 +837,139 @@ class Benchmark {
     if (ptr == NULL) exit(1); // Disable unused variable warning.
   }
 
+  static bool CompressWith(CompressionType type, const Slice& input,
+                           std::string* output) {
+    switch (type) {
+      case kSnappyCompression:
+        return port::Snappy_Compress(input.data(), input.size(), output);
+      case kZstdCompression:
+        return port::Zstd_Compress(FLAGS_zstd_compression_level,
+                                   input.data(), input.size(), output);
+      case kLZ4Compression:
+        return port::LZ4_Compress(input.data(), input.size(), output);
+      default:
+        return false;
+    }
+  }
+
+  static bool UncompressWith(CompressionType type, const std::string& input,
+                             char* output) {
+    switch (type) {
+      case kSnappyCompression:
+        return port::Snappy_Uncompress(input.data(), input.size(), output);
+      case kZstdCompression:
+        return port::Zstd_Uncompress(input.data(), input.size(), output);
+      case kLZ4Compression:
+        return port::LZ4_Uncompress(input.data(), input.size(), output);
+      default:
+        return false;
+    }
+  }
+
   void SnappyCompress(ThreadState* thread) {
+    Compress(thread, kSnappyCompression, "snappy");
+  }
+
+  void SnappyUncompress(ThreadState* thread) {
+    Uncompress(thread, kSnappyCompression, "snappy");
+  }
+
+  void ZstdCompress(ThreadState* thread) {
+    Compress(thread, kZstdCompression, "zstd");
+  }
+
+  void ZstdUncompress(ThreadState* thread) {
+    Uncompress(thread, kZstdCompression, "zstd");
+  }
+
+  void LZ4Compress(ThreadState* thread) {
+    Compress(thread, kLZ4Compression, "lz4");
+  }
+
+  void LZ4Uncompress(ThreadState* thread) {
+    Uncompress(thread, kLZ4Compression, "lz4");
+  }
+
+  void ZstdDictionaryCompress(ThreadState* thread) {
+    // 100-300 byte records that share field names and value formats,
+    // packed into 4K blocks like a table builder would.
+    Random rnd(301);
+    const size_t kBlockSize = Options().block_size;
+    std::vector<std::string> blocks(1);
+    size_t raw_bytes = 0;
+    while (raw_bytes < 32 * 1048576) {
+      char record[400];
+      const int id = rnd.Next() % 1000000;
+      int len = snprintf(record, sizeof(record),
+                         "{\"id\":%d,\"user\":\"user_%06d\",\"email\":"
+                         "\"user_%06d@example.com\",\"score\":%d.%03d,"
+                         "\"active\":%s,\"tags\":[",
+                         id, id, id, rnd.Uniform(100), rnd.Uniform(1000),
+                         rnd.OneIn(2) ? "true" : "false");
+      const int tags = rnd.Uniform(8);
+      for (int t = 0; t < tags; t++) {
+        static const char* kTags[] = { "alpha", "beta", "gamma", "delta",
+                                       "staging", "production", "eu-west" };
+        len += snprintf(record + len, sizeof(record) - len, "%s\"%s\"",
+                        t == 0 ? "" : ",", kTags[rnd.Uniform(7)]);
+      }
+      len += snprintf(record + len, sizeof(record) - len, "]}");
+      if (blocks.back().size() + len > kBlockSize) {
+        blocks.push_back(std::string());
+      }
+      blocks.back().append(record, len);
+      raw_bytes += len;
+    }
+
+    // Train on the first blocks, as the table builder does
+    const size_t dict_size =
+        FLAGS_zstd_dictionary_size > 0 ? FLAGS_zstd_dictionary_size : 16384;
+    std::string samples;
+    std::vector<size_t> sample_sizes;
+    for (size_t i = 0; i < blocks.size() && samples.size() < 100 * dict_size;
+         i++) {
+      samples.append(blocks[i]);
+      sample_sizes.push_back(blocks[i].size());
+    }
+    std::string dict_data;
+    if (!port::Zstd_TrainDictionary(samples, sample_sizes, dict_size,
+                                    &dict_data)) {
+      thread->stats.AddMessage("(zstd dictionary training failure)");
+      return;
+    }
+    port::ZstdDictionary dict(dict_data.data(), dict_data.size(), true,
+                              FLAGS_zstd_compression_level);
+
+    int64_t bytes = 0;
+    int64_t plain = 0;
+    int64_t with_dict = 0;
+    bool ok = dict.ok();
+    std::string compressed;
+    for (size_t i = 0; ok && i < blocks.size(); i++) {
+      ok = port::Zstd_Compress(FLAGS_zstd_compression_level, blocks[i].data(),
+                               blocks[i].size(), &compressed);
+      plain += compressed.size();
+      ok = ok && dict.Compress(blocks[i].data(), blocks[i].size(),
+                               &compressed);
+      with_dict += compressed.size();
+      bytes += blocks[i].size();
+      thread->stats.FinishedSingleOp();
+    }
+
+    if (!ok) {
+      thread->stats.AddMessage("(zstd failure)");
+    } else {
+      char buf[100];
+      snprintf(buf, sizeof(buf),
+               "(output: %.1f%% plain, %.1f%% with %d byte dictionary)",
+               (plain * 100.0) / bytes, (with_dict * 100.0) / bytes,
+               static_cast<int>(dict_data.size()));
+      thread->stats.AddMessage(buf);
+      thread->stats.AddBytes(bytes);
+    }
+  }
+
+  void Compress(ThreadState* thread, CompressionType type, const char* name) {
     RandomGenerator gen;
     Slice input = gen.Generate(Options().block_size);
     int64_t bytes = 0;
@@ -658,14 +977,16 @@ class Benchmark {
     bool ok = true;
     std::string compressed;
     while (ok && bytes < 1024 * 1048576) {  // Compress 1G
-      ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+      ok = CompressWith(type, input, &compressed);
       produced += compressed.size();
       bytes += input.size();
       thread->stats.FinishedSingleOp();
     }
 
     if (!ok) {
-      thread->stats.AddMessage("(snappy failure)");
+      char buf[100];
+      snprintf(buf, sizeof(buf), "(%s failure)", name);
+      thread->stats.AddMessage(buf);
     } else {
       char buf[100];
       snprintf(buf, sizeof(buf), "(output: %.1f%%)",
@@ -675,23 +996,24 @@ class Benchmark {
     }
   }
 
-  void SnappyUncompress(ThreadState* thread) {
+  void Uncompress(ThreadState* thread, CompressionType type, const char* name) {
     RandomGenerator gen;
     Slice input = gen.Generate(Options().block_size);
     std::string compressed;
-    bool ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+    bool ok = CompressWith(type, input, &compressed);
     int64_t bytes = 0;
     char* uncompressed = new char[input.size()];
     while (ok && bytes < 1024 * 1048576) {  // Compress 1G
-      ok =  port::Snappy_Uncompress(compressed.data(), compressed.size(),
-                                    uncompressed);
+      ok = UncompressWith(type, compressed, uncompressed);
       bytes += input.size();
       thread->stats.FinishedSingleOp();
     }
     delete[] uncompressed;
 
     if (!ok) {
-      thread->stats.AddMessage("(snappy failure)");
+      char buf[100];
+      snprintf(buf, sizeof(buf), "(%s failure)", name);
+      thread->stats.AddMessage(buf);
     } else {
       thread->stats.AddBytes(bytes);
     }
@@ -703,9 +1025,48 @@ class Benchmark {
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.allow_concurrent_memtable_write =
+        FLAGS_allow_concurrent_memtable_write;
+    options.enable_pipelined_write = FLAGS_enable_pipelined_write;
+    options.enable_log_flusher = FLAGS_enable_log_flusher;
     options.max_open_files = FLAGS_open_files;
+    options.max_background_compactions = FLAGS_max_background_compactions;
+    options.max_subcompactions = FLAGS_max_subcompactions;
     options.filter_policy = filter_policy_;
+    options.full_table_filter = FLAGS_full_table_filter;
+    if (FLAGS_metadata_block_size > 0) {
+      options.partition_index_and_filters = true;
+      options.metadata_block_size = FLAGS_metadata_block_size;
+    }
+    options.cache_index_and_filter_blocks = FLAGS_cache_index_and_filter_blocks;
+    options.pin_l0_filter_and_index_blocks_in_cache =
+        FLAGS_pin_l0_filter_and_index_blocks_in_cache;
+    if (FLAGS_secondary_cache_path != NULL) {
+      options.secondary_cache_path = FLAGS_secondary_cache_path;
+      options.secondary_cache_size = FLAGS_secondary_cache_size;
+    }
     options.reuse_logs = FLAGS_reuse_logs;
+    if (FLAGS_compression != NULL) {
+      options.compression = ParseCompressionType(FLAGS_compression);
+    }
+    if (FLAGS_compression_per_level != NULL) {
+      Slice list(FLAGS_compression_per_level);
+      while (!list.empty()) {
+        const char* comma = static_cast<const char*>(
+            memchr(list.data(), ',', list.size()));
+        const size_t len = (comma == NULL) ? list.size() : comma - list.data();
+        options.compression_per_level.push_back(
+            ParseCompressionType(Slice(list.data(), len)));
+        list.remove_prefix(comma == NULL ? len : len + 1);
+      }
+    }
+    options.zstd_compression_level = FLAGS_zstd_compression_level;
+    options.zstd_dictionary_size = FLAGS_zstd_dictionary_size;
+    options.zstd_max_train_bytes = FLAGS_zstd_max_train_bytes;
+    options.use_direct_reads = FLAGS_use_direct_reads;
+    options.use_direct_io_for_flush_and_compaction =
+        FLAGS_use_direct_io_for_flush_and_compaction;
+    options.use_dsync_writes = FLAGS_use_dsync_writes;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -846,6 +1207,116 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  // Keeps the threads of the LOW priority pool, where compactions run,
+  // busy until Release(), while memtable flushes still run in the HIGH
+  // pool.
+  class CompactionBlocker {
+   public:
+    CompactionBlocker()
+        : cv_(&mu_),
+          threads_(Env::Default()->GetBackgroundThreads(Env::LOW)),
+          started_(0),
+          finished_(0),
+          released_(false) {
+      for (int i = 0; i < threads_; i++) {
+        Env::Default()->ScheduleWithPriority(&Block, this, Env::LOW, NULL);
+      }
+      MutexLock l(&mu_);
+      while (started_ < threads_) {
+        cv_.Wait();
+      }
+    }
+
+    void Release() {
+      MutexLock l(&mu_);
+      released_ = true;
+      cv_.SignalAll();
+      while (finished_ < threads_) {
+        cv_.Wait();
+      }
+    }
+
+   private:
+    static void Block(void* arg) {
+      CompactionBlocker* b = reinterpret_cast<CompactionBlocker*>(arg);
+      MutexLock l(&b->mu_);
+      b->started_++;
+      b->cv_.SignalAll();
+      while (!b->released_) {
+        b->cv_.Wait();
+      }
+      b->finished_++;
+      b->cv_.SignalAll();
+    }
+
+    port::Mutex mu_;
+    port::CondVar cv_;
+    const int threads_;
+    int started_;
+    int finished_;
+    bool released_;
+  };
+
+  // Spread the entries over config::kL0_StopWritesTrigger flushed tables
+  // and the memtable with compactions held back, so that the scan merges
+  // them all: the first two tables go to levels 2 and 1, the others stay
+  // in level-0.  Each table gets at most half a write buffer of entries so
+  // that no extra flush can fill level-0 up and stop the writes.
+  void ReadSequentialOverlapping(ThreadState* thread) {
+    if (thread->tid > 0) {
+      return;
+    }
+    const int tables = config::kL0_StopWritesTrigger;
+    int per_table = num_ / (tables + 1);
+    const int max_per_table =
+        FLAGS_write_buffer_size / (2 * (16 + value_size_));
+    if (per_table > max_per_table) {
+      per_table = max_per_table;
+    }
+    const int kBatchSize = 1000;  // Few writes to delay at 8 level-0 files
+
+    CompactionBlocker blocker;
+    RandomGenerator gen;
+    WriteBatch batch;
+    for (int t = 0; t <= tables; t++) {
+      for (int i = 0; i < per_table; i += kBatchSize) {
+        batch.Clear();
+        for (int j = i; j < per_table && j < i + kBatchSize; j++) {
+          char key[100];
+          snprintf(key, sizeof(key), "%016d", thread->rand.Next() % FLAGS_num);
+          batch.Put(key, gen.Generate(value_size_));
+        }
+        Status s = db_->Write(write_options_, &batch);
+        if (!s.ok()) {
+          fprintf(stderr, "put error: %s\n", s.ToString().c_str());
+          exit(1);
+        }
+      }
+      if (t < tables) {
+        reinterpret_cast<DBImpl*>(db_)->TEST_CompactMemTable();
+      }
+    }
+    std::string level0_files;
+    db_->GetProperty("leveldb.num-files-at-level0", &level0_files);
+
+    // Only time the scan
+    thread->stats.Start();
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int i = 0;
+    int64_t bytes = 0;
+    for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
+      bytes += iter->key().size() + iter->value().size();
+      thread->stats.FinishedSingleOp();
+      ++i;
+    }
+    delete iter;
+    blocker.Release();
+    thread->stats.AddBytes(bytes);
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%s files in level-0)", level0_files.c_str());
+    thread->stats.AddMessage(msg);
+  }
+
   void DoDelete(ThreadState* thread, bool seq) {
     RandomGenerator gen;
     WriteBatch batch;
@@ -943,7 +1414,15 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_allow_concurrent_memtable_write =
+      leveldb::Options().allow_concurrent_memtable_write;
+  FLAGS_enable_pipelined_write = leveldb::Options().enable_pipelined_write;
+  FLAGS_enable_log_flusher = leveldb::Options().enable_log_flusher;
   FLAGS_open_files = leveldb::Options().max_open_files;
+  FLAGS_max_background_compactions =
+      leveldb::Options().max_background_compactions;
+  FLAGS_max_subcompactions = leveldb::Options().max_subcompactions;
+  FLAGS_zstd_compression_level = leveldb::Options().zstd_compression_level;
   std::string default_db_path;
 
   for (int i = 1; i < argc; i++) {
@@ -973,12 +1452,74 @@ int main(int argc, char** argv) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--allow_concurrent_memtable_write=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_allow_concurrent_memtable_write = n;
+    } else if (sscanf(argv[i], "--enable_pipelined_write=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_enable_pipelined_write = n;
+    } else if (sscanf(argv[i], "--enable_log_flusher=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_enable_log_flusher = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c",
+                      &d, &junk) == 1 && d >= 0 && d <= 1) {
+      FLAGS_cache_high_pri_pool_ratio = d;
+    } else if (strncmp(argv[i], "--cache_type=", 13) == 0) {
+      FLAGS_cache_type = argv[i] + 13;
+    } else if (sscanf(argv[i], "--cache_numshardbits=%d%c", &n, &junk) == 1 &&
+               n >= 0 && n <= 20) {
+      FLAGS_cache_numshardbits = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (sscanf(argv[i], "--max_background_compactions=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_max_background_compactions = n;
+    } else if (sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) == 1) {
+      FLAGS_max_subcompactions = n;
+    } else if (strncmp(argv[i], "--filter_policy=", 16) == 0) {
+      FLAGS_filter_policy = argv[i] + 16;
+    } else if (sscanf(argv[i], "--full_table_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_full_table_filter = n;
+    } else if (sscanf(argv[i], "--metadata_block_size=%d%c", &n, &junk) == 1) {
+      FLAGS_metadata_block_size = n;
+    } else if (sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_cache_index_and_filter_blocks = n;
+    } else if (sscanf(argv[i], "--pin_l0_filter_and_index_blocks_in_cache=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_pin_l0_filter_and_index_blocks_in_cache = n;
+    } else if (strncmp(argv[i], "--secondary_cache_path=", 23) == 0) {
+      FLAGS_secondary_cache_path = argv[i] + 23;
+    } else if (sscanf(argv[i], "--secondary_cache_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_secondary_cache_size = n;
+    } else if (strncmp(argv[i], "--compression=", 14) == 0) {
+      FLAGS_compression = argv[i] + 14;
+    } else if (strncmp(argv[i], "--compression_per_level=", 24) == 0) {
+      FLAGS_compression_per_level = argv[i] + 24;
+    } else if (sscanf(argv[i], "--zstd_compression_level=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_zstd_compression_level = n;
+    } else if (sscanf(argv[i], "--zstd_dictionary_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_zstd_dictionary_size = n;
+    } else if (sscanf(argv[i], "--zstd_max_train_bytes=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_zstd_max_train_bytes = n;
+    } else if (sscanf(argv[i], "--use_direct_reads=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_reads = n;
+    } else if (sscanf(argv[i], "--use_direct_io_for_flush_and_compaction=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_use_direct_io_for_flush_and_compaction = n;
+    } else if (sscanf(argv[i], "--use_dsync_writes=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_dsync_writes = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else {
@@ -17,6 +17,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -32,6 +33,7 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/secondary_cache.h"
 
 namespace leveldb 
 {
@@ -46,7 +48,28 @@ struct DBImpl::Writer
   bool sync;
   bool done;
   port::CondVar cv;
-  explicit Writer(port::Mutex* mu) : cv(mu)
+
+  // With allow_concurrent_memtable_write, the group leader sets mem to
+  // ask this writer to insert its own batch; the writer then decrements
+  // leader->pending_inserts.  pending_inserts is only used by the leader.
+  MemTable* mem;
+  Writer* leader;
+  int pending_inserts;
+
+  // With enable_pipelined_write, set once the writer's group has been
+  // logged and taken off writers_.  last_sequence is the last sequence
+  // number of the group, kept on its leader.
+  bool logged;
+  SequenceNumber last_sequence;
+
+  // Also kept on the leader while its group is in memtable_writers_: the
+  // writers of the group and, with a log flusher, the log offset that
+  // must be written out before the group may be inserted.  The leader
+  // fills group, and it is emptied again by whichever leader inserts it.
+  std::vector<Writer*> group;
+  uint64_t log_offset;
+
+  explicit Writer(port::Mutex* mu) : cv(mu), mem(NULL), leader(NULL), pending_inserts(0), logged(false), last_sequence(0), log_offset(0)
   {
 
   }
@@ -68,6 +91,7 @@ struct DBImpl::CompactionState
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
   };
   std::vector<Output> outputs;
 
@@ -77,21 +101,83 @@ struct DBImpl::CompactionState
 
   uint64_t total_bytes;
 
+  // Range of user keys [start, end) handled by this state when the
+  // compaction is split into subcompactions.  Empty means unbounded.
+  Slice start;
+  Slice end;
+
+  // Position of this (sub)compaction within Compaction's grandparent and
+  // higher-level files
+  Compaction::Progress progress;
+
+  // Range tombstones of the compaction inputs, or NULL if there are
+  // none.  Owned by DoCompactionWork() and shared by subcompactions.
+  // Each output takes the pieces from output_lower (unbounded if
+  // !has_output_lower) up to the first user key of the next output.
+  const RangeTombstones* range_deletions;
+  std::string output_lower;
+  bool has_output_lower;
+
+  Status status;
+  int64_t imm_micros;  // Micros spent doing imm_ compactions
+
   Output* current_output() 
   { 
 	  return &outputs[outputs.size()-1]; 
   }
 
+  // Store in *result the range tombstones that the next output must keep
+  // for user keys below *upper (NULL means up to "end").  A tombstone no
+  // snapshot needs is left out once no deeper level overlaps it.
+  void KeptRangeDeletions(const Slice* upper, std::vector<RangeTombstones::Tombstone>* result)
+  {
+    result->clear();
+    if (range_deletions == NULL)
+    {
+      return;
+    }
+    if (upper == NULL && !end.empty())
+    {
+      upper = &end;
+    }
+    Slice lower(output_lower);
+    std::vector<RangeTombstones::Tombstone> pieces;
+    range_deletions->GetOverlapping(has_output_lower ? &lower : NULL, upper, &pieces);
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+      const RangeTombstones::Tombstone& t = pieces[i];
+      if (t.sequence > smallest_snapshot || !compaction->IsBaseLevelForRange(t.begin, t.end))
+      {
+        result->push_back(t);
+      }
+    }
+  }
+
   explicit CompactionState(Compaction* c)
       : compaction(c),
         outfile(NULL),
         builder(NULL),
-        total_bytes(0) 
+        total_bytes(0),
+        range_deletions(NULL),
+        has_output_lower(false),
+        imm_micros(0) 
   {
 
   }
 };
 
+// The subcompactions of one compaction.  DoCompactionWork() and the
+// helpers it schedules in the LOW pool take them in order until none
+// are left.  Protected by db->mutex_.
+struct DBImpl::SubcompactionWork
+{
+  DBImpl* db;
+  std::vector<CompactionState*> subs;
+  size_t next;   // First subcompaction not taken yet
+  int running;   // Subcompactions taken but not finished
+  int refs;      // DoCompactionWork() plus the helpers not finished yet
+};
+
 // Fix user-supplied options to be reasonable
 template <class T,class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) 
@@ -102,14 +188,18 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue)
 	  *ptr = minvalue;
 }
 //调整用户传入的Option使其合法
-Options SanitizeOptions(const std::string& dbname, const InternalKeyComparator* icmp, const InternalFilterPolicy* ipolicy, const Options& src)
+Options SanitizeOptions(const std::string& dbname, const InternalKeyComparator* icmp, const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix, const Options& src)
 {
   Options result = src;
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != NULL) ? ipolicy : NULL;
+  result.prefix_extractor = (src.prefix_extractor != NULL) ? iprefix : NULL;
   ClipToRange(&result.max_open_files,    64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.max_background_compactions, 1,                   64);
+  ClipToRange(&result.max_subcompactions, 1,                           64);
   if (result.info_log == NULL) 
   {
     // Open a log file in the same directory as the db
@@ -133,14 +223,46 @@ Options SanitizeOptions(const std::string& dbname, const InternalKeyComparator*
   return result;
 }
 
+// Options for building a table that will live in "level": the same as
+// "options" except for the codec picked from compression_per_level.
+static Options TableOptionsForLevel(const Options& options, int level)
+{
+  Options result = options;
+  const std::vector<CompressionType>& per_level = options.compression_per_level;
+  if (!per_level.empty())
+  {
+    result.compression = per_level[std::min<size_t>(level, per_level.size() - 1)];
+  }
+  return result;
+}
+
+// Create (or, if "append", reopen) a log file, with O_DSYNC if
+// options.use_dsync_writes.
+static Status NewLogFile(Env* env, const Options& options, const std::string& fname,
+                         bool append, WritableFile** result)
+{
+  if (!options.use_dsync_writes)
+  {
+    return append ? env->NewAppendableFile(fname, result) : env->NewWritableFile(fname, result);
+  }
+  FileOptions file_options;
+  file_options.use_dsync = true;
+  return append ? env->NewAppendableFileWithOptions(fname, file_options, result)
+                : env->NewWritableFileWithOptions(fname, file_options, result);
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
       internal_filter_policy_(raw_options.filter_policy),
-      options_(SanitizeOptions(dbname, &internal_comparator_, &internal_filter_policy_, raw_options)),
+      internal_prefix_extractor_(raw_options.prefix_extractor),
+      options_(SanitizeOptions(dbname, &internal_comparator_, &internal_filter_policy_, &internal_prefix_extractor_,
+                               raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
+      secondary_cache_(NULL),
+      statistics_(config::kNumLevels),
       db_lock_(NULL),
       shutting_down_(NULL),
       bg_cv_(&mutex_),
@@ -149,17 +271,42 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_(NULL),
       logfile_number_(0),
       log_(NULL),
+      log_flusher_(NULL),
       seed_(0),
       tmp_batch_(new WriteBatch),
-      bg_compaction_scheduled_(false),
-      manual_compaction_(NULL)
+      bg_compactions_scheduled_(0),
+      bg_flush_scheduled_(false),
+      imm_flush_running_(false),
+      manifest_writing_(false),
+      ingesting_(false),
+      manual_compaction_(NULL),
+      running_compactions_(0),
+      max_running_compactions_(0),
+      compacting_files_disjoint_(true)
 {
   has_imm_.Release_Store(NULL);
 
+  if (!options_.secondary_cache_path.empty())
+  {
+    Status s = SecondaryCache::Open(env_, options_.secondary_cache_path,
+                                    options_.secondary_cache_size, &secondary_cache_);
+    if (!s.ok())
+    {
+      // Work without the tier
+      Log(options_.info_log, "Secondary cache disabled: %s", s.ToString().c_str());
+    }
+  }
+
   // Reserve ten files or so for other uses and give the rest to TableCache.
   const int table_cache_size = options_.max_open_files - kNumNonTableCacheFiles;
-  table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
+  table_cache_ = new TableCache(dbname_, &options_, table_cache_size, secondary_cache_, &statistics_);
   versions_ = new VersionSet(dbname_, &options_, table_cache_, &internal_comparator_);
+
+  // Make sure the compaction pool can run the compactions we allow.
+  if (env_->GetBackgroundThreads(Env::LOW) < options_.max_background_compactions)
+  {
+    env_->SetBackgroundThreads(options_.max_background_compactions, Env::LOW);
+  }
 }
 
 DBImpl::~DBImpl() 
@@ -167,7 +314,14 @@ DBImpl::~DBImpl()
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-  while (bg_compaction_scheduled_) 
+  // Work that has not started yet would do nothing now; drop it rather
+  // than wait for it to reach the front of a shared queue.
+  if (env_->UnSchedule(this, Env::HIGH) > 0)
+  {
+    bg_flush_scheduled_ = false;
+  }
+  bg_compactions_scheduled_ -= env_->UnSchedule(this, Env::LOW);
+  while (bg_compactions_scheduled_ > 0 || bg_flush_scheduled_) 
   {
     bg_cv_.Wait();
   }
@@ -183,8 +337,10 @@ DBImpl::~DBImpl()
   if (imm_ != NULL) imm_->Unref();
   delete tmp_batch_;
   delete log_;
+  delete log_flusher_;
   delete logfile_;
   delete table_cache_;
+  delete secondary_cache_;
 
   if (owns_info_log_)
   {
@@ -505,7 +661,11 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 	{
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, NULL);
+      uint64_t file_number;
+      status = WriteLevel0Table(mem, edit, NULL, &file_number);
+      // No background work runs during recovery, so the file needs no
+      // protection until the edit is applied.
+      pending_outputs_.erase(file_number);
       mem->Unref();
       mem = NULL;
       if (!status.ok())
@@ -526,11 +686,11 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     assert(log_ == NULL);
     assert(mem_ == NULL);
     uint64_t lfile_size;
-    if (env_->GetFileSize(fname, &lfile_size).ok() && env_->NewAppendableFile(fname, &logfile_).ok())
+    WritableFile* lfile;
+    if (env_->GetFileSize(fname, &lfile_size).ok() && NewLogFile(env_, options_, fname, true, &lfile).ok())
 	{
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
-      logfile_number_ = log_number;
+      SetLogFile(lfile, log_number, lfile_size);
       if (mem != NULL) 
 	  {
         mem_ = mem;
@@ -551,28 +711,32 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (status.ok()) 
 	{
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, NULL);
+      uint64_t file_number;
+      status = WriteLevel0Table(mem, edit, NULL, &file_number);
+      pending_outputs_.erase(file_number);
     }
     mem->Unref();
   }
   return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base) 
+Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base, uint64_t* file_number) 
 {
   mutex_.AssertHeld();
   //获取当前时间微妙
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
+  *file_number = meta.number;
   pending_outputs_.insert(meta.number);
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->HasRangeDeletions() ? mem->NewRangeDeletionIterator() : NULL;
   //打印
   Log(options_.info_log, "Level-0 table #%llu: started", (unsigned long long) meta.number);
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, TableOptionsForLevel(options_, 0), table_cache_, iter, range_del_iter, &meta);
     mutex_.Lock();
   }
 
@@ -581,8 +745,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       (unsigned long long) meta.file_size,
       s.ToString().c_str());
   delete iter;
-  pending_outputs_.erase(meta.number);
-
+  delete range_del_iter;
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -598,13 +761,14 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
 	  */
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest, meta.largest);
+    edit->AddFile(level, meta.number, meta.file_size, meta.smallest, meta.largest, meta.has_range_deletions);
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
+  statistics_.MeasureTime(Statistics::kFlushMicros, stats.micros);
   return s;
 }
 
@@ -612,6 +776,13 @@ void DBImpl::CompactMemTable()
 {
   mutex_.AssertHeld();
   assert(imm_ != NULL);
+  if (imm_flush_running_)
+  {
+    // Another background thread is already writing imm_ out
+    return;
+  }
+  imm_flush_running_ = true;
+  has_imm_.Release_Store(NULL);  // Claimed; compactions need not check
 
   /*
 	保存imm数据到sstable中
@@ -619,7 +790,8 @@ void DBImpl::CompactMemTable()
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  uint64_t file_number;
+  Status s = WriteLevel0Table(imm_, &edit, base, &file_number);
   base->Unref();
 
   if (s.ok() && shutting_down_.Acquire_Load()) 
@@ -635,21 +807,41 @@ void DBImpl::CompactMemTable()
   {
     edit.SetPrevLogNumber(0);
     edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    s = LogAndApply(&edit);
   }
+  // LogAndApply() may wait for other threads' manifest writes, and their
+  // DeleteObsoleteFiles() must not remove the new table before it is live.
+  pending_outputs_.erase(file_number);
 
   if (s.ok()) 
   {
     //Commit to the new state
     imm_->Unref();
     imm_ = NULL;
-    has_imm_.Release_Store(NULL);
     DeleteObsoleteFiles();
   }
   else 
   {
     RecordBackgroundError(s);
+    has_imm_.Release_Store(imm_);
+  }
+  imm_flush_running_ = false;
+}
+
+Status DBImpl::LogAndApply(VersionEdit* edit)
+{
+  mutex_.AssertHeld();
+  // VersionSet::LogAndApply() releases mutex_ while writing the MANIFEST,
+  // so with several background threads the callers have to take turns.
+  while (manifest_writing_)
+  {
+    bg_cv_.Wait();
   }
+  manifest_writing_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  manifest_writing_ = false;
+  bg_cv_.SignalAll();
+  return s;
 }
 
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
@@ -734,28 +926,38 @@ void DBImpl::MaybeScheduleCompaction()
 {
   //确保已经加锁
   mutex_.AssertHeld();
-  //判断是否已经有了后台压缩进程在跑了
-  if (bg_compaction_scheduled_) 
-  {
-    // Already scheduled
-  }
-  else if (shutting_down_.Acquire_Load())
+  if (shutting_down_.Acquire_Load())
   {
     // DB is being deleted; no more background compactions
+    return;
   } 
-  else if (!bg_error_.ok()) 
+  if (!bg_error_.ok()) 
   {
     // Already got an error; no more changes
+    return;
+  }
+
+  //内存表的dump单独调度, 不会排在耗时较长的compaction后面
+  if (imm_ != NULL && !bg_flush_scheduled_ && !imm_flush_running_)
+  {
+    bg_flush_scheduled_ = true;
+    env_->ScheduleWithPriority(&DBImpl::BGWorkFlush, this, Env::HIGH, this);
   }
-  else if (imm_ == NULL && manual_compaction_ == NULL && !versions_->NeedsCompaction()) 
+
+  //每次最多新调度一个compaction; 它选中输入文件后会再调用本函数,
+  //从而在空闲槽位上启动下一个不相交的compaction
+  if (bg_compactions_scheduled_ >= options_.max_background_compactions) 
+  {
+    // Enough compactions already scheduled
+  }
+  else if (manual_compaction_ == NULL && !versions_->NeedsCompaction()) 
   {
     // No work to be done
   }
   else 
   {
-	//创建后台压缩线程
-    bg_compaction_scheduled_ = true;
-    env_->Schedule(&DBImpl::BGWork, this);
+    bg_compactions_scheduled_++;
+    env_->ScheduleWithPriority(&DBImpl::BGWork, this, Env::LOW, this);
   }
 }
 
@@ -764,10 +966,16 @@ void DBImpl::BGWork(void* db)
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
 
+void DBImpl::BGWorkFlush(void* db)
+{
+  reinterpret_cast<DBImpl*>(db)->BackgroundFlushCall();
+}
+
 void DBImpl::BackgroundCall() 
 {
   MutexLock l(&mutex_);
-  assert(bg_compaction_scheduled_);
+  assert(bg_compactions_scheduled_ > 0);
+  bool picked = false;
   if (shutting_down_.Acquire_Load())
   {
     // No more background work when shutting down.
@@ -776,22 +984,55 @@ void DBImpl::BackgroundCall()
   {
     // No more background work after a background error.
   } 
+  else if (ingesting_)
+  {
+    // IngestExternalFile() reschedules once its tables are installed.
+  }
   else 
   {
 	//做实际的compact逻辑
-    BackgroundCompaction();
+    picked = BackgroundCompaction();
   }
 
-  bg_compaction_scheduled_ = false;
+  bg_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
-  // so reschedule another compaction if needed.
+  // so reschedule another compaction if needed.  If nothing could be
+  // picked because every candidate is busy, the compactions still
+  // running will reschedule when they finish.
+  if (picked)
+  {
+    MaybeScheduleCompaction();
+  }
+  bg_cv_.SignalAll();
+}
+
+void DBImpl::BackgroundFlushCall()
+{
+  MutexLock l(&mutex_);
+  assert(bg_flush_scheduled_);
+  if (shutting_down_.Acquire_Load())
+  {
+    // No more background work when shutting down.
+  }
+  else if (!bg_error_.ok())
+  {
+    // No more background work after a background error.
+  }
+  else if (imm_ != NULL)
+  {
+    CompactMemTable();
+  }
+
+  bg_flush_scheduled_ = false;
+
+  // The new level-0 file may have made a compaction necessary.
   MaybeScheduleCompaction();
   bg_cv_.SignalAll();
 }
 
 /*
-	1. 存在自读内存, 压缩内存dump成sstable, 完成后直接返回
+	1. 内存表的dump由BackgroundFlushCall()单独处理
 
 	2. 如果存在外部触发的compact, 根据manual_compaction指定的level,start_key,end_key选出Compaction
 	为了避免外部指定的key-range过大, 一次compact过多的sstable文件, manual_compaction可能不会一次
@@ -800,19 +1041,10 @@ void DBImpl::BackgroundCall()
 
 	3. 非外部触发, 根据db当前的状态, 进行Compact
 */
-void DBImpl::BackgroundCompaction() 
+bool DBImpl::BackgroundCompaction() 
 {
   mutex_.AssertHeld();
 
-  /*
-	存在自读内存, 压缩内存dump成sstable, 完成后直接返回
-  */
-  if (imm_ != NULL)
-  {
-    CompactMemTable();
-    return;
-  }
-
   Compaction* c;
   bool is_manual = (manual_compaction_ != NULL);
   InternalKey manual_end;
@@ -824,6 +1056,12 @@ void DBImpl::BackgroundCompaction()
 	*/
     ManualCompaction* m = manual_compaction_;
     c = versions_->CompactRange(m->level, m->begin, m->end);
+    if (c == NULL && bg_compactions_scheduled_ > 1)
+    {
+      // The range may overlap a compaction that is still running; try
+      // again once it has finished (it will reschedule us).
+      return false;
+    }
     m->done = (c == NULL);
     if (c != NULL)
 	{
@@ -844,6 +1082,14 @@ void DBImpl::BackgroundCompaction()
     c = versions_->PickCompaction();
   }
 
+  const bool picked = (c != NULL);
+  if (picked && !is_manual)
+  {
+    // The inputs are marked as being compacted; let another thread look
+    // for a disjoint compaction meanwhile.
+    MaybeScheduleCompaction();
+  }
+
   Status status;
   if (c == NULL)
   {
@@ -858,8 +1104,9 @@ void DBImpl::BackgroundCompaction()
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest, f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
+    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest, f->largest, f->has_range_deletions,
+                       f->global_sequence);
+    status = LogAndApply(c->edit());
     if (!status.ok()) 
 	{
       RecordBackgroundError(status);
@@ -871,6 +1118,7 @@ void DBImpl::BackgroundCompaction()
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(),
         versions_->LevelSummary(&tmp));
+    c->MarkFilesBeingCompacted(false);
   }
   else
   {
@@ -879,12 +1127,35 @@ void DBImpl::BackgroundCompaction()
 		最后做异常情况的清理（DBImpl::CleanupCompaction()） 。
 	*/
     CompactionState* compact = new CompactionState(c);
+    running_compactions_++;
+    max_running_compactions_ = std::max(max_running_compactions_, running_compactions_);
+    for (int which = 0; which < 2; which++)
+    {
+      for (int i = 0; i < c->num_input_files(which); i++)
+      {
+        const uint64_t number = c->input(which, i)->number;
+        if (compacting_files_.count(number) > 0)
+        {
+          compacting_files_disjoint_ = false;
+        }
+        compacting_files_.insert(number);
+      }
+    }
     status = DoCompactionWork(compact);
+    for (int which = 0; which < 2; which++)
+    {
+      for (int i = 0; i < c->num_input_files(which); i++)
+      {
+        compacting_files_.erase(compacting_files_.find(c->input(which, i)->number));
+      }
+    }
+    running_compactions_--;
     if (!status.ok()) 
 	{
       RecordBackgroundError(status);
     }
     CleanupCompaction(compact);
+    c->MarkFilesBeingCompacted(false);
     c->ReleaseInputs();
     DeleteObsoleteFiles();
   }
@@ -920,6 +1191,7 @@ void DBImpl::BackgroundCompaction()
     }
     manual_compaction_ = NULL;
   }
+  return picked || is_manual;
 }
 
 void DBImpl::CleanupCompaction(CompactionState* compact) 
@@ -952,22 +1224,24 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s = NewTableFile(env_, options_, fname, &compact->outfile);
   if (s.ok())
   {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    compact->builder = new TableBuilder(TableOptionsForLevel(options_, compact->compaction->level() + 1), compact->outfile);
   }
   return s;
 }
 
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-                                          Iterator* input) {
+                                          Iterator* input,
+                                          const Slice* upper) {
   assert(compact != NULL);
   assert(compact->outfile != NULL);
   assert(compact->builder != NULL);
@@ -975,6 +1249,24 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   const uint64_t output_number = compact->current_output()->number;
   assert(output_number != 0);
 
+  // The key range of the output takes in its range tombstones
+  std::vector<RangeTombstones::Tombstone> tombstones;
+  compact->KeptRangeDeletions(upper, &tombstones);
+  CompactionState::Output* out = compact->current_output();
+  bool empty = (compact->builder->NumEntries() == 0);
+  for (size_t i = 0; i < tombstones.size(); i++) {
+    const RangeTombstones::Tombstone& t = tombstones[i];
+    InternalKey begin(t.begin, t.sequence, kTypeRangeDeletion);
+    compact->builder->AddRangeDeletion(begin.Encode(), t.end);
+    ExtendRangeForTombstone(&internal_comparator_, t.begin, t.end, t.sequence,
+                            &empty, &out->smallest, &out->largest);
+    out->has_range_deletions = true;
+  }
+  if (upper != NULL) {
+    compact->output_lower = upper->ToString();
+    compact->has_output_lower = true;
+  }
+
   // Check for iterator errors
   Status s = input->status();
   const uint64_t current_entries = compact->builder->NumEntries();
@@ -999,7 +1291,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = NULL;
 
-  if (s.ok() && current_entries > 0) {
+  if (s.ok() && (current_entries > 0 || !tombstones.empty())) {
     // Verify that the table is usable
     Iterator* iter = table_cache_->NewIterator(ReadOptions(),
                                                output_number,
@@ -1034,15 +1326,15 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     compact->compaction->edit()->AddFile(
         level + 1,
-        out.number, out.file_size, out.smallest, out.largest);
+        out.number, out.file_size, out.smallest, out.largest,
+        out.has_range_deletions);
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  return LogAndApply(compact->compaction->edit());
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact)
 {
   const uint64_t start_micros = env_->NowMicros();
-  int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
 
   Log(options_.info_log,  "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0),
@@ -1062,38 +1354,214 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
     compact->smallest_snapshot = snapshots_.oldest()->number_;
   }
 
-  // Release mutex while we're actually doing the compaction work
+  // Range tombstones of the inputs apply to every subcompaction
+  RangeTombstones* range_deletions = new RangeTombstones(user_comparator());
   mutex_.Unlock();
+  Status status = compact->compaction->AddRangeDeletions(range_deletions);
+  mutex_.Lock();
+  if (!status.ok()) {
+    delete range_deletions;
+    return status;
+  }
+  if (range_deletions->empty()) {
+    delete range_deletions;
+    range_deletions = NULL;
+  }
+  compact->range_deletions = range_deletions;
+
+  // Split the key space at level+1/grandparent file boundaries so that
+  // each range can be merged by its own thread.  subs[0] is "compact"
+  // itself.
+  std::vector<Slice> boundaries;
+  compact->compaction->GetSubcompactionBoundaries(options_.max_subcompactions, &boundaries);
+  std::vector<CompactionState*> subs;
+  subs.push_back(compact);
+  for (size_t i = 0; i < boundaries.size(); i++)
+  {
+    CompactionState* sub = new CompactionState(compact->compaction);
+    sub->smallest_snapshot = compact->smallest_snapshot;
+    sub->range_deletions = range_deletions;
+    sub->start = boundaries[i];
+    subs.back()->end = boundaries[i];
+    subs.push_back(sub);
+  }
+  if (subs.size() > 1)
+  {
+    Log(options_.info_log, "Compacting in %d subcompactions", static_cast<int>(subs.size()));
+  }
+
+  // Helpers only take free compaction slots of the LOW pool, so they
+  // count against max_background_compactions like any compaction.  This
+  // thread works through whatever subcompactions they do not get to.
+  SubcompactionWork* work = new SubcompactionWork;
+  work->db = this;
+  work->subs = subs;
+  work->next = 0;
+  work->running = 0;
+  work->refs = 1;
+  const int helpers = std::min(static_cast<int>(subs.size()) - 1,
+                               options_.max_background_compactions - bg_compactions_scheduled_);
+  for (int i = 0; i < helpers; i++)
+  {
+    work->refs++;
+    bg_compactions_scheduled_++;
+    // Not tagged with "this": the destructor must not unschedule a helper,
+    // which still holds a reference to "work"
+    env_->ScheduleWithPriority(&DBImpl::BGWorkSubcompaction, work, Env::LOW, NULL);
+  }
+  RunSubcompactions(work);
+  while (work->running > 0)
+  {
+    bg_cv_.Wait();
+  }
+  if (--work->refs == 0)
+  {
+    delete work;
+  }
+
+  delete range_deletions;
+  compact->range_deletions = NULL;
+
+  // Gather the outputs of all subcompactions in key order so that they
+  // are installed through a single VersionEdit.  The subcompactions ran
+  // at the same time, so their memtable flushes may overlap in time; only
+  // the longest is left out of the compaction time.
+  int64_t imm_micros = 0;
+  for (size_t i = 0; i < subs.size(); i++)
+  {
+    if (status.ok())
+    {
+      status = subs[i]->status;
+    }
+    imm_micros = std::max(imm_micros, subs[i]->imm_micros);
+    if (i > 0)
+    {
+      compact->outputs.insert(compact->outputs.end(),
+                              subs[i]->outputs.begin(), subs[i]->outputs.end());
+      compact->total_bytes += subs[i]->total_bytes;
+      subs[i]->outputs.clear();
+      CleanupCompaction(subs[i]);
+    }
+  }
+
+  const uint64_t wall_micros = env_->NowMicros() - start_micros;
+  CompactionStats stats;
+  stats.micros = std::max<int64_t>(0, static_cast<int64_t>(wall_micros) - imm_micros);
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+
+  stats_[compact->compaction->level() + 1].Add(stats);
+  statistics_.MeasureTime(Statistics::kCompactionMicros, wall_micros);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::BGWorkSubcompaction(void* arg)
+{
+  SubcompactionWork* work = reinterpret_cast<SubcompactionWork*>(arg);
+  DBImpl* db = work->db;
+  MutexLock l(&db->mutex_);
+  db->RunSubcompactions(work);
+  if (--work->refs == 0)
+  {
+    delete work;
+  }
+  db->bg_compactions_scheduled_--;
+  db->MaybeScheduleCompaction();
+  db->bg_cv_.SignalAll();
+}
+
+void DBImpl::RunSubcompactions(SubcompactionWork* work)
+{
+  mutex_.AssertHeld();
+  while (work->next < work->subs.size())
+  {
+    CompactionState* compact = work->subs[work->next++];
+    work->running++;
+    // Release mutex while we're actually doing the compaction work
+    mutex_.Unlock();
+    compact->status = DoSubcompactionWork(compact);
+    mutex_.Lock();
+    work->running--;
+    bg_cv_.SignalAll();
+  }
+}
 
+Status DBImpl::DoSubcompactionWork(CompactionState* compact)
+{
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
+  if (compact->start.empty())
+  {
+    input->SeekToFirst();
+  }
+  else
+  {
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  }
+  compact->output_lower = compact->start.ToString();
+  compact->has_output_lower = !compact->start.empty();
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  bool close_output = false;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
-    // Prioritize immutable compaction work
+    // Prioritize immutable compaction work, unless a thread (usually the
+    // flush thread) is already writing imm_ out
     if (has_imm_.NoBarrier_Load() != NULL) {
-      const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != NULL) {
+      if (imm_ != NULL && !imm_flush_running_) {
+        const uint64_t imm_start = env_->NowMicros();
         CompactMemTable();
         bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
+        compact->imm_micros += (env_->NowMicros() - imm_start);
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (!compact->end.empty() && key.size() >= 8 &&
+        user_comparator()->Compare(ExtractUserKey(key), compact->end) >= 0) {
+      // The rest belongs to the next subcompaction
+      break;
+    }
+    if (compact->compaction->ShouldStopBefore(key, &compact->progress) &&
         compact->builder != NULL) {
-      status = FinishCompactionOutputFile(compact, input);
+      close_output = true;
+    }
+    if (close_output && compact->builder != NULL) {
+      if (compact->range_deletions == NULL) {
+        status = FinishCompactionOutputFile(compact, input, NULL);
+        close_output = false;
+      } else if (ParseInternalKey(key, &ikey) &&
+                 (!has_current_user_key ||
+                  user_comparator()->Compare(ikey.user_key, Slice(current_user_key)) != 0)) {
+        // With range tombstones an output must hold every entry for its
+        // user keys, and cuts its tombstones at the next file's first key
+        status = FinishCompactionOutputFile(compact, input, &ikey.user_key);
+        close_output = false;
+      }
       if (!status.ok()) {
         break;
       }
     }
-
     // Handle key/value, add to state, etc.
     bool drop = false;
     if (!ParseInternalKey(key, &ikey)) {
@@ -1117,7 +1585,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
         drop = true;    // (A)
       } 
 	  else if (ikey.type == kTypeDeletion && ikey.sequence <= compact->smallest_snapshot
-				&& compact->compaction->IsBaseLevelForKey(ikey.user_key)) 
+				&& compact->compaction->IsBaseLevelForKey(ikey.user_key, &compact->progress)) 
 	  {
         // For this user key:
         // (1) there is no data in higher levels
@@ -1127,6 +1595,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      }
+	  else if (compact->range_deletions != NULL &&
+	           compact->range_deletions->Covers(ikey.user_key, ikey.sequence, compact->smallest_snapshot))
+	  {
+        // Deleted by a range tombstone that every snapshot sees
+        drop = true;
       }
       last_sequence_for_key = ikey.sequence;
     }
@@ -1159,9 +1633,13 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
+        if (compact->range_deletions == NULL) {
+          status = FinishCompactionOutputFile(compact, input, NULL);
+          if (!status.ok()) {
+            break;
+          }
+        } else {
+          close_output = true;
         }
       }
     }
@@ -1172,38 +1650,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
   if (status.ok() && shutting_down_.Acquire_Load()) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == NULL && compact->range_deletions != NULL) {
+    // Tombstones past the last output entry still need a file
+    std::vector<RangeTombstones::Tombstone> tombstones;
+    compact->KeptRangeDeletions(NULL, &tombstones);
+    if (!tombstones.empty()) {
+      status = OpenCompactionOutputFile(compact);
+    }
+  }
   if (status.ok() && compact->builder != NULL) {
-    status = FinishCompactionOutputFile(compact, input);
+    status = FinishCompactionOutputFile(compact, input, NULL);
   }
   if (status.ok()) {
     status = input->status();
   }
   delete input;
   input = NULL;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1213,6 +1675,10 @@ struct IterState {
   Version* version;
   MemTable* mem;
   MemTable* imm;
+  // ReadOptions::iterate_upper_bound as an internal key, for the table
+  // iterators: the smallest internal key with the bound as user key
+  std::string upper_bound_rep;
+  Slice upper_bound;
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
@@ -1228,22 +1694,36 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeTombstones** range_deletions) {
   IterState* cleanup = new IterState;
+  ReadOptions table_options = options;
+  if (options.iterate_upper_bound != NULL) {
+    AppendInternalKey(&cleanup->upper_bound_rep,
+                      ParsedInternalKey(*options.iterate_upper_bound,
+                                        kMaxSequenceNumber, kValueTypeForSeek));
+    cleanup->upper_bound = cleanup->upper_bound_rep;
+    table_options.iterate_upper_bound = &cleanup->upper_bound;
+  }
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
-  // Collect together all needed child iterators
+  // Collect together all needed child iterators, with the smallest key
+  // of each so that the merging iterator can open tables lazily
   std::vector<Iterator*> list;
+  std::vector<Slice> smallest;
   list.push_back(mem_->NewIterator());
+  smallest.push_back(Slice());
   mem_->Ref();
   if (imm_ != NULL) {
     list.push_back(imm_->NewIterator());
+    smallest.push_back(Slice());
     imm_->Ref();
   }
-  versions_->current()->AddIterators(options, &list);
+  versions_->current()->AddIterators(table_options, &list, &smallest);
   Iterator* internal_iter =
-      NewMergingIterator(&internal_comparator_, &list[0], list.size());
+      NewMergingIterator(&internal_comparator_, &list[0], list.size(),
+                         &smallest[0]);
   versions_->current()->Ref();
 
   cleanup->mu = &mutex_;
@@ -1254,13 +1734,44 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
   *seed = ++seed_;
   mutex_.Unlock();
+
+  if (range_deletions != NULL) {
+    // The references taken above keep the memtables and files alive
+    *range_deletions = NULL;
+    RangeTombstones* tombstones = new RangeTombstones(user_comparator());
+    Status s;
+    if (cleanup->mem->HasRangeDeletions()) {
+      Iterator* iter = cleanup->mem->NewRangeDeletionIterator();
+      s = tombstones->AddAll(iter);
+      delete iter;
+    }
+    if (s.ok() && cleanup->imm != NULL && cleanup->imm->HasRangeDeletions()) {
+      Iterator* iter = cleanup->imm->NewRangeDeletionIterator();
+      s = tombstones->AddAll(iter);
+      delete iter;
+    }
+    if (s.ok()) {
+      s = cleanup->version->AddRangeDeletions(tombstones,
+                                              table_options.iterate_upper_bound);
+    }
+    if (!s.ok()) {
+      delete tombstones;
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+    if (tombstones->empty()) {
+      delete tombstones;
+    } else {
+      *range_deletions = tombstones;
+    }
+  }
   return internal_iter;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
   uint32_t ignored_seed;
-  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed);
+  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed, NULL);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1268,8 +1779,23 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+int DBImpl::TEST_MaxConcurrentCompactions(bool* disjoint) {
+  MutexLock l(&mutex_);
+  *disjoint = compacting_files_disjoint_;
+  return max_running_compactions_;
+}
+
+// Count a lookup that had to search the tables
+static void RecordGetStats(Statistics* statistics, const Version::GetStats& stats)
+{
+  statistics->Record(Statistics::kMemtableMisses);
+  statistics->RecordAtLevel(Statistics::kGetHitsAtLevel, stats.found_level);
+  statistics->Record(Statistics::kBloomUseless, stats.useless_probes);
+}
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* value) 
 {
+  StopWatch sw(env_, &statistics_, Statistics::kGetMicros);
   Status s;
   MutexLock l(&mutex_);
   SequenceNumber snapshot;
@@ -1304,15 +1830,22 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* va
     if (mem->Get(lkey, value, &s))
 	{
       // Done
+      statistics_.Record(Statistics::kMemtableHits);
     }
 	else if (imm != NULL && imm->Get(lkey, value, &s)) 
 	{
       // Done
+      statistics_.Record(Statistics::kMemtableHits);
     } 
 	else
 	{
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
+      RecordGetStats(&statistics_, stats);
+    }
+    if (s.IsNotFound())
+    {
+      statistics_.Record(Statistics::kGetNotFound);
     }
     mutex_.Lock();
   }
@@ -1330,24 +1863,155 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* va
   return s;
 }
 
-Iterator* DBImpl::NewIterator(const ReadOptions& options) 
+namespace {
+// Orders indexes into a MultiGet() key vector by user key
+struct KeyIndexLess
 {
-  SequenceNumber latest_snapshot;
-  uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator( this, user_comparator(), iter,(options.snapshot != NULL ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_ : latest_snapshot), seed);
-}
+  const Comparator* ucmp;
+  const std::vector<Slice>* keys;
+  bool operator()(size_t a, size_t b) const
+  {
+    return ucmp->Compare((*keys)[a], (*keys)[b]) < 0;
+  }
+};
+}  // namespace
 
-void DBImpl::RecordReadSample(Slice key) 
+void DBImpl::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                      std::vector<std::string>* values, std::vector<Status>* statuses)
 {
+  const size_t n = keys.size();
+  values->assign(n, std::string());
+  statuses->assign(n, Status());
+
   MutexLock l(&mutex_);
-  if (versions_->current()->RecordReadSample(key)) 
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) 
   {
-    MaybeScheduleCompaction();
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } 
+  else
+  {
+    snapshot = versions_->LastSequence();
   }
-}
 
-const Snapshot* DBImpl::GetSnapshot() {
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current(); 
+  mem->Ref();
+  if (imm != NULL)
+  {
+	  imm->Ref();
+  }
+  current->Ref();
+
+  std::vector<LookupKey*> lkeys(n);
+  std::vector<Version::GetRequest> requests;
+
+  //Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    // Sort the keys so that every level and table is walked in order
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      order[i] = i;
+    }
+    KeyIndexLess cmp;
+    cmp.ucmp = user_comparator();
+    cmp.keys = &keys;
+    std::stable_sort(order.begin(), order.end(), cmp);
+
+    for (size_t k = 0; k < n; k++)
+    {
+      const size_t i = order[k];
+      lkeys[i] = new LookupKey(keys[i], snapshot);
+      // First look in the memtable, then in the immutable memtable (if any).
+      if (mem->Get(*lkeys[i], &(*values)[i], &(*statuses)[i]))
+      {
+        // Done
+        statistics_.Record(Statistics::kMemtableHits);
+      }
+      else if (imm != NULL && imm->Get(*lkeys[i], &(*values)[i], &(*statuses)[i]))
+      {
+        // Done
+        statistics_.Record(Statistics::kMemtableHits);
+      }
+      else
+      {
+        Version::GetRequest r;
+        r.key = lkeys[i];
+        r.value = &(*values)[i];
+        r.status = &(*statuses)[i];
+        requests.push_back(r);
+      }
+    }
+    if (!requests.empty())
+    {
+      current->MultiGet(options, &requests);
+    }
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+      RecordGetStats(&statistics_, requests[i].stats);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+      if ((*statuses)[i].IsNotFound())
+      {
+        statistics_.Record(Statistics::kGetNotFound);
+      }
+    }
+    mutex_.Lock();
+  }
+
+  bool need_compaction = false;
+  for (size_t i = 0; i < requests.size(); i++)
+  {
+    if (current->UpdateStats(requests[i].stats))
+    {
+      need_compaction = true;
+    }
+  }
+  if (need_compaction)
+  {
+    MaybeScheduleCompaction();
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    delete lkeys[i];
+  }
+  mem->Unref();
+  if (imm != NULL)
+  {
+	imm->Unref();
+  }
+  current->Unref();
+}
+
+Iterator* DBImpl::NewIterator(const ReadOptions& options) 
+{
+  SequenceNumber latest_snapshot;
+  uint32_t seed;
+  RangeTombstones* range_deletions;
+  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed, &range_deletions);
+  const SliceTransform* prefix_extractor = options.prefix_same_as_start ? internal_prefix_extractor_.user_transform() : NULL;
+  return NewDBIterator( this, user_comparator(), iter,(options.snapshot != NULL ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_ : latest_snapshot), range_deletions, prefix_extractor, options.iterate_upper_bound, seed);
+}
+
+void DBImpl::ResetStats()
+{
+  statistics_.Reset();
+}
+
+void DBImpl::RecordReadSample(Slice key) 
+{
+  MutexLock l(&mutex_);
+  if (versions_->current()->RecordReadSample(key)) 
+  {
+    MaybeScheduleCompaction();
+  }
+}
+
+const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
 }
@@ -1369,9 +2033,393 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key)
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin, const Slice& end)
+{
+  if (user_comparator()->Compare(begin, end) >= 0)
+  {
+    return Status::OK();  // Nothing to delete
+  }
+
+  // Tables numbered below this only hold entries older than the tombstone
+  mutex_.Lock();
+  const uint64_t file_number_limit = versions_->NewFileNumber();
+  versions_->ReuseFileNumber(file_number_limit);
+  mutex_.Unlock();
+
+  Status s = DB::DeleteRange(options, begin, end);
+  if (!s.ok())
+  {
+    return s;
+  }
+
+  MutexLock l(&mutex_);
+  if (!snapshots_.empty() && snapshots_.oldest()->number_ < versions_->LastSequence())
+  {
+    return s;  // A snapshot may still read the tables
+  }
+  // Drop the tables that hold only keys in [begin, end) in one edit.
+  // Their files are marked as compacted meanwhile so that no compaction
+  // picks them while LogAndApply() waits for the MANIFEST.
+  Version* current = versions_->current();
+  InternalKey first(begin, kMaxSequenceNumber, kValueTypeForSeek);
+  InternalKey last(end, 0, static_cast<ValueType>(0));
+  VersionEdit edit;
+  std::vector<FileMetaData*> dropped;
+  for (int level = 0; level < config::kNumLevels; level++)
+  {
+    std::vector<FileMetaData*> files;
+    current->GetOverlappingInputs(level, &first, &last, &files);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      FileMetaData* f = files[i];
+      if (f->number < file_number_limit && !f->being_compacted &&
+          user_comparator()->Compare(f->smallest.user_key(), begin) >= 0 &&
+          user_comparator()->Compare(f->largest.user_key(), end) < 0)
+      {
+        edit.DeleteFile(level, f->number);
+        f->being_compacted = true;
+        dropped.push_back(f);
+      }
+    }
+  }
+  if (dropped.empty())
+  {
+    return s;
+  }
+  current->Ref();
+  Status drop_status = LogAndApply(&edit);
+  for (size_t i = 0; i < dropped.size(); i++)
+  {
+    dropped[i]->being_compacted = false;
+  }
+  current->Unref();
+  if (drop_status.ok())
+  {
+    Log(options_.info_log, "DeleteRange dropped %d tables", static_cast<int>(dropped.size()));
+    DeleteObsoleteFiles();
+  }
+  else
+  {
+    RecordBackgroundError(drop_status);
+  }
+  return s;
+}
+
+namespace
+{
+// A table being loaded by DBImpl::IngestExternalFile()
+struct IngestedFile
+{
+  std::string path;
+  uint64_t file_size;
+  std::string smallest;         // User keys
+  std::string largest;
+  ValueType smallest_type;
+  ValueType largest_type;
+  uint64_t number;              // Number of its copy in the DB, or 0
+  bool moved;                   // Was "path" moved to the DB?
+};
+
+struct IngestedFileLess
+{
+  const Comparator* ucmp;
+  explicit IngestedFileLess(const Comparator* c) : ucmp(c) { }
+  bool operator()(const IngestedFile& a, const IngestedFile& b) const
+  {
+    return ucmp->Compare(a.smallest, b.smallest) < 0;
+  }
+};
+}  // namespace
+
+// Parse the key at which "iter" is positioned, which must have been
+// added by SstFileWriter.
+static Status ParseIngestedKey(Iterator* iter, const std::string& path, std::string* user_key, ValueType* type)
+{
+  if (!iter->Valid())
+  {
+    return iter->status().ok() ? Status::InvalidArgument("table has no entries", path) : iter->status();
+  }
+  ParsedInternalKey ikey;
+  if (!ParseInternalKey(iter->key(), &ikey) || ikey.sequence != 0 || ikey.type == kTypeRangeDeletion)
+  {
+    return Status::InvalidArgument("table was not built by SstFileWriter", path);
+  }
+  user_key->assign(ikey.user_key.data(), ikey.user_key.size());
+  *type = ikey.type;
+  return Status::OK();
+}
+
+// Read the size and the key range of f->path.  Only the first and last
+// data blocks are read.
+static Status ReadIngestedFile(Env* env, const Options& options, IngestedFile* f)
+{
+  Status s = env->GetFileSize(f->path, &f->file_size);
+  RandomAccessFile* file = NULL;
+  if (s.ok())
+  {
+    s = env->NewRandomAccessFile(f->path, &file);
+  }
+  Table* table = NULL;
+  if (s.ok())
+  {
+    s = Table::Open(options, file, f->file_size, &table);
+  }
+  if (s.ok())
+  {
+    ReadOptions read_options;
+    read_options.fill_cache = false;
+    Iterator* iter = table->NewIterator(read_options);
+    iter->SeekToFirst();
+    s = ParseIngestedKey(iter, f->path, &f->smallest, &f->smallest_type);
+    if (s.ok())
+    {
+      iter->SeekToLast();
+      s = ParseIngestedKey(iter, f->path, &f->largest, &f->largest_type);
+    }
+    delete iter;
+  }
+  delete table;
+  delete file;
+  return s;
+}
+
+// Move the file "src" to "dst", or copy it if it cannot be moved (to
+// another file system, say).  Sets *moved accordingly.
+static Status MoveOrCopyFile(Env* env, const std::string& src, const std::string& dst, bool* moved)
+{
+  *moved = env->RenameFile(src, dst).ok();
+  if (*moved)
+  {
+    return Status::OK();
+  }
+  SequentialFile* in = NULL;
+  Status s = env->NewSequentialFile(src, &in);
+  if (!s.ok())
+  {
+    return s;
+  }
+  WritableFile* out = NULL;
+  s = env->NewWritableFile(dst, &out);
+  if (s.ok())
+  {
+    std::string scratch(1 << 20, '\0');
+    while (true)
+    {
+      Slice chunk;
+      s = in->Read(scratch.size(), &chunk, &scratch[0]);
+      if (!s.ok() || chunk.empty())
+      {
+        break;
+      }
+      s = out->Append(chunk);
+      if (!s.ok())
+      {
+        break;
+      }
+    }
+    if (s.ok())
+    {
+      s = out->Sync();
+    }
+    if (s.ok())
+    {
+      s = out->Close();
+    }
+    delete out;
+    if (!s.ok())
+    {
+      env->DeleteFile(dst);
+    }
+  }
+  delete in;
+  return s;
+}
+
+// Whether "mem" holds an entry or a range tombstone for a user key in
+// [smallest,largest].
+static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp, const Slice& smallest, const Slice& largest)
+{
+  InternalKey begin(smallest, kMaxSequenceNumber, kValueTypeForSeek);
+  Iterator* iter = mem->NewIterator();
+  iter->Seek(begin.Encode());
+  bool overlap = iter->Valid() && ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0;
+  delete iter;
+  if (!overlap && mem->HasRangeDeletions())
+  {
+    iter = mem->NewRangeDeletionIterator();
+    for (iter->SeekToFirst(); iter->Valid() && !overlap; iter->Next())
+    {
+      overlap = ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0 &&
+                ucmp->Compare(iter->value(), smallest) > 0;
+    }
+    delete iter;
+  }
+  return overlap;
+}
+
+Status DBImpl::IngestExternalFile(const std::vector<std::string>& paths)
+{
+  const Comparator* ucmp = user_comparator();
+  std::vector<IngestedFile> files(paths.size());
+  Status s;
+  for (size_t i = 0; i < files.size() && s.ok(); i++)
+  {
+    files[i].path = paths[i];
+    files[i].number = 0;
+    files[i].moved = false;
+    s = ReadIngestedFile(env_, options_, &files[i]);
+  }
+  if (!s.ok() || files.empty())
+  {
+    return s;
+  }
+  // All entries get one sequence number, so a key may only be in one file
+  std::sort(files.begin(), files.end(), IngestedFileLess(ucmp));
+  for (size_t i = 1; i < files.size(); i++)
+  {
+    if (ucmp->Compare(files[i-1].largest, files[i].smallest) >= 0)
+    {
+      return Status::InvalidArgument("ingested tables overlap", files[i].path);
+    }
+  }
+
+  // Bring the files into the DB before holding up writes, as that may
+  // mean copying them.  Every number taken stays in pending_outputs_
+  // until the end.
+  MutexLock l(&mutex_);
+  std::vector<uint64_t> reserved;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    reserved.push_back(versions_->NewFileNumber());
+    pending_outputs_.insert(reserved.back());
+  }
+  mutex_.Unlock();
+  for (size_t i = 0; i < files.size() && s.ok(); i++)
+  {
+    s = MoveOrCopyFile(env_, files[i].path, TableFileName(dbname_, reserved[i]), &files[i].moved);
+    if (s.ok())
+    {
+      files[i].number = reserved[i];
+    }
+  }
+  mutex_.Lock();
+
+  // Become the only writer, once earlier pipelined writes have published
+  // their sequence numbers.
+  Writer w(&mutex_);
+  w.batch = NULL;
+  w.sync = false;
+  w.done = false;
+  writers_.push_back(&w);
+  while (&w != writers_.front() || !memtable_writers_.empty())
+  {
+    w.cv.Wait();
+  }
+
+  // The tables have to be newer than every entry for their keys, and the
+  // memtable is searched first.  No write gets in until they are installed.
+  bool flush = false;
+  for (size_t i = 0; i < files.size() && s.ok() && !flush; i++)
+  {
+    flush = MemTableOverlaps(mem_, ucmp, files[i].smallest, files[i].largest);
+  }
+  if (s.ok() && flush)
+  {
+    s = MakeRoomForWrite(true);
+  }
+  // Nor may a flush pick levels without the tables
+  while (s.ok() && imm_ != NULL)
+  {
+    bg_cv_.Wait();
+    s = bg_error_;
+  }
+
+  // Level-0 tables are searched newest first by file number, so the
+  // tables are renumbered after the ones flushed meanwhile.
+  for (size_t i = 0; i < files.size() && s.ok(); i++)
+  {
+    reserved.push_back(versions_->NewFileNumber());
+    pending_outputs_.insert(reserved.back());
+    mutex_.Unlock();
+    s = env_->RenameFile(TableFileName(dbname_, files[i].number), TableFileName(dbname_, reserved.back()));
+    mutex_.Lock();
+    if (s.ok())
+    {
+      files[i].number = reserved.back();
+    }
+  }
+
+  bool installed = false;
+  if (s.ok())
+  {
+    // The levels are picked from the current version; no compaction
+    // may be picked from it until the tables are in.
+    ingesting_ = true;
+    Version* current = versions_->current();
+    const SequenceNumber sequence = versions_->LastSequence() + 1;
+    VersionEdit edit;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      const IngestedFile& f = files[i];
+      const int level = current->PickLevelForIngestedFile(f.smallest, f.largest);
+      edit.AddFile(level, f.number, f.file_size,
+                   InternalKey(f.smallest, sequence, f.smallest_type),
+                   InternalKey(f.largest, sequence, f.largest_type),
+                   false, sequence);
+      Log(options_.info_log, "Ingesting %s as #%llu at level-%d",
+          f.path.c_str(), static_cast<unsigned long long>(f.number), level);
+    }
+    versions_->SetLastSequence(sequence);
+    s = LogAndApply(&edit);
+    ingesting_ = false;
+    installed = true;
+    if (!s.ok())
+    {
+      // The MANIFEST may or may not list the tables now
+      RecordBackgroundError(s);
+    }
+  }
+
+  writers_.pop_front();
+  if (!writers_.empty())
+  {
+    writers_.front()->cv.Signal();
+  }
+
+  if (!installed)
+  {
+    // Give the files back
+    mutex_.Unlock();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      if (files[i].number == 0)
+      {
+        continue;
+      }
+      const std::string fname = TableFileName(dbname_, files[i].number);
+      if (files[i].moved)
+      {
+        env_->RenameFile(fname, files[i].path);
+      }
+      else
+      {
+        env_->DeleteFile(fname);
+      }
+    }
+    mutex_.Lock();
+  }
+  for (size_t i = 0; i < reserved.size(); i++)
+  {
+    pending_outputs_.erase(reserved[i]);
+  }
+  MaybeScheduleCompaction();
+  return s;
+}
+
 //Thread safe interface
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) 
 {
+  StopWatch sw(env_, &statistics_, Statistics::kWriteMicros);
   Writer w(&mutex_);
   w.batch = my_batch;
   w.sync = options.sync;
@@ -1379,8 +2427,22 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front())
+  while (!w.done && (w.logged || &w != writers_.front()))
   {
+    if (w.mem != NULL)
+    {
+      // The leader has logged our batch; insert it while it waits.
+      MemTable* mem = w.mem;
+      w.mem = NULL;
+      mutex_.Unlock();
+      w.status = WriteBatchInternal::InsertIntoConcurrently(my_batch, mem);
+      mutex_.Lock();
+      if (--w.leader->pending_inserts == 0)
+      {
+        w.leader->cv.Signal();
+      }
+      continue;
+    }
 	//等待条件变量的时候，mutex_.unlock()
     w.cv.Wait();
   }
@@ -1390,14 +2452,22 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
   }
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(my_batch == NULL);
-  uint64_t last_sequence = versions_->LastSequence();
+  // Groups still in the memtable stage of a pipelined write have taken
+  // sequence numbers that are not published yet.
+  uint64_t last_sequence = memtable_writers_.empty() ? versions_->LastSequence() : memtable_writers_.back()->last_sequence;
   Writer* last_writer = &w;
   if (status.ok() && my_batch != NULL) 
   {  // NULL batch is for compactions
     WriteBatch* updates = BuildBatchGroup(&last_writer);
-    WriteBatchInternal::SetSequence(updates, last_sequence + 1);
+    const SequenceNumber first_sequence = last_sequence + 1;
+    WriteBatchInternal::SetSequence(updates, first_sequence);
     last_sequence += WriteBatchInternal::Count(updates);
 
+    // A merged group can be inserted by all of its writers at once.
+    const bool parallel = options_.allow_concurrent_memtable_write && updates == tmp_batch_;
+    const bool pipelined = options_.enable_pipelined_write || log_flusher_ != NULL;
+    uint64_t log_offset = 0;
+
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
@@ -1407,8 +2477,14 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 	  //写入log中
       status = log_->AddRecord(WriteBatchInternal::Contents(updates));
       bool sync_error = false;
-      if (status.ok() && options.sync) 
+      if (log_flusher_ != NULL)
+      {
+        // The memtable stage waits for the flusher thread to write it out
+        log_offset = log_flusher_->Size();
+      }
+      else if (status.ok() && options.sync) 
 	  {
+        StopWatch sync_sw(env_, &statistics_, Statistics::kWalSyncMicros);
         status = logfile_->Sync();
         if (!status.ok()) 
 		{
@@ -1416,11 +2492,24 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
         }
       }
 	  // 写入mem中
-      if (status.ok()) 
+      if (status.ok() && !parallel && !pipelined) 
 	  {
         status = WriteBatchInternal::InsertInto(updates, mem_);
       }
       mutex_.Lock();
+      if (status.ok() && parallel && !pipelined)
+      {
+        std::vector<Writer*> group;
+        for (std::deque<Writer*>::iterator iter = writers_.begin(); ; ++iter)
+        {
+          group.push_back(*iter);
+          if (*iter == last_writer)
+          {
+            break;
+          }
+        }
+        status = InsertWriteGroup(group, first_sequence, mem_, true);
+      }
       if (sync_error) 
 	  {
         // The state of the log file is indeterminate: the log record we
@@ -1433,6 +2522,10 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 	{
 	   tmp_batch_->Clear();
 	}
+    if (pipelined)
+    {
+      return PipelinedMemTableWrite(&w, last_writer, status, last_sequence, log_offset);
+    }
     versions_->SetLastSequence(last_sequence);
   }
 
@@ -1442,7 +2535,11 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
     writers_.pop_front();
     if (ready != &w)
 	{
-      ready->status = status;
+      if (ready->status.ok())
+      {
+        // Keep the error from a failed concurrent insert, if any
+        ready->status = status;
+      }
       ready->done = true;
       ready->cv.Signal();
     }
@@ -1460,6 +2557,182 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
   return status;
 }
 
+// Insert the batches of "group" (group[0] is the leader) into mem.  Each
+// batch gets the sequence numbers it occupies in the merged record that
+// was logged for the group.  With allow_concurrent_memtable_write (and
+// "allow_concurrent") every writer inserts its own batch and the leader
+// waits for the others.  The calling thread must be the leader's then.
+// REQUIRES: mutex_ is held and the group has been written to the log
+Status DBImpl::InsertWriteGroup(const std::vector<Writer*>& group, SequenceNumber sequence, MemTable* mem, bool allow_concurrent)
+{
+  mutex_.AssertHeld();
+  Writer* leader = group[0];
+  const bool concurrent = allow_concurrent && options_.allow_concurrent_memtable_write && group.size() > 1;
+  leader->pending_inserts = 0;
+  for (size_t i = 0; i < group.size(); i++)
+  {
+    Writer* w = group[i];
+    if (w->batch != NULL)
+    {
+      WriteBatchInternal::SetSequence(w->batch, sequence);
+      sequence += WriteBatchInternal::Count(w->batch);
+      if (concurrent && w != leader)
+      {
+        w->mem = mem;
+        w->leader = leader;
+        leader->pending_inserts++;
+        w->cv.Signal();
+      }
+    }
+  }
+
+  mutex_.Unlock();
+  Status s;
+  if (concurrent)
+  {
+    s = WriteBatchInternal::InsertIntoConcurrently(leader->batch, mem);
+  }
+  else
+  {
+    for (size_t i = 0; i < group.size() && s.ok(); i++)
+    {
+      if (group[i]->batch != NULL)
+      {
+        s = WriteBatchInternal::InsertInto(group[i]->batch, mem);
+      }
+    }
+  }
+  mutex_.Lock();
+  while (leader->pending_inserts > 0)
+  {
+    leader->cv.Wait();
+  }
+  return s;
+}
+
+// Second stage of a pipelined write.  Take the logged group [w, last_writer]
+// off writers_ so that the next group can build and log its record while
+// this one is inserted.  Groups are inserted and their sequence numbers
+// published in log order.  With a log flusher, the group first waits for
+// its record, which ends at "log_offset", to be written out; the group at
+// the front then also inserts the later groups whose records are out,
+// rather than waking them one at a time.
+// REQUIRES: mutex_ is held and w is the leader of a group that was logged
+Status DBImpl::PipelinedMemTableWrite(Writer* w, Writer* last_writer, Status status, SequenceNumber last_sequence, uint64_t log_offset)
+{
+  mutex_.AssertHeld();
+  assert(w->group.empty());
+  while (true)
+  {
+    Writer* x = writers_.front();
+    writers_.pop_front();
+    x->logged = true;
+    w->group.push_back(x);
+    if (x == last_writer)
+    {
+      break;
+    }
+  }
+  w->status = status;
+  w->last_sequence = last_sequence;
+  w->log_offset = log_offset;
+  memtable_writers_.push_back(w);
+  if (!writers_.empty())
+  {
+    writers_.front()->cv.Signal();
+  }
+
+  if (log_flusher_ != NULL && status.ok())
+  {
+    // Later groups append their records meanwhile; one write and one
+    // sync by the flusher thread can cover all of them.
+    log_flusher_->Schedule(log_offset, w->sync);
+  }
+
+  while (!w->done && (memtable_writers_.front() != w || w->group.empty()))
+  {
+    w->cv.Wait();
+  }
+  if (w->done)
+  {
+    return w->status;
+  }
+
+  if (log_flusher_ != NULL && w->status.ok())
+  {
+    // Only the group at the front waits for the flusher.  The log is not
+    // switched while this group is in memtable_writers_.
+    log::Flusher* flusher = log_flusher_;
+    mutex_.Unlock();
+    const uint64_t wait_start = env_->NowMicros();
+    Status s = flusher->WaitFor(log_offset, w->sync);
+    if (w->sync)
+    {
+      // Includes writing out the records, which the sync needs anyway
+      statistics_.MeasureTime(Statistics::kWalSyncMicros, env_->NowMicros() - wait_start);
+    }
+    mutex_.Lock();
+    if (!s.ok())
+    {
+      // As with a failed inline sync, the log may or may not hold the
+      // record, so all future writes must fail.
+      w->status = s;
+      RecordBackgroundError(s);
+    }
+  }
+
+  // MakeRoomForWrite() does not retire mem_ while groups are queued here,
+  // so mem_ is still the memtable that matches the log we wrote to.
+  Writer* leader = w;
+  while (true)
+  {
+    std::vector<Writer*> members;
+    members.swap(leader->group);
+    // Groups in memtable_writers_ hold consecutive sequence numbers
+    if (leader->status.ok())
+    {
+      // Only our own group's writers help with the insert
+      leader->status = InsertWriteGroup(members, versions_->LastSequence() + 1, mem_, leader == w);
+    }
+    versions_->SetLastSequence(leader->last_sequence);
+    memtable_writers_.pop_front();
+
+    for (size_t i = 1; i < members.size(); i++)
+    {
+      Writer* ready = members[i];
+      if (ready->status.ok())
+      {
+        ready->status = leader->status;
+      }
+      ready->done = true;
+      ready->cv.Signal();
+    }
+    if (leader != w)
+    {
+      leader->done = true;
+      leader->cv.Signal();
+    }
+
+    if (memtable_writers_.empty())
+    {
+      if (!writers_.empty())
+      {
+        // The log leader may be waiting in MakeRoomForWrite()
+        writers_.front()->cv.Signal();
+      }
+      break;
+    }
+    Writer* next = memtable_writers_.front();
+    if (log_flusher_ == NULL || !next->status.ok() || !log_flusher_->Covers(next->log_offset, next->sync))
+    {
+      next->cv.Signal();
+      break;
+    }
+    leader = next;
+  }
+  return w->status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-NULL batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
@@ -1492,6 +2765,13 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
       break;
     }
 
+    if (w->batch == NULL)
+    {
+      // Forced memtable switches and ingestions happen at the front of
+      // the queue.
+      break;
+    }
+
     if (w->batch != NULL) 
 	{
       size += WriteBatchInternal::ByteSize(w->batch);
@@ -1523,6 +2803,7 @@ Status DBImpl::MakeRoomForWrite(bool force)
   mutex_.AssertHeld();
   assert(!writers_.empty());
   bool allow_delay = !force;
+  uint64_t stall_micros = 0;
   Status s;
   while (true) 
   {
@@ -1542,7 +2823,9 @@ Status DBImpl::MakeRoomForWrite(bool force)
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
       mutex_.Unlock();
+      const uint64_t stall_start = env_->NowMicros();
       env_->SleepForMicroseconds(1000);
+      stall_micros += env_->NowMicros() - stall_start;
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
     } 
@@ -1557,14 +2840,24 @@ Status DBImpl::MakeRoomForWrite(bool force)
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
+      stall_micros += env_->NowMicros() - stall_start;
     } 
 	else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger)
 	{
       // There are too many level-0 files. level-0层文件数达到了12个，等待compact
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
+      stall_micros += env_->NowMicros() - stall_start;
     } 
+    else if (!memtable_writers_.empty())
+    {
+      // Earlier pipelined groups are still inserting into mem_.  Let them
+      // finish before mem_ and its log are retired.
+      writers_.front()->cv.Wait();
+    }
 	else 
 	{
 	  //memtable已经写满，但是immutable memtable不存在，将当前memtable转换成immutable，生成新的logfile 和 memtable 主动触发compact
@@ -1572,18 +2865,14 @@ Status DBImpl::MakeRoomForWrite(bool force)
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = NULL;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      s = NewLogFile(env_, options_, LogFileName(dbname_, new_log_number), false, &lfile);
       if (!s.ok()) 
 	  {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
         break;
       }
-      delete log_;
-      delete logfile_;
-      logfile_ = lfile;
-      logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      SetLogFile(lfile, new_log_number, 0);
       imm_ = mem_;
       has_imm_.Release_Store(imm_);
       mem_ = new MemTable(internal_comparator_);
@@ -1592,9 +2881,35 @@ Status DBImpl::MakeRoomForWrite(bool force)
       MaybeScheduleCompaction();
     }
   }
+  if (stall_micros > 0)
+  {
+    statistics_.MeasureTime(Statistics::kWriteStallMicros, stall_micros);
+  }
   return s;
 }
 
+// REQUIRES: mutex_ is held
+// REQUIRES: no write is still waiting on the current log
+void DBImpl::SetLogFile(WritableFile* file, uint64_t number, uint64_t file_size)
+{
+  mutex_.AssertHeld();
+  delete log_;
+  delete log_flusher_;   // Only stops its thread; nothing is left buffered
+  delete logfile_;
+  logfile_ = file;
+  logfile_number_ = number;
+  log_flusher_ = NULL;
+  if (options_.enable_log_flusher)
+  {
+    log_flusher_ = new log::Flusher(env_, file);
+    log_ = new log::Writer(log_flusher_, file_size);
+  }
+  else
+  {
+    log_ = new log::Writer(file, file_size);
+  }
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
@@ -1644,6 +2959,18 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "secondary-cache-stats") {
+    if (secondary_cache_ == NULL) {
+      return false;
+    }
+    secondary_cache_->GetStats(value);
+    return true;
+  } else if (in == "stats.json") {
+    statistics_.AppendJson(value);
+    return true;
+  } else if (in == "histograms") {
+    statistics_.AppendHistograms(value);
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
@@ -1659,7 +2986,8 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
     return true;
   }
 
-  return false;
+  // One of the read counters, e.g. "leveldb.bloom-useful"
+  return statistics_.GetProperty(in, value);
 }
 
 void DBImpl::GetApproximateSizes(
@@ -1704,6 +3032,31 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key)
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin, const Slice& end)
+{
+  WriteBatch batch;
+  batch.DeleteRange(begin, end);
+  return Write(opt, &batch);
+}
+
+Status DB::IngestExternalFile(const std::vector<std::string>& paths)
+{
+  return Status::NotSupported("IngestExternalFile");
+}
+
+void DB::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                  std::vector<std::string>* values, std::vector<Status>* statuses)
+{
+  values->assign(keys.size(), std::string());
+  statuses->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    (*statuses)[i] = Get(options, keys[i], &(*values)[i]);
+  }
+}
+
+void DB::ResetStats() { }
+
 DB::~DB() { }
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) 
@@ -1721,13 +3074,11 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr)
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number), &lfile);
+    s = NewLogFile(options.env, impl->options_, LogFileName(dbname, new_log_number), false, &lfile);
     if (s.ok()) 
 	{										   
       edit.SetLogNumber(new_log_number);
-      impl->logfile_ = lfile;
-      impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
+      impl->SetLogFile(lfile, new_log_number, 0);
       impl->mem_ = new MemTable(impl->internal_comparator_);
       impl->mem_->Ref();
     }
@@ -1737,7 +3088,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr)
   {
     edit.SetPrevLogNumber(0);  // No older logs needed after recovery.
     edit.SetLogNumber(impl->logfile_number_);
-    s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
+    s = impl->LogAndApply(&edit);
   }
   //删除无用的文件，尝试compact 
   if (s.ok())
@@ -7,17 +7,22 @@
 
 #include <deque>
 #include <set>
+#include <vector>
 #include "dbformat.h"
+#include "log_flusher.h"
 #include "log_writer.h"
 #include "snapshot.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "./port/port.h"
 #include "port/thread_annotations.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
 class MemTable;
+class RangeTombstones;
+class SecondaryCache;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -32,12 +37,17 @@ class DBImpl : public DB
   // Implementations of the DB interface
   virtual Status Put(const WriteOptions&, const Slice& key, const Slice& value);
   virtual Status Delete(const WriteOptions&, const Slice& key);
+  virtual Status DeleteRange(const WriteOptions&, const Slice& begin, const Slice& end);
+  virtual Status IngestExternalFile(const std::vector<std::string>& paths);
   virtual Status Write(const WriteOptions& options, WriteBatch* updates);
   virtual Status Get(const ReadOptions& options, const Slice& key, std::string* value);
+  virtual void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                        std::vector<std::string>* values, std::vector<Status>* statuses);
   virtual Iterator* NewIterator(const ReadOptions&);
   virtual const Snapshot* GetSnapshot();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
   virtual bool GetProperty(const Slice& property, std::string* value);
+  virtual void ResetStats();
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
 
@@ -58,17 +68,31 @@ class DBImpl : public DB
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Return the largest number of compactions that have merged files at
+  // the same time, and store in *disjoint whether the input files of the
+  // compactions running at the same time never overlapped.
+  int TEST_MaxConcurrentCompactions(bool* disjoint);
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Counters and histograms of the DB, also updated by the iterators
+  // returned by NewIterator(), and the clock they are timed with.
+  Statistics* statistics() { return &statistics_; }
+  Env* env() const { return env_; }
+
  private:
   friend class DB;
   struct CompactionState;
+  struct SubcompactionWork;
   struct Writer;
 
-  Iterator* NewInternalIterator(const ReadOptions&,SequenceNumber* latest_snapshot, uint32_t* seed);
+  // Also sets *range_deletions, unless it is NULL, to the range
+  // tombstones that apply to the iterator, or to NULL if there are none.
+  Iterator* NewInternalIterator(const ReadOptions&,SequenceNumber* latest_snapshot, uint32_t* seed,
+                                RangeTombstones** range_deletions);
   Status NewDB();
   // Recover the descriptor from persistent storage.  May do a significant
   // amount of work to recover recently logged updates.  Any changes to
@@ -82,18 +106,37 @@ class DBImpl : public DB
   // Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest, VersionEdit* edit, SequenceNumber* max_sequence) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // The new table stays in pending_outputs_; the caller removes
+  // *file_number from it once "edit" has been applied.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base, uint64_t* file_number) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status MakeRoomForWrite(bool force /* compact even if there is room? */) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Start writing the log to "file", which already holds "file_size" bytes.
+  void SetLogFile(WritableFile* file, uint64_t number, uint64_t file_size) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer);
+  Status InsertWriteGroup(const std::vector<Writer*>& group, SequenceNumber sequence, MemTable* mem, bool allow_concurrent) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status PipelinedMemTableWrite(Writer* w, Writer* last_writer, Status status, SequenceNumber last_sequence, uint64_t log_offset) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void RecordBackgroundError(const Status& s);
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
+  static void BGWorkFlush(void* db);
   void BackgroundCall();
-  void  BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void BackgroundFlushCall();
+  // Returns false if no compaction was picked; the caller need not
+  // reschedule then since any busy inputs belong to a running compaction.
+  bool BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Serializes VersionSet::LogAndApply() between background threads.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Merge the part of the compaction input in [compact->start, compact->end).
+  Status DoSubcompactionWork(CompactionState* compact);
+  static void BGWorkSubcompaction(void* arg);
+  // Run the subcompactions of "work" that nobody has taken yet.
+  void RunSubcompactions(SubcompactionWork* work) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status OpenCompactionOutputFile(CompactionState* compact);
-  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  // Range tombstones of the compaction go into the output up to the
+  // user key *upper (NULL means up to the end of the subcompaction).
+  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input, const Slice* upper);
   Status InstallCompactionResults(CompactionState* compact) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   
   /*
@@ -110,6 +153,7 @@ class DBImpl : public DB
 	过滤策略类
   */
   const InternalFilterPolicy internal_filter_policy_;
+  const InternalKeySliceTransform internal_prefix_extractor_;
 
   /*
 	配置类 关于DB的相关配置
@@ -137,6 +181,13 @@ class DBImpl : public DB
   */
   TableCache* table_cache_;
 
+  // Second block cache tier; NULL unless options_.secondary_cache_path
+  // is set.  Provides its own synchronization.
+  SecondaryCache* secondary_cache_;
+
+  // Read counters, filled in without holding mutex_
+  Statistics statistics_;
+
   // Lock over the persistent DB state.  Non-NULL iff successfully acquired.
   /*
 	文件锁用来锁定lock文件, 保证仅能运行单个DB实例
@@ -155,7 +206,8 @@ class DBImpl : public DB
 	只读内存
   */
   MemTable* imm_;                // Memtable being compacted
-  port::AtomicPointer has_imm_;  // So bg thread can detect non-NULL imm_
+  port::AtomicPointer has_imm_;  // So bg threads can detect an imm_ that
+                                 // no thread is writing out yet
   /*
 	日志文件
   */
@@ -165,10 +217,16 @@ class DBImpl : public DB
   */
   uint64_t logfile_number_;
   log::Writer* log_;
+  // Non-NULL iff options_.enable_log_flusher; log_ appends to it and it
+  // writes to logfile_.
+  log::Flusher* log_flusher_;
   uint32_t seed_;                // For sampling.
 
   // Queue of writers.
   std::deque<Writer*> writers_;	//写队列
+  // Leaders of logged groups waiting for or doing their memtable insert
+  // (enable_pipelined_write), oldest first.
+  std::deque<Writer*> memtable_writers_;
   WriteBatch* tmp_batch_;
 
   SnapshotList snapshots_;
@@ -180,8 +238,23 @@ class DBImpl : public DB
   */
   std::set<uint64_t> pending_outputs_;
 
-  // Has a background compaction been scheduled or is running?
-  bool bg_compaction_scheduled_;
+  // Number of background compactions scheduled or running.  At most
+  // options_.max_background_compactions.
+  int bg_compactions_scheduled_;
+
+  // Has a memtable flush been scheduled or is running?  Flushes get their
+  // own slot so that they never wait for a long compaction to finish.
+  bool bg_flush_scheduled_;
+
+  // Is some thread currently writing imm_ to a level-0 table?
+  bool imm_flush_running_;
+
+  // Is some thread inside VersionSet::LogAndApply()?
+  bool manifest_writing_;
+
+  // Is IngestExternalFile() installing tables?  No compaction is picked
+  // meanwhile, as the tables' levels were picked without it.
+  bool ingesting_;
 
   // Information for a manual compaction
   /*
@@ -198,6 +271,13 @@ class DBImpl : public DB
 
   ManualCompaction* manual_compaction_;
 
+  // Input files of the compactions now in DoCompactionWork(), and what
+  // TEST_MaxConcurrentCompactions() reports
+  std::multiset<uint64_t> compacting_files_;
+  int running_compactions_;
+  int max_running_compactions_;
+  bool compacting_files_disjoint_;
+
   /*
 	整个DB状态的管理者, 包括当前最新的Version,正在服务的Version链表, 全局的SequenceNumber，FileNumber, 当前的manifest_file_number, 
 	封装的sstable的TableCache, 还有每个level中下一次compact要选取的start_key等等
@@ -241,7 +321,8 @@ class DBImpl : public DB
 /*
 	调整用户传入的Option使其合法
 */
-extern Options SanitizeOptions(const std::string& db,const InternalKeyComparator* icmp,const InternalFilterPolicy* ipolicy, const Options& src);
+extern Options SanitizeOptions(const std::string& db,const InternalKeyComparator* icmp,const InternalFilterPolicy* ipolicy,
+                               const InternalKeySliceTransform* iprefix, const Options& src);
 
 }  // namespace leveldb
 
@@ -7,6 +7,7 @@
 #include "db/filename.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
+#include "db/range_tombstones.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
@@ -49,18 +50,25 @@ class DBIter: public Iterator {
   };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         RangeTombstones* range_deletions, const SliceTransform* prefix_extractor,
+         const Slice* upper_bound, uint32_t seed)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        range_deletions_(range_deletions),
+        prefix_extractor_(prefix_extractor),
+        has_upper_bound_(upper_bound != NULL),
+        upper_bound_(upper_bound != NULL ? upper_bound->ToString() : std::string()),
         direction_(kForward),
         valid_(false),
+        prefix_same_as_start_(false),
         rnd_(seed),
         bytes_counter_(RandomPeriod()) {
   }
   virtual ~DBIter() {
     delete iter_;
+    delete range_deletions_;
   }
   virtual bool Valid() const { return valid_; }
   virtual Slice key() const {
@@ -90,6 +98,28 @@ class DBIter: public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // The type of *ikey, as kTypeDeletion if a range tombstone hides it
+  ValueType EffectiveType(const ParsedInternalKey& ikey) const {
+    if (ikey.type == kTypeValue && range_deletions_ != NULL &&
+        range_deletions_->Covers(ikey.user_key, ikey.sequence, sequence_)) {
+      return kTypeDeletion;
+    }
+    return ikey.type;
+  }
+
+  // Whether "user_key" is outside of the prefix of the last Seek() target
+  // while the iterator is bounded by it
+  bool OutOfPrefix(const Slice& user_key) const {
+    return prefix_same_as_start_ &&
+           (!prefix_extractor_->InDomain(user_key) ||
+            prefix_extractor_->Transform(user_key) != Slice(prefix_));
+  }
+
+  bool PastUpperBound(const Slice& user_key) const {
+    return has_upper_bound_ &&
+           user_comparator_->Compare(user_key, upper_bound_) >= 0;
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -112,12 +142,18 @@ class DBIter: public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  RangeTombstones* const range_deletions_;  // May be NULL
+  const SliceTransform* const prefix_extractor_;  // NULL unless prefix_same_as_start
+  const bool has_upper_bound_;
+  const std::string upper_bound_;  // Only user keys before it are yielded
 
   Status status_;
   std::string saved_key_;     // == current key when direction_==kReverse
   std::string saved_value_;   // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool prefix_same_as_start_;  // Only keys with prefix_ are yielded
+  std::string prefix_;
 
   Random rnd_;
   ssize_t bytes_counter_;
@@ -176,8 +212,13 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
-      switch (ikey.type) {
+    const bool parsed = ParseKey(&ikey);
+    if (parsed &&
+        (OutOfPrefix(ikey.user_key) || PastUpperBound(ikey.user_key))) {
+      break;
+    }
+    if (parsed && ikey.sequence <= sequence_) {
+      switch (EffectiveType(ikey)) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
           // they are hidden by this deletion.
@@ -194,6 +235,8 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
             return;
           }
           break;
+        default:
+          break;
       }
     }
     iter_->Next();
@@ -236,13 +279,14 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      if (ParseKey(&ikey) && ikey.sequence <= sequence_ &&
+          !PastUpperBound(ikey.user_key)) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = EffectiveType(ikey);
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -272,8 +316,16 @@ void DBIter::FindPrevUserEntry() {
 }
 
 void DBIter::Seek(const Slice& target) {
+  StopWatch sw(db_->env(), db_->statistics(), Statistics::kIterSeekMicros);
+  db_->statistics()->Record(Statistics::kIterSeeks);
   direction_ = kForward;
   ClearSavedValue();
+  prefix_same_as_start_ = (prefix_extractor_ != NULL &&
+                           prefix_extractor_->InDomain(target));
+  if (prefix_same_as_start_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   saved_key_.clear();
   AppendInternalKey(
       &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
@@ -286,8 +338,11 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  StopWatch sw(db_->env(), db_->statistics(), Statistics::kIterSeekMicros);
+  db_->statistics()->Record(Statistics::kIterSeeks);
   direction_ = kForward;
   ClearSavedValue();
+  prefix_same_as_start_ = false;
   iter_->SeekToFirst();
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -297,9 +352,26 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  StopWatch sw(db_->env(), db_->statistics(), Statistics::kIterSeekMicros);
+  db_->statistics()->Record(Statistics::kIterSeeks);
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  prefix_same_as_start_ = false;
+  if (has_upper_bound_) {
+    // Start from the last entry before the bound rather than skip back
+    // over all the later ones
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(
+        upper_bound_, kMaxSequenceNumber, kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
@@ -310,8 +382,12 @@ Iterator* NewDBIterator(
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
     SequenceNumber sequence,
+    RangeTombstones* range_deletions,
+    const SliceTransform* prefix_extractor,
+    const Slice* upper_bound,
     uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+  return new DBIter(db, user_key_comparator, internal_iter, sequence,
+                    range_deletions, prefix_extractor, upper_bound, seed);
 }
 
 }  // namespace leveldb
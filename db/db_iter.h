@@ -12,15 +12,24 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeTombstones;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys, hiding those deleted by the tombstones in
+// "*range_deletions".  Takes ownership of "range_deletions", which may
+// be NULL.  If "prefix_extractor" is non-NULL, the iterator stops at the
+// end of the prefix of each Seek() target (see
+// ReadOptions::prefix_same_as_start).  If "upper_bound" is non-NULL, the
+// iterator only yields user keys before *upper_bound, which is copied.
 extern Iterator* NewDBIterator(
     DBImpl* db,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
     SequenceNumber sequence,
+    RangeTombstones* range_deletions,
+    const SliceTransform* prefix_extractor,
+    const Slice* upper_bound,
     uint32_t seed);
 
 }  // namespace leveldb
@@ -10,6 +10,8 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/table.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -161,10 +163,18 @@ class SpecialEnv : public EnvWrapper {
     return s;
   }
 
-  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r)
-  {
-    class CountingFile : public RandomAccessFile 
-	{
+  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+    return CountRandomReads(target()->NewRandomAccessFile(f, r), r);
+  }
+
+  Status NewRandomAccessFileWithOptions(const std::string& f, const FileOptions& o,
+                                        RandomAccessFile** r) {
+    return CountRandomReads(target()->NewRandomAccessFileWithOptions(f, o, r), r);
+  }
+
+ private:
+  Status CountRandomReads(const Status& s, RandomAccessFile** r) {
+    class CountingFile : public RandomAccessFile {
      private:
       RandomAccessFile* target_;
       AtomicCounter* counter_;
@@ -180,7 +190,6 @@ class SpecialEnv : public EnvWrapper {
       }
     };
 
-    Status s = target()->NewRandomAccessFile(f, r);
     if (s.ok() && count_random_reads_) {
       *r = new CountingFile(*r, &random_read_counter_);
     }
@@ -191,13 +200,25 @@ class SpecialEnv : public EnvWrapper {
 class DBTest {
  private:
   const FilterPolicy* filter_policy_;
+  const FilterPolicy* cache_local_filter_policy_;
+  const FilterPolicy* ribbon_filter_policy_;
+  Cache* clock_cache_;
 
   // Sequence of option configurations to try
   enum OptionConfig {
     kDefault,
     kReuse,
     kFilter,
+    kCacheLocalFilter,
+    kRibbonFilter,
+    kFullFilter,
+    kPartitionedIndex,
+    kCachedIndexAndFilter,
+    kClockCache,
     kUncompressed,
+    kParallelCompaction,
+    kConcurrentMemtableWrite,
+    kPipelinedWrite,
     kEnd
   };
   int option_config_;
@@ -212,6 +233,9 @@ class DBTest {
   DBTest() : option_config_(kDefault),
              env_(new SpecialEnv(Env::Default())) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    cache_local_filter_policy_ = NewCacheLocalBloomFilterPolicy(10);
+    ribbon_filter_policy_ = NewRibbonFilterPolicy(10);
+    clock_cache_ = NewClockCache(1 << 20);
     dbname_ = test::TmpDir() + "/db_test";
     DestroyDB(dbname_, Options());
     db_ = NULL;
@@ -223,6 +247,9 @@ class DBTest {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete cache_local_filter_policy_;
+    delete ribbon_filter_policy_;
+    delete clock_cache_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -248,9 +275,46 @@ class DBTest {
       case kFilter:
         options.filter_policy = filter_policy_;
         break;
+      case kCacheLocalFilter:
+        options.filter_policy = cache_local_filter_policy_;
+        break;
+      case kRibbonFilter:
+        options.filter_policy = ribbon_filter_policy_;
+        break;
+      case kFullFilter:
+        options.filter_policy = filter_policy_;
+        options.full_table_filter = true;
+        break;
+      case kPartitionedIndex:
+        options.filter_policy = filter_policy_;
+        options.partition_index_and_filters = true;
+        options.metadata_block_size = 256;
+        break;
+      case kCachedIndexAndFilter:
+        // Blocks of mmap-ed tables cannot be cached
+        options.filter_policy = filter_policy_;
+        options.use_direct_reads = true;
+        options.cache_index_and_filter_blocks = true;
+        options.pin_l0_filter_and_index_blocks_in_cache = true;
+        break;
+      case kClockCache:
+        options.block_cache = clock_cache_;
+        options.use_direct_reads = true;
+        break;
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kParallelCompaction:
+        options.max_background_compactions = 4;
+        options.max_subcompactions = 4;
+        break;
+      case kConcurrentMemtableWrite:
+        options.allow_concurrent_memtable_write = true;
+        break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        options.allow_concurrent_memtable_write = true;
+        break;
       default:
         break;
     }
@@ -369,6 +433,8 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            default:
+              break;
           }
         }
         iter->Next();
@@ -390,6 +456,33 @@ class DBTest {
     return atoi(property.c_str());
   }
 
+  uint64_t Counter(const std::string& name) {
+    std::string property;
+    ASSERT_TRUE(db_->GetProperty("leveldb." + name, &property));
+    return strtoull(property.c_str(), NULL, 10);
+  }
+
+  // Build a table for IngestExternalFile() at a new path from "entries",
+  // given as "key=value" or "-key" for a deletion, in order.
+  std::string WriteExternalFile(const std::vector<std::string>& entries) {
+    static int next_file = 0;
+    const std::string path = test::TmpDir() + "/db_test_external_" +
+                             NumberToString(next_file++) + ".sst";
+    SstFileWriter writer(last_options_);
+    ASSERT_OK(writer.Open(path));
+    for (size_t i = 0; i < entries.size(); i++) {
+      const std::string& e = entries[i];
+      if (e[0] == '-') {
+        ASSERT_OK(writer.Delete(e.substr(1)));
+      } else {
+        const size_t eq = e.find('=');
+        ASSERT_OK(writer.Put(e.substr(0, eq), e.substr(eq + 1)));
+      }
+    }
+    ASSERT_OK(writer.Finish());
+    return path;
+  }
+
   int TotalTableFiles() {
     int result = 0;
     for (int level = 0; level < config::kNumLevels; level++) {
@@ -565,6 +658,65 @@ TEST(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, MultiGet) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    Compact("a", "z");                // Push to a deeper level
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Delete("c"));
+    dbfull()->TEST_CompactMemTable();  // Level-0
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(Put("a", "va2"));        // Memtable
+    ASSERT_OK(Put("e", "ve"));
+    ASSERT_OK(Delete("d"));
+
+    std::vector<Slice> keys;
+    keys.push_back("e");
+    keys.push_back("a");
+    keys.push_back("c");
+    keys.push_back("zz");
+    keys.push_back("b");
+    keys.push_back("a");
+    keys.push_back("d");
+    const char* expected[] = { "ve", "va2", NULL, NULL, "vb", "va2", NULL };
+    const char* expected_snapshot[] = { NULL, "va", NULL, NULL, "vb", "va", "vd" };
+
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+    ASSERT_EQ(keys.size(), values.size());
+    ASSERT_EQ(keys.size(), statuses.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (expected[i] == NULL) {
+        ASSERT_TRUE(statuses[i].IsNotFound()) << keys[i].ToString();
+      } else {
+        ASSERT_OK(statuses[i]);
+        ASSERT_EQ(expected[i], values[i]);
+      }
+    }
+
+    ReadOptions options;
+    options.snapshot = snapshot;
+    db_->MultiGet(options, keys, &values, &statuses);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (expected_snapshot[i] == NULL) {
+        ASSERT_TRUE(statuses[i].IsNotFound()) << keys[i].ToString();
+      } else {
+        ASSERT_OK(statuses[i]);
+        ASSERT_EQ(expected_snapshot[i], values[i]);
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
+
+    keys.clear();
+    db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+    ASSERT_TRUE(values.empty());
+    ASSERT_TRUE(statuses.empty());
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetMemUsage) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -1004,6 +1156,189 @@ TEST(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+namespace {
+// Keeps every thread of the low-priority pool busy, so that compactions
+// wait in the queue until Release()
+class CompactionBlocker {
+ public:
+  explicit CompactionBlocker(Env* env)
+      : cv_(&mu_),
+        threads_(env->GetBackgroundThreads(Env::LOW)),
+        started_(0),
+        finished_(0),
+        released_(false) {
+    for (int i = 0; i < threads_; i++) {
+      env->ScheduleWithPriority(&Block, this, Env::LOW, NULL);
+    }
+    MutexLock l(&mu_);
+    while (started_ < threads_) {
+      cv_.Wait();
+    }
+  }
+
+  void Release() {
+    MutexLock l(&mu_);
+    released_ = true;
+    cv_.SignalAll();
+    while (finished_ < threads_) {
+      cv_.Wait();
+    }
+  }
+
+ private:
+  static void Block(void* arg) {
+    CompactionBlocker* b = reinterpret_cast<CompactionBlocker*>(arg);
+    MutexLock l(&b->mu_);
+    b->started_++;
+    b->cv_.SignalAll();
+    while (!b->released_) {
+      b->cv_.Wait();
+    }
+    b->finished_++;
+    b->cv_.SignalAll();
+  }
+
+  port::Mutex mu_;
+  port::CondVar cv_;
+  const int threads_;
+  int started_;
+  int finished_;
+  bool released_;
+};
+}  // namespace
+
+TEST(DBTest, ParallelCompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 32 << 20;  // Only flush when asked to
+  options.max_background_compactions = 4;
+  Reopen(&options);
+
+  // A level-2 table over the whole key space keeps the next flushes out
+  // of level-2, and a level-1 table under "a" keeps the later "a" flushes
+  // in level-0.
+  ASSERT_OK(Put("0", "v"));
+  ASSERT_OK(Put("~", "v"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(Put("a", "v"));
+  ASSERT_OK(Put("b", "v"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // Hold the compactions back while level-1 grows past its limit under
+  // "z" and level-0 fills up under "a", so that there are two disjoint
+  // compactions to run.  Level-0 scores higher, so its compaction takes
+  // the "a" table of level-1 before a level-1 compaction could.
+  CompactionBlocker blocker(env_);
+  Random rnd(301);
+  std::map<std::string, std::string> values;
+  for (int i = 0; i < 13; i++) {
+    std::string key = "z" + Key(i);
+    values[key] = RandomString(&rnd, 1 << 20);
+    ASSERT_OK(Put(key, values[key]));
+  }
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int t = 0; t < 6; t++) {
+    for (int i = 0; i < 10; i++) {
+      std::string key = "a" + Key(i);
+      values[key] = RandomString(&rnd, 1000);
+      ASSERT_OK(Put(key, values[key]));
+    }
+    ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  }
+  ASSERT_EQ("6,2,1", FilesPerLevel());
+
+  // Both compactions stop at the sync of their first output until both
+  // have started
+  env_->delay_data_sync_.Release_Store(env_);
+  blocker.Release();
+  bool disjoint = false;
+  for (int i = 0; i < 1000 && dbfull()->TEST_MaxConcurrentCompactions(&disjoint) < 2; i++) {
+    DelayMilliseconds(10);
+  }
+  env_->delay_data_sync_.Release_Store(NULL);
+  ASSERT_GE(dbfull()->TEST_MaxConcurrentCompactions(&disjoint), 2);
+  ASSERT_TRUE(disjoint);
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (std::map<std::string, std::string>::iterator it = values.begin();
+         it != values.end(); ++it) {
+      ASSERT_EQ(it->second, Get(it->first));
+    }
+    Reopen(&options);
+  }
+}
+
+TEST(DBTest, MultiGetManyFiles) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  Reopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int i = 0; i < 2000; i++) {
+    std::string key = Key(rnd.Uniform(1500));
+    if (rnd.OneIn(10)) {
+      model.erase(key);
+      ASSERT_OK(Delete(key));
+    } else {
+      model[key] = RandomString(&rnd, 200);
+      ASSERT_OK(Put(key, model[key]));
+    }
+  }
+  ASSERT_GT(TotalTableFiles(), 1);
+
+  std::vector<std::string> key_storage;
+  for (int i = 0; i < 500; i++) {
+    key_storage.push_back(Key(rnd.Uniform(2000)));
+  }
+  std::vector<Slice> keys(key_storage.begin(), key_storage.end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+  for (size_t i = 0; i < keys.size(); i++) {
+    std::map<std::string, std::string>::iterator it = model.find(key_storage[i]);
+    if (it == model.end()) {
+      ASSERT_TRUE(statuses[i].IsNotFound());
+    } else {
+      ASSERT_OK(statuses[i]);
+      ASSERT_EQ(it->second, values[i]);
+    }
+  }
+}
+
+TEST(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_background_compactions = 4;
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> values;
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 2000; i++) {
+      std::string key = Key(rnd.Uniform(2000));
+      values[key] = RandomString(&rnd, 1000);
+      ASSERT_OK(Put(key, values[key]));
+    }
+    // Push everything down so that the next round's level-0 files
+    // overlap several files in the levels below.
+    db_->CompactRange(NULL, NULL);
+    ASSERT_EQ(0, NumTableFilesAtLevel(0));
+    ASSERT_GT(TotalTableFiles(), 1);
+  }
+
+  for (std::map<std::string, std::string>::iterator it = values.begin();
+       it != values.end(); ++it) {
+    ASSERT_EQ(it->second, Get(it->first));
+  }
+  Reopen(&options);
+  for (std::map<std::string, std::string>::iterator it = values.begin();
+       it != values.end(); ++it) {
+    ASSERT_EQ(it->second, Get(it->first));
+  }
+}
+
 TEST(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1074,6 +1409,89 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
   return result;
 }
 
+TEST(DBTest, CompressionPerLevel) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;        // Large write buffer
+  options.compression = kSnappyCompression;     // Overridden below
+  options.compression_per_level.push_back(kNoCompression);
+  options.compression_per_level.push_back(kLZ4Compression);
+  options.compression_per_level.push_back(kZstdCompression);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // Write 1MB of data that compresses to about a quarter
+  const int N = 100;
+  Random rnd(301);
+  std::vector<std::string> values(N);
+  for (int i = 0; i < N; i++) {
+    test::CompressibleString(&rnd, 0.25, 10000, &values[i]);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+
+  // The memtable flush uses the level-0 entry, so it is not compressed
+  // no matter which level the table lands in.
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_TRUE(Between(Size("", Key(N)), N * 10000, N * 10500));
+
+  // Push the table one level down; every level below 0 compresses, with
+  // LZ4 at level 1 and zstd further down.
+  int level = 0;
+  while (NumTableFilesAtLevel(level) == 0) {
+    level++;
+  }
+  const CompressionType expected = (level == 0) ? kLZ4Compression : kZstdCompression;
+  std::string out;
+  const bool supported = (expected == kLZ4Compression)
+      ? port::LZ4_Compress("aaaaaaaaaa", 10, &out)
+      : port::Zstd_Compress(1, "aaaaaaaaaa", 10, &out);
+  dbfull()->TEST_CompactRange(level, NULL, NULL);
+  ASSERT_EQ(0, NumTableFilesAtLevel(level));
+  ASSERT_GT(NumTableFilesAtLevel(level + 1), 0);
+  if (supported) {
+    ASSERT_LT(Size("", Key(N)), static_cast<uint64_t>(N) * 10000 / 2);
+  } else {
+    fprintf(stderr, "compression type %d not supported; skipping size check\n",
+            static_cast<int>(expected));
+  }
+
+  // Tables written with different codecs read back the same
+  for (int run = 0; run < 2; run++) {
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+    Reopen(&options);
+  }
+}
+
+TEST(DBTest, DirectIO) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.use_direct_reads = true;
+  options.use_direct_io_for_flush_and_compaction = true;
+  options.use_dsync_writes = true;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // Enough data for flushes and compactions across several levels
+  const int N = 2000;
+  Random rnd(301);
+  std::vector<std::string> values(N);
+  for (int i = 0; i < N; i++) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+
+  for (int run = 0; run < 2; run++) {
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+    Reopen(&options);
+  }
+}
+
 TEST(DBTest, ApproximateSizes) {
   do {
     Options options = CurrentOptions();
@@ -1312,6 +1730,312 @@ TEST(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_OK(Put("b2", "vb2"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_OK(Put("c", "vc2"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "x", "a"));  // Empty range
+
+    for (int i = 0; i < 4; i++) {
+      // In the memtable, after a flush, after reopening and after a full
+      // compaction
+      if (i == 1) ASSERT_OK(dbfull()->TEST_CompactMemTable());
+      if (i == 2) Reopen();
+      if (i == 3) db_->CompactRange(NULL, NULL);
+      ASSERT_EQ("va", Get("a"));
+      ASSERT_EQ("NOT_FOUND", Get("b"));
+      ASSERT_EQ("NOT_FOUND", Get("b2"));
+      ASSERT_EQ("vc2", Get("c"));
+      ASSERT_EQ("vd", Get("d"));
+      ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+      std::vector<Slice> keys;
+      keys.push_back("b");
+      keys.push_back("c");
+      std::vector<std::string> values;
+      std::vector<Status> statuses;
+      db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+      ASSERT_TRUE(statuses[0].IsNotFound());
+      ASSERT_OK(statuses[1]);
+      ASSERT_EQ("vc2", values[1]);
+    }
+    // Nothing is left under the tombstone once it reaches the last level
+    ASSERT_EQ("[ ]", AllEntriesFor("b"));
+    ASSERT_EQ("[ vc2 ]", AllEntriesFor("c"));
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeSnapshot) {
+  ASSERT_OK(Put("k1", "v1"));
+  ASSERT_OK(Put("k2", "v2"));
+  ASSERT_OK(Put("k3", "v3"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "k1", "k3"));
+  for (int i = 0; i < 2; i++) {
+    if (i == 1) db_->CompactRange(NULL, NULL);
+    ASSERT_EQ("NOT_FOUND", Get("k1"));
+    ASSERT_EQ("NOT_FOUND", Get("k2"));
+    ASSERT_EQ("v3", Get("k3"));
+    ASSERT_EQ("v1", Get("k1", snapshot));
+    ASSERT_EQ("v2", Get("k2", snapshot));
+    ReadOptions options;
+    options.snapshot = snapshot;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "k1->v1");
+    delete iter;
+  }
+  ASSERT_EQ("[ v1 ]", AllEntriesFor("k1"));
+
+  // Once the snapshot is gone, compacting the data down drops it
+  db_->ReleaseSnapshot(snapshot);
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ("[ ]", AllEntriesFor("k1"));
+  ASSERT_EQ("(k3->v3)", Contents());
+}
+
+TEST(DBTest, DeleteRangeOverlapping) {
+  // Tombstones that overlap each other, with snapshots between them
+  const char* kKeys[] = { "a", "b", "c", "d", "e", "f", "g" };
+  for (int i = 0; i < 7; i++) {
+    ASSERT_OK(Put(kKeys[i], "1"));
+  }
+  const Snapshot* s1 = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "c", "f"));
+  ASSERT_OK(Put("d", "2"));
+  const Snapshot* s2 = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "e"));
+  ASSERT_OK(Put("c", "3"));
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "e", "g"));
+
+  for (int i = 0; i < 3; i++) {
+    // In the memtable, after a flush and after a full compaction
+    if (i == 1) ASSERT_OK(dbfull()->TEST_CompactMemTable());
+    if (i == 2) db_->CompactRange(NULL, NULL);
+    ASSERT_EQ("(a->1)(c->3)(g->1)", Contents());
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("3", Get("c"));
+    ASSERT_EQ("NOT_FOUND", Get("d"));
+    ASSERT_EQ("NOT_FOUND", Get("f"));
+    ASSERT_EQ("1", Get("g"));
+    ASSERT_EQ("1", Get("b", s2));
+    ASSERT_EQ("NOT_FOUND", Get("c", s2));
+    ASSERT_EQ("2", Get("d", s2));
+    ASSERT_EQ("NOT_FOUND", Get("e", s2));
+    ASSERT_EQ("1", Get("f", s2));
+    for (int k = 0; k < 7; k++) {
+      ASSERT_EQ("1", Get(kKeys[k], s1));
+    }
+  }
+  db_->ReleaseSnapshot(s1);
+  db_->ReleaseSnapshot(s2);
+}
+
+TEST(DBTest, DeleteRangeDropsTables) {
+  ASSERT_OK(Put("b1", "v"));
+  ASSERT_OK(Put("b2", "v"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(Put("x", "v"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(2, TotalTableFiles());
+
+  // A snapshot keeps the table
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "a", "b2"));
+  ASSERT_EQ(2, TotalTableFiles());
+  db_->ReleaseSnapshot(snapshot);
+
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "c"));
+  ASSERT_EQ(1, TotalTableFiles());
+  ASSERT_EQ("NOT_FOUND", Get("b1"));
+  ASSERT_EQ("(x->v)", Contents());
+  Reopen();
+  ASSERT_EQ("NOT_FOUND", Get("b1"));
+  ASSERT_EQ("(x->v)", Contents());
+}
+
+TEST(DBTest, DeleteRangeAcrossTables) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> values;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 3000; i++) {
+      if (i % 500 == 499) {
+        // Tombstones cut into the middle of tables and past their ends
+        const int begin = rnd.Uniform(2000);
+        const std::string begin_key = Key(begin);
+        const std::string end_key = Key(begin + rnd.Uniform(300));
+        values.erase(values.lower_bound(begin_key), values.lower_bound(end_key));
+        ASSERT_OK(db_->DeleteRange(WriteOptions(), begin_key, end_key));
+      } else {
+        std::string key = Key(rnd.Uniform(2000));
+        values[key] = RandomString(&rnd, 1000);
+        ASSERT_OK(Put(key, values[key]));
+      }
+    }
+    if (round < 2) {
+      db_->CompactRange(NULL, NULL);
+    }
+
+    for (int i = 0; i < 2000; i++) {
+      std::map<std::string, std::string>::iterator it = values.find(Key(i));
+      ASSERT_EQ(it == values.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    std::map<std::string, std::string>::iterator it = values.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++it) {
+      ASSERT_TRUE(it != values.end());
+      ASSERT_EQ(it->first, iter->key().ToString());
+    }
+    ASSERT_TRUE(it == values.end());
+    delete iter;
+  }
+}
+
+static std::vector<std::string> Entries(const char* e1, const char* e2 = NULL,
+                                        const char* e3 = NULL) {
+  std::vector<std::string> result;
+  result.push_back(e1);
+  if (e2 != NULL) result.push_back(e2);
+  if (e3 != NULL) result.push_back(e3);
+  return result;
+}
+
+TEST(DBTest, IngestExternalFile) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("c", "old"));
+    ASSERT_OK(Put("d", "old"));
+    ASSERT_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_OK(Put("d", "vd"));  // Still in the memtable
+    const Snapshot* snapshot = db_->GetSnapshot();
+
+    std::vector<std::string> paths;
+    paths.push_back(WriteExternalFile(Entries("b=vb", "c=new", "-d")));
+    paths.push_back(WriteExternalFile(Entries("x=vx")));
+    ASSERT_OK(db_->IngestExternalFile(paths));
+    ASSERT_TRUE(!env_->FileExists(paths[0]));
+    ASSERT_OK(Put("x", "vx2"));
+
+    // The snapshot predates the ingestion
+    ASSERT_EQ("NOT_FOUND", Get("b", snapshot));
+    ASSERT_EQ("old", Get("c", snapshot));
+    ASSERT_EQ("vd", Get("d", snapshot));
+    ReadOptions options;
+    options.snapshot = snapshot;
+    Iterator* iter = db_->NewIterator(options);
+    iter->Seek("b");
+    ASSERT_EQ(IterStatus(iter), "c->old");
+    delete iter;
+    db_->ReleaseSnapshot(snapshot);
+
+    for (int i = 0; i < 3; i++) {
+      // As ingested, after reopening and after a full compaction
+      if (i == 1) Reopen();
+      if (i == 2) db_->CompactRange(NULL, NULL);
+      ASSERT_EQ("va", Get("a"));
+      ASSERT_EQ("vb", Get("b"));
+      ASSERT_EQ("new", Get("c"));
+      ASSERT_EQ("NOT_FOUND", Get("d"));
+      ASSERT_EQ("vx2", Get("x"));
+      ASSERT_EQ("(a->va)(b->vb)(c->new)(x->vx2)", Contents());
+
+      std::vector<Slice> keys;
+      keys.push_back("b");
+      keys.push_back("d");
+      std::vector<std::string> values;
+      std::vector<Status> statuses;
+      db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+      ASSERT_OK(statuses[0]);
+      ASSERT_EQ("vb", values[0]);
+      ASSERT_TRUE(statuses[1].IsNotFound());
+    }
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IngestExternalFileLevels) {
+  const int last = config::kNumLevels - 1;
+  std::vector<std::string> paths;
+  paths.push_back(WriteExternalFile(Entries("b=v1", "d=v1")));
+  ASSERT_OK(db_->IngestExternalFile(paths));
+  ASSERT_EQ(1, NumTableFilesAtLevel(last));
+
+  // A table sinks to just above the data for its keys
+  paths[0] = WriteExternalFile(Entries("c=v2", "e=v2"));
+  ASSERT_OK(db_->IngestExternalFile(paths));
+  ASSERT_EQ(1, NumTableFilesAtLevel(last - 1));
+
+  paths[0] = WriteExternalFile(Entries("x=v3"));
+  ASSERT_OK(db_->IngestExternalFile(paths));
+  ASSERT_EQ(2, NumTableFilesAtLevel(last));
+
+  // Level-0 tables are searched newest first, so an ingested table must
+  // come after the memtable flushed for it
+  ASSERT_OK(Put("a", "v4"));
+  ASSERT_OK(Put("z", "v4"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(Put("a", "v5"));
+  ASSERT_OK(Put("m", "v5"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(Put("a", "v6"));
+  ASSERT_OK(Put("y", "v6"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("1,1,1,0,0,1,2", FilesPerLevel());
+  ASSERT_OK(Put("y", "v7"));
+  paths[0] = WriteExternalFile(Entries("a=v8", "y=v8"));
+  ASSERT_OK(db_->IngestExternalFile(paths));
+  ASSERT_EQ(3, NumTableFilesAtLevel(0));
+  for (int i = 0; i < 2; i++) {
+    if (i == 1) Reopen();
+    ASSERT_EQ("v8", Get("a"));
+    ASSERT_EQ("v8", Get("y"));
+    ASSERT_EQ("(a->v8)(b->v1)(c->v2)(d->v1)(e->v2)(m->v5)(x->v3)(y->v8)(z->v4)",
+              Contents());
+  }
+}
+
+TEST(DBTest, IngestExternalFileErrors) {
+  const std::string path = test::TmpDir() + "/db_test_external_bad.sst";
+  SstFileWriter writer(last_options_);
+  ASSERT_OK(writer.Open(path));
+  ASSERT_OK(writer.Put("b", "v"));
+  ASSERT_TRUE(writer.Put("b", "v").IsInvalidArgument());
+  ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+  ASSERT_OK(writer.Finish());
+  ASSERT_TRUE(writer.FileSize() > 0);
+
+  SstFileWriter empty(last_options_);
+  ASSERT_OK(empty.Open(path + ".empty"));
+  ASSERT_TRUE(empty.Finish().IsInvalidArgument());
+  ASSERT_TRUE(!env_->FileExists(path + ".empty"));
+
+  // Overlapping tables are refused and left in place
+  std::vector<std::string> paths;
+  paths.push_back(path);
+  paths.push_back(WriteExternalFile(Entries("a=v", "c=v")));
+  ASSERT_TRUE(db_->IngestExternalFile(paths).IsInvalidArgument());
+  ASSERT_TRUE(env_->FileExists(paths[0]));
+  ASSERT_TRUE(env_->FileExists(paths[1]));
+  paths[1] = test::TmpDir() + "/db_test_external_missing.sst";
+  ASSERT_TRUE(!db_->IngestExternalFile(paths).ok());
+  ASSERT_TRUE(env_->FileExists(paths[0]));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ(0, TotalTableFiles());
+  env_->DeleteFile(paths[0]);
+}
+
 TEST(DBTest, OverlapInLevel0) {
   do {
     ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
@@ -1757,6 +2481,524 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, FullTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.full_table_filter = true;
+  Reopen(&options);
+
+  // Populate multiple layers
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d present => %d reads\n", N, reads);
+  ASSERT_GE(reads, N);
+  ASSERT_LE(reads, N + 2*N/100);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3*N/100);
+  env_->delay_data_sync_.Release_Store(NULL);
+
+  // Tables written with per-block filters stay readable, and both
+  // formats can live in one DB.
+  options.full_table_filter = false;
+  Reopen(&options);
+  ASSERT_OK(Put("a", "va"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(Key(7), Get(Key(7)));
+  options.full_table_filter = true;
+  Reopen(&options);
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(Key(7), Get(Key(7)));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, PartitionedIndexAndFilters) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.partition_index_and_filters = true;
+  options.metadata_block_size = 256;
+  // Blocks of mmap-ed tables cannot be cached
+  options.use_direct_reads = true;
+  Reopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  // A missing key costs one filter partition lookup per table, served
+  // from the block cache after the partition is first read, and rarely
+  // a data block read.  Every index partition covers at least one data
+  // block and has one filter partition, so the tables have at most
+  // 2 * blocks partitions.
+  const int blocks = static_cast<int>(Size("", "~") / options.block_size) +
+                     TotalTableFiles();
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads (%d blocks)\n", N, reads, blocks);
+  ASSERT_LE(reads, 2*blocks + 3*N/100);
+
+  // Without a block cache every partition is read from the file
+  env_->delay_data_sync_.Release_Store(NULL);
+  Close();
+  delete options.block_cache;
+  options.block_cache = NewLRUCache(0);
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i += 10) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d uncached missing => %d reads\n", N / 10, reads);
+  ASSERT_GE(reads, N / 10);
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, CacheIndexAndFilterBlocks) {
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  // Blocks of mmap-ed tables cannot be cached
+  options.use_direct_reads = true;
+  options.block_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  const int N = 2000;
+  const std::string value(100, 'v');
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), value));
+  }
+  Compact("a", "z");
+
+  // A lookup in a freshly opened table also charges its index block and
+  // filter to the block cache
+  size_t charge[2];
+  for (int cached = 0; cached < 2; cached++) {
+    Close();
+    delete options.block_cache;
+    options.block_cache = NewLRUCache(1 << 20);
+    options.cache_index_and_filter_blocks = (cached == 1);
+    Reopen(&options);
+    ASSERT_EQ(value, Get(Key(0)));
+    charge[cached] = options.block_cache->TotalCharge();
+  }
+  fprintf(stderr, "block cache charge %d => %d\n",
+          static_cast<int>(charge[0]), static_cast<int>(charge[1]));
+  ASSERT_GT(charge[1], charge[0]);
+
+  // Index blocks and filters that do not fit are read again
+  Close();
+  delete options.block_cache;
+  options.block_cache = NewLRUCache(1);
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(value, Get(Key(i)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  ASSERT_EQ(0u, options.block_cache->TotalCharge());
+
+  // Unless they belong to a freshly flushed table and are pinned
+  options.pin_l0_filter_and_index_blocks_in_cache = true;
+  Reopen(&options);
+  for (int i = 0; i < N; i += 10) {
+    ASSERT_OK(Put(Key(i), "new"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(options.block_cache->TotalCharge(), 0u);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(i % 10 == 0 ? "new" : value, Get(Key(i)));
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, ReadStatistics) {
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  // Blocks of mmap-ed tables are not read through the block cache
+  options.use_direct_reads = true;
+  Reopen(&options);
+
+  const int N = 100;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  Compact("a", "z");
+  ASSERT_OK(Put("memtable", "v"));
+  Reopen(&options);
+  ASSERT_OK(Put("memtable", "v"));
+
+  ASSERT_EQ("v", Get("memtable"));
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("v", Get(Key(i)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  iter->Seek(Key(N / 2));
+  delete iter;
+
+  ASSERT_EQ(1u, Counter("memtable-hits"));
+  ASSERT_EQ(static_cast<uint64_t>(2 * N), Counter("memtable-misses"));
+  ASSERT_EQ(static_cast<uint64_t>(N), Counter("get-not-found"));
+  uint64_t level_hits = 0;
+  uint64_t level_bytes = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    level_hits += Counter("get-hits-at-level" + NumberToString(level));
+    level_bytes += Counter("bytes-read-at-level" + NumberToString(level));
+  }
+  ASSERT_EQ(static_cast<uint64_t>(N), level_hits);
+  ASSERT_GT(Counter("bloom-useful"), static_cast<uint64_t>(N / 2));
+  ASSERT_LT(Counter("bloom-useless"), static_cast<uint64_t>(N / 2));
+  ASSERT_GT(Counter("block-cache-data-hits"), 0u);
+  ASSERT_GT(Counter("block-cache-data-misses"), 0u);
+  ASSERT_GT(Counter("bytes-read"), 0u);
+  ASSERT_GT(level_bytes, 0u);
+  ASSERT_EQ(2u, Counter("iter-seeks"));
+
+  std::string json;
+  ASSERT_TRUE(db_->GetProperty("leveldb.stats.json", &json));
+  ASSERT_EQ('{', json[0]);
+  ASSERT_TRUE(json.find("\"bloom-useful\": ") != std::string::npos) << json;
+  ASSERT_TRUE(json.find("\"get-hits-at-level\": [") != std::string::npos) << json;
+  std::string value;
+  ASSERT_TRUE(!db_->GetProperty("leveldb.no-such-counter", &value));
+  ASSERT_TRUE(!db_->GetProperty("leveldb.get-hits-at-level99", &value));
+
+  Close();
+  delete options.filter_policy;
+}
+
+// Keys yielded by a prefix_same_as_start iterator after Seek(target),
+// separated by commas.
+static std::string PrefixScan(DB* db, const std::string& target) {
+  ReadOptions options;
+  options.prefix_same_as_start = true;
+  Iterator* iter = db->NewIterator(options);
+  std::string result;
+  for (iter->Seek(target); iter->Valid(); iter->Next()) {
+    if (!result.empty()) {
+      result += ",";
+    }
+    result += iter->key().ToString();
+  }
+  delete iter;
+  return result;
+}
+
+TEST(DBTest, PrefixSameAsStart) {
+  const SliceTransform* prefix_extractor = NewFixedPrefixTransform(3);
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.full_table_filter = true;
+  options.partition_index_and_filters = false;
+  options.prefix_extractor = prefix_extractor;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // t01, t03 and t05 in the last level, t02 and t04 in level-0, t06 in
+  // the memtable
+  ASSERT_OK(Put("t01|a", "v"));
+  ASSERT_OK(Put("t03|a", "v"));
+  ASSERT_OK(Put("t03|b", "v"));
+  ASSERT_OK(Put("t05|a", "v"));
+  Compact("t", "u");
+  ASSERT_OK(Put("t02|a", "v"));
+  ASSERT_OK(Put("t04|a", "v"));
+  ASSERT_OK(Put("t04|b", "v"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("t06|a", "v"));
+  ASSERT_OK(Delete("t03|b"));
+
+  ASSERT_EQ("t03|a", PrefixScan(db_, "t03"));
+  ASSERT_EQ("t04|a,t04|b", PrefixScan(db_, "t04"));
+  ASSERT_EQ("t04|b", PrefixScan(db_, "t04|b"));
+  ASSERT_EQ("t06|a", PrefixScan(db_, "t06"));
+  ASSERT_EQ("", PrefixScan(db_, "t07"));
+  ReadOptions prefix_options;
+  prefix_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(prefix_options);
+  iter->Seek("t00");
+  ASSERT_EQ("(invalid)", IterStatus(iter));
+  iter->SeekToFirst();
+  ASSERT_EQ("t01|a->v", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("t02|a->v", IterStatus(iter));
+  delete iter;
+  ASSERT_GT(Counter("bloom-prefix-useful"), 0u);
+
+  // A target without a prefix does not bound the iterator
+  ASSERT_EQ("t01|a,t02|a,t03|a,t04|a,t04|b,t05|a,t06|a", PrefixScan(db_, "t"));
+  iter = db_->NewIterator(ReadOptions());
+  iter->Seek("t03");
+  iter->Next();
+  ASSERT_EQ("t04|a->v", IterStatus(iter));
+  delete iter;
+
+  // Tables written with another prefix extractor are searched in full
+  const SliceTransform* other_extractor = NewFixedPrefixTransform(2);
+  options.prefix_extractor = other_extractor;
+  Reopen(&options);
+  ASSERT_EQ("t01|a,t02|a,t03|a,t04|a,t04|b,t05|a,t06|a", PrefixScan(db_, "t0"));
+  ASSERT_EQ("", PrefixScan(db_, "t1"));
+  ASSERT_EQ("", PrefixScan(db_, "u0"));
+
+  Close();
+  delete options.filter_policy;
+  delete other_extractor;
+  delete prefix_extractor;
+}
+
+// Return the keys in [start, limit) read with ReadOptions::iterate_upper_bound,
+// backward if "reverse", followed by the number of random reads it took
+static std::string BoundedScan(DB* db, SpecialEnv* env, const std::string& start,
+                               const std::string& limit, bool reverse) {
+  ReadOptions options;
+  Slice upper_bound(limit);
+  options.iterate_upper_bound = &upper_bound;
+  env->random_read_counter_.Reset();
+  Iterator* iter = db->NewIterator(options);
+  int count = 0;
+  std::string result;
+  if (reverse) {
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      ASSERT_TRUE(iter->key().compare(limit) < 0);
+      result = iter->key().ToString();
+      count++;
+    }
+  } else {
+    for (iter->Seek(start); iter->Valid(); iter->Next()) {
+      if (count == 0) {
+        result = iter->key().ToString();
+      }
+      count++;
+    }
+  }
+  delete iter;
+  char buf[100];
+  snprintf(buf, sizeof(buf), ":%d", count);
+  return result + buf;
+}
+
+TEST(DBTest, IterateUpperBound) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.block_size = 1024;
+  Reopen(&options);
+
+  // Three tables starting at "a", "b" and "c" that all end at "z", in
+  // levels 2, 1 and 0
+  const std::string value(100, 'v');
+  for (char c = 'a'; c <= 'c'; c++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(std::string(1, c) + Key(i), value));
+    }
+    ASSERT_OK(Put("z", value));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  ASSERT_EQ("a" + Key(0) + ":100", BoundedScan(db_, env_, "a", "b", false));
+  ASSERT_EQ("b" + Key(50) + ":50", BoundedScan(db_, env_, "b" + Key(50), "c", false));
+  ASSERT_EQ(":0", BoundedScan(db_, env_, "c", "c", false));
+  ASSERT_EQ("a" + Key(0) + ":300", BoundedScan(db_, env_, "", "d", false));
+  ASSERT_EQ("a" + Key(0) + ":100", BoundedScan(db_, env_, "", "b", true));
+  ASSERT_EQ("a" + Key(0) + ":300", BoundedScan(db_, env_, "", "z", true));
+  ASSERT_EQ(":0", BoundedScan(db_, env_, "", "a", true));
+
+  // Turning around below the bound
+  ReadOptions read_options;
+  Slice upper_bound("b");
+  read_options.iterate_upper_bound = &upper_bound;
+  Iterator* iter = db_->NewIterator(read_options);
+  iter->Seek("a" + Key(99));
+  ASSERT_EQ("a" + Key(99) + "->" + value, IterStatus(iter));
+  iter->Prev();
+  ASSERT_EQ("a" + Key(98) + "->" + value, IterStatus(iter));
+  iter->Next();
+  iter->Next();
+  ASSERT_EQ("(invalid)", IterStatus(iter));
+  iter->SeekToLast();
+  ASSERT_EQ("a" + Key(99) + "->" + value, IterStatus(iter));
+  delete iter;
+
+  // A scan that stops at the bound reads neither the tables after it nor
+  // the block holding "z"
+  Reopen(&options);
+  BoundedScan(db_, env_, "a", "b", false);
+  const int bounded_reads = env_->random_read_counter_.Read();
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ReadOptions());
+  for (iter->Seek("a"); iter->Valid() && iter->key().compare("b") < 0; iter->Next()) {
+  }
+  delete iter;
+  const int unbounded_reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "bounded scan => %d reads, unbounded => %d reads\n",
+          bounded_reads, unbounded_reads);
+  ASSERT_LT(bounded_reads, unbounded_reads);
+
+  // Tables whose smallest key is after the target are only opened once
+  // the iterator gets there
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ReadOptions());
+  iter->Seek("a" + Key(50));
+  ASSERT_EQ("a" + Key(50) + "->" + value, IterStatus(iter));
+  delete iter;
+  const int one_table_reads = env_->random_read_counter_.Read();
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ReadOptions());
+  iter->Seek("c" + Key(50));
+  ASSERT_EQ("c" + Key(50) + "->" + value, IterStatus(iter));
+  delete iter;
+  const int three_table_reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "seek in one table => %d reads, in three => %d reads\n",
+          one_table_reads, three_table_reads);
+  ASSERT_LT(one_table_reads, three_table_reads);
+
+  delete options.block_cache;
+}
+
+TEST(DBTest, Histograms) {
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ("v", Get(Key(i)));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  delete iter;
+
+  Histogram histogram;
+  histogram.Clear();
+  dbfull()->statistics()->MergeHistogram(Statistics::kGetMicros, &histogram);
+  ASSERT_EQ(100, histogram.num());
+  histogram.Clear();
+  dbfull()->statistics()->MergeHistogram(Statistics::kWriteMicros, &histogram);
+  ASSERT_EQ(101, histogram.num());  // Including the write that forced the flush
+  histogram.Clear();
+  dbfull()->statistics()->MergeHistogram(Statistics::kFlushMicros, &histogram);
+  ASSERT_EQ(1, histogram.num());
+  histogram.Clear();
+  dbfull()->statistics()->MergeHistogram(Statistics::kIterSeekMicros, &histogram);
+  ASSERT_EQ(1, histogram.num());
+
+  std::string value;
+  ASSERT_TRUE(db_->GetProperty("leveldb.histograms", &value));
+  ASSERT_TRUE(value.find("** get (micros) **\nCount: 100 ") != std::string::npos)
+      << value;
+  ASSERT_TRUE(value.find("** compaction (micros) **\nNo samples\n") !=
+              std::string::npos) << value;
+
+  db_->ResetStats();
+  ASSERT_EQ(0u, Counter("memtable-misses"));
+  ASSERT_TRUE(db_->GetProperty("leveldb.histograms", &value));
+  ASSERT_TRUE(value.find("Count:") == std::string::npos) << value;
+}
+
+TEST(DBTest, SecondaryCache) {
+  Options options = CurrentOptions();
+  // Blocks of mmap-ed tables are not read through the caches
+  options.use_direct_reads = true;
+  options.block_cache = NewLRUCache(1);
+  Reopen(&options);
+
+  const int N = 500;
+  const std::string value(1000, 'v');
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), value));
+  }
+  Compact("a", "z");
+  std::string stats;
+  ASSERT_TRUE(!db_->GetProperty("leveldb.secondary-cache-stats", &stats));
+
+  options.secondary_cache_path = dbname_ + "_secondary_cache";
+  options.secondary_cache_size = 1 << 20;
+  Reopen(&options);
+  // Blocks are admitted on their second read, and found on the third
+  for (int pass = 0; pass < 3; pass++) {
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(value, Get(Key(i)));
+    }
+  }
+  ASSERT_TRUE(db_->GetProperty("leveldb.secondary-cache-stats", &stats));
+  fprintf(stderr, "%s", stats.c_str());
+  unsigned long long hits = 0;
+  ASSERT_EQ(1, sscanf(stats.c_str(), "hits: %llu", &hits));
+  ASSERT_GE(hits, static_cast<unsigned long long>(N / 4));
+
+  // Opening the database a second time fails on its lock, without
+  // wiping the cache files that the open instance reads from
+  std::vector<std::string> files;
+  ASSERT_OK(env_->GetChildren(options.secondary_cache_path, &files));
+  DB* db2 = NULL;
+  ASSERT_TRUE(!DB::Open(options, dbname_, &db2).ok());
+  ASSERT_TRUE(db2 == NULL);
+  std::vector<std::string> files_after;
+  ASSERT_OK(env_->GetChildren(options.secondary_cache_path, &files_after));
+  ASSERT_EQ(files.size(), files_after.size());
+
+  Close();
+  delete options.block_cache;
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -1855,6 +3097,132 @@ TEST(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+namespace {
+
+struct ConcurrentWriteState {
+  DB* db;
+  bool sync;
+  port::Mutex mu;
+  port::CondVar cv;
+  int started;
+  int done;
+
+  ConcurrentWriteState() : sync(false), cv(&mu), started(0), done(0) { }
+};
+
+static const int kConcurrentWriters = 8;
+static const int kBatchesPerWriter = 200;
+
+static void ConcurrentWriterBody(void* arg) {
+  ConcurrentWriteState* state = reinterpret_cast<ConcurrentWriteState*>(arg);
+  int id;
+  {
+    MutexLock l(&state->mu);
+    id = state->started++;
+  }
+  WriteOptions write_options;
+  write_options.sync = state->sync;
+  std::string value;
+  for (int i = 0; i < kBatchesPerWriter; i++) {
+    WriteBatch batch;
+    char buf[32];
+    for (int j = 0; j < 5; j++) {
+      snprintf(buf, sizeof(buf), "%02d.%04d.%d", id, i, j);
+      batch.Put(buf, std::string(buf) + "v");
+    }
+    ASSERT_OK(state->db->Write(write_options, &batch));
+    // A write is visible as soon as Write() returns
+    ASSERT_OK(state->db->Get(ReadOptions(), buf, &value));
+    ASSERT_EQ(std::string(buf) + "v", value);
+  }
+  MutexLock l(&state->mu);
+  state->done++;
+  state->cv.Signal();
+}
+
+}  // namespace
+
+// Run kConcurrentWriters threads of ConcurrentWriterBody against a fresh
+// DB opened with "options" and check the result, before and after a
+// reopen.
+static void CheckConcurrentWriters(DBTest* test, Options options, bool sync) {
+  options.write_buffer_size = 100000;  // Switch memtables along the way
+  options.create_if_missing = true;
+  test->DestroyAndReopen(&options);
+
+  ConcurrentWriteState state;
+  state.db = test->db_;
+  state.sync = sync;
+  for (int i = 0; i < kConcurrentWriters; i++) {
+    test->env_->StartThread(ConcurrentWriterBody, &state);
+  }
+  {
+    MutexLock l(&state.mu);
+    while (state.done < kConcurrentWriters) {
+      state.cv.Wait();
+    }
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    Iterator* iter = test->db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(iter->key().ToString() + "v", iter->value().ToString());
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(kConcurrentWriters * kBatchesPerWriter * 5, count);
+    ASSERT_EQ("03.0123.4v", test->Get("03.0123.4"));
+    // Everything must come back from the log as well
+    test->Reopen(&options);
+  }
+}
+
+TEST(DBTest, ConcurrentMemtableWrite) {
+  Options options = CurrentOptions();
+  options.allow_concurrent_memtable_write = true;
+  CheckConcurrentWriters(this, options, false);
+}
+
+TEST(DBTest, PipelinedWrite) {
+  Options options = CurrentOptions();
+  options.enable_pipelined_write = true;
+  CheckConcurrentWriters(this, options, false);
+  CheckConcurrentWriters(this, options, true);
+  options.allow_concurrent_memtable_write = true;
+  CheckConcurrentWriters(this, options, true);
+}
+
+TEST(DBTest, LogFlusher) {
+  Options options = CurrentOptions();
+  options.enable_log_flusher = true;
+  CheckConcurrentWriters(this, options, false);
+  CheckConcurrentWriters(this, options, true);
+  options.allow_concurrent_memtable_write = true;
+  CheckConcurrentWriters(this, options, true);
+}
+
+TEST(DBTest, LogFlusherSyncError) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.enable_log_flusher = true;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  WriteOptions sync_options;
+  sync_options.sync = true;
+  ASSERT_OK(db_->Put(sync_options, "k1", "v1"));
+  ASSERT_EQ("v1", Get("k1"));
+
+  // A failed sync by the flusher thread fails the write and every later one
+  env_->data_sync_error_.Release_Store(env_);
+  ASSERT_TRUE(!db_->Put(sync_options, "k2", "v2").ok());
+  env_->data_sync_error_.Release_Store(NULL);
+  ASSERT_EQ("NOT_FOUND", Get("k2"));
+  ASSERT_TRUE(!db_->Put(WriteOptions(), "k3", "v3").ok());
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -1909,6 +3277,12 @@ class ModelDB: public DB {
       virtual void Delete(const Slice& key) {
         map_->erase(key.ToString());
       }
+      virtual void DeleteRange(const Slice& begin, const Slice& end) {
+        if (begin.compare(end) < 0) {
+          map_->erase(map_->lower_bound(begin.ToString()),
+                      map_->lower_bound(end.ToString()));
+        }
+      }
     };
     Handler handler;
     handler.map_ = &map_;
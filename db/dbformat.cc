@@ -111,13 +111,17 @@ const char* InternalFilterPolicy::Name() const
 void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
                                         std::string* dst) const {
   // We rely on the fact that the code in table.cc does not mind us
-  // adjusting keys[].
+  // adjusting keys[].  Adjacent duplicates (versions of one user key, or
+  // prefixes shared by consecutive keys) are dropped.
   Slice* mkey = const_cast<Slice*>(keys);
+  int m = 0;
   for (int i = 0; i < n; i++) {
-    mkey[i] = ExtractUserKey(keys[i]);
-    // TODO(sanjay): Suppress dups?
+    Slice user_key = ExtractUserKey(keys[i]);
+    if (m == 0 || mkey[m-1] != user_key) {
+      mkey[m++] = user_key;
+    }
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  user_policy_->CreateFilter(keys, m, dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const
@@ -125,6 +129,20 @@ bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const
   return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
 }
 
+const char* InternalKeySliceTransform::Name() const {
+  return user_transform_->Name();
+}
+
+Slice InternalKeySliceTransform::Transform(const Slice& key) const {
+  Slice prefix = user_transform_->Transform(ExtractUserKey(key));
+  assert(prefix.data() == key.data());
+  return Slice(key.data(), prefix.size() + 8);
+}
+
+bool InternalKeySliceTransform::InDomain(const Slice& key) const {
+  return user_transform_->InDomain(ExtractUserKey(key));
+}
+
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) 
 {
   size_t usize = user_key.size();
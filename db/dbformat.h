@@ -10,6 +10,7 @@
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/slice.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
 #include "util/logging.h"
@@ -56,7 +57,10 @@ class InternalKey;
 enum ValueType 
 {
   kTypeDeletion = 0x0,
-  kTypeValue = 0x1
+  kTypeValue = 0x1,
+  // Deletes the user keys in [key, value): written to WriteBatches and
+  // kept apart from other entries in memtables and tables
+  kTypeRangeDeletion = 0x2
 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
@@ -64,7 +68,7 @@ enum ValueType
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeRangeDeletion;
 
 //leveldb每次更新都有一个版本，这个版本就是由SequenceNumber标识
 //key的排序，compact以及snapshot都依赖于它
@@ -154,6 +158,23 @@ class InternalFilterPolicy : public FilterPolicy
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const;
 };
 
+// Prefix extractor wrapper for internal keys.  The prefix of an internal
+// key is the prefix of its user key followed by the next 8 bytes of the
+// key, which InternalFilterPolicy strips off again, so that the prefixes
+// added to a filter and the ones probed with are user key prefixes.
+class InternalKeySliceTransform : public SliceTransform
+{
+ private:
+  const SliceTransform* const user_transform_;
+ public:
+  explicit InternalKeySliceTransform(const SliceTransform* t) : user_transform_(t) { }
+  virtual const char* Name() const;
+  virtual Slice Transform(const Slice& key) const;
+  virtual bool InDomain(const Slice& key) const;
+
+  const SliceTransform* user_transform() const { return user_transform_; }
+};
+
 // Modules in this directory should keep internal keys wrapped inside
 // the following class instead of plain strings so that we do not
 // incorrectly use string comparisons instead of an InternalKeyComparator.
@@ -206,7 +227,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<unsigned char>(kTypeValue));
+  return (c <= static_cast<unsigned char>(kTypeRangeDeletion));
 }
 
 // A helper class useful for DBImpl::Get()
@@ -229,6 +250,9 @@ class LookupKey
   // Return the user key
   Slice user_key() const { return Slice(kstart_, end_ - kstart_ - 8); }
 
+  // Return the sequence number the lookup reads at
+  SequenceNumber sequence() const { return DecodeFixed64(end_ - 8) >> 8; }
+
  private:
   // We construct a char array of the form:
   //    klength  varint32               <-- start_
@@ -89,6 +89,14 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  virtual void DeleteRange(const Slice& begin, const Slice& end) {
+    std::string r = "  del-range '";
+    AppendEscapedStringTo(&r, begin);
+    r += "' '";
+    AppendEscapedStringTo(&r, end);
+    r += "'\n";
+    dst_->Append(r);
+  }
 };
 
 
@@ -144,30 +152,8 @@ Status DumpDescriptor(Env* env, const std::string& fname, WritableFile* dst) {
   return PrintLogContents(env, fname, VersionEditPrinter, dst);
 }
 
-Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
-  uint64_t file_size;
-  RandomAccessFile* file = NULL;
-  Table* table = NULL;
-  Status s = env->GetFileSize(fname, &file_size);
-  if (s.ok()) {
-    s = env->NewRandomAccessFile(fname, &file);
-  }
-  if (s.ok()) {
-    // We use the default comparator, which may or may not match the
-    // comparator used in this database. However this should not cause
-    // problems since we only use Table operations that do not require
-    // any comparisons.  In particular, we do not call Seek or Prev.
-    s = Table::Open(Options(), file, file_size, &table);
-  }
-  if (!s.ok()) {
-    delete table;
-    delete file;
-    return s;
-  }
-
-  ReadOptions ro;
-  ro.fill_cache = false;
-  Iterator* iter = table->NewIterator(ro);
+// Print the internal keys and values yielded by "iter".
+void DumpTableEntries(Iterator* iter, WritableFile* dst) {
   std::string r;
   for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
     r.clear();
@@ -189,6 +175,8 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
         r += "del";
       } else if (key.type == kTypeValue) {
         r += "val";
+      } else if (key.type == kTypeRangeDeletion) {
+        r += "del-range";
       } else {
         AppendNumberTo(&r, key.type);
       }
@@ -198,11 +186,40 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
       dst->Append(r);
     }
   }
-  s = iter->status();
+  Status s = iter->status();
   if (!s.ok()) {
     dst->Append("iterator error: " + s.ToString() + "\n");
   }
+}
 
+Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
+  uint64_t file_size;
+  RandomAccessFile* file = NULL;
+  Table* table = NULL;
+  Status s = env->GetFileSize(fname, &file_size);
+  if (s.ok()) {
+    s = env->NewRandomAccessFile(fname, &file);
+  }
+  if (s.ok()) {
+    // We use the default comparator, which may or may not match the
+    // comparator used in this database. However this should not cause
+    // problems since we only use Table operations that do not require
+    // any comparisons.  In particular, we do not call Seek or Prev.
+    s = Table::Open(Options(), file, file_size, &table);
+  }
+  if (!s.ok()) {
+    delete table;
+    delete file;
+    return s;
+  }
+
+  ReadOptions ro;
+  ro.fill_cache = false;
+  Iterator* iter = table->NewIterator(ro);
+  DumpTableEntries(iter, dst);
+  delete iter;
+  iter = table->NewRangeDeletionIterator();
+  DumpTableEntries(iter, dst);
   delete iter;
   delete table;
   delete file;
@@ -0,0 +1,176 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/log_flusher.h"
+
+#include "util/mutexlock.h"
+
+namespace leveldb {
+namespace log {
+
+Flusher::Flusher(Env* env, WritableFile* dest)
+    : dest_(dest),
+      work_cv_(&mu_),
+      done_cv_(&mu_),
+      appended_(0),
+      written_(0),
+      synced_(0),
+      write_requested_(0),
+      sync_requested_(0),
+      shutting_down_(false),
+      thread_done_(false)
+{
+  env->StartThread(&Flusher::BGThreadWrapper, this);
+}
+
+Flusher::~Flusher()
+{
+  MutexLock l(&mu_);
+  shutting_down_ = true;
+  work_cv_.Signal();
+  while (!thread_done_)
+  {
+    done_cv_.Wait();
+  }
+}
+
+Status Flusher::Append(const Slice& data)
+{
+  MutexLock l(&mu_);
+  if (!status_.ok())
+  {
+    return status_;
+  }
+  buffer_.append(data.data(), data.size());
+  appended_ += data.size();
+  return Status::OK();
+}
+
+Status Flusher::Close()
+{
+  return WaitFor(Size(), false);
+}
+
+Status Flusher::Flush()
+{
+  return Status::OK();
+}
+
+Status Flusher::Sync()
+{
+  return WaitFor(Size(), true);
+}
+
+uint64_t Flusher::Size()
+{
+  MutexLock l(&mu_);
+  return appended_;
+}
+
+void Flusher::Schedule(uint64_t offset, bool sync)
+{
+  MutexLock l(&mu_);
+  ScheduleLocked(offset, sync);
+}
+
+void Flusher::ScheduleLocked(uint64_t offset, bool sync)
+{
+  assert(offset <= appended_);
+  uint64_t* requested = sync ? &sync_requested_ : &write_requested_;
+  if (*requested < offset)
+  {
+    *requested = offset;
+    work_cv_.Signal();
+  }
+}
+
+bool Flusher::Covers(uint64_t offset, bool sync)
+{
+  MutexLock l(&mu_);
+  return (sync ? synced_ : written_) >= offset;
+}
+
+Status Flusher::WaitFor(uint64_t offset, bool sync)
+{
+  MutexLock l(&mu_);
+  ScheduleLocked(offset, sync);
+  while ((sync ? synced_ : written_) < offset)
+  {
+    if (!status_.ok())
+    {
+      return status_;
+    }
+    done_cv_.Wait();
+  }
+  return Status::OK();
+}
+
+void Flusher::BGThreadWrapper(void* arg)
+{
+  reinterpret_cast<Flusher*>(arg)->BGThread();
+}
+
+void Flusher::BGThread()
+{
+  std::string data;
+  MutexLock l(&mu_);
+  while (true)
+  {
+    // Wait until somebody needs data written or synced.  Records that
+    // nobody waits for yet stay buffered so that they can join the write
+    // of a later request.
+    while (status_.ok() && !shutting_down_ &&
+           write_requested_ <= written_ && sync_requested_ <= synced_)
+    {
+      work_cv_.Wait();
+    }
+    if (!status_.ok() ||
+        (shutting_down_ && buffer_.empty() && sync_requested_ <= synced_))
+    {
+      break;
+    }
+
+    // Everything appended so far goes out in one write.  Whatever is
+    // appended meanwhile waits for the next round.
+    data.clear();
+    data.swap(buffer_);
+    const uint64_t offset = appended_;
+    const bool sync = sync_requested_ > synced_;
+
+    mu_.Unlock();
+    Status s;
+    if (!data.empty())
+    {
+      s = dest_->Append(data);
+      if (s.ok())
+      {
+        s = dest_->Flush();
+      }
+    }
+    if (s.ok() && sync)
+    {
+      s = dest_->Sync();
+    }
+    mu_.Lock();
+
+    if (s.ok())
+    {
+      written_ = offset;
+      if (sync)
+      {
+        synced_ = offset;
+      }
+    }
+    else
+    {
+      status_ = s;
+    }
+    done_cv_.SignalAll();
+  }
+  thread_done_ = true;
+  done_cv_.SignalAll();
+}
+
+}  // namespace log
+}  // namespace leveldb
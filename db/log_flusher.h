@@ -0,0 +1,89 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_LOG_FLUSHER_H_
+#define STORAGE_LEVELDB_DB_LOG_FLUSHER_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/env.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+
+namespace leveldb {
+namespace log {
+
+// A WritableFile that buffers appends in memory and hands them to a
+// dedicated thread, which writes them to "*dest" and syncs it once some
+// caller waits for them.  While one Sync() of the file is in progress,
+// the records of later writer groups pile up in the buffer and are then
+// covered by a single write and a single Sync().
+//
+// Offsets count the bytes appended since the Flusher was created.
+class Flusher : public WritableFile
+{
+ public:
+  // "*dest" must remain live while this Flusher is in use, and must not
+  // be used by anyone else meanwhile.
+  Flusher(Env* env, WritableFile* dest);
+
+  // Writes out whatever is still buffered and stops the thread.  Does
+  // not close or delete "*dest".
+  virtual ~Flusher();
+
+  // Only one thread at a time may append.  Appended data is written out
+  // once some thread waits for it; Flush() does not wait.
+  virtual Status Append(const Slice& data);
+  virtual Status Close();
+  virtual Status Flush();
+  virtual Status Sync();
+
+  // Returns the offset just past the last byte appended so far.
+  uint64_t Size();
+
+  // Ask the thread to write the first "offset" bytes to the file and, if
+  // "sync", to sync them.  Does not wait.
+  void Schedule(uint64_t offset, bool sync);
+
+  // Returns true iff the first "offset" bytes have been written to the
+  // file and, if "sync", synced.
+  bool Covers(uint64_t offset, bool sync);
+
+  // Schedule(offset, sync), then block until the first "offset" bytes
+  // have been written to the file and, if "sync", synced.  Returns the error of the write or sync that
+  // should have covered them, if any.  Errors are sticky.
+  Status WaitFor(uint64_t offset, bool sync);
+
+ private:
+  // REQUIRES: mu_ is held
+  void ScheduleLocked(uint64_t offset, bool sync);
+
+  static void BGThreadWrapper(void* arg);
+  void BGThread();
+
+  WritableFile* const dest_;
+
+  // State below is protected by mu_
+  port::Mutex mu_;
+  port::CondVar work_cv_;     // Signalled when the thread has work
+  port::CondVar done_cv_;     // Signalled when the thread finishes some
+  std::string buffer_;        // Appended but not yet handed to the thread
+  uint64_t appended_;         // Offset at the end of buffer_
+  uint64_t written_;          // Bytes written to dest_
+  uint64_t synced_;           // Bytes covered by a dest_->Sync()
+  uint64_t write_requested_;  // Bytes some waiter needs written
+  uint64_t sync_requested_;   // Bytes some waiter needs synced
+  Status status_;             // First error from dest_; sticky
+  bool shutting_down_;
+  bool thread_done_;
+
+  // No copying allowed
+  Flusher(const Flusher&);
+  void operator=(const Flusher&);
+};
+
+}  // namespace log
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_FLUSHER_H_
@@ -93,6 +93,11 @@ Status Writer::AddRecord(const Slice& slice)
     left -= fragment_length;
     begin = false;
   } while (s.ok() && left > 0);
+  // One Flush() per record rather than per fragment
+  if (s.ok())
+  {
+    s = dest_->Flush();
+  }
   return s;
 }
 
@@ -117,10 +122,6 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n)
   if (s.ok())
   {
     s = dest_->Append(Slice(ptr, n));
-    if (s.ok()) 
-	{
-      s = dest_->Flush();
-    }
   }
   block_offset_ += kHeaderSize + n;
   return s;
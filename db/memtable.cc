@@ -8,6 +8,7 @@
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -22,7 +23,11 @@ static Slice GetLengthPrefixedSlice(const char* data)
 MemTable::MemTable(const InternalKeyComparator& cmp)
     : comparator_(cmp),
       refs_(0),
-      table_(comparator_, &arena_) 
+      table_(comparator_, &arena_),
+      range_deletions_(comparator_, &arena_),
+      has_range_deletions_(NULL),
+      fragments_(NULL),
+      fragments_memory_(NULL)
 {
 
 }
@@ -30,11 +35,16 @@ MemTable::MemTable(const InternalKeyComparator& cmp)
 MemTable::~MemTable()
 {
   assert(refs_ == 0);
+  delete reinterpret_cast<RangeTombstones*>(fragments_.NoBarrier_Load());
+  for (size_t i = 0; i < replaced_fragments_.size(); i++)
+  {
+    delete replaced_fragments_[i];
+  }
 }
 
 size_t MemTable::ApproximateMemoryUsage() 
 { 
-	return arena_.MemoryUsage(); 
+	return arena_.MemoryUsage() + reinterpret_cast<uintptr_t>(fragments_memory_.NoBarrier_Load());
 }
 
 int MemTable::KeyComparator::operator()(const char* aptr, const char* bptr) const 
@@ -90,7 +100,12 @@ Iterator* MemTable::NewIterator()
   return new MemTableIterator(&table_);
 }
 
-void MemTable::Add(SequenceNumber s, ValueType type,const Slice& key, const Slice& value)
+Iterator* MemTable::NewRangeDeletionIterator()
+{
+  return new MemTableIterator(&range_deletions_);
+}
+
+char* MemTable::EncodeEntry(SequenceNumber s, ValueType type, const Slice& key, const Slice& value, bool concurrent)
 {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
@@ -101,7 +116,7 @@ void MemTable::Add(SequenceNumber s, ValueType type,const Slice& key, const Slic
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
   const size_t encoded_len = VarintLength(internal_key_size) + internal_key_size + VarintLength(val_size) + val_size;
-  char* buf = arena_.Allocate(encoded_len);
+  char* buf = concurrent ? arena_.AllocateConcurrent(encoded_len) : arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   memcpy(p, key.data(), key_size);
   p += key_size;
@@ -110,12 +125,76 @@ void MemTable::Add(SequenceNumber s, ValueType type,const Slice& key, const Slic
   p = EncodeVarint32(p, val_size);
   memcpy(p, value.data(), val_size);
   assert((p + val_size) - buf == encoded_len);
-  table_.Insert(buf);//插入skiplist
+  return buf;
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type,const Slice& key, const Slice& value)
+{
+  if (type == kTypeRangeDeletion)
+  {
+    // An empty range deletes nothing
+    if (comparator_.comparator.user_comparator()->Compare(key, value) < 0)
+    {
+      range_deletions_.Insert(EncodeEntry(s, type, key, value, false));
+      AddToFragments(key, value, s);
+      has_range_deletions_.Release_Store(this);
+    }
+    return;
+  }
+  table_.Insert(EncodeEntry(s, type, key, value, false));//插入skiplist
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type, const Slice& key, const Slice& value)
+{
+  if (type == kTypeRangeDeletion)
+  {
+    // An empty range deletes nothing
+    if (comparator_.comparator.user_comparator()->Compare(key, value) < 0)
+    {
+      range_deletions_.InsertConcurrently(EncodeEntry(s, type, key, value, true));
+      AddToFragments(key, value, s);
+      has_range_deletions_.Release_Store(this);
+    }
+    return;
+  }
+  table_.InsertConcurrently(EncodeEntry(s, type, key, value, true));
+}
+
+void MemTable::AddToFragments(const Slice& begin, const Slice& end, SequenceNumber s)
+{
+  MutexLock l(&fragments_mutex_);
+  RangeTombstones* current = reinterpret_cast<RangeTombstones*>(fragments_.NoBarrier_Load());
+  RangeTombstones* next;
+  if (current == NULL)
+  {
+    next = new RangeTombstones(comparator_.comparator.user_comparator());
+  }
+  else
+  {
+    next = current->Clone();
+    replaced_fragments_.push_back(current);
+  }
+  next->Add(begin, end, s);
+  const uintptr_t memory = reinterpret_cast<uintptr_t>(fragments_memory_.NoBarrier_Load());
+  fragments_memory_.NoBarrier_Store(
+      reinterpret_cast<void*>(memory + next->ApproximateMemoryUsage()));
+  fragments_.Release_Store(next);
+}
+
+SequenceNumber MemTable::MaxCoveringTombstone(const Slice& user_key, SequenceNumber snapshot)
+{
+  const RangeTombstones* fragments = reinterpret_cast<const RangeTombstones*>(fragments_.Acquire_Load());
+  return (fragments == NULL) ? 0 : fragments->MaxCoveringSequence(user_key, snapshot);
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) 
 {
   Slice memkey = key.memtable_key();
+  SequenceNumber covering = 0;
+  if (HasRangeDeletions())
+  {
+    covering = MaxCoveringTombstone(key.user_key(), key.sequence());
+  }
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());	//查到
   if (iter.Valid())
@@ -142,6 +221,12 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
 	{
       // Correct user key
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+      if ((tag >> 8) < covering)
+      {
+        // Deleted by a later range tombstone
+        *s = Status::NotFound(Slice());
+        return true;
+      }
       switch (static_cast<ValueType>(tag & 0xff)) 
 	  {
         case kTypeValue: 
@@ -153,9 +238,17 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
         case kTypeDeletion:
           *s = Status::NotFound(Slice());
           return true;
+        default:
+          break;
       }
     }
   }
+  if (covering > 0)
+  {
+    // Older entries for the key, here or in tables, are deleted too
+    *s = Status::NotFound(Slice());
+    return true;
+  }
   return false;
 }
 
@@ -6,9 +6,12 @@
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
 #include <string>
+#include <vector>
 #include "leveldb/db.h"
 #include "db/dbformat.h"
+#include "db/range_tombstones.h"
 #include "db/skiplist.h"
+#include "port/port.h"
 #include "util/arena.h"
 
 namespace leveldb {
@@ -66,17 +69,34 @@ class MemTable
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones added with type
+  // kTypeRangeDeletion, which NewIterator() does not yield.  Keys are
+  // internal keys of the begin keys and values are the end keys.  Same
+  // lifetime rules as NewIterator().
+  Iterator* NewRangeDeletionIterator();
+
+  // Whether any range tombstone has been added.
+  bool HasRangeDeletions() const
+  {
+    return has_range_deletions_.Acquire_Load() != NULL;
+  }
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  For
+  // kTypeRangeDeletion, key and value are the begin and end keys.
   /*
 	写入将传入的key和value dump成memtable中存储的数据格式
   */
    void Add(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value);
 
+  // Same as Add(), but may be called from several threads at once.
+  // REQUIRES: no thread calls Add() at the same time.
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value);
+
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // If memtable contains a deletion for key, or a range tombstone that
+  // covers it, store a NotFound() error in *status and return true.
   // Else, return false.
   /*
 	读取（Memtable对key的查找和遍历封装成MemtableIterator）
@@ -86,6 +106,16 @@ class MemTable
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Largest sequence number of the range tombstones visible at
+  // "snapshot" that cover "user_key", or 0 if there are none.
+  SequenceNumber MaxCoveringTombstone(const Slice& user_key, SequenceNumber snapshot);
+
+  // Publish a new version of fragments_ that also holds [begin, end).
+  void AddToFragments(const Slice& begin, const Slice& end, SequenceNumber seq);
+
+  // Encode an entry into memory taken from arena_.
+  char* EncodeEntry(SequenceNumber seq, ValueType type, const Slice& key, const Slice& value, bool concurrent);
+
   struct KeyComparator 
  {
     const InternalKeyComparator comparator;
@@ -101,6 +131,20 @@ class MemTable
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_deletions_;               // Kept apart so that Get() seeks
+                                        // over point entries only
+  port::AtomicPointer has_range_deletions_;
+
+  // The tombstones of range_deletions_ again, cut into fragments so that
+  // Get() finds the ones over its key with one binary search.  A version
+  // is never changed once published, so Get() reads it without a lock;
+  // adding a tombstone publishes a changed copy.  Replaced versions may
+  // still be read and are kept, and charged to ApproximateMemoryUsage(),
+  // until the memtable is deleted.
+  port::AtomicPointer fragments_;       // Current RangeTombstones, or NULL
+  port::Mutex fragments_mutex_;         // Serializes AddToFragments()
+  std::vector<RangeTombstones*> replaced_fragments_;  // Guarded by fragments_mutex_
+  port::AtomicPointer fragments_memory_;  // Bytes used by all versions
 
   // No copying allowed
   MemTable(const MemTable&);
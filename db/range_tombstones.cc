@@ -0,0 +1,244 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstones.h"
+
+#include <algorithm>
+#include <functional>
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+namespace {
+// Orders tombstones by begin key, then by decreasing sequence number like
+// the internal keys they are stored under
+struct TombstoneLess {
+  const Comparator* ucmp;
+  explicit TombstoneLess(const Comparator* c) : ucmp(c) { }
+  bool operator()(const RangeTombstones::Tombstone& a,
+                  const RangeTombstones::Tombstone& b) const {
+    const int r = ucmp->Compare(a.begin, b.begin);
+    return r < 0 || (r == 0 && a.sequence > b.sequence);
+  }
+};
+}  // namespace
+
+RangeTombstones::RangeTombstones(const Comparator* user_comparator)
+    : ucmp_(user_comparator) {
+}
+
+void RangeTombstones::Add(const Slice& begin, const Slice& end,
+                          SequenceNumber sequence) {
+  if (ucmp_->Compare(begin, end) >= 0) {
+    return;
+  }
+  Tombstone t;
+  t.begin = begin.ToString();
+  t.end = end.ToString();
+  t.sequence = sequence;
+  tombstones_.insert(std::upper_bound(tombstones_.begin(), tombstones_.end(),
+                                      t, TombstoneLess(ucmp_)),
+                     t);
+  AddToFragments(begin, end, sequence);
+}
+
+RangeTombstones* RangeTombstones::Clone() const {
+  RangeTombstones* result = new RangeTombstones(ucmp_);
+  result->tombstones_ = tombstones_;
+  result->fragments_ = fragments_;
+  return result;
+}
+
+size_t RangeTombstones::ApproximateMemoryUsage() const {
+  size_t usage = sizeof(*this) +
+                 tombstones_.capacity() * sizeof(Tombstone) +
+                 fragments_.capacity() * sizeof(Fragment);
+  for (size_t i = 0; i < tombstones_.size(); i++) {
+    usage += tombstones_[i].begin.capacity() + tombstones_[i].end.capacity();
+  }
+  for (size_t i = 0; i < fragments_.size(); i++) {
+    const Fragment& f = fragments_[i];
+    usage += f.begin.capacity() + f.end.capacity() +
+             f.sequences.capacity() * sizeof(SequenceNumber);
+  }
+  return usage;
+}
+
+Status RangeTombstones::AddAll(Iterator* iter) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey) ||
+        ikey.type != kTypeRangeDeletion) {
+      return Status::Corruption("bad range tombstone");
+    }
+    Add(ikey.user_key, iter->value(), ikey.sequence);
+  }
+  return iter->status();
+}
+
+// The first of the decreasing "sequences" that is visible at "snapshot",
+// or NULL if there is none
+static const SequenceNumber* NewestVisible(
+    const std::vector<SequenceNumber>& sequences, SequenceNumber snapshot) {
+  std::vector<SequenceNumber>::const_iterator it =
+      std::lower_bound(sequences.begin(), sequences.end(), snapshot,
+                       std::greater<SequenceNumber>());
+  return (it == sequences.end()) ? NULL : &*it;
+}
+
+SequenceNumber RangeTombstones::MaxCoveringSequence(
+    const Slice& user_key, SequenceNumber snapshot) const {
+  const Fragment* f = FindFragment(user_key);
+  const SequenceNumber* sequence =
+      (f == NULL) ? NULL : NewestVisible(f->sequences, snapshot);
+  return (sequence == NULL) ? 0 : *sequence;
+}
+
+bool RangeTombstones::GetCovering(const Slice& user_key,
+                                  SequenceNumber snapshot,
+                                  Tombstone* result) const {
+  const Fragment* f = FindFragment(user_key);
+  const SequenceNumber* sequence =
+      (f == NULL) ? NULL : NewestVisible(f->sequences, snapshot);
+  if (sequence == NULL) {
+    return false;
+  }
+  result->begin = f->begin;
+  result->end = f->end;
+  result->sequence = *sequence;
+  return true;
+}
+
+size_t RangeTombstones::FirstEndingAfter(const Slice& key) const {
+  // The fragments do not overlap, so their end keys increase too
+  size_t left = 0;
+  size_t right = fragments_.size();
+  while (left < right) {
+    const size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(fragments_[mid].end, key) > 0) {
+      right = mid;
+    } else {
+      left = mid + 1;
+    }
+  }
+  return left;
+}
+
+const RangeTombstones::Fragment* RangeTombstones::FindFragment(
+    const Slice& user_key) const {
+  const size_t i = FirstEndingAfter(user_key);
+  if (i == fragments_.size() ||
+      ucmp_->Compare(fragments_[i].begin, user_key) > 0) {
+    return NULL;
+  }
+  return &fragments_[i];
+}
+
+void RangeTombstones::SplitFragment(size_t i, const Slice& key) {
+  Fragment second = fragments_[i];
+  second.begin = key.ToString();
+  fragments_[i].end = key.ToString();
+  fragments_.insert(fragments_.begin() + i + 1, second);
+}
+
+void RangeTombstones::AddToFragments(const Slice& begin, const Slice& end,
+                                     SequenceNumber sequence) {
+  std::string cursor = begin.ToString();   // Start of the part left to add
+  size_t i = FirstEndingAfter(begin);
+  while (ucmp_->Compare(cursor, end) < 0) {
+    if (i == fragments_.size() ||
+        ucmp_->Compare(fragments_[i].begin, end) >= 0) {
+      // Nothing else overlaps the rest of the range
+      Fragment f;
+      f.begin = cursor;
+      f.end = end.ToString();
+      f.sequences.push_back(sequence);
+      fragments_.insert(fragments_.begin() + i, f);
+      break;
+    }
+    if (ucmp_->Compare(cursor, fragments_[i].begin) < 0) {
+      // Fill the gap before fragments_[i]
+      Fragment f;
+      f.begin = cursor;
+      f.end = fragments_[i].begin;
+      f.sequences.push_back(sequence);
+      fragments_.insert(fragments_.begin() + i, f);
+      cursor = f.end;
+      i++;
+      continue;
+    }
+    if (ucmp_->Compare(fragments_[i].begin, cursor) < 0) {
+      SplitFragment(i, cursor);
+      i++;
+    }
+    if (ucmp_->Compare(end, fragments_[i].end) < 0) {
+      SplitFragment(i, end);
+    }
+    std::vector<SequenceNumber>* sequences = &fragments_[i].sequences;
+    std::vector<SequenceNumber>::iterator pos =
+        std::lower_bound(sequences->begin(), sequences->end(), sequence,
+                         std::greater<SequenceNumber>());
+    if (pos == sequences->end() || *pos != sequence) {
+      sequences->insert(pos, sequence);
+    }
+    cursor = fragments_[i].end;
+    i++;
+  }
+}
+
+void RangeTombstones::GetOverlapping(const Slice* lower, const Slice* upper,
+                                     std::vector<Tombstone>* result) const {
+  result->clear();
+  for (size_t i = 0; i < tombstones_.size(); i++) {
+    Tombstone t = tombstones_[i];
+    if (upper != NULL && ucmp_->Compare(t.begin, *upper) >= 0) {
+      break;
+    }
+    if (lower != NULL && ucmp_->Compare(t.begin, *lower) < 0) {
+      t.begin = lower->ToString();
+    }
+    if (upper != NULL && ucmp_->Compare(t.end, *upper) > 0) {
+      t.end = upper->ToString();
+    }
+    if (ucmp_->Compare(t.begin, t.end) < 0) {
+      result->push_back(t);
+    }
+  }
+  // Cutting at "lower" may have moved begin keys out of order
+  std::sort(result->begin(), result->end(), TombstoneLess(ucmp_));
+  // The same tombstone may have been gathered from two tables
+  size_t n = 0;
+  for (size_t i = 0; i < result->size(); i++) {
+    if (n > 0 && (*result)[n-1].sequence == (*result)[i].sequence &&
+        (*result)[n-1].begin == (*result)[i].begin) {
+      if (ucmp_->Compare((*result)[i].end, (*result)[n-1].end) > 0) {
+        (*result)[n-1].end = (*result)[i].end;
+      }
+      continue;
+    }
+    if (n != i) {
+      (*result)[n] = (*result)[i];
+    }
+    n++;
+  }
+  result->resize(n);
+}
+
+void ExtendRangeForTombstone(const Comparator* icmp,
+                             const Slice& begin, const Slice& end,
+                             SequenceNumber sequence, bool* empty,
+                             InternalKey* smallest, InternalKey* largest) {
+  InternalKey first(begin, sequence, kTypeRangeDeletion);
+  InternalKey limit(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  if (*empty || icmp->Compare(first.Encode(), smallest->Encode()) < 0) {
+    *smallest = first;
+  }
+  if (*empty || icmp->Compare(limit.Encode(), largest->Encode()) > 0) {
+    *largest = limit;
+  }
+  *empty = false;
+}
+
+}  // namespace leveldb
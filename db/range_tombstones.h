@@ -0,0 +1,116 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Range tombstones are written by DB::DeleteRange().  Memtables keep
+// them apart from other entries, and tables store them in a meta block
+// (see TableBuilder::AddRangeDeletion()).  Either way a tombstone is an
+// internal key for its begin key, with type kTypeRangeDeletion, that
+// maps to its end key.  A tombstone deletes the entries for user keys in
+// [begin, end) with smaller sequence numbers.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
+
+#include <string>
+#include <vector>
+#include "db/dbformat.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Iterator;
+
+// A set of range tombstones gathered from memtables and tables.  Besides
+// the tombstones themselves it keeps them cut into non-overlapping
+// fragments, each with the sequence numbers of the tombstones over it,
+// so that a lookup is one binary search however many tombstones there
+// are.  Not thread-safe while tombstones are added.
+class RangeTombstones {
+ public:
+  struct Tombstone {
+    std::string begin;
+    std::string end;
+    SequenceNumber sequence;
+  };
+
+  explicit RangeTombstones(const Comparator* user_comparator);
+
+  // Ignores empty ranges.
+  void Add(const Slice& begin, const Slice& end, SequenceNumber sequence);
+
+  // Add every tombstone yielded by "iter".  Does not delete "iter".
+  Status AddAll(Iterator* iter);
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // Return a new set holding the same tombstones.  Lets a caller change
+  // a copy while readers go on using the original.
+  RangeTombstones* Clone() const;
+
+  // Approximate number of bytes of memory used by the set.
+  size_t ApproximateMemoryUsage() const;
+
+  // Largest sequence number of the tombstones visible at "snapshot" that
+  // cover "user_key", or 0 if there are none.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                     SequenceNumber snapshot) const;
+
+  // If a tombstone visible at "snapshot" covers "user_key", store in
+  // *result the newest such tombstone, cut to the fragment that holds
+  // "user_key", and return true.  Else return false.
+  bool GetCovering(const Slice& user_key, SequenceNumber snapshot,
+                   Tombstone* result) const;
+
+  // Whether a tombstone visible at "snapshot" deletes the entry for
+  // "user_key" at "sequence".
+  bool Covers(const Slice& user_key, SequenceNumber sequence,
+              SequenceNumber snapshot) const {
+    return MaxCoveringSequence(user_key, snapshot) > sequence;
+  }
+
+  // Store in *result the tombstones that overlap [*lower, *upper), cut
+  // to that range, in the order TableBuilder::AddRangeDeletion()
+  // requires.  A NULL bound is unbounded.
+  void GetOverlapping(const Slice* lower, const Slice* upper,
+                      std::vector<Tombstone>* result) const;
+
+ private:
+  struct Fragment {
+    std::string begin;
+    std::string end;
+    std::vector<SequenceNumber> sequences;  // Decreasing
+  };
+
+  // Index of the first fragment that ends after "key"
+  size_t FirstEndingAfter(const Slice& key) const;
+  // The fragment that holds "user_key", or NULL if none does
+  const Fragment* FindFragment(const Slice& user_key) const;
+  // Cut fragments_[i] in two at "key", which must lie strictly inside it
+  void SplitFragment(size_t i, const Slice& key);
+  void AddToFragments(const Slice& begin, const Slice& end,
+                      SequenceNumber sequence);
+
+  const Comparator* const ucmp_;
+  std::vector<Tombstone> tombstones_;  // Sorted by begin
+  std::vector<Fragment> fragments_;    // Non-overlapping, sorted by begin
+
+  // No copying allowed
+  RangeTombstones(const RangeTombstones&);
+  void operator=(const RangeTombstones&);
+};
+
+// Widen the key range [*smallest,*largest] of a table to cover the
+// tombstone [begin, end) at "sequence", comparing internal keys with
+// "icmp".  The range is unset if *empty, which is cleared.  The end key
+// is exclusive, so *largest becomes an internal key that sorts before
+// every entry for it.
+extern void ExtendRangeForTombstone(const Comparator* icmp,
+                                    const Slice& begin, const Slice& end,
+                                    SequenceNumber sequence, bool* empty,
+                                    InternalKey* smallest,
+                                    InternalKey* largest);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
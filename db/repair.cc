@@ -31,6 +31,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -49,7 +50,8 @@ class Repairer {
         env_(options.env),
         icmp_(options.comparator),
         ipolicy_(options.filter_policy),
-        options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
+        iprefix_(options.prefix_extractor),
+        options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, &iprefix_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
         next_file_number_(1) {
@@ -101,6 +103,7 @@ class Repairer {
   Env* const env_;
   InternalKeyComparator const icmp_;
   InternalFilterPolicy const ipolicy_;
+  InternalKeySliceTransform const iprefix_;
   Options const options_;
   bool owns_info_log_;
   bool owns_cache_;
@@ -224,8 +227,10 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeDeletionIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter, range_del_iter, &meta);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = NULL;
     if (status.ok()) {
@@ -306,6 +311,28 @@ class Repairer {
       status = iter->status();
     }
     delete iter;
+
+    // Range tombstones widen the key range of the table
+    t.meta.has_range_deletions = false;
+    iter = table_cache_->NewRangeDeletionIterator(t.meta.number, t.meta.file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (!ParseInternalKey(iter->key(), &parsed)) {
+        status = Status::Corruption("bad range tombstone");
+        break;
+      }
+      counter++;
+      ExtendRangeForTombstone(&icmp_, parsed.user_key, iter->value(),
+                              parsed.sequence, &empty, &t.meta.smallest,
+                              &t.meta.largest);
+      t.meta.has_range_deletions = true;
+      if (parsed.sequence > t.max_sequence) {
+        t.max_sequence = parsed.sequence;
+      }
+    }
+    if (status.ok() && !iter->status().ok()) {
+      status = iter->status();
+    }
+    delete iter;
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long) t.meta.number,
         counter,
@@ -339,6 +366,14 @@ class Repairer {
       counter++;
     }
     delete iter;
+    t.meta.has_range_deletions = false;
+    iter = table_cache_->NewRangeDeletionIterator(t.meta.number, t.meta.file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      builder->AddRangeDeletion(iter->key(), iter->value());
+      t.meta.has_range_deletions = true;
+      counter++;
+    }
+    delete iter;
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -396,7 +431,8 @@ class Repairer {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
       edit_.AddFile(0, t.meta.number, t.meta.file_size,
-                    t.meta.smallest, t.meta.largest);
+                    t.meta.smallest, t.meta.largest,
+                    t.meta.has_range_deletions);
     }
 
     //fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
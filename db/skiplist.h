@@ -8,7 +8,9 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex.  The
+// exception is InsertConcurrently(), which several threads may call at
+// once as long as no thread calls Insert() at the same time.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -52,6 +54,13 @@ class SkipList {
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
+  // Like Insert(), but safe to call from several threads at once.  Nodes
+  // are linked in with compare-and-swap and allocated with the arena's
+  // thread-safe allocator.
+  // REQUIRES: nothing that compares equal to key is currently in the list,
+  // or is being inserted concurrently.
+  void InsertConcurrently(const Key& key);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -115,8 +124,12 @@ class SkipList {
   // Read/written only by Insert().
   Random rnd_;
 
-  Node* NewNode(const Key& key, int height);
+  // Random state shared by concurrent inserters; advanced with CAS.
+  port::AtomicPointer concurrent_rnd_;
+
+  Node* NewNode(const Key& key, int height, bool concurrent);
   int RandomHeight();
+  int RandomHeightConcurrently();
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -137,6 +150,11 @@ class SkipList {
   // Return head_ if list is empty.
   Node* FindLast() const;
 
+  // Starting at "before", which must sort before key, walk "level" and
+  // store the pair of adjacent nodes that key falls between.
+  void FindSpliceForLevel(const Key& key, Node* before, int level,
+                          Node** out_prev, Node** out_next) const;
+
   // No copying allowed
   SkipList(const SkipList&);
   void operator=(const SkipList&);
@@ -174,6 +192,12 @@ struct SkipList<Key,Comparator>::Node {
     next_[n].NoBarrier_Store(x);
   }
 
+  // Link x in at level n iff the current successor is still "expected".
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].CompareAndSwap(expected, x);
+  }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
   port::AtomicPointer next_[1];
@@ -181,9 +205,12 @@ struct SkipList<Key,Comparator>::Node {
 
 template<typename Key, class Comparator>
 typename SkipList<Key,Comparator>::Node*
-SkipList<Key,Comparator>::NewNode(const Key& key, int height) {
-  char* mem = arena_->AllocateAligned(
-      sizeof(Node) + sizeof(port::AtomicPointer) * (height - 1));
+SkipList<Key,Comparator>::NewNode(const Key& key, int height,
+                                  bool concurrent) {
+  const size_t bytes =
+      sizeof(Node) + sizeof(port::AtomicPointer) * (height - 1);
+  char* mem = concurrent ? arena_->AllocateAlignedConcurrent(bytes)
+                         : arena_->AllocateAligned(bytes);
   return new (mem) Node(key);
 }
 
@@ -252,6 +279,26 @@ int SkipList<Key,Comparator>::RandomHeight() {
   return height;
 }
 
+template<typename Key, class Comparator>
+int SkipList<Key,Comparator>::RandomHeightConcurrently() {
+  // Draw one 31-bit value per insert and consume it two bits at a time,
+  // which gives the same 1 in 4 branching as RandomHeight().
+  void* old_state;
+  uint32_t r;
+  do {
+    old_state = concurrent_rnd_.NoBarrier_Load();
+    Random rnd(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(old_state)));
+    r = rnd.Next();
+  } while (!concurrent_rnd_.CompareAndSwap(
+      old_state, reinterpret_cast<void*>(static_cast<uintptr_t>(r))));
+  int height = 1;
+  while (height < kMaxHeight && (r & 3) == 0) {
+    height++;
+    r >>= 2;
+  }
+  return height;
+}
+
 template<typename Key, class Comparator>
 bool SkipList<Key,Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
   // NULL n is considered infinite
@@ -325,9 +372,10 @@ template<typename Key, class Comparator>
 SkipList<Key,Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      head_(NewNode(0 /* any key will do */, kMaxHeight, false)),
       max_height_(reinterpret_cast<void*>(1)),
-      rnd_(0xdeadbeef) {
+      rnd_(0xdeadbeef),
+      concurrent_rnd_(reinterpret_cast<void*>(0xdeadbeef)) {
   for (int i = 0; i < kMaxHeight; i++) {
     head_->SetNext(i, NULL);
   }
@@ -360,7 +408,7 @@ void SkipList<Key,Comparator>::Insert(const Key& key) {
     max_height_.NoBarrier_Store(reinterpret_cast<void*>(height));
   }
 
-  x = NewNode(key, height);
+  x = NewNode(key, height, false);
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
@@ -369,6 +417,66 @@ void SkipList<Key,Comparator>::Insert(const Key& key) {
   }
 }
 
+template<typename Key, class Comparator>
+void SkipList<Key,Comparator>::FindSpliceForLevel(const Key& key,
+                                                  Node* before, int level,
+                                                  Node** out_prev,
+                                                  Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (KeyIsAfterNode(key, next)) {
+      before = next;
+    } else {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+  }
+}
+
+template<typename Key, class Comparator>
+void SkipList<Key,Comparator>::InsertConcurrently(const Key& key) {
+  int height = RandomHeightConcurrently();
+
+  // Raise max_height_ first.  As in Insert(), readers that see the new
+  // height before the node is linked in just find NULL at head_.
+  int max_height = GetMaxHeight();
+  while (height > max_height) {
+    if (max_height_.CompareAndSwap(reinterpret_cast<void*>(max_height),
+                                   reinterpret_cast<void*>(height))) {
+      max_height = height;
+      break;
+    }
+    max_height = GetMaxHeight();
+  }
+
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = head_;
+  for (int i = max_height - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == NULL || !Equal(key, next[0]->key));
+
+  // Link bottom-up so that a node reachable at level i is always
+  // reachable at every level below it.  A failed CAS means another
+  // thread linked a node into the same gap; the splice only ever moves
+  // forward, so search again from prev[i].
+  Node* x = NewNode(key, height, true);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+    }
+  }
+}
+
 template<typename Key, class Comparator>
 bool SkipList<Key,Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, NULL);
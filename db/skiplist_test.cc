@@ -7,6 +7,7 @@
 #include "leveldb/env.h"
 #include "util/arena.h"
 #include "util/hash.h"
+#include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testharness.h"
 
@@ -371,6 +372,76 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads call InsertConcurrently() on one list at once.
+struct ConcurrentInsertState {
+  SkipList<Key, Comparator>* list;
+  int num_threads;
+  int keys_per_thread;
+  port::Mutex mu;
+  port::CondVar cv;
+  int started;
+  int done;
+
+  ConcurrentInsertState() : cv(&mu), started(0), done(0) { }
+};
+
+static void ConcurrentInserter(void* arg) {
+  ConcurrentInsertState* state = reinterpret_cast<ConcurrentInsertState*>(arg);
+  int id;
+  {
+    MutexLock l(&state->mu);
+    id = state->started++;
+  }
+  // Thread "id" owns the keys congruent to id, inserted in random order
+  std::vector<Key> keys;
+  for (int i = 0; i < state->keys_per_thread; i++) {
+    keys.push_back(static_cast<Key>(i) * state->num_threads + id);
+  }
+  Random rnd(test::RandomSeed() + id);
+  for (size_t i = keys.size(); i > 1; i--) {
+    std::swap(keys[i - 1], keys[rnd.Uniform(i)]);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    state->list->InsertConcurrently(keys[i]);
+  }
+  MutexLock l(&state->mu);
+  state->done++;
+  state->cv.Signal();
+}
+
+TEST(SkipTest, InsertConcurrently) {
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  ConcurrentInsertState state;
+  state.list = &list;
+  state.num_threads = 4;
+  state.keys_per_thread = 5000;
+  for (int i = 0; i < state.num_threads; i++) {
+    Env::Default()->StartThread(ConcurrentInserter, &state);
+  }
+  {
+    MutexLock l(&state.mu);
+    while (state.done < state.num_threads) {
+      state.cv.Wait();
+    }
+  }
+
+  const Key n = static_cast<Key>(state.num_threads) * state.keys_per_thread;
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k = 0; k < n; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  for (Key k = 0; k < n; k += 97) {
+    ASSERT_TRUE(list.Contains(k));
+  }
+  ASSERT_TRUE(!list.Contains(n));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
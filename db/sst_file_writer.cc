@@ -0,0 +1,133 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include <assert.h>
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+// The entries are stored as internal keys, as in the tables the database
+// builds itself, but with sequence number 0.  The database gives them
+// their sequence number when it ingests the file (see FileMetaData).
+struct SstFileWriter::Rep {
+  const InternalKeyComparator internal_comparator;
+  const InternalFilterPolicy internal_filter_policy;
+  const InternalKeySliceTransform internal_prefix_extractor;
+  Options options;
+  std::string fname;
+  WritableFile* file;
+  TableBuilder* builder;
+  std::string last_key;
+  std::string key;          // Scratch space for the internal key
+  uint64_t file_size;
+
+  explicit Rep(const Options& src)
+      : internal_comparator(src.comparator),
+        internal_filter_policy(src.filter_policy),
+        internal_prefix_extractor(src.prefix_extractor),
+        options(src),
+        file(NULL),
+        builder(NULL),
+        file_size(0) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (src.filter_policy != NULL) ? &internal_filter_policy : NULL;
+    options.prefix_extractor =
+        (src.prefix_extractor != NULL) ? &internal_prefix_extractor : NULL;
+  }
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {
+}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != NULL) {
+    rep_->builder->Abandon();
+    delete rep_->builder;
+    delete rep_->file;
+    rep_->options.env->DeleteFile(rep_->fname);
+  }
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  assert(r->builder == NULL && r->fname.empty());
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (s.ok()) {
+    r->fname = fname;
+    r->builder = new TableBuilder(r->options, r->file);
+  }
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  return Add(key, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return Add(key, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool deletion) {
+  Rep* r = rep_;
+  if (r->builder == NULL) {
+    return Status::InvalidArgument("file is not open", r->fname);
+  }
+  if (r->builder->NumEntries() > 0 &&
+      r->internal_comparator.user_comparator()->Compare(
+          ExtractUserKey(r->last_key), key) >= 0) {
+    return Status::InvalidArgument("keys must be added in strictly increasing order",
+                                   key);
+  }
+  r->key.clear();
+  AppendInternalKey(&r->key, ParsedInternalKey(
+      key, 0, deletion ? kTypeDeletion : kTypeValue));
+  r->builder->Add(r->key, value);
+  r->last_key.swap(r->key);
+  r->file_size = r->builder->FileSize();
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  if (r->builder == NULL) {
+    return Status::InvalidArgument("file is not open", r->fname);
+  }
+  Status s;
+  if (r->builder->NumEntries() == 0) {
+    s = Status::InvalidArgument("cannot create a table with no entries",
+                                r->fname);
+    r->builder->Abandon();
+  } else {
+    s = r->builder->Finish();
+    r->file_size = r->builder->FileSize();
+  }
+  delete r->builder;
+  r->builder = NULL;
+  if (s.ok()) {
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  delete r->file;
+  r->file = NULL;
+  if (!s.ok()) {
+    r->options.env->DeleteFile(r->fname);
+  }
+  return s;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+  return rep_->file_size;
+}
+
+}  // namespace leveldb
@@ -4,23 +4,73 @@
 
 #include "db/table_cache.h"
 
+#include <vector>
 #include "db/filename.h"
+#include "db/range_tombstones.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
+#include "util/statistics.h"
 
 namespace leveldb
 {
 
+// Counts the bytes read from a table file, against the level the file
+// was last looked up at.
+class CountingFile : public RandomAccessFile
+{
+ public:
+  CountingFile(RandomAccessFile* base, Statistics* statistics)
+      : base_(base),
+        statistics_(statistics),
+        level_(reinterpret_cast<void*>(-1))
+  {
+  }
+
+  virtual ~CountingFile()
+  {
+    delete base_;
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result, char* scratch) const
+  {
+    Status s = base_->Read(offset, n, result, scratch);
+    statistics_->Record(Statistics::kBytesRead, result->size());
+    statistics_->RecordAtLevel(Statistics::kBytesReadAtLevel, level(), result->size());
+    return s;
+  }
+
+  int level() const
+  {
+    return static_cast<int>(reinterpret_cast<intptr_t>(level_.NoBarrier_Load()));
+  }
+
+  void SetLevel(int level)
+  {
+    if (level >= 0 && level != this->level())
+    {
+      level_.NoBarrier_Store(reinterpret_cast<void*>(static_cast<intptr_t>(level)));
+    }
+  }
+
+ private:
+  RandomAccessFile* const base_;
+  Statistics* const statistics_;
+  port::AtomicPointer level_;   // Stored as a pointer; -1 if unknown
+};
+
 struct TableAndFile
 {
   RandomAccessFile* file;
+  CountingFile* counting_file;  // Same as file, or NULL
   Table* table;
+  RangeTombstones* range_deletions;  // Fragmented for lookups; NULL if none
 };
 
 static void DeleteEntry(const Slice& key, void* value) 
 {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_deletions;
   delete tf->table;
   delete tf->file;
   delete tf;
@@ -34,12 +84,174 @@ static void UnrefEntry(void* arg1, void* arg2)
   cache->Release(h);
 }
 
+// Yields the entries of an ingested table, which are stored with sequence
+// number 0, with the table's global sequence number instead.  Each user
+// key appears once in such a table, so the order of the keys is kept.
+class GlobalSequenceIterator : public Iterator
+{
+ public:
+  GlobalSequenceIterator(const Comparator* icmp, Iterator* iter, SequenceNumber sequence)
+      : icmp_(icmp),
+        iter_(iter),
+        sequence_(sequence)
+  {
+    UpdateKey();
+  }
+
+  virtual ~GlobalSequenceIterator()
+  {
+    delete iter_;
+  }
+
+  virtual bool Valid() const { return iter_->Valid(); }
+  virtual Slice key() const { return key_; }
+  virtual Slice value() const { return iter_->value(); }
+  virtual Status status() const { return iter_->status(); }
+  virtual void SeekToFirst() { iter_->SeekToFirst(); UpdateKey(); }
+  virtual void SeekToLast() { iter_->SeekToLast(); UpdateKey(); }
+  virtual void Next() { iter_->Next(); UpdateKey(); }
+  virtual void Prev() { iter_->Prev(); UpdateKey(); }
+
+  virtual void Seek(const Slice& target)
+  {
+    iter_->Seek(target);
+    UpdateKey();
+    // The stored key may sort at or after "target" only because of its
+    // sequence number 0
+    if (iter_->Valid() && icmp_->Compare(key_, target) < 0)
+    {
+      Next();
+    }
+  }
+
+ private:
+  void UpdateKey()
+  {
+    key_.clear();
+    if (iter_->Valid())
+    {
+      const Slice stored = iter_->key();
+      if (stored.size() < 8)
+      {
+        key_.assign(stored.data(), stored.size());  // Left for the reader to reject
+        return;
+      }
+      const ValueType type = static_cast<ValueType>(stored[stored.size() - 8]);
+      AppendInternalKey(&key_, ParsedInternalKey(ExtractUserKey(stored), sequence_, type));
+    }
+  }
+
+  const Comparator* const icmp_;
+  Iterator* const iter_;
+  const SequenceNumber sequence_;
+  std::string key_;
+};
+
+// Passes the entries that an ingested table finds for a lookup on to
+// the saver of the lookup with the table's global sequence number, unless
+// the lookup reads at an older snapshot.
+struct GlobalSequenceSaver
+{
+  void* arg;
+  void (*saver)(void*, const Slice&, const Slice&);
+  SequenceNumber sequence;
+  SequenceNumber snapshot;
+  std::string key;
+};
+
+static void SaveWithGlobalSequence(void* arg, const Slice& found_key, const Slice& found_value)
+{
+  GlobalSequenceSaver* s = reinterpret_cast<GlobalSequenceSaver*>(arg);
+  if (s->sequence > s->snapshot)
+  {
+    return;
+  }
+  if (found_key.size() < 8)
+  {
+    (*s->saver)(s->arg, found_key, found_value);
+    return;
+  }
+  const ValueType type = static_cast<ValueType>(found_key[found_key.size() - 8]);
+  s->key.clear();
+  AppendInternalKey(&s->key, ParsedInternalKey(ExtractUserKey(found_key), s->sequence, type));
+  (*s->saver)(s->arg, s->key, found_value);
+}
+
+static void InitGlobalSequenceSaver(GlobalSequenceSaver* s, const Slice& k, void* arg,
+                                    void (*saver)(void*, const Slice&, const Slice&),
+                                    SequenceNumber global_sequence)
+{
+  s->arg = arg;
+  s->saver = saver;
+  s->sequence = global_sequence;
+  s->snapshot = DecodeFixed64(k.data() + k.size() - 8) >> 8;
+}
+
+// Gather the range tombstones of "table" into *result, or set it to NULL
+// if the table has none
+static Status ReadRangeDeletions(const Comparator* ucmp, Table* table, RangeTombstones** result)
+{
+  *result = NULL;
+  Iterator* iter = table->NewRangeDeletionIterator();
+  iter->SeekToFirst();
+  Status s = iter->status();
+  if (iter->Valid())
+  {
+    RangeTombstones* tombstones = new RangeTombstones(ucmp);
+    s = tombstones->AddAll(iter);
+    if (s.ok())
+    {
+      *result = tombstones;
+    }
+    else
+    {
+      delete tombstones;
+    }
+  }
+  delete iter;
+  return s;
+}
+
+// Hand the newest tombstone of "tombstones" (which may be NULL) that
+// covers the lookup key "k" to (*saver)(arg, ...) as a table entry.
+// Callers pass it before the entry found for "k".
+static void SaveCoveringTombstone(const RangeTombstones* tombstones, const Slice& k, void* arg,
+                                  void (*saver)(void*, const Slice&, const Slice&))
+{
+  RangeTombstones::Tombstone t;
+  if (tombstones != NULL &&
+      tombstones->GetCovering(ExtractUserKey(k), DecodeFixed64(k.data() + k.size() - 8) >> 8, &t))
+  {
+    std::string key;
+    AppendInternalKey(&key, ParsedInternalKey(t.begin, t.sequence, kTypeRangeDeletion));
+    (*saver)(arg, key, t.end);
+  }
+}
+
+// Open a table file, reading it with O_DIRECT if options.use_direct_reads
+static Status NewTableReadFile(Env* env, const Options& options,
+                               const std::string& fname, RandomAccessFile** file)
+{
+  if (!options.use_direct_reads)
+  {
+    return env->NewRandomAccessFile(fname, file);
+  }
+  FileOptions file_options;
+  file_options.use_direct_io = true;
+  return env->NewRandomAccessFileWithOptions(fname, file_options, file);
+}
+
 TableCache::TableCache(const std::string& dbname,
                        const Options* options,
-                       int entries)
+                       int entries,
+                       SecondaryCache* secondary_cache,
+                       Statistics* statistics)
     : env_(options->env),
       dbname_(dbname),
       options_(options),
+      user_comparator_(static_cast<const InternalKeyComparator*>(options->comparator)->user_comparator()),
+      secondary_cache_(secondary_cache),
+      statistics_(statistics),
       cache_(NewLRUCache(entries))
 {
 
@@ -50,7 +262,7 @@ TableCache::~TableCache()
   delete cache_;
 }
 
-Status TableCache::FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle** handle)
+Status TableCache::FindTable(uint64_t file_number, uint64_t file_size, int level, Cache::Handle** handle)
 {
   Status s;
   char buf[sizeof(file_number)];
@@ -63,21 +275,38 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size, Cache::Ha
     std::string fname = TableFileName(dbname_, file_number);
     RandomAccessFile* file = NULL;
     Table* table = NULL;
-    s = env_->NewRandomAccessFile(fname, &file);
+    s = NewTableReadFile(env_, *options_, fname, &file);
     if (!s.ok()) 
 	{
 	  //tablefile（.sst）中查找
       std::string old_fname = SSTTableFileName(dbname_, file_number);
-      if (env_->NewRandomAccessFile(old_fname, &file).ok())
+      if (NewTableReadFile(env_, *options_, old_fname, &file).ok())
 	  {
         s = Status::OK();
       }
     }
+    CountingFile* counting_file = NULL;
+    if (s.ok() && statistics_ != NULL)
+    {
+      counting_file = new CountingFile(file, statistics_);
+      counting_file->SetLevel(level);
+      file = counting_file;
+    }
     if (s.ok())
 	{
 	 //通过open获取具体的Table，open成功之后插入到TableCache中
       s = Table::Open(*options_, file, file_size, &table);
     }
+    RangeTombstones* range_deletions = NULL;
+    if (s.ok())
+    {
+      s = ReadRangeDeletions(user_comparator_, table, &range_deletions);
+      if (!s.ok())
+      {
+        delete table;
+        table = NULL;
+      }
+    }
 
     if (!s.ok()) 
 	{
@@ -88,19 +317,37 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size, Cache::Ha
     } 
 	else
 	{
+      table->UseSecondaryCache(secondary_cache_, file_number);
+      table->UseStatistics(statistics_);
+      if (level == 0 && options_->pin_l0_filter_and_index_blocks_in_cache)
+      {
+        table->PinMetaBlocks();
+      }
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
+      tf->counting_file = counting_file;
       tf->table = table;
+      tf->range_deletions = range_deletions;
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
+  else
+  {
+    CountingFile* counting_file = reinterpret_cast<TableAndFile*>(cache_->Value(*handle))->counting_file;
+    if (counting_file != NULL)
+    {
+      counting_file->SetLevel(level);
+    }
+  }
   return s;
 }
 
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number,
                                   uint64_t file_size,
-                                  Table** tableptr) 
+                                  Table** tableptr,
+                                  int level,
+                                  SequenceNumber global_sequence)
 {
   if (tableptr != NULL) 
   {
@@ -108,7 +355,7 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   }
 
   Cache::Handle* handle = NULL;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (!s.ok()) 
   {
     return NewErrorIterator(s);
@@ -116,6 +363,10 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
   Iterator* result = table->NewIterator(options);
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (global_sequence != 0)
+  {
+    result = new GlobalSequenceIterator(options_->comparator, result, global_sequence);
+  }
   if (tableptr != NULL)
   {
     *tableptr = table;
@@ -123,24 +374,99 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+Iterator* TableCache::NewRangeDeletionIterator(uint64_t file_number, uint64_t file_size, int level)
+{
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (!s.ok())
+  {
+    return NewErrorIterator(s);
+  }
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeDeletionIterator();
+  result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  return result;
+}
+
 Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_number,
                        uint64_t file_size,
                        const Slice& k,
                        void* arg,
-                       void (*saver)(void*, const Slice&, const Slice&)) 
+                       void (*saver)(void*, const Slice&, const Slice&),
+                       int level,
+                       SequenceNumber global_sequence)
 {
   Cache::Handle* handle = NULL;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (s.ok()) 
   {
-    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, saver);
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (global_sequence != 0)
+    {
+      GlobalSequenceSaver wrapper;
+      InitGlobalSequenceSaver(&wrapper, k, arg, saver, global_sequence);
+      SaveCoveringTombstone(tf->range_deletions, k, &wrapper, &SaveWithGlobalSequence);
+      s = tf->table->InternalGet(options, k, &wrapper, &SaveWithGlobalSequence);
+    }
+    else
+    {
+      SaveCoveringTombstone(tf->range_deletions, k, arg, saver);
+      s = tf->table->InternalGet(options, k, arg, saver);
+    }
     cache_->Release(handle);
   }
   return s;
 }
 
+void TableCache::MultiGet(const ReadOptions& options,
+                          uint64_t file_number,
+                          uint64_t file_size,
+                          int n,
+                          const Slice* keys,
+                          void* const* args,
+                          Status* statuses,
+                          void (*saver)(void*, const Slice&, const Slice&),
+                          int level,
+                          SequenceNumber global_sequence)
+{
+  Cache::Handle* handle = NULL;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok())
+  {
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (global_sequence != 0)
+    {
+      std::vector<GlobalSequenceSaver> wrappers(n);
+      std::vector<void*> wrapper_args(n);
+      for (int i = 0; i < n; i++)
+      {
+        InitGlobalSequenceSaver(&wrappers[i], keys[i], args[i], saver, global_sequence);
+        wrapper_args[i] = &wrappers[i];
+        SaveCoveringTombstone(tf->range_deletions, keys[i], wrapper_args[i], &SaveWithGlobalSequence);
+      }
+      tf->table->InternalMultiGet(options, n, keys, &wrapper_args[0], statuses, &SaveWithGlobalSequence);
+    }
+    else
+    {
+      for (int i = 0; i < n; i++)
+      {
+        SaveCoveringTombstone(tf->range_deletions, keys[i], args[i], saver);
+      }
+      tf->table->InternalMultiGet(options, n, keys, args, statuses, saver);
+    }
+    cache_->Release(handle);
+  }
+  else
+  {
+    // Every key needed the table
+    for (int i = 0; i < n; i++)
+    {
+      statuses[i] = s;
+    }
+  }
+}
+
 void TableCache::Evict(uint64_t file_number) 
 {
   char buf[sizeof(file_number)];
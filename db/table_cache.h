@@ -18,11 +18,17 @@ namespace leveldb
 {
 
 class Env;
+class SecondaryCache;
+class Statistics;
 
 class TableCache 
 {
  public:
-  TableCache(const std::string& dbname, const Options* options, int entries);
+  // Tables read their blocks through "secondary_cache" and count their
+  // reads in "statistics", if those are non-NULL.  The caller must keep
+  // them live while the cache is in use.
+  TableCache(const std::string& dbname, const Options* options, int entries,
+             SecondaryCache* secondary_cache = NULL, Statistics* statistics = NULL);
   ~TableCache();
 
   // Return an iterator for the specified file number (the corresponding
@@ -32,12 +38,38 @@ class TableCache
   // the returned iterator.  The returned "*tableptr" object is owned by
   // the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
-  Iterator* NewIterator(const ReadOptions& options, uint64_t file_number, uint64_t file_size, Table** tableptr = NULL);
+  //
+  // "level" is the level of the file, or -1 if unknown.  It decides
+  // whether a newly opened table pins its index and filter blocks, and
+  // which level the bytes read from the file are counted against.
+  //
+  // A non-zero "global_sequence" is the sequence number of every entry of
+  // an ingested table (see FileMetaData); keys are returned with it.
+  Iterator* NewIterator(const ReadOptions& options, uint64_t file_number, uint64_t file_size, Table** tableptr = NULL,
+                        int level = -1, SequenceNumber global_sequence = 0);
+
+  // Return an iterator over the range tombstones of the specified file
+  // (see Table::NewRangeDeletionIterator()).
+  Iterator* NewRangeDeletionIterator(uint64_t file_number, uint64_t file_size, int level = -1);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  Entries of an
+  // ingested table newer than the sequence number of "k" are skipped.
+  // Before that, if range tombstones of the file cover the key of "k" at
+  // its sequence number, the newest of them is handed over the same way,
+  // cut to the fragment of its range that holds the key.
   Status Get(const ReadOptions& options, uint64_t file_number, uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&), int level = -1,
+             SequenceNumber global_sequence = 0);
+
+  // Like Get() for each of the n sorted internal keys in keys[], with
+  // args[i] passed to handle_result for keys[i] and the status of its
+  // lookup stored in statuses[i].  The table is looked up in the cache
+  // once for the whole batch.
+  void MultiGet(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                int n, const Slice* keys, void* const* args, Status* statuses,
+                void (*handle_result)(void*, const Slice&, const Slice&), int level = -1,
+                SequenceNumber global_sequence = 0);
 
   // Evict any entry for the specified file number
   /*
@@ -49,12 +81,15 @@ class TableCache
   Env* const env_;
   const std::string dbname_;
   const Options* options_;
+  const Comparator* const user_comparator_;  // options_->comparator is an InternalKeyComparator
+  SecondaryCache* const secondary_cache_;
+  Statistics* const statistics_;
   /*
 	LRUCache缓存类指针
   */
   Cache* cache_;
 
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindTable(uint64_t file_number, uint64_t file_size, int level, Cache::Handle**);
 };
 
 }  // namespace leveldb
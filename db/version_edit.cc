@@ -20,7 +20,9 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  kNewFileWithRangeDeletions = 10, // Same fields as kNewFile
+  kNewFileWithGlobalSequence = 11  // kNewFile fields, then the sequence
 };
 
 void VersionEdit::Clear() {
@@ -76,12 +78,24 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Older readers fail on the new tags rather than lose the tombstones
+    // or the sequence number of an ingested file
+    Tag tag = kNewFile;
+    if (f.global_sequence != 0) {
+      assert(!f.has_range_deletions);  // Ingested files have no tombstones
+      tag = kNewFileWithGlobalSequence;
+    } else if (f.has_range_deletions) {
+      tag = kNewFileWithRangeDeletions;
+    }
+    PutVarint32(dst, tag);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (tag == kNewFileWithGlobalSequence) {
+      PutVarint64(dst, f.global_sequence);
+    }
   }
 }
 
@@ -207,11 +221,17 @@ Status VersionEdit::DecodeFrom(const Slice& src)
         break;
 
       case kNewFile:
+      case kNewFileWithRangeDeletions:
+      case kNewFileWithGlobalSequence:
+        f.has_range_deletions = (tag == kNewFileWithRangeDeletions);
+        f.global_sequence = 0;
         if (GetLevel(&input, &level) &&
             GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
-            GetInternalKey(&input, &f.largest)) 
+            GetInternalKey(&input, &f.largest) &&
+            (tag != kNewFileWithGlobalSequence ||
+             GetVarint64(&input, &f.global_sequence)))
 		{
           new_files_.push_back(std::make_pair(level, f));
         } 
@@ -289,6 +309,13 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_deletions) {
+      r.append(" (range deletions)");
+    }
+    if (f.global_sequence != 0) {
+      r.append(" @ ");
+      AppendNumberTo(&r, f.global_sequence);
+    }
   }
   r.append("\n}\n");
   return r;
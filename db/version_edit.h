@@ -23,8 +23,13 @@ struct FileMetaData
   uint64_t file_size;         // File size in bytes
   InternalKey smallest;       // Smallest internal key served by table(sstable文件的最小key)
   InternalKey largest;        // Largest internal key served by table （sstable文件的最大key）
+  bool being_compacted;       // Input of a running compaction; protected by DBImpl::mutex_
+  bool has_range_deletions;   // Table has a range deletion block
+  SequenceNumber global_sequence;  // If non-zero, the sequence number of every entry
+                                   // of an ingested table, whose keys are stored with 0
 
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0), being_compacted(false), has_range_deletions(false),
+                   global_sequence(0) { }
 };
 
 /*
@@ -67,16 +72,22 @@ class VersionEdit
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // (see ExtendRangeForTombstone() for files with range tombstones, and
+  // DB::IngestExternalFile() for "global_sequence")
   void AddFile(int level, uint64_t file,
                uint64_t file_size,
                const InternalKey& smallest,
-               const InternalKey& largest)
+               const InternalKey& largest,
+               bool has_range_deletions = false,
+               SequenceNumber global_sequence = 0)
   {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.has_range_deletions = has_range_deletions;
+    f.global_sequence = global_sequence;
     new_files_.push_back(std::make_pair(level, f));
   }
 
@@ -27,7 +27,8 @@ TEST(VersionEditTest, EncodeDecode) {
     TestEncodeDecode(edit);
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
-                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion),
+                 (i % 2) == 1);
     edit.DeleteFile(4, kBig + 700 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
   }
@@ -39,6 +40,33 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, RangeDeletionsFlag) {
+  VersionEdit edit;
+  edit.AddFile(1, 10, 100, InternalKey("a", 5, kTypeRangeDeletion),
+               InternalKey("c", kMaxSequenceNumber, kTypeRangeDeletion), true);
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("(range deletions)") != std::string::npos);
+}
+
+TEST(VersionEditTest, GlobalSequence) {
+  VersionEdit edit;
+  edit.AddFile(2, 11, 100, InternalKey("a", 42, kTypeValue),
+               InternalKey("c", 42, kTypeValue), false, 42);
+  edit.AddFile(2, 12, 100, InternalKey("d", 7, kTypeValue),
+               InternalKey("e", 8, kTypeValue));
+  TestEncodeDecode(edit);
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  const std::string debug = parsed.DebugString();
+  ASSERT_TRUE(debug.find("'c' @ 42 : 1 @ 42") != std::string::npos) << debug;
+  ASSERT_TRUE(debug.find("@ 8 : 1\n") != std::string::npos) << debug;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
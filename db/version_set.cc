@@ -10,6 +10,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -60,6 +61,18 @@ static int64_t TotalFileSize(const std::vector<FileMetaData*>& files)
   return sum;
 }
 
+static bool AnyBeingCompacted(const std::vector<FileMetaData*>& files)
+{
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    if (files[i]->being_compacted)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 Version::~Version()
 {
   assert(refs_ == 0);
@@ -179,16 +192,23 @@ bool SomeFileOverlapsRange(
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 24-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64.
+//
+// With a prefix extractor (for prefix_same_as_start reads), Next() after
+// a Seek() stops once a file's largest key is past the prefix of the
+// target, since no later file can hold keys with that prefix.
 class Version::LevelFileNumIterator : public Iterator 
 {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
+                       const std::vector<FileMetaData*>* flist,
+                       const SliceTransform* prefix_extractor = NULL)
       : icmp_(icmp),
         flist_(flist),
-        index_(flist->size()) 
+        prefix_extractor_(prefix_extractor),
+        index_(flist->size()),
+        prefix_seek_(false)
   {       
 	  // Marks as invalid
   }
@@ -199,21 +219,40 @@ class Version::LevelFileNumIterator : public Iterator
   virtual void Seek(const Slice& target) 
   {
     index_ = FindFile(icmp_, *flist_, target);
+    prefix_seek_ = (prefix_extractor_ != NULL && prefix_extractor_->InDomain(target));
+    if (prefix_seek_)
+    {
+      prefix_ = ExtractUserKey(prefix_extractor_->Transform(target)).ToString();
+    }
+  }
+  virtual void SeekToFirst()
+  {
+    index_ = 0;
+    prefix_seek_ = false;
   }
-  virtual void SeekToFirst() { index_ = 0; }
   virtual void SeekToLast() 
   {
     index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    prefix_seek_ = false;
   }
   virtual void Next() 
   {
     assert(Valid());
+    const Slice largest = (*flist_)[index_]->largest.Encode();
+    if (prefix_seek_ &&
+        (!prefix_extractor_->InDomain(largest) ||
+         ExtractUserKey(prefix_extractor_->Transform(largest)) != Slice(prefix_)))
+    {
+      index_ = flist_->size();  // Marks as invalid
+      return;
+    }
     index_++;
   }
 
   virtual void Prev() 
   {
     assert(Valid());
+    prefix_seek_ = false;
     if (index_ == 0)
 	{
       index_ = flist_->size();  // Marks as invalid
@@ -233,15 +272,20 @@ class Version::LevelFileNumIterator : public Iterator
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_+8, (*flist_)[index_]->file_size);
+    EncodeFixed64(value_buf_+16, (*flist_)[index_]->global_sequence);
     return Slice(value_buf_, sizeof(value_buf_));
   }
   virtual Status status() const { return Status::OK(); }
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const SliceTransform* const prefix_extractor_;  // Applies to internal keys; may be NULL
   uint32_t index_;
-  // Backing store for value(). Holds the file number and size.
-  mutable char value_buf_[16];
+  bool prefix_seek_;            // Next() is bounded by prefix_
+  std::string prefix_;          // User key prefix of the last Seek() target
+  // Backing store for value(). Holds the file number, size and global
+  // sequence number.
+  mutable char value_buf_[24];
 };
 
 static Iterator* GetFileIterator(void* arg,
@@ -249,7 +293,7 @@ static Iterator* GetFileIterator(void* arg,
                                  const Slice& file_value) 
 {
   TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) 
+  if (file_value.size() != 24) 
   {
     return NewErrorIterator(Status::Corruption("FileReader invoked with unexpected value"));
   }
@@ -257,34 +301,87 @@ static Iterator* GetFileIterator(void* arg,
   {
     return cache->NewIterator(options,
                               DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+                              DecodeFixed64(file_value.data() + 8),
+                              NULL, -1,
+                              DecodeFixed64(file_value.data() + 16));
   }
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
+  const SliceTransform* prefix_extractor =
+      options.prefix_same_as_start ? vset_->options_->prefix_extractor : NULL;
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]),
-      &GetFileIterator, vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], prefix_extractor),
+      &GetFileIterator, vset_->table_cache_, options, &vset_->icmp_);
+}
+
+// Whether "f" only holds keys at or after the internal key "*upper_bound"
+static bool StartsAfterBound(const InternalKeyComparator& icmp, const FileMetaData* f,
+                             const Slice* upper_bound)
+{
+  return upper_bound != NULL && icmp.Compare(f->smallest.Encode(), *upper_bound) >= 0;
 }
 
 void Version::AddIterators(const ReadOptions& options,
-                           std::vector<Iterator*>* iters) {
+                           std::vector<Iterator*>* iters,
+                           std::vector<Slice>* smallest) {
+  const Slice* upper_bound = options.iterate_upper_bound;
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
+    const FileMetaData* f = files_[0][i];
+    if (StartsAfterBound(vset_->icmp_, f, upper_bound)) {
+      continue;
+    }
     iters->push_back(
         vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+            options, f->number, f->file_size, NULL, 0, f->global_sequence));
+    if (smallest != NULL) {
+      smallest->push_back(f->smallest.Encode());
+    }
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
   for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
+    if (!files_[level].empty() &&
+        !StartsAfterBound(vset_->icmp_, files_[level][0], upper_bound)) {
       iters->push_back(NewConcatenatingIterator(options, level));
+      if (smallest != NULL) {
+        smallest->push_back(files_[level][0]->smallest.Encode());
+      }
+    }
+  }
+}
+
+// Add the tombstones of those "files" that have any to *result
+static Status AddFileRangeDeletions(TableCache* table_cache, const InternalKeyComparator& icmp,
+                                    const std::vector<FileMetaData*>& files,
+                                    int level, const Slice* upper_bound, RangeTombstones* result)
+{
+  Status s;
+  for (size_t i = 0; i < files.size() && s.ok(); i++)
+  {
+    if (files[i]->has_range_deletions && !StartsAfterBound(icmp, files[i], upper_bound))
+    {
+      Iterator* iter = table_cache->NewRangeDeletionIterator(files[i]->number, files[i]->file_size, level);
+      s = result->AddAll(iter);
+      delete iter;
     }
   }
+  return s;
+}
+
+Status Version::AddRangeDeletions(RangeTombstones* result, const Slice* upper_bound)
+{
+  Status s;
+  for (int level = 0; level < config::kNumLevels && s.ok(); level++)
+  {
+    s = AddFileRangeDeletions(vset_->table_cache_, vset_->icmp_, files_[level], level,
+                              upper_bound, result);
+  }
+  return s;
 }
 
 // Callback from TableCache::Get()
@@ -302,10 +399,16 @@ struct Saver
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
+  SequenceNumber snapshot;
   std::string* value;
+  bool probed;    // Whether the table handed over an entry
+  SequenceNumber covering;  // Newest range tombstone over user_key; 0 if none
 };
 }
 
+// Tables hand over their range tombstones before the entry found for the
+// key.  A covering tombstone marks the key deleted unless that entry is
+// newer.
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) 
 {
   Saver* s = reinterpret_cast<Saver*>(arg);
@@ -314,9 +417,20 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v)
   {
     s->state = kCorrupt;
   } 
+  else if (parsed_key.type == kTypeRangeDeletion)
+  {
+    if (parsed_key.sequence <= s->snapshot && parsed_key.sequence > s->covering &&
+        s->ucmp->Compare(parsed_key.user_key, s->user_key) <= 0 &&
+        s->ucmp->Compare(s->user_key, v) < 0)
+    {
+      s->covering = parsed_key.sequence;
+      s->state = kDeleted;
+    }
+  }
   else
   {
-    if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) 
+    s->probed = true;
+    if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0 && parsed_key.sequence > s->covering)
 	{
       s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
       if (s->state == kFound)
@@ -396,6 +510,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k, std::string*
 
   stats->seek_file = NULL;
   stats->seek_file_level = -1;
+  stats->found_level = -1;
+  stats->useless_probes = 0;
   FileMetaData* last_file_read = NULL;
   int last_file_read_level = -1;
 
@@ -480,8 +596,12 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k, std::string*
       saver.state = kNotFound;
       saver.ucmp = ucmp;
       saver.user_key = user_key;
+      saver.snapshot = k.sequence();
       saver.value = value;
-      s = vset_->table_cache_->Get(options, f->number, f->file_size, ikey, &saver, SaveValue);
+      saver.probed = false;
+      saver.covering = 0;
+      s = vset_->table_cache_->Get(options, f->number, f->file_size, ikey, &saver, SaveValue, level,
+                                   f->global_sequence);
       if (!s.ok())
 	  {
         return s;
@@ -489,8 +609,13 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k, std::string*
       switch (saver.state) 
 	  {
         case kNotFound:
+          if (saver.probed)
+          {
+            stats->useless_probes++;
+          }
           break;      // Keep searching in other files
         case kFound:
+          stats->found_level = level;
           return s;
         case kDeleted:
           s = Status::NotFound(Slice());  // Use empty error message for speed
@@ -505,6 +630,206 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k, std::string*
   return Status::NotFound(Slice());  // Use an empty error message for speed
 }
 
+namespace
+{
+// Per-key state of Version::MultiGet()
+struct MultiGetState
+{
+  std::vector<Saver> savers;
+  std::vector<FileMetaData*> last_file_read;
+  std::vector<int> last_file_read_level;
+  std::vector<bool> done;
+};
+}
+
+// Look up the keys batch[] of *requests in file f of the given level.
+static void MultiGetFromFile(TableCache* table_cache,
+                             const ReadOptions& options,
+                             int level,
+                             FileMetaData* f,
+                             const std::vector<size_t>& batch,
+                             std::vector<Version::GetRequest>* requests,
+                             MultiGetState* state)
+{
+  if (batch.empty())
+  {
+    return;
+  }
+  std::vector<Slice> keys(batch.size());
+  std::vector<void*> args(batch.size());
+  std::vector<Status> statuses(batch.size());
+  for (size_t j = 0; j < batch.size(); j++)
+  {
+    const size_t i = batch[j];
+    Version::GetStats* stats = &(*requests)[i].stats;
+    if (state->last_file_read[i] != NULL && stats->seek_file == NULL)
+    {
+      // We have had more than one seek for this read.  Charge the 1st file.
+      stats->seek_file = state->last_file_read[i];
+      stats->seek_file_level = state->last_file_read_level[i];
+    }
+    state->last_file_read[i] = f;
+    state->last_file_read_level[i] = level;
+    keys[j] = (*requests)[i].key->internal_key();
+    args[j] = &state->savers[i];
+    state->savers[i].probed = false;
+  }
+
+  table_cache->MultiGet(options, f->number, f->file_size,
+                        static_cast<int>(batch.size()), &keys[0], &args[0], &statuses[0],
+                        SaveValue, level, f->global_sequence);
+  for (size_t j = 0; j < batch.size(); j++)
+  {
+    const size_t i = batch[j];
+    Status* status = (*requests)[i].status;
+    if (!statuses[j].ok())
+    {
+      *status = statuses[j];
+      state->done[i] = true;
+      continue;
+    }
+    switch (state->savers[i].state)
+    {
+      case kNotFound:
+        if (state->savers[i].probed)
+        {
+          (*requests)[i].stats.useless_probes++;
+        }
+        break;      // Keep searching in other files
+      case kFound:
+        (*requests)[i].stats.found_level = level;
+        *status = Status::OK();
+        state->done[i] = true;
+        break;
+      case kDeleted:
+        *status = Status::NotFound(Slice());  // Use empty error message for speed
+        state->done[i] = true;
+        break;
+      case kCorrupt:
+        *status = Status::Corruption("corrupted key for ", state->savers[i].user_key);
+        state->done[i] = true;
+        break;
+    }
+  }
+}
+
+void Version::MultiGet(const ReadOptions& options, std::vector<GetRequest>* requests)
+{
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const size_t n = requests->size();
+
+  MultiGetState state;
+  state.savers.resize(n);
+  state.last_file_read.resize(n, NULL);
+  state.last_file_read_level.resize(n, -1);
+  state.done.resize(n, false);
+  std::vector<size_t> pending;   // Keys not resolved yet, in sorted order
+  for (size_t i = 0; i < n; i++)
+  {
+    GetRequest* r = &(*requests)[i];
+    r->stats.seek_file = NULL;
+    r->stats.seek_file_level = -1;
+    r->stats.found_level = -1;
+    r->stats.useless_probes = 0;
+    state.savers[i].state = kNotFound;
+    state.savers[i].ucmp = ucmp;
+    state.savers[i].user_key = r->key->user_key();
+    state.savers[i].snapshot = r->key->sequence();
+    state.savers[i].value = r->value;
+    state.savers[i].covering = 0;
+    pending.push_back(i);
+  }
+
+  // We can search level-by-level since entries never hop across
+  // levels.  Therefore we are guaranteed that if we find data
+  // in an smaller level, later levels are irrelevant.
+  std::vector<size_t> batch;
+  for (int level = 0; level < config::kNumLevels && !pending.empty(); level++)
+  {
+    const std::vector<FileMetaData*>& files = files_[level];
+    if (files.empty())
+    {
+      continue;
+    }
+
+    if (level == 0)
+    {
+      // Level-0 files may overlap each other.  Probe them from newest to
+      // oldest, each with the keys still unresolved that fall in its range.
+      std::vector<FileMetaData*> tmp(files);
+      std::sort(tmp.begin(), tmp.end(), NewestFirst);
+      for (size_t k = 0; k < tmp.size(); k++)
+      {
+        FileMetaData* f = tmp[k];
+        batch.clear();
+        for (size_t p = 0; p < pending.size(); p++)
+        {
+          const size_t i = pending[p];
+          const Slice user_key = state.savers[i].user_key;
+          if (!state.done[i] &&
+              ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+              ucmp->Compare(user_key, f->largest.user_key()) <= 0)
+          {
+            batch.push_back(i);
+          }
+        }
+        MultiGetFromFile(vset_->table_cache_, options, level, f, batch, requests, &state);
+      }
+    }
+    else
+    {
+      // Files do not overlap: walk the sorted keys and files together,
+      // batching consecutive keys that land in the same file.
+      size_t index = FindFile(vset_->icmp_, files, (*requests)[pending[0]].key->internal_key());
+      FileMetaData* batch_file = NULL;
+      batch.clear();
+      for (size_t p = 0; p < pending.size() && index < files.size(); p++)
+      {
+        const size_t i = pending[p];
+        const Slice ikey = (*requests)[i].key->internal_key();
+        while (index < files.size() &&
+               vset_->icmp_.Compare(files[index]->largest.Encode(), ikey) < 0)
+        {
+          index++;
+        }
+        if (index == files.size())
+        {
+          break;
+        }
+        FileMetaData* f = files[index];
+        if (ucmp->Compare(state.savers[i].user_key, f->smallest.user_key()) < 0)
+        {
+          // All of "f" is past any data for user_key
+          continue;
+        }
+        if (f != batch_file)
+        {
+          MultiGetFromFile(vset_->table_cache_, options, level, batch_file, batch, requests, &state);
+          batch.clear();
+          batch_file = f;
+        }
+        batch.push_back(i);
+      }
+      MultiGetFromFile(vset_->table_cache_, options, level, batch_file, batch, requests, &state);
+    }
+
+    size_t remaining = 0;
+    for (size_t p = 0; p < pending.size(); p++)
+    {
+      if (!state.done[pending[p]])
+      {
+        pending[remaining++] = pending[p];
+      }
+    }
+    pending.resize(remaining);
+  }
+
+  for (size_t p = 0; p < pending.size(); p++)
+  {
+    *(*requests)[pending[p]].status = Status::NotFound(Slice());  // Use an empty error message for speed
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) 
 {
   FileMetaData* f = stats.seek_file;
@@ -630,6 +955,64 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key, const Sl
   return level;
 }
 
+// Whether [smallest_user_key,largest_user_key] overlaps the key span of the
+// inputs that a running compaction takes from "files".  The outputs may
+// cover that whole span, gaps between the inputs included.  The inputs
+// from a level other than level-0 are adjacent files of the level.
+static bool OverlapsCompactionSpan(const Comparator* ucmp, bool disjoint_sorted_files,
+                                   const std::vector<FileMetaData*>& files,
+                                   const Slice& smallest_user_key, const Slice& largest_user_key)
+{
+  bool in_span = false;
+  Slice span_begin, span_end;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    const FileMetaData* f = files[i];
+    if (!f->being_compacted)
+    {
+      if (disjoint_sorted_files)
+      {
+        in_span = false;
+      }
+      continue;
+    }
+    if (!in_span || ucmp->Compare(f->smallest.user_key(), span_begin) < 0)
+    {
+      span_begin = f->smallest.user_key();
+    }
+    if (!in_span || ucmp->Compare(f->largest.user_key(), span_end) > 0)
+    {
+      span_end = f->largest.user_key();
+    }
+    in_span = true;
+    if (ucmp->Compare(span_begin, largest_user_key) <= 0 &&
+        ucmp->Compare(span_end, smallest_user_key) >= 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int Version::PickLevelForIngestedFile(const Slice& smallest_user_key, const Slice& largest_user_key)
+{
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  int level = 0;
+  if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key))
+  {
+    // The table holds the newest entries for its keys, so it may sink
+    // past every level without them.  A running compaction into the
+    // next level could still write some there.
+    while (level + 1 < config::kNumLevels &&
+           !OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key) &&
+           !OverlapsCompactionSpan(ucmp, (level > 0), files_[level], smallest_user_key, largest_user_key))
+    {
+      level++;
+    }
+  }
+  return level;
+}
+
 // Store in "*inputs" all files in "level" that overlap [begin,end]
 void Version::GetOverlappingInputs( int level,
 	const InternalKey* begin,
@@ -1280,6 +1663,7 @@ void VersionSet::Finalize(Version* v)
       score = static_cast<double>(level_bytes) / MaxBytesForLevel(level);
     }
 
+    v->level_scores_[level] = score;
     if (score > best_score)
 	{
       best_level = level;
@@ -1315,7 +1699,8 @@ Status VersionSet::WriteSnapshot(log::Writer* log)
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest, f->has_range_deletions,
+                   f->global_sequence);
     }
   }
 
@@ -1367,7 +1752,7 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         Table* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr, level);
         if (tableptr != NULL) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1476,7 +1861,8 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(
-              options, files[i]->number, files[i]->file_size);
+              options, files[i]->number, files[i]->file_size, NULL, 0,
+              files[i]->global_sequence);
         }
       } else {
         // Create concatenating iterator for the files from this level
@@ -1494,76 +1880,146 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 
 Compaction* VersionSet::PickCompaction()
 {
-  Compaction* c;
-  int level;
+  Compaction* c = NULL;
 
   // We prefer compactions triggered by too much data in a level over
   // the compactions triggered by seeks.
-  // compaction_score_ >= 1说明compaction_level_上最不均衡
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != NULL);
-  if (size_compaction)
-  {
-    level = current_->compaction_level_;
-    assert(level >= 0);
-    assert(level+1 < config::kNumLevels);
-    c = new Compaction(level);
-
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++)
-	{
-      FileMetaData* f = current_->files_[level][i];
+  // 按score从大到小尝试各个level: 最不均衡的level上的文件可能正在被其他
+  // 后台线程compact, 此时退而选择另一个不相交的compaction
+  int levels[config::kNumLevels];
+  int num_levels = 0;
+  for (int level = 0; level < config::kNumLevels - 1; level++)
+  {
+    if (current_->level_scores_[level] < 1)
+    {
+      continue;
+    }
+    int pos = num_levels++;
+    while (pos > 0 && current_->level_scores_[levels[pos-1]] < current_->level_scores_[level])
+    {
+      levels[pos] = levels[pos-1];
+      pos--;
+    }
+    levels[pos] = level;
+  }
+  for (int i = 0; i < num_levels && c == NULL; i++)
+  {
+    c = PickCompactionAt(levels[i]);
+  }
 
-      if (compact_pointer_[level].empty() || icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0)
-	  {
-        c->inputs_[0].push_back(f);
-        break;
-      }
+  FileMetaData* f = current_->file_to_compact_;
+  if (c == NULL && f != NULL && !f->being_compacted &&
+      !(current_->file_to_compact_level_ == 0 && AnyBeingCompacted(current_->files_[0])))
+  {
+    c = new Compaction(current_->file_to_compact_level_);
+    c->input_version_ = current_;
+    c->input_version_->Ref();
+    c->inputs_[0].push_back(f);
+    if (c->level() == 0)
+    {
+      InternalKey smallest, largest;
+      GetRange(c->inputs_[0], &smallest, &largest);
+      current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
     }
-    if (c->inputs_[0].empty()) 
-	{
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
+    if (AnyBeingCompacted(c->inputs_[0]) || !SetupOtherInputs(c))
+    {
+      delete c;
+      c = NULL;
     }
   }
-  else if (seek_compaction)
+
+  if (c != NULL)
   {
-    level = current_->file_to_compact_level_;
-    c = new Compaction(level);
-    c->inputs_[0].push_back(current_->file_to_compact_);
-  } 
-  else 
+    c->MarkFilesBeingCompacted(true);
+  }
+  return c;
+}
+
+Compaction* VersionSet::PickCompactionAt(int level)
+{
+  assert(level >= 0);
+  assert(level+1 < config::kNumLevels);
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  if (files.empty())
   {
     return NULL;
   }
+  if (level == 0 && AnyBeingCompacted(files))
+  {
+    // level-0的文件之间有overlap, 同一时刻只允许一个level-0的compaction
+    return NULL;
+  }
 
-  c->input_version_ = current_;
-  c->input_version_->Ref();
-
-  // 当level == 0的时候，由于其中的sstable会有overlap 取出在level-0中与已经确定的compact的sstable有overlap的文件
-  if (level == 0) 
+  // Pick the first file that comes after compact_pointer_[level]
+  size_t start = 0;
+  for (; start < files.size(); start++)
   {
-    InternalKey smallest, largest;
-    GetRange(c->inputs_[0], &smallest, &largest);
-    // Note that the next call will discard the file we placed in
-    // c->inputs_[0] earlier and replace it with an overlapping set
-    // which will include the picked file.
-    current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
-    assert(!c->inputs_[0].empty());
+    if (compact_pointer_[level].empty() ||
+        icmp_.Compare(files[start]->largest.Encode(), compact_pointer_[level]) > 0)
+    {
+      break;
+    }
+  }
+  if (start == files.size())
+  {
+    // Wrap-around to the beginning of the key space
+    start = 0;
   }
-  //取得需要其他的sstable
-  SetupOtherInputs(c);
 
-  return c;
+  // Files that are part of another compaction (directly, or through an
+  // overlapping level+1 file) are skipped.
+  for (size_t n = 0; n < files.size(); n++)
+  {
+    FileMetaData* f = files[(start + n) % files.size()];
+    if (f->being_compacted)
+    {
+      continue;
+    }
+
+    Compaction* c = new Compaction(level);
+    c->input_version_ = current_;
+    c->input_version_->Ref();
+    c->inputs_[0].push_back(f);
+
+    // 当level == 0的时候，由于其中的sstable会有overlap 取出在level-0中与已经确定的compact的sstable有overlap的文件
+    if (level == 0)
+    {
+      InternalKey smallest, largest;
+      GetRange(c->inputs_[0], &smallest, &largest);
+      // Note that the next call will discard the file we placed in
+      // c->inputs_[0] earlier and replace it with an overlapping set
+      // which will include the picked file.
+      current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+      assert(!c->inputs_[0].empty());
+    }
+    //取得需要其他的sstable
+    if (SetupOtherInputs(c))
+    {
+      return c;
+    }
+    delete c;
+
+    if (level == 0)
+    {
+      // Every choice of level-0 file expands to the same overlapping set
+      // in the common case; do not retry with each of them.
+      break;
+    }
+  }
+  return NULL;
 }
 
-void VersionSet::SetupOtherInputs(Compaction* c) 
+bool VersionSet::SetupOtherInputs(Compaction* c) 
 {
   const int level = c->level();
   InternalKey smallest, largest;
   GetRange(c->inputs_[0], &smallest, &largest);
 
   current_->GetOverlappingInputs(level+1, &smallest, &largest, &c->inputs_[1]);
+  if (AnyBeingCompacted(c->inputs_[1]))
+  {
+    return false;
+  }
 
   // Get entire range covered by compaction
   InternalKey all_start, all_limit;
@@ -1580,7 +2036,8 @@ void VersionSet::SetupOtherInputs(Compaction* c)
     const int64_t expanded0_size = TotalFileSize(expanded0);
 
     if (expanded0.size() > c->inputs_[0].size() &&
-        inputs1_size + expanded0_size < kExpandedCompactionByteSizeLimit)
+        inputs1_size + expanded0_size < kExpandedCompactionByteSizeLimit &&
+        !AnyBeingCompacted(expanded0))
 	{
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
@@ -1629,6 +2086,7 @@ void VersionSet::SetupOtherInputs(Compaction* c)
   // key range next time.
   compact_pointer_[level] = largest.Encode().ToString();
   c->edit_.SetCompactPointer(level, largest);
+  return true;
 }
 
 Compaction* VersionSet::CompactRange(
@@ -1666,21 +2124,30 @@ Compaction* VersionSet::CompactRange(
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
-  SetupOtherInputs(c);
+  if (AnyBeingCompacted(c->inputs_[0]) || !SetupOtherInputs(c))
+  {
+    delete c;
+    return NULL;
+  }
+  c->MarkFilesBeingCompacted(true);
   return c;
 }
 
 Compaction::Compaction(int level)
     : level_(level),
       max_output_file_size_(MaxFileSizeForLevel(level)),	  //2mb
-      input_version_(NULL),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0)
+      input_version_(NULL)
+{
+}
+
+Compaction::Progress::Progress()
+    : grandparent_index(0),
+      seen_key(false),
+      overlapped_bytes(0)
 {
   for (int i = 0; i < config::kNumLevels; i++)
   {
-    level_ptrs_[i] = 0;
+    level_ptrs[i] = 0;
   }
 }
 
@@ -1714,17 +2181,17 @@ void Compaction::AddInputDeletions(VersionEdit* edit)
 
 //compact时，当key的valuetype是kTypeDeletion时，要检查level-n+1以上是否存在，来确定是否丢弃该key
 //因为key的遍历是顺序的，所以每次检查从上一次检查结束的地方开始
-//level_ptrs_[i]中记录了input_version_->levels_[i]中，上次比较结束的sstable的容器下标
-bool Compaction::IsBaseLevelForKey(const Slice& user_key)
+//progress->level_ptrs[i]中记录了input_version_->levels_[i]中，上次比较结束的sstable的容器下标
+bool Compaction::IsBaseLevelForKey(const Slice& user_key, Progress* progress)
 {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) 
   {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    for (; level_ptrs_[lvl] < files.size(); )
+    for (; progress->level_ptrs[lvl] < files.size(); )
 	{
-      FileMetaData* f = files[level_ptrs_[lvl]];
+      FileMetaData* f = files[progress->level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0)
 	  {
         // We've advanced far enough
@@ -1735,31 +2202,54 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key)
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      progress->level_ptrs[lvl]++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end)
+{
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++)
+  {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status Compaction::AddRangeDeletions(RangeTombstones* result)
+{
+  Status s;
+  for (int which = 0; which < 2 && s.ok(); which++)
+  {
+    s = AddFileRangeDeletions(input_version_->vset_->table_cache_, input_version_->vset_->icmp_,
+                              inputs_[which], level_ + which, NULL, result);
+  }
+  return s;
+}
+
+bool Compaction::ShouldStopBefore(const Slice& internal_key, Progress* progress) 
 {
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &input_version_->vset_->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
-      icmp->Compare(internal_key, grandparents_[grandparent_index_]->largest.Encode()) > 0) 
+  while (progress->grandparent_index < grandparents_.size() &&
+      icmp->Compare(internal_key, grandparents_[progress->grandparent_index]->largest.Encode()) > 0) 
   {
-    if (seen_key_)
+    if (progress->seen_key)
 	{
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+      progress->overlapped_bytes += grandparents_[progress->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    progress->grandparent_index++;
   }
-  seen_key_ = true;
+  progress->seen_key = true;
 
-  if (overlapped_bytes_ > kMaxGrandParentOverlapBytes) 
+  if (progress->overlapped_bytes > kMaxGrandParentOverlapBytes) 
   {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    progress->overlapped_bytes = 0;
     return true;
   } else 
   {
@@ -1767,6 +2257,64 @@ bool Compaction::ShouldStopBefore(const Slice& internal_key)
   }
 }
 
+namespace {
+struct UserKeyLess
+{
+  const Comparator* user_cmp;
+  explicit UserKeyLess(const Comparator* c) : user_cmp(c) { }
+  bool operator()(const Slice& a, const Slice& b) const
+  {
+    return user_cmp->Compare(a, b) < 0;
+  }
+};
+}  // namespace
+
+void Compaction::GetSubcompactionBoundaries(int max_subcompactions,
+                                            std::vector<Slice>* boundaries)
+{
+  boundaries->clear();
+  if (max_subcompactions <= 1)
+  {
+    return;
+  }
+
+  // Candidate split points are the first keys of the level+1 and
+  // grandparent files: splitting there lets every subcompaction read
+  // (and write next to) its own set of files.
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  InternalKey smallest, largest;
+  input_version_->vset_->GetRange2(inputs_[0], inputs_[1], &smallest, &largest);
+  std::vector<Slice> candidates;
+  for (int which = 0; which < 2; which++)
+  {
+    const std::vector<FileMetaData*>& files = (which == 0 ? inputs_[1] : grandparents_);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      Slice k = files[i]->smallest.user_key();
+      if (user_cmp->Compare(k, smallest.user_key()) > 0 &&
+          user_cmp->Compare(k, largest.user_key()) <= 0)
+      {
+        candidates.push_back(k);
+      }
+    }
+  }
+  if (candidates.empty())
+  {
+    return;
+  }
+  std::sort(candidates.begin(), candidates.end(), UserKeyLess(user_cmp));
+
+  const size_t n = std::min(static_cast<size_t>(max_subcompactions), candidates.size() + 1);
+  for (size_t i = 1; i < n; i++)
+  {
+    const Slice& k = candidates[i * candidates.size() / n];
+    if (boundaries->empty() || user_cmp->Compare(boundaries->back(), k) < 0)
+    {
+      boundaries->push_back(k);
+    }
+  }
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != NULL) {
     input_version_->Unref();
@@ -1774,4 +2322,17 @@ void Compaction::ReleaseInputs() {
   }
 }
 
+void Compaction::MarkFilesBeingCompacted(bool value)
+{
+  assert(input_version_ != NULL);
+  for (int which = 0; which < 2; which++)
+  {
+    for (size_t i = 0; i < inputs_[which].size(); i++)
+    {
+      assert(inputs_[which][i]->being_compacted != value);
+      inputs_[which][i]->being_compacted = value;
+    }
+  }
+}
+
 }  // namespace leveldb
@@ -28,6 +28,7 @@ namespace leveldb {
 namespace log { class Writer; }
 
 class Compaction;
+class RangeTombstones;
 class Iterator;
 class MemTable;
 class TableBuilder;
@@ -63,9 +64,19 @@ class Version
 {
  public:
   // Append to *iters a sequence of iterators that will
-  // yield the contents of this Version when merged together.
+  // yield the contents of this Version when merged together, and to
+  // *smallest (if non-NULL) the smallest key of each of them.  If
+  // options.iterate_upper_bound is set, it is an internal key, and the
+  // files that start at or after it are left out.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
-  void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
+  void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters,
+                    std::vector<Slice>* smallest = NULL);
+
+  // Add the range tombstones of every file of this Version to *result,
+  // except for the files that start at or after the internal key
+  // "*upper_bound" if it is non-NULL.
+  // REQUIRES: This version has been saved (see VersionSet::SaveTo)
+  Status AddRangeDeletions(RangeTombstones* result, const Slice* upper_bound = NULL);
 
   // Lookup the value for key.  If found, store it in *val and
   // return OK.  Else return a non-OK status.  Fills *stats.
@@ -74,9 +85,27 @@ class Version
   {
     FileMetaData* seek_file;
     int seek_file_level;
+    int found_level;      // Level the value was found at, or -1
+    int useless_probes;   // Files that read a data block in vain
   };
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val, GetStats* stats);
 
+  // One key of a MultiGet() batch
+  struct GetRequest
+  {
+    const LookupKey* key;
+    std::string* value;
+    Status* status;
+    GetStats stats;
+  };
+
+  // Batched Get(): *requests must be sorted by key.  Levels are searched
+  // once for the whole batch, and every file is probed once for all the
+  // keys that may be in it.  Sets *status, *value and stats of each request
+  // as Get() would.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, std::vector<GetRequest>* requests);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -112,6 +141,14 @@ class Version
   int PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                  const Slice& largest_user_key);
 
+  // Return the deepest level at which a table ingested with keys in
+  // [smallest_user_key,largest_user_key] can be placed: no level down to
+  // it holds keys in the range, and no running compaction can write
+  // such keys to it.
+  // REQUIRES: no compaction is picked until the table is installed
+  int PickLevelForIngestedFile(const Slice& smallest_user_key,
+                               const Slice& largest_user_key);
+
   int NumFiles(int level) const { return files_[level].size(); }
 
   // Return a human readable string that describes this version's contents.
@@ -158,6 +195,10 @@ class Version
   */
   int compaction_level_;	 
 
+  // Compaction score of every level, also computed by Finalize().  Used to
+  // fall back to a less urgent level while the best one is busy.
+  double level_scores_[config::kNumLevels];
+
   explicit Version(VersionSet* vset)
       : vset_(vset), next_(this), prev_(this), refs_(0),
         file_to_compact_(NULL),
@@ -165,7 +206,10 @@ class Version
         compaction_score_(-1),
         compaction_level_(-1) 
   {
-
+    for (int level = 0; level < config::kNumLevels; level++)
+    {
+      level_scores_[level] = -1;
+    }
   }
 
   ~Version();
@@ -248,12 +292,14 @@ class VersionSet
   // Returns NULL if there is no compaction to be done.
   // Otherwise returns a pointer to a heap-allocated object that
   // describes the compaction.  Caller should delete the result.
+  // Files already marked being_compacted are never picked, and the
+  // inputs of the returned compaction are marked being_compacted.
   Compaction* PickCompaction();
 
   // Return a compaction object for compacting the range [begin,end] in
   // the specified level.  Returns NULL if there is nothing in that
-  // level that overlaps the specified range.  Caller should delete
-  // the result.
+  // level that overlaps the specified range, or if the inputs overlap
+  // a running compaction.  Caller should delete the result.
   Compaction* CompactRange(
       int level,
       const InternalKey* begin,
@@ -309,7 +355,13 @@ class VersionSet
                  InternalKey* smallest,
                  InternalKey* largest);
 
-  void SetupOtherInputs(Compaction* c);
+  // Returns false (leaving compact_pointer_ untouched) if the inputs
+  // would include a file that is already part of a running compaction.
+  bool SetupOtherInputs(Compaction* c);
+
+  // Try to build a size-triggered compaction for "level" out of files that
+  // are not being compacted.  Returns NULL if there is none.
+  Compaction* PickCompactionAt(int level);
 
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
@@ -374,19 +426,61 @@ class Compaction
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
+  // Position of one pass over the compaction's merged input, as used by
+  // IsBaseLevelForKey() and ShouldStopBefore().  Both expect keys in
+  // increasing order, so a compaction split into subcompactions keeps
+  // one Progress per subcompaction.
+  struct Progress
+  {
+    size_t grandparent_index;  // Index in grandparents_ (compact时grandparents_中已经overlap的index)
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+    // level_ptrs holds indices into input_version_->levels_: our state
+    // is that we are positioned at one of the file ranges for each
+    // higher level than the ones involved in this compaction (i.e. for
+    // all L >= level_ + 2).
+    size_t level_ptrs[config::kNumLevels];  //sstable的容器下标
+
+    Progress();
+  };
+
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  bool IsBaseLevelForKey(const Slice& user_key) { return IsBaseLevelForKey(user_key, &progress_); }
+  bool IsBaseLevelForKey(const Slice& user_key, Progress* progress);
+
+  // Returns true if no file in levels greater than "level+1" overlaps
+  // the user keys [begin, end), so a range tombstone over them that no
+  // snapshot needs can be dropped.
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+  // Add the range tombstones of the input files to *result.
+  Status AddRangeDeletions(RangeTombstones* result);
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  bool ShouldStopBefore(const Slice& internal_key) { return ShouldStopBefore(internal_key, &progress_); }
+  bool ShouldStopBefore(const Slice& internal_key, Progress* progress);
+
+  // Store in *boundaries up to max_subcompactions-1 user keys, in
+  // increasing order, that split this compaction into ranges of roughly
+  // equal numbers of level+1 and grandparent files.  Range i covers user
+  // keys in [boundaries[i-1], boundaries[i]).  The slices stay valid
+  // until ReleaseInputs() is called.
+  void GetSubcompactionBoundaries(int max_subcompactions,
+                                  std::vector<Slice>* boundaries);
 
   // Release the input version for the compaction, once the compaction
   // is successful.
   void ReleaseInputs();
 
+  // Flag (or unflag) every input file as part of a running compaction so
+  // that concurrent PickCompaction() calls choose disjoint inputs.
+  // REQUIRES: the input version is still referenced.
+  void MarkFilesBeingCompacted(bool value);
+
  private:
   friend class Version;
   friend class VersionSet;
@@ -412,19 +506,10 @@ class Compaction
   // State used to check for number of of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
-  //compact时grandparents_中已经overlap的index
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
-
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];	//sstable的容器下标
+
+  // State for implementing IsBaseLevelForKey and ShouldStopBefore when
+  // the compaction is processed by a single thread
+  Progress progress_;
 };
 
 }  // namespace leveldb
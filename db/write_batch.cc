@@ -8,7 +8,8 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -49,6 +50,10 @@ WriteBatch::Handler::~Handler()
 		
 }
 
+void WriteBatch::Handler::DeleteRange(const Slice& begin, const Slice& end)
+{
+}
+
 void WriteBatch::Clear() 
 {
   rep_.clear();
@@ -94,6 +99,17 @@ Status WriteBatch::Iterate(Handler* handler) const
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeRangeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value))
+        {
+          handler->DeleteRange(key, value);
+        }
+        else
+        {
+          return Status::Corruption("bad WriteBatch DeleteRange");
+        }
+        break;
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
@@ -143,6 +159,14 @@ void WriteBatch::Delete(const Slice& key)
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::DeleteRange(const Slice& begin, const Slice& end)
+{
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+  PutLengthPrefixedSlice(&rep_, begin);
+  PutLengthPrefixedSlice(&rep_, end);
+}
+
 namespace
 {
 class MemTableInserter : public WriteBatch::Handler 
@@ -150,15 +174,34 @@ class MemTableInserter : public WriteBatch::Handler
  public:
   SequenceNumber sequence_;
   MemTable* mem_;
+  bool concurrent_;
+
+  MemTableInserter() : concurrent_(false) { }
 
   virtual void Put(const Slice& key, const Slice& value)
   {
-    mem_->Add(sequence_, kTypeValue, key, value);
-    sequence_++;
+    Add(kTypeValue, key, value);
   }
   virtual void Delete(const Slice& key) 
   {
-    mem_->Add(sequence_, kTypeDeletion, key, Slice());
+    Add(kTypeDeletion, key, Slice());
+  }
+  virtual void DeleteRange(const Slice& begin, const Slice& end)
+  {
+    Add(kTypeRangeDeletion, begin, end);
+  }
+
+ private:
+  void Add(ValueType type, const Slice& key, const Slice& value)
+  {
+    if (concurrent_)
+    {
+      mem_->AddConcurrently(sequence_, type, key, value);
+    }
+    else
+    {
+      mem_->Add(sequence_, type, key, value);
+    }
     sequence_++;
   }
 };
@@ -172,6 +215,15 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable)
   return b->Iterate(&inserter);
 }
 
+Status WriteBatchInternal::InsertIntoConcurrently(const WriteBatch* b, MemTable* memtable)
+{
+  MemTableInserter inserter;
+  inserter.sequence_ = WriteBatchInternal::Sequence(b);
+  inserter.mem_ = memtable;
+  inserter.concurrent_ = true;
+  return b->Iterate(&inserter);
+}
+
 void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) 
 {
   assert(contents.size() >= kHeader);
@@ -44,6 +44,10 @@ class WriteBatchInternal
 
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
+  // Like InsertInto(), but uses MemTable::AddConcurrently() so that
+  // several batches can be inserted into "memtable" at once.
+  static Status InsertIntoConcurrently(const WriteBatch* batch, MemTable* memtable);
+
   static void Append(WriteBatch* dst, const WriteBatch* src);
 };
 
@@ -21,7 +21,9 @@ static std::string PrintContents(WriteBatch* b) {
   int count = 0;
   Iterator* iter = mem->NewIterator();
   for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
-    ParsedInternalKey ikey;
+    // Initialized since the compiler cannot tell that a failed
+    // ASSERT_TRUE() does not return
+    ParsedInternalKey ikey(Slice(), 0, kTypeValue);
     ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
     switch (ikey.type) {
       case kTypeValue:
@@ -38,11 +40,27 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      default:
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  iter = mem->NewRangeDeletionIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey(Slice(), 0, kTypeRangeDeletion);
+    ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+    ASSERT_EQ(kTypeRangeDeletion, ikey.type);
+    state.append("DeleteRange(");
+    state.append(ikey.user_key.ToString());
+    state.append(", ");
+    state.append(iter->value().ToString());
+    state.append(")@");
+    state.append(NumberToString(ikey.sequence));
+    count++;
+  }
+  delete iter;
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -74,6 +92,21 @@ TEST(WriteBatchTest, Multiple) {
             PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Delete(Slice("box"));
+  batch.DeleteRange(Slice("x"), Slice("z"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(4, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ("Delete(box)@102"
+            "Put(foo, bar)@100"
+            "DeleteRange(a, g)@101"
+            "DeleteRange(x, z)@103",
+            PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -290,6 +290,26 @@ class InMemoryEnv : public EnvWrapper {
     return Status::OK();
   }
 
+  // There is no page cache to bypass, so the options are ignored rather
+  // than forwarded to the base Env.
+  virtual Status NewRandomAccessFileWithOptions(const std::string& fname,
+                                                const FileOptions& options,
+                                                RandomAccessFile** result) {
+    return NewRandomAccessFile(fname, result);
+  }
+
+  virtual Status NewWritableFileWithOptions(const std::string& fname,
+                                            const FileOptions& options,
+                                            WritableFile** result) {
+    return NewWritableFile(fname, result);
+  }
+
+  virtual Status NewAppendableFileWithOptions(const std::string& fname,
+                                              const FileOptions& options,
+                                              WritableFile** result) {
+    return NewAppendableFile(fname, result);
+  }
+
   virtual bool FileExists(const std::string& fname) {
     MutexLock lock(&mutex_);
     return file_map_.find(fname) != file_map_.end();
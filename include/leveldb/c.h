@@ -63,6 +63,7 @@ typedef struct leveldb_options_t       leveldb_options_t;
 typedef struct leveldb_randomfile_t    leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t   leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t       leveldb_seqfile_t;
+typedef struct leveldb_slicetransform_t leveldb_slicetransform_t;
 typedef struct leveldb_snapshot_t      leveldb_snapshot_t;
 typedef struct leveldb_writablefile_t  leveldb_writablefile_t;
 typedef struct leveldb_writebatch_t    leveldb_writebatch_t;
@@ -90,6 +91,14 @@ extern void leveldb_delete(
     const char* key, size_t keylen,
     char** errptr);
 
+/* Deletes the keys in [begin, end). */
+extern void leveldb_delete_range(
+    leveldb_t* db,
+    const leveldb_writeoptions_t* options,
+    const char* begin, size_t beginlen,
+    const char* end, size_t endlen,
+    char** errptr);
+
 extern void leveldb_write(
     leveldb_t* db,
     const leveldb_writeoptions_t* options,
@@ -105,6 +114,20 @@ extern char* leveldb_get(
     size_t* vallen,
     char** errptr);
 
+/* Looks up num_keys keys at once.  For each key i, values_list[i] is set
+   to NULL if not found, or to a malloc()ed array whose length is stored
+   in values_list_sizes[i].  errs[i] is set to NULL or, on an error other
+   than not-found, to a malloc()ed error message. */
+extern void leveldb_multi_get(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    size_t num_keys,
+    const char* const* keys_list,
+    const size_t* keys_list_sizes,
+    char** values_list,
+    size_t* values_list_sizes,
+    char** errs);
+
 extern leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options);
@@ -122,6 +145,8 @@ extern char* leveldb_property_value(
     leveldb_t* db,
     const char* propname);
 
+extern void leveldb_reset_stats(leveldb_t* db);
+
 extern void leveldb_approximate_sizes(
     leveldb_t* db,
     int num_ranges,
@@ -171,6 +196,10 @@ extern void leveldb_writebatch_put(
 extern void leveldb_writebatch_delete(
     leveldb_writebatch_t*,
     const char* key, size_t klen);
+extern void leveldb_writebatch_delete_range(
+    leveldb_writebatch_t*,
+    const char* begin, size_t beginlen,
+    const char* end, size_t endlen);
 extern void leveldb_writebatch_iterate(
     leveldb_writebatch_t*,
     void* state,
@@ -187,6 +216,20 @@ extern void leveldb_options_set_comparator(
 extern void leveldb_options_set_filter_policy(
     leveldb_options_t*,
     leveldb_filterpolicy_t*);
+extern void leveldb_options_set_full_table_filter(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_prefix_extractor(
+    leveldb_options_t*, leveldb_slicetransform_t*);
+extern void leveldb_options_set_partition_index_and_filters(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_metadata_block_size(
+    leveldb_options_t*, size_t);
+extern void leveldb_options_set_cache_index_and_filter_blocks(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_pin_l0_filter_and_index_blocks_in_cache(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_secondary_cache(
+    leveldb_options_t*, const char* path, size_t capacity);
 extern void leveldb_options_set_create_if_missing(
     leveldb_options_t*, unsigned char);
 extern void leveldb_options_set_error_if_exists(
@@ -196,16 +239,38 @@ extern void leveldb_options_set_paranoid_checks(
 extern void leveldb_options_set_env(leveldb_options_t*, leveldb_env_t*);
 extern void leveldb_options_set_info_log(leveldb_options_t*, leveldb_logger_t*);
 extern void leveldb_options_set_write_buffer_size(leveldb_options_t*, size_t);
+extern void leveldb_options_set_allow_concurrent_memtable_write(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_enable_pipelined_write(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_enable_log_flusher(
+    leveldb_options_t*, unsigned char);
 extern void leveldb_options_set_max_open_files(leveldb_options_t*, int);
+extern void leveldb_options_set_max_background_compactions(leveldb_options_t*, int);
+extern void leveldb_options_set_max_subcompactions(leveldb_options_t*, int);
 extern void leveldb_options_set_cache(leveldb_options_t*, leveldb_cache_t*);
 extern void leveldb_options_set_block_size(leveldb_options_t*, size_t);
 extern void leveldb_options_set_block_restart_interval(leveldb_options_t*, int);
 
 enum {
   leveldb_no_compression = 0,
-  leveldb_snappy_compression = 1
+  leveldb_snappy_compression = 1,
+  leveldb_zstd_compression = 2,
+  leveldb_lz4_compression = 3
 };
 extern void leveldb_options_set_compression(leveldb_options_t*, int);
+extern void leveldb_options_set_zstd_compression_level(leveldb_options_t*, int);
+extern void leveldb_options_set_zstd_dictionary_size(leveldb_options_t*, size_t);
+extern void leveldb_options_set_zstd_max_train_bytes(leveldb_options_t*, size_t);
+extern void leveldb_options_set_use_direct_reads(leveldb_options_t*,
+                                                 unsigned char);
+extern void leveldb_options_set_use_direct_io_for_flush_and_compaction(
+    leveldb_options_t*, unsigned char);
+extern void leveldb_options_set_use_dsync_writes(leveldb_options_t*,
+                                                 unsigned char);
+/* levels[i] is the compression type for level i; num_levels == 0 clears it */
+extern void leveldb_options_set_compression_per_level(
+    leveldb_options_t*, const int* levels, size_t num_levels);
 
 /* Comparator */
 
@@ -238,6 +303,16 @@ extern void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t*);
 
 extern leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(
     int bits_per_key);
+extern leveldb_filterpolicy_t* leveldb_filterpolicy_create_cache_local_bloom(
+    int bits_per_key);
+extern leveldb_filterpolicy_t* leveldb_filterpolicy_create_ribbon(
+    int bits_per_key);
+
+/* Prefix extractor */
+
+extern leveldb_slicetransform_t* leveldb_slicetransform_create_fixed_prefix(
+    size_t prefix_len);
+extern void leveldb_slicetransform_destroy(leveldb_slicetransform_t*);
 
 /* Read options */
 
@@ -251,6 +326,12 @@ extern void leveldb_readoptions_set_fill_cache(
 extern void leveldb_readoptions_set_snapshot(
     leveldb_readoptions_t*,
     const leveldb_snapshot_t*);
+extern void leveldb_readoptions_set_prefix_same_as_start(
+    leveldb_readoptions_t*, unsigned char);
+/* The key is copied; a NULL key removes the bound. */
+extern void leveldb_readoptions_set_iterate_upper_bound(
+    leveldb_readoptions_t*,
+    const char* key, size_t keylen);
 
 /* Write options */
 
@@ -34,6 +34,30 @@ class Cache;
 */
 extern Cache* NewLRUCache(size_t capacity);
 
+// Create a new LRU cache that keeps up to high_pri_pool_ratio of its
+// capacity for a high-priority pool.  Entries inserted with
+// Cache::kHighPriority, and entries found again by Lookup() after
+// they were inserted, go to the most recently used end of that pool.
+// Other new entries are inserted at the midpoint, the most recently
+// used end of the rest of the cache, so a scan that touches each entry
+// once only evicts entries that were never reused.  Entries that
+// overflow the pool move to the midpoint.  A ratio of zero behaves
+// like NewLRUCache(capacity).
+extern Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
+// Create a new cache with a fixed size capacity whose Lookup() and
+// Release() take no locks, for block caches shared by many reader
+// threads.  Eviction uses the CLOCK algorithm: entries that are found
+// again survive more sweeps of the clock hand, and high priority
+// entries start out as if they had been found again.  The cache is
+// split into 2^num_shard_bits shards, each with a fixed table sized for
+// entries with a charge of about estimated_entry_charge; if entries are
+// much smaller, the tables fill up and entries are evicted before the
+// capacity is reached.  The one-argument form uses 16 shards and 4K
+// entries.
+extern Cache* NewClockCache(size_t capacity);
+extern Cache* NewClockCache(size_t capacity, int num_shard_bits, size_t estimated_entry_charge);
+
 class Cache 
 {
  public:
@@ -46,6 +70,14 @@ class Cache
   // Opaque（不透明） handle to an entry stored in the cache.
   struct Handle { };
 
+  // Eviction priority of an inserted entry.  Caches without a
+  // high-priority pool treat both alike.
+  enum Priority
+  {
+    kHighPriority,
+    kLowPriority
+  };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -55,11 +87,15 @@ class Cache
   //
   // When the inserted entry is no longer needed, the key and
   // value will be passed to "deleter".
+  //
+  // "priority" decides where the entry starts out in caches that keep
+  // a high-priority pool (see NewLRUCache()).
   /*
 	插入到缓冲中, 指定的负荷charge分配到总容量中
 	返回 Handle指针, 不再使用调用this->Release(handle)释放
   */
-  virtual Handle* Insert(const Slice& key, void* value, size_t charge, void (*deleter)(const Slice& key, void* value)) = 0;
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge, void (*deleter)(const Slice& key, void* value),
+                         Priority priority = kLowPriority) = 0;
 
   // If the cache has no mapping for "key", returns NULL.
   //
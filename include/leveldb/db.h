@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 
@@ -72,6 +74,24 @@ class DB
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for the keys in [begin, end),
+  // as ordered by the comparator.  Returns OK on success, and a non-OK
+  // status on error.  A single range tombstone is written however many
+  // keys the range holds, and tables that only hold keys in the range
+  // may be dropped at once when no snapshot can read them.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options, const Slice& begin, const Slice& end);
+
+  // Load the table files at "paths", built with SstFileWriter, into the
+  // database as they are: their contents are neither logged nor copied
+  // into a memtable, and compactions do not rewrite them on the way to
+  // their level.  Each file is moved into the database, or copied if it
+  // cannot be moved.  All entries of the files become visible at once,
+  // newer than any earlier write.  The files must not overlap each other.
+  // Writes wait while the files are installed, and the memtable is
+  // flushed first if it holds keys in their ranges.
+  virtual Status IngestExternalFile(const std::vector<std::string>& paths);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -86,6 +106,18 @@ class DB
   // May return some other Status on an error.
   virtual Status Get(const ReadOptions& options, const Slice& key, std::string* value) = 0;
 
+  // Look up every key in "keys" as of a single snapshot.  On return
+  // (*values)[i] and (*statuses)[i] hold what Get() would have returned
+  // for keys[i]; (*values)[i] is empty unless (*statuses)[i] is OK.
+  //
+  // Cheaper than a loop over Get(): the keys are sorted and each level
+  // and table is searched once for the whole batch, so keys that land in
+  // the same data block share the block lookup.
+  virtual void MultiGet(const ReadOptions& options,
+                        const std::vector<Slice>& keys,
+                        std::vector<std::string>* values,
+                        std::vector<Status>* statuses);
+
   // Return a heap-iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -123,6 +155,28 @@ class DB
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.secondary-cache-stats" - returns a multi-line string with
+  //     the counters of the secondary block cache, if one is configured.
+  //  "leveldb.stats.json" - returns the read counters below as a JSON
+  //     object, for tuning filters, the block cache and level sizes.
+  //  "leveldb.memtable-hits", "leveldb.memtable-misses",
+  //  "leveldb.get-not-found" - Get() calls answered by a memtable, that
+  //     had to search the tables, and that found no value.
+  //  "leveldb.get-hits-at-level<N>" - Get() calls that found the value in
+  //     a table at level <N>.
+  //  "leveldb.bloom-useful", "leveldb.bloom-useless" - table lookups that
+  //     a filter ruled out, and that read a data block without finding
+  //     the key.
+  //  "leveldb.bloom-prefix-useful" - table seeks that a prefix filter
+  //     ruled out (see ReadOptions::prefix_same_as_start).
+  //  "leveldb.block-cache-{data,index,filter}-{hits,misses}" - block
+  //     cache lookups by kind of block.
+  //  "leveldb.bytes-read", "leveldb.bytes-read-at-level<N>" - bytes read
+  //     from table files, by the level of the file.
+  //  "leveldb.iter-seeks" - seeks of iterators returned by NewIterator().
+  //  "leveldb.histograms" - returns a multi-line string with latency
+  //     histograms, in microseconds, of Get(), Write(), write stalls,
+  //     log syncs, memtable flushes, compactions and iterator seeks.
   
   /*
 	获取当前DB的状态属性
@@ -134,6 +188,10 @@ class DB
   */
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
+  // Set the read counters and latency histograms reported by
+  // GetProperty() back to zero.  Does nothing by default.
+  virtual void ResetStats();
+
   // For each i in [0,n-1], store in "sizes[i]", the approximate
   // file system space used by keys in "[range[i].start .. range[i].limit)".
   //
@@ -30,6 +30,24 @@ class SequentialFile;
 class Slice;
 class WritableFile;
 
+// Hints on how a file should be opened.  An Env that cannot honor one
+// may ignore it.
+struct FileOptions
+{
+  // Bypass the OS page cache (O_DIRECT).  Reads and writes are staged
+  // through aligned buffers, so callers need not align anything.
+  bool use_direct_io;
+
+  // Make every write durable before it returns (O_DSYNC).
+  bool use_dsync;
+
+  // Drop the file's pages from the OS page cache when it is closed.
+  // Only pages that have already been synced are dropped.
+  bool drop_cache_on_close;
+
+  FileOptions() : use_direct_io(false), use_dsync(false), drop_cache_on_close(false) { }
+};
+
 //ϵͳصļ̡ʱ֮ĴɳEnv
 class Env
 {
@@ -84,6 +102,16 @@ class Env
   // an Env that does not support appending.
   virtual Status NewAppendableFile(const std::string& fname, WritableFile** result);
 
+  // Like NewRandomAccessFile(), NewWritableFile() and NewAppendableFile(),
+  // but open the file as described by "options".  The default
+  // implementations ignore "options".
+  virtual Status NewRandomAccessFileWithOptions(const std::string& fname, const FileOptions& options,
+                                                RandomAccessFile** result);
+  virtual Status NewWritableFileWithOptions(const std::string& fname, const FileOptions& options,
+                                            WritableFile** result);
+  virtual Status NewAppendableFileWithOptions(const std::string& fname, const FileOptions& options,
+                                              WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -136,6 +164,29 @@ class Env
   // serialized.
   virtual void Schedule( void (*function)(void* arg), void* arg) = 0;
 
+  // Background work runs in one of several thread pools.  Flushes use
+  // HIGH so that they never queue up behind long compactions in LOW.
+  enum Priority { LOW, HIGH, TOTAL };
+
+  // Like Schedule(), but run "(*function)(arg)" in the pool for "pri".
+  // "tag" identifies the work for UnSchedule(); it may be NULL.
+  // The default implementation ignores pri and tag and calls Schedule().
+  virtual void ScheduleWithPriority(void (*function)(void* arg), void* arg,
+                                    Priority pri, void* tag);
+
+  // Remove the work scheduled in the "pri" pool with the given tag that
+  // has not started running yet.  Returns the number of items removed.
+  // The default implementation removes nothing.
+  virtual int UnSchedule(void* tag, Priority pri);
+
+  // Set the number of background threads in the "pri" pool.  Surplus
+  // threads exit once they finish their current work item.  The default
+  // implementation ignores the request.
+  virtual void SetBackgroundThreads(int number, Priority pri);
+
+  // Return the number of background threads in the "pri" pool.
+  virtual int GetBackgroundThreads(Priority pri);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -311,6 +362,18 @@ class EnvWrapper : public Env
   {
     return target_->NewAppendableFile(f, r);
   }
+  Status NewRandomAccessFileWithOptions(const std::string& f, const FileOptions& o, RandomAccessFile** r)
+  {
+    return target_->NewRandomAccessFileWithOptions(f, o, r);
+  }
+  Status NewWritableFileWithOptions(const std::string& f, const FileOptions& o, WritableFile** r)
+  {
+    return target_->NewWritableFileWithOptions(f, o, r);
+  }
+  Status NewAppendableFileWithOptions(const std::string& f, const FileOptions& o, WritableFile** r)
+  {
+    return target_->NewAppendableFileWithOptions(f, o, r);
+  }
   bool FileExists(const std::string& f)
   { 
 	  return target_->FileExists(f); 
@@ -339,6 +402,22 @@ class EnvWrapper : public Env
   {
     return target_->Schedule(f, a);
   }
+  void ScheduleWithPriority(void (*f)(void*), void* a, Priority pri, void* tag)
+  {
+    return target_->ScheduleWithPriority(f, a, pri, tag);
+  }
+  int UnSchedule(void* tag, Priority pri)
+  {
+    return target_->UnSchedule(tag, pri);
+  }
+  void SetBackgroundThreads(int number, Priority pri)
+  {
+    return target_->SetBackgroundThreads(number, pri);
+  }
+  int GetBackgroundThreads(Priority pri)
+  {
+    return target_->GetBackgroundThreads(pri);
+  }
   void StartThread(void (*f)(void*), void* a)
   {
     return target_->StartThread(f, a);
@@ -6,6 +6,8 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include <string>
+#include <vector>
 
 //包含控制数据库的相关选项包括writeoption readoption
 namespace leveldb {
@@ -15,6 +17,8 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +30,9 @@ enum CompressionType
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression     = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression   = 0x2,
+  kLZ4Compression    = 0x3
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -89,6 +95,32 @@ struct Options
   // memtable的最大size
   size_t write_buffer_size;
 
+  // If true, writers whose batches are committed together in one log
+  // record insert their own batches into the memtable in parallel once
+  // the log write is done, instead of leaving every insert to the thread
+  // that wrote the log.  Helps write throughput with many writer threads.
+  //
+  // Default: false
+  bool allow_concurrent_memtable_write;
+
+  // If true, split writes into a log stage and a memtable stage, so that
+  // the next writer group can append (and sync) its log record while the
+  // previous group is still being inserted into the memtable.  Writes
+  // still become visible in log order.  Most useful with sync writes.
+  //
+  // Default: false
+  bool enable_pipelined_write;
+
+  // If true, log records are buffered in memory and a dedicated thread
+  // writes them to the log file and syncs it.  Sync writes of many writer
+  // groups then share one write and one fdatasync instead of each group
+  // syncing in turn, so enable it for many concurrent sync writers.
+  // Implies enable_pipelined_write.  A write still returns only once its
+  // record has been written (and, for sync writes, synced).
+  //
+  // Default: false
+  bool enable_log_flusher;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -99,6 +131,25 @@ struct Options
   */
   int max_open_files;  
 
+  // Maximum number of compactions that may run concurrently in the
+  // background.  Concurrent compactions always work on disjoint sets of
+  // files.  Memtable flushes are scheduled separately and do not count
+  // against this limit.
+  //
+  // Default: 1
+  int max_background_compactions;
+
+  // Maximum number of threads a single compaction may be split across.
+  // A large compaction is divided into key ranges at the boundaries of
+  // the files it overlaps in the next two levels, and the ranges are
+  // merged in parallel.  The extra threads come from the background
+  // compaction pool and count against max_background_compactions; with
+  // no free slot, the ranges are merged one after another.  The outputs
+  // are installed together.
+  //
+  // Default: 1
+  int max_subcompactions;
+
   // Control over blocks (user data is stored in a set of blocks, and
   // a block is the unit of reading from disk).
 
@@ -141,6 +192,66 @@ struct Options
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression;	//压缩数据的类型（默认是snappy，其他的类型需要自己实现）
 
+  // Compression level used when a block is compressed with
+  // kZstdCompression.  Higher levels compress better but slower; the
+  // decompression speed barely changes.  Negative levels trade ratio for
+  // speed.
+  //
+  // Default: 1
+  int zstd_compression_level;
+
+  // If non-empty, tables written to level i are compressed with
+  // compression_per_level[i] instead of "compression"; levels past the
+  // end of the vector use its last entry.  Memtable flushes use the
+  // level-0 entry.  A typical setup is kLZ4Compression for the hot
+  // upper levels and kZstdCompression for the large bottom levels.
+  // Existing tables keep whatever codec they were written with.
+  //
+  // Default: empty
+  std::vector<CompressionType> compression_per_level;
+
+  // If non-zero, each table compressed with kZstdCompression gets its
+  // own zstd dictionary of at most this many bytes, trained on the
+  // table's first data blocks and stored in a meta block.  Small values
+  // that share structure (e.g. JSON records) compress much better with
+  // a dictionary than one 4K block at a time.  Tables holding less than
+  // 10 * zstd_dictionary_size bytes are written without one.
+  //
+  // Default: 0 (no dictionary)
+  size_t zstd_dictionary_size;
+
+  // Bytes of uncompressed entries the table builder holds back as
+  // training samples for the dictionary before writing anything.  Zero
+  // means 100 * zstd_dictionary_size.
+  //
+  // Default: 0
+  size_t zstd_max_train_bytes;
+
+  // If true, table files are read with O_DIRECT, bypassing the OS page
+  // cache, so that blocks are cached once (in block_cache) rather than
+  // twice.  Size block_cache accordingly.  Tables written by flushes and
+  // compactions are also dropped from the page cache once they are
+  // complete.  Ignored where the file system does not support O_DIRECT.
+  //
+  // Default: false
+  bool use_direct_reads;
+
+  // If true, the tables written by memtable flushes and compactions are
+  // written with O_DIRECT, so that large compactions do not evict hot
+  // pages from the OS page cache.  Where the file system does not
+  // support O_DIRECT, the pages are dropped when each table is complete.
+  //
+  // Default: false
+  bool use_direct_io_for_flush_and_compaction;
+
+  // If true, log and table files are opened with O_DSYNC, so that each
+  // write reaches stable storage before it returns and Sync() has
+  // nothing left to flush.  Every log write then costs a device write,
+  // even without WriteOptions::sync.
+  //
+  // Default: false
+  bool use_dsync_writes;
+
   // EXPERIMENTAL（实验）: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -154,6 +265,76 @@ struct Options
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // If true (and filter_policy is non-NULL), new tables store a single
+  // filter built from all of their keys instead of one filter per 2KB
+  // of data block offsets.  Reads check it before searching the index
+  // block, so a negative lookup costs no index search at all.  Building
+  // a table holds all of its keys in memory until the table is finished.
+  // Tables written with either format stay readable.
+  //
+  // Default: false
+  bool full_table_filter;
+
+  // If non-NULL (and full_table_filter is set), new tables also add the
+  // prefix of each key to their filter, so that an iterator reading with
+  // ReadOptions::prefix_same_as_start can rule out a whole table with
+  // one filter probe when its Seek() target's prefix is not in it.
+  // Filter partitions cannot rule out a prefix, so tables written with
+  // partition_index_and_filters do not get prefixes.
+  // Tables record the name of the transform; those written without it,
+  // or with a differently named one, are always searched.
+  //
+  // Default: NULL
+  const SliceTransform* prefix_extractor;
+
+  // If true, new tables split their index block into partitions of about
+  // metadata_block_size bytes under a small top-level index, and split
+  // their filter (if filter_policy is non-NULL) along the same
+  // boundaries.  An open table keeps only the top-level index in
+  // memory; partitions are read on demand through block_cache, so
+  // index and filter memory follows the hot set instead of the size of
+  // the database.  full_table_filter is ignored for such tables.
+  //
+  // Default: false
+  bool partition_index_and_filters;
+
+  // Approximate size of an index or filter partition when
+  // partition_index_and_filters is set.
+  //
+  // Default: 4K
+  size_t metadata_block_size;
+
+  // If true (and block_cache is non-NULL), the index block and filter of
+  // an open table are kept in block_cache and charged against its
+  // capacity like data blocks, instead of living outside of it for as
+  // long as the table is open.  They can then be evicted, and are read
+  // again on the next lookup that needs them.
+  //
+  // Default: false
+  bool cache_index_and_filter_blocks;
+
+  // If true (and cache_index_and_filter_blocks is set), the index block
+  // and filter of level-0 tables (including tables just written by a
+  // memtable flush) are pinned in block_cache while the table is open,
+  // since every read consults all of the level-0 tables.
+  //
+  // Default: false
+  bool pin_l0_filter_and_index_blocks_in_cache;
+
+  // If non-empty, blocks read from table files are also kept, as stored
+  // (i.e. compressed), in files under this directory, and looked up there
+  // on a block_cache miss before reading the table file.  Meant for a
+  // fast local device in front of slow table storage.  The directory is
+  // emptied when the DB is opened and must not be shared.
+  //
+  // Default: ""
+  std::string secondary_cache_path;
+
+  // Maximum number of bytes kept under secondary_cache_path.
+  //
+  // Default: 1GB
+  size_t secondary_cache_size;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -178,7 +359,30 @@ struct ReadOptions
   // Default: NULL
   const Snapshot* snapshot;	//指定读取snapshot
 
-  ReadOptions() : verify_checksums(false), fill_cache(true), snapshot(NULL) 
+  // If true (and Options::prefix_extractor is non-NULL), an iterator only
+  // yields keys with the same prefix as the target of its last Seek(),
+  // and becomes invalid at the first key after them.  Tables whose
+  // filter does not hold the prefix are skipped without reading any of
+  // their blocks, so Prev() is not supported after such a Seek().  Has
+  // no effect after SeekToFirst() or SeekToLast(), or after a Seek() to
+  // a key that prefix_extractor has no prefix for.
+  // Default: false
+  bool prefix_same_as_start;
+
+  // If non-NULL, an iterator only yields keys before *iterate_upper_bound
+  // (exclusive), in either direction, and becomes invalid at the first
+  // key at or after it.  Files and blocks that only hold later keys are
+  // not read.  DB::NewIterator() copies the bound, so it need not outlive
+  // the call.
+  // Default: NULL
+  const Slice* iterate_upper_bound;
+
+  ReadOptions()
+      : verify_checksums(false),
+        fill_cache(true),
+        snapshot(NULL),
+        prefix_same_as_start(false),
+        iterate_upper_bound(NULL)
   {
 
   }
@@ -0,0 +1,50 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a SliceTransform that extracts a
+// prefix from each key (see Options::prefix_extractor).  The prefixes
+// are added to table filters, so that an iterator that only wants the
+// keys sharing the prefix of its Seek() target (see
+// ReadOptions::prefix_same_as_start) can skip the tables that hold
+// none of them without reading their index or data blocks.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <stddef.h>
+#include "leveldb/slice.h"
+
+namespace leveldb
+{
+
+class SliceTransform
+{
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transform.  It is recorded in every table
+  // whose filter holds prefixes, and a table is only searched by prefix
+  // if the name matches, so the name must change whenever Transform()
+  // changes in an incompatible way.
+  virtual const char* Name() const = 0;
+
+  // Return the prefix of "key".
+  // REQUIRES: InDomain(key)
+  // The result must be a prefix of "key", i.e. point to key.data(), and
+  // keys with the same prefix must be adjacent in comparator order.
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Return true if "key" has a prefix.  Keys that do not are added to
+  // filters whole only, and a Seek() to such a key ignores the prefix.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transform whose prefix is the first "prefix_len" bytes of
+// a key.  Keys shorter than that have no prefix.  The caller must delete
+// the result after any database using it has been closed.
+extern const SliceTransform* NewFixedPrefixTransform(size_t prefix_len);
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
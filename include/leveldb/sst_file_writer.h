@@ -0,0 +1,67 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table file from keys supplied in sorted order,
+// outside of any database, for DB::IngestExternalFile() to load without
+// going through the log, the memtable or compactions.
+//
+// An SstFileWriter is not thread-safe; concurrent use must be externally
+// synchronized.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class SstFileWriter {
+ public:
+  // "options" should match the options of the database the file will be
+  // ingested into: the comparator, filter policy and prefix extractor in
+  // particular, as well as the block size and compression settings that
+  // the database would use for its own tables.
+  explicit SstFileWriter(const Options& options);
+
+  // Abandons the file if Finish() has not been called.
+  ~SstFileWriter();
+
+  // Create the file "fname", replacing any existing file.
+  // REQUIRES: Open() has not been called
+  Status Open(const std::string& fname);
+
+  // Add an entry that maps "key" to "value".
+  // REQUIRES: key is after any previously added key according to the
+  //           comparator; a key may only be added once.
+  Status Put(const Slice& key, const Slice& value);
+
+  // Add a deletion of "key", which hides the entries for it that are
+  // older than the ingested file.  Same order rules as Put().
+  Status Delete(const Slice& key);
+
+  // Finish building the file, sync and close it.  A file with no entries
+  // is an error and is deleted.  No other method may be called after it.
+  Status Finish();
+
+  // Size of the file generated so far.  After a successful Finish(),
+  // the final size of the file.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+  Rep* rep_;
+
+  Status Add(const Slice& key, const Slice& value, bool deletion);
+
+  // No copying allowed
+  SstFileWriter(const SstFileWriter&);
+  void operator=(const SstFileWriter&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
@@ -18,6 +18,8 @@ class Footer;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
+class SecondaryCache;
+class Statistics;
 class TableCache;
 
 // A Table is a sorted map from strings to strings.  Tables are
@@ -48,8 +50,19 @@ class Table
   // Returns a new iterator over the table contents.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
+  // With ReadOptions::prefix_same_as_start, a Seek() to a key whose
+  // prefix the table's filter rules out leaves the iterator invalid
+  // without reading any block.  ReadOptions::iterate_upper_bound is a
+  // key in the order of Options::comparator here; Next() does not read
+  // the blocks after it, but the iterator may still yield keys past it.
+  // The bound must remain live while the iterator is in use.
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the range tombstones added with
+  // TableBuilder::AddRangeDeletion(), which NewIterator() does not
+  // yield.  Keys are the begin keys and values the end keys.
+  Iterator* NewRangeDeletionIterator() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -63,16 +76,62 @@ class Table
   struct Rep;
   Rep* rep_;
 
+  class PrefixSeekIterator;
+
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&, const Slice&);
+  // Iterator over the block whose handle starts "index_value", read
+  // through the block cache.
+  Iterator* BlockIterator(const ReadOptions&, const Slice& index_value, bool data_block) const;
+  // Iterator over the index block (the top-level index if partitioned),
+  // which may have to be read through the block cache.
+  Iterator* IndexBlockIterator(const ReadOptions&) const;
+  // Iterator over all index entries, loading partitions as needed.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+  // Consult the filter partition that covers "key".
+  bool PartitionedFilterMayMatch(const ReadOptions&, const Slice& key) const;
+  // Consult the full-table filter, if the table has one.
+  bool FullFilterMayMatch(const ReadOptions&, const Slice& key) const;
+  // Whether the table may hold keys with the prefix of "key", according
+  // to the prefixes in its full-table filter.
+  bool PrefixMayMatch(const ReadOptions&, const Slice& key) const;
+  // Consult the filter of the data block whose handle starts
+  // "index_value", if the table has per-block filters.
+  bool BlockFilterMayMatch(const ReadOptions&, const Slice& index_value, const Slice& key) const;
+  // Keep the index block and filter that were handed to the block cache
+  // in it until the table is closed.  Must be called before the table
+  // is shared between threads.
+  void PinMetaBlocks();
+  // Read blocks through "secondary_cache" (which may be NULL), where
+  // they are keyed by "file_number".  Must be called before the table
+  // is shared between threads.
+  void UseSecondaryCache(SecondaryCache* secondary_cache, uint64_t file_number);
+  // Count block cache hits and filter probes in "statistics" (which may
+  // be NULL).  Must be called before the table is shared between threads.
+  void UseStatistics(Statistics* statistics);
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
   friend class TableCache;
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg, void (*handle_result)(void* arg, const Slice& k, const Slice& v));
-  void ReadMeta(const Footer& footer);
-  void ReadFilter(const Slice& filter_handle_value);
+
+  // Batched InternalGet() for keys[0,n-1], which must be sorted.  Calls
+  // (*handle_result)(args[i], ...) for each key and stores the status of
+  // the lookup of keys[i] in statuses[i], so that an unreadable block
+  // only fails the keys that needed it.  Keys that map to the same index
+  // entry share one index seek and one data block lookup.
+  void InternalMultiGet(const ReadOptions&, int n, const Slice* keys, void* const* args,
+                        Status* statuses,
+                        void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+  // Errors reading the filter are ignored since it is optional; a
+  // zstd dictionary or range deletion block that cannot be loaded
+  // fails the open.
+  Status ReadMeta(const Footer& footer);
+  void ReadFilter(const Slice& filter_handle_value, bool full);
+  Status ReadZstdDictionary(const Slice& dictionary_handle_value);
+  Status ReadRangeDeletions(const Slice& range_del_handle_value);
 
   // No copying allowed
   Table(const Table&);
@@ -49,6 +49,14 @@ class TableBuilder
   // 写入sstable中，和block的写入一样不需要关心排序
   void Add(const Slice& key, const Slice& value);
 
+  // Add the range tombstone [begin, end) to the table's range deletion
+  // block.  begin_key is the internal key of the begin key; end is the
+  // end user key.  Range tombstones are not counted by NumEntries().
+  // REQUIRES: begin_key is after any previously added begin_key
+  //           according to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeDeletion(const Slice& begin_key, const Slice& end);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -80,7 +88,13 @@ class TableBuilder
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+  // Train the zstd dictionary on the entries held back so far and
+  // replay them through Add().
+  void FinishBuffering();
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  // Write out the current index partition and its filter partition and
+  // point the top-level index at them.
+  void FinishPartition();
 
   struct Rep;
   Rep* rep_;
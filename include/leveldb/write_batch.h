@@ -40,6 +40,11 @@ class WriteBatch
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase the mappings for all keys in ["begin", "end"), without
+  // having to know which keys are present.  Does nothing if "end" is
+  // not after "begin".
+  void DeleteRange(const Slice& begin, const Slice& end);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -50,6 +55,8 @@ class WriteBatch
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // The default implementation ignores range deletions.
+    virtual void DeleteRange(const Slice& begin, const Slice& end);
   };
   Status Iterate(Handler* handler) const;
 
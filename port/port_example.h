@@ -97,6 +97,11 @@ class AtomicPointer {
 
   // Set va as the stored pointer with no ordering guarantees.
   void NoBarrier_Store(void* v);
+
+  // If the stored pointer equals old_value, atomically replace it with
+  // new_value and return true.  Otherwise leave it alone and return false.
+  // Acts as a full memory barrier either way.
+  bool CompareAndSwap(void* old_value, void* new_value);
 };
 
 // ------------------ Compression -------------------
@@ -122,6 +127,92 @@ extern bool Snappy_GetUncompressedLength(const char* input, size_t length,
 extern bool Snappy_Uncompress(const char* input_data, size_t input_length,
                               char* output);
 
+// Store the zstd compression of "input[0,input_length-1]" at the given
+// compression level in *output.  Returns false if zstd is not supported
+// by this port.
+extern bool Zstd_Compress(int level, const char* input, size_t input_length,
+                          std::string* output);
+
+// If input[0,input_length-1] looks like a valid zstd compressed buffer,
+// store the size of the uncompressed data in *result and return true.
+// Else return false.
+extern bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result);
+
+// Attempt to zstd uncompress input[0,input_length-1] into *output.
+// Returns true if successful, false if the input is invalid.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+extern bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                            char* output);
+
+// Train a zstd dictionary of at most "max_dictionary_size" bytes from
+// the concatenation of samples whose lengths are "sample_sizes" and
+// store it in *dictionary.  Returns false if zstd is not supported or
+// the samples are too few or too small to train on.
+extern bool Zstd_TrainDictionary(const std::string& samples,
+                                 const std::vector<size_t>& sample_sizes,
+                                 size_t max_dictionary_size,
+                                 std::string* dictionary);
+
+// A zstd dictionary digested once so that it can be applied to many
+// blocks cheaply.  A dictionary built for compression keeps one zstd
+// context for all its blocks, so Compress() needs external
+// synchronization; Uncompress() is safe for concurrent use by multiple
+// threads.
+class ZstdDictionary {
+ public:
+  // "data[0,size-1]" need not outlive the object.  A dictionary built
+  // with "for_compression" compresses at "level"; otherwise it can only
+  // uncompress.
+  ZstdDictionary(const char* data, size_t size, bool for_compression,
+                 int level);
+  ~ZstdDictionary();
+
+  // Returns false if zstd is not supported or "data" was rejected.
+  bool ok() const;
+
+  // Like Zstd_Compress(), but using the dictionary.
+  // REQUIRES: constructed with for_compression == true
+  bool Compress(const char* input, size_t input_length,
+                std::string* output) const;
+
+  // Like Zstd_Uncompress(), but using the dictionary.  Blocks compressed
+  // without any dictionary are accepted too.
+  // REQUIRES: constructed with for_compression == false
+  bool Uncompress(const char* input_data, size_t input_length,
+                  char* output) const;
+};
+
+// The same three operations for LZ4.  The port is responsible for
+// recording the uncompressed length in *output, since a raw LZ4 block
+// does not.
+extern bool LZ4_Compress(const char* input, size_t input_length,
+                         std::string* output);
+extern bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result);
+extern bool LZ4_Uncompress(const char* input_data, size_t input_length,
+                           char* output);
+
+// ------------------ CRC32C -------------------
+
+// Returns true iff AcceleratedCRC32C() can run on this CPU, i.e. the
+// SSE4.2 crc32 instruction (or its equivalent on this platform) is
+// available.  If "need_pclmul" is true, also requires the carry-less
+// multiply used to merge parallel streams.
+extern bool HasAcceleratedCRC32C(bool need_pclmul);
+
+// Returns the same value as crc32c::Extend(crc, buf, size), computed with
+// hardware instructions.  If "use_pclmul" is true, large buffers are
+// checksummed as three interleaved streams whose results are combined
+// with carry-less multiplication.
+//
+// REQUIRES: HasAcceleratedCRC32C(use_pclmul) returned true.
+extern uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size,
+                                  bool use_pclmul);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -4,9 +4,13 @@
 
 #include "port/port_posix.h"
 
+#include <assert.h>
 #include <cstdlib>
 #include <stdio.h>
 #include <string.h>
+#ifdef ZSTD
+#include <zdict.h>
+#endif
 
 namespace leveldb {
 namespace port {
@@ -52,5 +56,134 @@ void InitOnce(OnceType* once, void (*initializer)())
   PthreadCall("once", pthread_once(once, initializer));
 }
 
+bool Zstd_TrainDictionary(const std::string& samples,
+                          const std::vector<size_t>& sample_sizes,
+                          size_t max_dictionary_size,
+                          std::string* dictionary) {
+#ifdef ZSTD
+  if (sample_sizes.empty() || max_dictionary_size == 0) {
+    return false;
+  }
+  dictionary->resize(max_dictionary_size);
+  const size_t n = ZDICT_trainFromBuffer(
+      &(*dictionary)[0], max_dictionary_size, samples.data(),
+      &sample_sizes[0], static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(n)) {
+    dictionary->clear();
+    return false;
+  }
+  dictionary->resize(n);
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef ZSTD
+
+// Tables are read by many threads at once, so each thread keeps its own
+// decompression context for all the tables it reads from rather than
+// setting one up for every block.
+static pthread_key_t dctx_key;
+static OnceType dctx_once = LEVELDB_ONCE_INIT;
+
+static void FreeDCtx(void* ctx) {
+  ZSTD_freeDCtx(reinterpret_cast<ZSTD_DCtx*>(ctx));
+}
+
+static void InitDCtxKey() {
+  PthreadCall("create key", pthread_key_create(&dctx_key, &FreeDCtx));
+}
+
+static ZSTD_DCtx* ThreadDCtx() {
+  InitOnce(&dctx_once, &InitDCtxKey);
+  ZSTD_DCtx* ctx = reinterpret_cast<ZSTD_DCtx*>(pthread_getspecific(dctx_key));
+  if (ctx == NULL) {
+    ctx = ZSTD_createDCtx();
+    if (ctx != NULL) {
+      PthreadCall("set key", pthread_setspecific(dctx_key, ctx));
+    }
+  }
+  return ctx;
+}
+
+ZstdDictionary::ZstdDictionary(const char* data, size_t size,
+                               bool for_compression, int level)
+    : cdict_(NULL),
+      ddict_(NULL),
+      cctx_(NULL) {
+  if (for_compression) {
+    cdict_ = ZSTD_createCDict(data, size, level);
+    cctx_ = ZSTD_createCCtx();
+  } else {
+    ddict_ = ZSTD_createDDict(data, size);
+  }
+}
+
+ZstdDictionary::~ZstdDictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+  ZSTD_freeCCtx(cctx_);
+}
+
+bool ZstdDictionary::ok() const {
+  return (cdict_ != NULL && cctx_ != NULL) || ddict_ != NULL;
+}
+
+bool ZstdDictionary::Compress(const char* input, size_t length,
+                              std::string* output) const {
+  assert(cdict_ != NULL && cctx_ != NULL);
+  size_t outlen = ZSTD_compressBound(length);
+  output->resize(outlen);
+  outlen = ZSTD_compress_usingCDict(cctx_, &(*output)[0], outlen,
+                                    input, length, cdict_);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+}
+
+bool ZstdDictionary::Uncompress(const char* input, size_t length,
+                                char* output) const {
+  assert(ddict_ != NULL);
+  size_t ulength;
+  if (!Zstd_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  ZSTD_DCtx* ctx = ThreadDCtx();
+  if (ctx == NULL) {
+    return false;
+  }
+  const size_t outlen = ZSTD_decompress_usingDDict(ctx, output, ulength,
+                                                   input, length, ddict_);
+  return !ZSTD_isError(outlen) && outlen == ulength;
+}
+
+#else  // !ZSTD
+
+ZstdDictionary::ZstdDictionary(const char* data, size_t size,
+                               bool for_compression, int level) {
+}
+
+ZstdDictionary::~ZstdDictionary() {
+}
+
+bool ZstdDictionary::ok() const {
+  return false;
+}
+
+bool ZstdDictionary::Compress(const char* input, size_t length,
+                              std::string* output) const {
+  return false;
+}
+
+bool ZstdDictionary::Uncompress(const char* input, size_t length,
+                                char* output) const {
+  return false;
+}
+
+#endif  // ZSTD
+
 }  // namespace port
 }  // namespace leveldb
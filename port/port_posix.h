@@ -42,8 +42,15 @@
 #ifdef SNAPPY
 #include <snappy.h>
 #endif
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+#ifdef LZ4
+#include <lz4.h>
+#endif
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include "port/atomic_pointer.h"
 
 #ifndef PLATFORM_IS_LITTLE_ENDIAN
@@ -145,10 +152,151 @@ inline bool Snappy_Uncompress(const char* input, size_t length,
 #endif
 }
 
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          ::std::string* output) {
+#ifdef ZSTD
+  size_t outlen = ZSTD_compressBound(length);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  outlen = ZSTD_compress(&(*output)[0], outlen, input, length, level);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#endif
+
+  return false;
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#ifdef ZSTD
+  const unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  *result = static_cast<size_t>(size);
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length, char* output) {
+#ifdef ZSTD
+  size_t ulength;
+  if (!Zstd_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  const size_t outlen = ZSTD_decompress(output, ulength, input, length);
+  return !ZSTD_isError(outlen) && outlen == ulength;
+#else
+  return false;
+#endif
+}
+
+// Defined in port_posix.cc.
+extern bool Zstd_TrainDictionary(const std::string& samples,
+                                 const std::vector<size_t>& sample_sizes,
+                                 size_t max_dictionary_size,
+                                 std::string* dictionary);
+
+class ZstdDictionary {
+ public:
+  ZstdDictionary(const char* data, size_t size, bool for_compression,
+                 int level);
+  ~ZstdDictionary();
+  bool ok() const;
+  bool Compress(const char* input, size_t length,
+                ::std::string* output) const;
+  bool Uncompress(const char* input, size_t length, char* output) const;
+
+ private:
+#ifdef ZSTD
+  ZSTD_CDict* cdict_;
+  ZSTD_DDict* ddict_;
+  mutable ZSTD_CCtx* cctx_;   // Reused by Compress(); NULL if not for_compression
+#endif
+
+  // No copying allowed
+  ZstdDictionary(const ZstdDictionary&);
+  void operator=(const ZstdDictionary&);
+};
+
+// A raw LZ4 block does not record its uncompressed size, so the port
+// prefixes it with the size as four little-endian bytes.
+static const size_t kLZ4HeaderSize = 4;
+
+inline bool LZ4_Compress(const char* input, size_t length,
+                         ::std::string* output) {
+#ifdef LZ4
+  if (length > LZ4_MAX_INPUT_SIZE) {
+    return false;
+  }
+  const int bound = LZ4_compressBound(static_cast<int>(length));
+  output->resize(kLZ4HeaderSize + bound);
+  for (size_t i = 0; i < kLZ4HeaderSize; i++) {
+    (*output)[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  const int outlen = LZ4_compress_default(input, &(*output)[kLZ4HeaderSize],
+                                          static_cast<int>(length), bound);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(kLZ4HeaderSize + outlen);
+  return true;
+#endif
+
+  return false;
+}
+
+inline bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#ifdef LZ4
+  if (length < kLZ4HeaderSize) {
+    return false;
+  }
+  size_t ulength = 0;
+  for (size_t i = 0; i < kLZ4HeaderSize; i++) {
+    ulength |= static_cast<size_t>(static_cast<unsigned char>(input[i])) << (8 * i);
+  }
+  if (ulength > LZ4_MAX_INPUT_SIZE) {
+    return false;
+  }
+  *result = ulength;
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline bool LZ4_Uncompress(const char* input, size_t length, char* output) {
+#ifdef LZ4
+  size_t ulength;
+  if (!LZ4_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  const int outlen = LZ4_decompress_safe(
+      input + kLZ4HeaderSize, output,
+      static_cast<int>(length - kLZ4HeaderSize), static_cast<int>(ulength));
+  return outlen >= 0 && static_cast<size_t>(outlen) == ulength;
+#else
+  return false;
+#endif
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   return false;
 }
 
+// Defined in port_posix_sse.cc.
+extern bool HasAcceleratedCRC32C(bool need_pclmul);
+extern uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size,
+                                  bool use_pclmul);
+
 } // namespace port
 } // namespace leveldb
 
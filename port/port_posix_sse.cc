@@ -0,0 +1,202 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A portable implementation of crc32c lives in util/crc32c.cc.  This file
+// uses the SSE4.2 crc32 instruction (and PCLMULQDQ to merge three
+// independent streams over large buffers) when the CPU supports them.
+// The instructions are enabled per function, so the rest of the library
+// still runs on CPUs without them; util/crc32c.cc checks
+// HasAcceleratedCRC32C() before calling in here.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(LEVELDB_PLATFORM_POSIX_SSE)
+#include <cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#include "port/port.h"
+
+namespace leveldb {
+namespace port {
+
+#if defined(LEVELDB_PLATFORM_POSIX_SSE)
+
+namespace {
+
+// Bit-reflected Castagnoli polynomial.  In the reflected representation
+// the most significant bit of a 32-bit word holds the coefficient of x^0.
+const uint32_t kPoly = 0x82f63b78u;
+
+// Stream lengths used by the three-way loop, longest first.  A buffer is
+// consumed 3*kStreamBytes[i] bytes at a time by the first length that
+// still fits; whatever is left goes through the single-stream loop.
+const size_t kStreamBytes[] = { 4096, 1024, 256 };
+const int kNumStreamSizes = sizeof(kStreamBytes) / sizeof(kStreamBytes[0]);
+
+OnceType init_once = LEVELDB_ONCE_INIT;
+bool have_sse42 = false;
+bool have_pclmul = false;
+
+// shift_constants[i][j] is x^(8*(j+1)*kStreamBytes[i] - 33) mod P.  See
+// ShiftAndReduce() for why 33 is subtracted.
+uint32_t shift_constants[kNumStreamSizes][2];
+
+// Return a*b mod P.
+uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kPoly : b >> 1;
+  }
+  return p;
+}
+
+// Return x^n mod P.
+uint32_t XPowModP(uint64_t n) {
+  uint32_t result = 1u << 31;   // x^0
+  uint32_t square = 1u << 30;   // x^1, x^2, x^4, ...
+  while (n != 0) {
+    if (n & 1) {
+      result = MultModP(result, square);
+    }
+    square = MultModP(square, square);
+    n >>= 1;
+  }
+  return result;
+}
+
+void InitCRC32C() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    have_sse42 = (ecx & bit_SSE4_2) != 0;
+    have_pclmul = have_sse42 && (ecx & bit_PCLMUL) != 0;
+  }
+  for (int i = 0; i < kNumStreamSizes; i++) {
+    shift_constants[i][0] = XPowModP(8 * kStreamBytes[i] - 33);
+    shift_constants[i][1] = XPowModP(16 * kStreamBytes[i] - 33);
+  }
+}
+
+inline uint64_t LoadUnaligned64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));   // Compiles to a single load on x86
+  return v;
+}
+
+// Carry-less multiply of two reflected 32-bit polynomials.  The 64-bit
+// product, read as a reflected 64-bit polynomial, equals x*crc*k, and
+// running it through the crc32 instruction multiplies by another x^32
+// and reduces mod P.  So x^(n-33) as "k" shifts "crc" by n bits.
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t CarrylessMultiply(uint32_t crc, uint32_t k) {
+  __m128i product = _mm_clmulepi64_si128(
+      _mm_cvtsi32_si128(static_cast<int>(crc)),
+      _mm_cvtsi32_si128(static_cast<int>(k)), 0);
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+}
+
+// Feed p[0,e-p-1] into the crc register "l" one stream at a time.
+__attribute__((target("sse4.2")))
+uint64_t ExtendSingleStream(uint64_t l, const uint8_t* p, const uint8_t* e) {
+  // Process bytes until p is 8-byte aligned
+  while (p != e && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+    l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+  }
+  // Process bytes 32 at a time, then 8 at a time
+  while ((e - p) >= 32) {
+    l = _mm_crc32_u64(l, LoadUnaligned64(p));
+    l = _mm_crc32_u64(l, LoadUnaligned64(p + 8));
+    l = _mm_crc32_u64(l, LoadUnaligned64(p + 16));
+    l = _mm_crc32_u64(l, LoadUnaligned64(p + 24));
+    p += 32;
+  }
+  while ((e - p) >= 8) {
+    l = _mm_crc32_u64(l, LoadUnaligned64(p));
+    p += 8;
+  }
+  // Process the last few bytes
+  while (p != e) {
+    l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+  }
+  return l;
+}
+
+// The crc32 instruction has a latency of three cycles but can issue one
+// per cycle, so a single dependency chain leaves two thirds of the unit
+// idle.  Split large buffers into three adjacent streams, checksum them
+// in an interleaved loop and stitch the results together:
+//   crc(A|B|C) = crc(A)*x^(16L) + crc(B)*x^(8L) + crc(C)  (mod P)
+__attribute__((target("sse4.2,pclmul")))
+uint64_t ExtendThreeStreams(uint64_t l, const uint8_t* p, const uint8_t* e) {
+  while (p != e && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+    l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+  }
+  for (int i = 0; i < kNumStreamSizes; i++) {
+    const size_t n = kStreamBytes[i];
+    while (static_cast<size_t>(e - p) >= 3 * n) {
+      const uint8_t* p1 = p + n;
+      const uint8_t* p2 = p1 + n;
+      uint64_t l1 = 0;
+      uint64_t l2 = 0;
+      for (size_t j = 0; j < n; j += 8) {
+        l = _mm_crc32_u64(l, LoadUnaligned64(p + j));
+        l1 = _mm_crc32_u64(l1, LoadUnaligned64(p1 + j));
+        l2 = _mm_crc32_u64(l2, LoadUnaligned64(p2 + j));
+      }
+      // The reduction is linear, so both products share one crc32.
+      const uint64_t merged =
+          CarrylessMultiply(static_cast<uint32_t>(l), shift_constants[i][1]) ^
+          CarrylessMultiply(static_cast<uint32_t>(l1), shift_constants[i][0]);
+      l = _mm_crc32_u64(0, merged) ^ l2;
+      p += 3 * n;
+    }
+  }
+  return ExtendSingleStream(l, p, e);
+}
+
+}  // namespace
+
+bool HasAcceleratedCRC32C(bool need_pclmul) {
+  InitOnce(&init_once, &InitCRC32C);
+  return need_pclmul ? have_pclmul : have_sse42;
+}
+
+uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size,
+                           bool use_pclmul) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+  const uint8_t* e = p + size;
+  uint64_t l = crc ^ 0xffffffffu;
+  if (use_pclmul) {
+    l = ExtendThreeStreams(l, p, e);
+  } else {
+    l = ExtendSingleStream(l, p, e);
+  }
+  return static_cast<uint32_t>(l) ^ 0xffffffffu;
+}
+
+#else  // !LEVELDB_PLATFORM_POSIX_SSE
+
+bool HasAcceleratedCRC32C(bool need_pclmul) {
+  return false;
+}
+
+uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size,
+                           bool use_pclmul) {
+  return 0;
+}
+
+#endif  // LEVELDB_PLATFORM_POSIX_SSE
+
+}  // namespace port
+}  // namespace leveldb
@@ -5,6 +5,7 @@
 #include "table/filter_block.h"
 
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -124,4 +125,67 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key)
   return true;  // Errors are treated as potential matches
 }
 
+FullFilterBlockBuilder::FullFilterBlockBuilder(const FilterPolicy* policy,
+                                               const SliceTransform* prefix_extractor)
+    : policy_(policy),
+      prefix_extractor_(prefix_extractor)
+{
+}
+
+void FullFilterBlockBuilder::AddKey(const Slice& key)
+{
+  start_.push_back(keys_.size());
+  keys_.append(key.data(), key.size());
+  if (prefix_extractor_ != NULL && prefix_extractor_->InDomain(key))
+  {
+    Slice prefix = prefix_extractor_->Transform(key);
+    if (prefix_start_.empty() ||
+        prefix != Slice(prefixes_.data() + prefix_start_.back(),
+                        prefixes_.size() - prefix_start_.back()))
+    {
+      prefix_start_.push_back(prefixes_.size());
+      prefixes_.append(prefix.data(), prefix.size());
+    }
+  }
+}
+
+Slice FullFilterBlockBuilder::Finish()
+{
+  const size_t num_keys = start_.size();
+  const size_t num_prefixes = prefix_start_.size();
+  std::vector<Slice> tmp_keys(num_keys + num_prefixes);
+  start_.push_back(keys_.size());  // Simplify length computation
+  for (size_t i = 0; i < num_keys; i++)
+  {
+    tmp_keys[i] = Slice(keys_.data() + start_[i], start_[i+1] - start_[i]);
+  }
+  prefix_start_.push_back(prefixes_.size());
+  for (size_t i = 0; i < num_prefixes; i++)
+  {
+    tmp_keys[num_keys + i] = Slice(prefixes_.data() + prefix_start_[i],
+                                   prefix_start_[i+1] - prefix_start_[i]);
+  }
+  // An empty table still gets a (non-matching) filter from the policy
+  result_.clear();
+  policy_->CreateFilter(tmp_keys.empty() ? NULL : &tmp_keys[0],
+                        static_cast<int>(tmp_keys.size()), &result_);
+  keys_.clear();
+  start_.clear();
+  prefixes_.clear();
+  prefix_start_.clear();
+  return Slice(result_);
+}
+
+FullFilterBlockReader::FullFilterBlockReader(const FilterPolicy* policy,
+                                             const Slice& contents)
+    : policy_(policy),
+      contents_(contents)
+{
+}
+
+bool FullFilterBlockReader::KeyMayMatch(const Slice& key) const
+{
+  return policy_->KeyMayMatch(key, contents_);
+}
+
 }
@@ -19,6 +19,7 @@
 namespace leveldb {
 
 class FilterPolicy;
+class SliceTransform;
 
 // A FilterBlockBuilder is used to construct all of the filters for a
 // particular Table.  It generates a single string which is stored as
@@ -65,6 +66,52 @@ class FilterBlockReader
   size_t base_lg_;      // Encoding parameter (see kFilterBaseLg in .cc file)
 };
 
+// A FullFilterBlockBuilder builds a single filter over every key in a
+// Table, so a lookup can consult it before searching the index block.
+// All keys are held in memory until Finish().
+//
+// The sequence of calls to FullFilterBlockBuilder must match the regexp:
+//      (AddKey* Finish)*
+// where each Finish() returns a filter over the keys added since the
+// previous one, so a builder can produce a series of filter partitions.
+//
+// With a non-NULL prefix extractor, the filter also holds the prefix of
+// every key in its domain.
+class FullFilterBlockBuilder
+{
+ public:
+  explicit FullFilterBlockBuilder(const FilterPolicy*,
+                                  const SliceTransform* prefix_extractor = NULL);
+
+  void AddKey(const Slice& key);
+  Slice Finish();
+
+ private:
+  const FilterPolicy* policy_;
+  const SliceTransform* prefix_extractor_;  // May be NULL
+  std::string keys_;              // Flattened key contents
+  std::vector<size_t> start_;     // Starting index in keys_ of each key
+  std::string prefixes_;          // Flattened prefixes, kept apart from keys_
+  std::vector<size_t> prefix_start_;  // so that equal ones stay adjacent
+  std::string result_;            // Filter data computed by Finish()
+
+  // No copying allowed
+  FullFilterBlockBuilder(const FullFilterBlockBuilder&);
+  void operator=(const FullFilterBlockBuilder&);
+};
+
+class FullFilterBlockReader
+{
+ public:
+  // REQUIRES: "contents" and *policy must stay live while *this is live.
+  FullFilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+  bool KeyMayMatch(const Slice& key) const;
+
+ private:
+  const FilterPolicy* policy_;
+  Slice contents_;
+};
+
 }
 
 #endif  // STORAGE_LEVELDB_TABLE_FILTER_BLOCK_H_
@@ -4,7 +4,9 @@
 
 #include "table/filter_block.h"
 
+#include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -121,6 +123,121 @@ TEST(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(! reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST(FilterBlockTest, FullFilter) {
+  FullFilterBlockBuilder builder(&policy_);
+  builder.AddKey("foo");
+  builder.AddKey("bar");
+  builder.AddKey("box");
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+  FullFilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.KeyMayMatch("foo"));
+  ASSERT_TRUE(reader.KeyMayMatch("bar"));
+  ASSERT_TRUE(reader.KeyMayMatch("box"));
+  ASSERT_TRUE(reader.KeyMayMatch("hello"));
+  ASSERT_TRUE(! reader.KeyMayMatch("missing"));
+  ASSERT_TRUE(! reader.KeyMayMatch("other"));
+}
+
+TEST(FilterBlockTest, EmptyFullFilter) {
+  FullFilterBlockBuilder builder(&policy_);
+  Slice block = builder.Finish();
+  FullFilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(! reader.KeyMayMatch("foo"));
+}
+
+TEST(FilterBlockTest, FullFilterWithPrefixes) {
+  const SliceTransform* prefix = NewFixedPrefixTransform(3);
+  FullFilterBlockBuilder builder(&policy_, prefix);
+  builder.AddKey("foo1");
+  builder.AddKey("foo2");
+  builder.AddKey("hello");
+  builder.AddKey("x");
+  Slice block = builder.Finish();
+  FullFilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.KeyMayMatch("foo1"));
+  ASSERT_TRUE(reader.KeyMayMatch("foo"));
+  ASSERT_TRUE(reader.KeyMayMatch("hel"));
+  ASSERT_TRUE(reader.KeyMayMatch("x"));
+  ASSERT_TRUE(! reader.KeyMayMatch("bar"));
+  ASSERT_TRUE(! reader.KeyMayMatch("foo3"));
+  delete prefix;
+}
+
+// Build a filter block for a table of 4KB blocks with each built-in
+// policy and report its size, false positive rate and lookup cost.
+static void CheckBuiltinPolicy(const char* label, const FilterPolicy* policy) {
+  const int kBlocks = 2000;
+  const int kKeysPerBlock = 100;
+  const uint64_t kBlockSize = 4096;
+  char buffer[sizeof(uint32_t)];
+
+  FilterBlockBuilder builder(policy);
+  for (int b = 0; b < kBlocks; b++) {
+    builder.StartBlock(b * kBlockSize);
+    for (int i = 0; i < kKeysPerBlock; i++) {
+      EncodeFixed32(buffer, b * kKeysPerBlock + i);
+      builder.AddKey(Slice(buffer, sizeof(buffer)));
+    }
+  }
+  Slice block = builder.Finish();
+  FilterBlockReader reader(policy, block);
+
+  // No false negatives
+  for (int b = 0; b < kBlocks; b++) {
+    for (int i = 0; i < kKeysPerBlock; i++) {
+      EncodeFixed32(buffer, b * kKeysPerBlock + i);
+      ASSERT_TRUE(reader.KeyMayMatch(b * kBlockSize,
+                                     Slice(buffer, sizeof(buffer))));
+    }
+  }
+
+  const int kProbes = kBlocks * kKeysPerBlock;
+  int matches = 0;
+  const uint64_t start = Env::Default()->NowMicros();
+  for (int i = 0; i < kProbes; i++) {
+    EncodeFixed32(buffer, kProbes + i);
+    const uint64_t offset = ((i * 2654435761u) % kBlocks) * kBlockSize;
+    if (reader.KeyMayMatch(offset, Slice(buffer, sizeof(buffer)))) {
+      matches++;
+    }
+  }
+  const uint64_t micros = Env::Default()->NowMicros() - start;
+  fprintf(stderr, "%-18s %7d bytes ; FP %5.2f%% ; %6.1f ns/probe\n",
+          label, static_cast<int>(block.size()), matches * 100.0 / kProbes,
+          micros * 1000.0 / kProbes);
+  ASSERT_LE(matches, kProbes / 50);
+
+  // The same keys in a single full-table filter
+  FullFilterBlockBuilder full_builder(policy);
+  for (int i = 0; i < kProbes; i++) {
+    EncodeFixed32(buffer, i);
+    full_builder.AddKey(Slice(buffer, sizeof(buffer)));
+  }
+  Slice full_block = full_builder.Finish();
+  FullFilterBlockReader full_reader(policy, full_block);
+  matches = 0;
+  const uint64_t full_start = Env::Default()->NowMicros();
+  for (int i = 0; i < kProbes; i++) {
+    EncodeFixed32(buffer, kProbes + i);
+    if (full_reader.KeyMayMatch(Slice(buffer, sizeof(buffer)))) {
+      matches++;
+    }
+  }
+  const uint64_t full_micros = Env::Default()->NowMicros() - full_start;
+  fprintf(stderr, "%-18s %7d bytes ; FP %5.2f%% ; %6.1f ns/probe (full)\n",
+          label, static_cast<int>(full_block.size()),
+          matches * 100.0 / kProbes, full_micros * 1000.0 / kProbes);
+  ASSERT_LE(matches, kProbes / 50);
+  delete policy;
+}
+
+TEST(FilterBlockTest, BuiltinPolicies) {
+  CheckBuiltinPolicy("bloom", NewBloomFilterPolicy(10));
+  CheckBuiltinPolicy("cache-local bloom", NewCacheLocalBloomFilterPolicy(10));
+  CheckBuiltinPolicy("ribbon", NewRibbonFilterPolicy(10));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -4,6 +4,7 @@
 
 #include "table/format.h"
 
+#include <string.h>
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -71,7 +72,44 @@ Status Footer::DecodeFrom(Slice* input)
   return result;
 }
 
-Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const BlockHandle& handle, BlockContents* result) 
+// Dispatch on the block type stored in the trailer.  Unknown types and
+// codecs this build was compiled without both report failure.
+static bool GetUncompressedLength(char type, const char* input, size_t length, size_t* result)
+{
+  switch (type)
+  {
+    case kSnappyCompression:
+      return port::Snappy_GetUncompressedLength(input, length, result);
+    case kZstdCompression:
+      return port::Zstd_GetUncompressedLength(input, length, result);
+    case kLZ4Compression:
+      return port::LZ4_GetUncompressedLength(input, length, result);
+    default:
+      return false;
+  }
+}
+
+static bool Uncompress(char type, const port::ZstdDictionary* dict, const char* input, size_t length, char* output)
+{
+  switch (type)
+  {
+    case kSnappyCompression:
+      return port::Snappy_Uncompress(input, length, output);
+    case kZstdCompression:
+      if (dict != NULL)
+      {
+        return dict->Uncompress(input, length, output);
+      }
+      return port::Zstd_Uncompress(input, length, output);
+    case kLZ4Compression:
+      return port::LZ4_Uncompress(input, length, output);
+    default:
+      return false;
+  }
+}
+
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const BlockHandle& handle, const port::ZstdDictionary* dict, BlockContents* result,
+                 std::string* raw) 
 {
   result->data = Slice();
   result->cachable = false;
@@ -107,6 +145,10 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const Block
       return s;
     }
   }
+  if (raw != NULL)
+  {
+    raw->assign(data, n + kBlockTrailerSize);
+  }
 
   switch (data[n]) 
   {
@@ -130,15 +172,17 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const Block
       // Ok
       break;
     case kSnappyCompression: 
+    case kZstdCompression:
+    case kLZ4Compression:
 	{
       size_t ulength = 0;
-      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) 
+      if (!GetUncompressedLength(data[n], data, n, &ulength)) 
 	  {
         delete[] buf;
         return Status::Corruption("corrupted compressed block contents");
       }
       char* ubuf = new char[ulength];
-      if (!port::Snappy_Uncompress(data, n, ubuf))
+      if (!Uncompress(data[n], dict, data, n, ubuf))
 	  {
         delete[] buf;
         delete[] ubuf;
@@ -158,4 +202,54 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const Block
   return Status::OK();
 }
 
+Status DecodeBlock(const Slice& raw, const BlockHandle& handle, const port::ZstdDictionary* dict, BlockContents* result)
+{
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+
+  const size_t n = static_cast<size_t>(handle.size());
+  if (raw.size() != n + kBlockTrailerSize)
+  {
+    return Status::Corruption("truncated block");
+  }
+  const char* data = raw.data();
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+  if (crc32c::Value(data, n + 1) != crc)
+  {
+    return Status::Corruption("block checksum mismatch");
+  }
+
+  char* ubuf = NULL;
+  size_t ulength = 0;
+  switch (data[n])
+  {
+    case kNoCompression:
+      ubuf = new char[n];
+      memcpy(ubuf, data, n);
+      ulength = n;
+      break;
+    case kSnappyCompression:
+    case kZstdCompression:
+    case kLZ4Compression:
+      if (!GetUncompressedLength(data[n], data, n, &ulength))
+      {
+        return Status::Corruption("corrupted compressed block contents");
+      }
+      ubuf = new char[ulength];
+      if (!Uncompress(data[n], dict, data, n, ubuf))
+      {
+        delete[] ubuf;
+        return Status::Corruption("corrupted compressed block contents");
+      }
+      break;
+    default:
+      return Status::Corruption("bad block type");
+  }
+  result->data = Slice(ubuf, ulength);
+  result->heap_allocated = true;
+  result->cachable = true;
+  return Status::OK();
+}
+
 }  // namespace leveldb
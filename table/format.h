@@ -17,6 +17,10 @@ class Block;
 class RandomAccessFile;
 struct ReadOptions;
 
+namespace port {
+class ZstdDictionary;
+}
+
 // BlockHandle is a pointer to the extent of a file that stores a data
 // block or a meta block.
 // blockhandleȷblocksstableеoffsetԼsizeԶȡblock
@@ -95,6 +99,22 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Metaindex key of the block holding a table's zstd dictionary.
+static const char kZstdDictionaryBlockName[] = "zstd.dictionary";
+
+// Metaindex keys marking a table whose footer points at a top-level
+// index over index partitions, and whose top-level index entries also
+// carry the handle of a filter partition built by the named policy.
+static const char kPartitionedIndexBlockName[] = "partitioned.index";
+static const char kPartitionedFilterBlockPrefix[] = "partitioned.filter.";
+
+// Metaindex key, followed by the name of a SliceTransform, marking a
+// table whose full filter also holds the prefixes of its keys.
+static const char kPrefixFilterPrefix[] = "prefix.";
+
+// Metaindex key of the block holding a table's range tombstones.
+static const char kRangeDeletionBlockName[] = "range.deletions";
+
 struct BlockContents
 {
   Slice data;           // Actual contents of data
@@ -103,8 +123,16 @@ struct BlockContents
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
-extern Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const BlockHandle& handle, BlockContents* result);
+// return non-OK.  On success fill *result and return OK.  zstd blocks
+// are uncompressed with "dict" if it is non-NULL.  If "raw" is non-NULL
+// it is also set to the block as stored, followed by its trailer.
+extern Status ReadBlock(RandomAccessFile* file, const ReadOptions& options, const BlockHandle& handle, const port::ZstdDictionary* dict, BlockContents* result,
+                        std::string* raw = NULL);
+
+// Like ReadBlock(), but for a copy "raw" of the stored block and its
+// trailer that was obtained elsewhere.  Always verifies the checksum.
+// The result is always heap allocated and cachable.
+extern Status DecodeBlock(const Slice& raw, const BlockHandle& handle, const port::ZstdDictionary* dict, BlockContents* result);
 
 // Implementation details follow.  Clients should ignore,
 
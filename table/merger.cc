@@ -4,6 +4,8 @@
 
 #include "table/merger.h"
 
+#include <string>
+#include <vector>
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
 #include "table/iterator_wrapper.h"
@@ -11,55 +13,83 @@
 namespace leveldb {
 
 namespace {
+// The children that still have entries in the current direction are kept
+// in a binary heap ordered by their current keys, so that a step only
+// compares O(log n) keys however many tables overlap.  Ties go to the
+// child that comes first in the forward direction and last in the
+// reverse one, as if the children were scanned in order.
 class MergingIterator : public Iterator {
  public:
-  MergingIterator(const Comparator* comparator, Iterator** children, int n)
+  MergingIterator(const Comparator* comparator, Iterator** children, int n,
+                  const Slice* lower_bounds)
       : comparator_(comparator),
         children_(new IteratorWrapper[n]),
         n_(n),
-        current_(NULL),
-        direction_(kForward) 
+        lower_bounds_(n),
+        deferred_(n, false),
+        deferred_to_first_(false),
+        keys_(n),
+        direction_(kForward)
   {
-    for (int i = 0; i < n; i++) 
+    for (int i = 0; i < n; i++)
 	{
       children_[i].Set(children[i]);
+      if (lower_bounds != NULL)
+      {
+        lower_bounds_[i] = lower_bounds[i];
+      }
     }
+    heap_.reserve(n);
   }
 
-  virtual ~MergingIterator() 
+  virtual ~MergingIterator()
   {
     delete[] children_;
   }
 
-  virtual bool Valid() const 
+  virtual bool Valid() const
   {
-    return (current_ != NULL);
+    return !heap_.empty();
   }
 
-  virtual void SeekToFirst() 
+  virtual void SeekToFirst()
   {
-    for (int i = 0; i < n_; i++) 
+    deferred_target_.clear();
+    deferred_to_first_ = true;
+    for (int i = 0; i < n_; i++)
 	{
-      children_[i].SeekToFirst();
+      deferred_[i] = !lower_bounds_[i].empty();
+      if (!deferred_[i])
+      {
+        children_[i].SeekToFirst();
+      }
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildHeap();
+    PositionDeferredTop();
   }
 
   virtual void SeekToLast() {
     for (int i = 0; i < n_; i++) {
+      deferred_[i] = false;
       children_[i].SeekToLast();
     }
-    FindLargest();
     direction_ = kReverse;
+    BuildHeap();
   }
 
   virtual void Seek(const Slice& target) {
+    deferred_target_.assign(target.data(), target.size());
+    deferred_to_first_ = false;
     for (int i = 0; i < n_; i++) {
-      children_[i].Seek(target);
+      deferred_[i] = AfterTarget(i, target);
+      if (!deferred_[i]) {
+        children_[i].Seek(target);
+      }
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildHeap();
+    PositionDeferredTop();
   }
 
   virtual void Next() {
@@ -67,25 +97,33 @@ class MergingIterator : public Iterator {
 
     // Ensure that all children are positioned after key().
     // If we are moving in the forward direction, it is already
-    // true for all of the non-current_ children since current_ is
-    // the smallest child and key() == current_->key().  Otherwise,
-    // we explicitly position the non-current_ children.
+    // true for all of the non-current children since the current
+    // child is the smallest and key() == its key.  Otherwise,
+    // we explicitly position the non-current children.
     if (direction_ != kForward) {
+      const int current = heap_[0];
+      deferred_target_.assign(key().data(), key().size());
+      deferred_to_first_ = false;
       for (int i = 0; i < n_; i++) {
         IteratorWrapper* child = &children_[i];
-        if (child != current_) {
-          child->Seek(key());
+        // A child whose bound is after key() has no entry equal to it
+        deferred_[i] = (i != current && AfterTarget(i, deferred_target_));
+        if (i != current && !deferred_[i]) {
+          child->Seek(deferred_target_);
           if (child->Valid() &&
-              comparator_->Compare(key(), child->key()) == 0) {
+              comparator_->Compare(deferred_target_, child->key()) == 0) {
             child->Next();
           }
         }
       }
       direction_ = kForward;
+      BuildHeap();
+      assert(heap_[0] == current);
     }
 
-    current_->Next();
-    FindSmallest();
+    children_[heap_[0]].Next();
+    ReplaceTop();
+    PositionDeferredTop();
   }
 
   virtual void Prev() {
@@ -93,38 +131,44 @@ class MergingIterator : public Iterator {
 
     // Ensure that all children are positioned before key().
     // If we are moving in the reverse direction, it is already
-    // true for all of the non-current_ children since current_ is
-    // the largest child and key() == current_->key().  Otherwise,
-    // we explicitly position the non-current_ children.
+    // true for all of the non-current children since the current
+    // child is the largest and key() == its key.  Otherwise,
+    // we explicitly position the non-current children.
     if (direction_ != kReverse) {
+      const int current = heap_[0];
       for (int i = 0; i < n_; i++) {
         IteratorWrapper* child = &children_[i];
-        if (child != current_) {
-          child->Seek(key());
-          if (child->Valid()) {
-            // Child is at first entry >= key().  Step back one to be < key()
-            child->Prev();
-          } else {
-            // Child has no entries >= key().  Position at last entry.
-            child->SeekToLast();
-          }
+        if (i == current || deferred_[i]) {
+          // A deferred child has nothing before its bound, which is not
+          // before key(), so it stays out of the heap untouched
+          continue;
+        }
+        child->Seek(key());
+        if (child->Valid()) {
+          // Child is at first entry >= key().  Step back one to be < key()
+          child->Prev();
+        } else {
+          // Child has no entries >= key().  Position at last entry.
+          child->SeekToLast();
         }
       }
       direction_ = kReverse;
+      BuildHeap();
+      assert(heap_[0] == current);
     }
 
-    current_->Prev();
-    FindLargest();
+    children_[heap_[0]].Prev();
+    ReplaceTop();
   }
 
   virtual Slice key() const {
     assert(Valid());
-    return current_->key();
+    return keys_[heap_[0]];
   }
 
   virtual Slice value() const {
     assert(Valid());
-    return current_->value();
+    return children_[heap_[0]].value();
   }
 
   virtual Status status() const {
@@ -139,16 +183,54 @@ class MergingIterator : public Iterator {
   }
 
  private:
-  void FindSmallest();
-  void FindLargest();
+  // Whether child i can be left unpositioned by a forward seek to "target"
+  bool AfterTarget(int i, const Slice& target) const {
+    return !lower_bounds_[i].empty() &&
+           comparator_->Compare(lower_bounds_[i], target) > 0;
+  }
+
+  // Carry out the forward seek that child i was left out of
+  void PositionDeferred(int i) {
+    deferred_[i] = false;
+    if (deferred_to_first_) {
+      children_[i].SeekToFirst();
+    } else {
+      children_[i].Seek(deferred_target_);
+    }
+  }
+
+  // Whether child a comes before child b in the current direction
+  bool Before(int a, int b) const {
+    const int r = comparator_->Compare(keys_[a], keys_[b]);
+    if (direction_ == kForward) {
+      return r < 0 || (r == 0 && a < b);
+    } else {
+      return r > 0 || (r == 0 && a > b);
+    }
+  }
+
+  void BuildHeap();
+  void SiftDown(size_t pos);
+  void ReplaceTop();
+  void PositionDeferredTop();
 
-  // We might want to use a heap in case there are lots of children.
-  // For now we use a simple array since we expect a very small number
-  // of children in leveldb.
   const Comparator* comparator_;
   IteratorWrapper* children_;
   int n_;
-  IteratorWrapper* current_;
+  std::vector<Slice> lower_bounds_;   // Empty if unknown
+  // While moving forward, deferred_[i] means children_[i] still has to
+  // be positioned by the last seek: to deferred_target_, or to its first
+  // entry if deferred_to_first_.  Until then it stands in the heap at
+  // lower_bounds_[i].  While moving backward, a deferred child has no
+  // entries left and is not in the heap.
+  std::vector<bool> deferred_;
+  std::string deferred_target_;
+  bool deferred_to_first_;
+  // keys_[i] is the key children_[i] stands at in the heap, kept here so
+  // that the heap compares keys held next to each other
+  std::vector<Slice> keys_;
+  // Indexes of the children in the heap; heap_[0] is the current child
+  std::vector<int> heap_;
 
   // Which direction is the iterator moving?
   enum Direction {
@@ -158,51 +240,85 @@ class MergingIterator : public Iterator {
   Direction direction_;
 };
 
-void MergingIterator::FindSmallest() {
-  IteratorWrapper* smallest = NULL;
+void MergingIterator::BuildHeap() {
+  heap_.clear();
   for (int i = 0; i < n_; i++) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (smallest == NULL) {
-        smallest = child;
-      } else if (comparator_->Compare(child->key(), smallest->key()) < 0) {
-        smallest = child;
+    if (deferred_[i]) {
+      if (direction_ == kForward) {
+        keys_[i] = lower_bounds_[i];
+        heap_.push_back(i);
       }
+    } else if (children_[i].Valid()) {
+      keys_[i] = children_[i].key();
+      heap_.push_back(i);
     }
   }
-  current_ = smallest;
+  for (size_t i = heap_.size() / 2; i > 0; i--) {
+    SiftDown(i - 1);
+  }
 }
 
-void MergingIterator::FindLargest() {
-  IteratorWrapper* largest = NULL;
-  for (int i = n_-1; i >= 0; i--) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (largest == NULL) {
-        largest = child;
-      } else if (comparator_->Compare(child->key(), largest->key()) > 0) {
-        largest = child;
-      }
+void MergingIterator::SiftDown(size_t pos) {
+  const int child = heap_[pos];
+  const size_t size = heap_.size();
+  while (true) {
+    size_t next = 2 * pos + 1;
+    if (next >= size) {
+      break;
+    }
+    if (next + 1 < size && Before(heap_[next + 1], heap_[next])) {
+      next++;
     }
+    if (!Before(heap_[next], child)) {
+      break;
+    }
+    heap_[pos] = heap_[next];
+    pos = next;
+  }
+  heap_[pos] = child;
+}
+
+// Update the heap after the current child has moved
+void MergingIterator::ReplaceTop() {
+  const int top = heap_[0];
+  if (children_[top].Valid()) {
+    keys_[top] = children_[top].key();
+  } else {
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+    if (heap_.empty()) {
+      return;
+    }
+  }
+  SiftDown(0);
+}
+
+// Position deferred children until a positioned one is current.  The
+// entries of a deferred child are not before its bound, so it only moves
+// down the heap.
+void MergingIterator::PositionDeferredTop() {
+  while (!heap_.empty() && deferred_[heap_[0]]) {
+    PositionDeferred(heap_[0]);
+    ReplaceTop();
   }
-  current_ = largest;
 }
 }  // namespace
 
-Iterator* NewMergingIterator(const Comparator* cmp, Iterator** list, int n)
+Iterator* NewMergingIterator(const Comparator* cmp, Iterator** list, int n,
+                             const Slice* lower_bounds)
 {
   assert(n >= 0);
-  if (n == 0) 
+  if (n == 0)
   {
     return NewEmptyIterator();
-  } 
-  else if (n == 1) 
+  }
+  else if (n == 1)
   {
     return list[0];
   }
   else
   {
-    return new MergingIterator(cmp, list, n);
+    return new MergingIterator(cmp, list, n, lower_bounds);
   }
 }
 
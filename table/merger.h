@@ -5,10 +5,13 @@
 #ifndef STORAGE_LEVELDB_TABLE_MERGER_H_
 #define STORAGE_LEVELDB_TABLE_MERGER_H_
 
+#include <stddef.h>
+
 namespace leveldb {
 
 class Comparator;
 class Iterator;
+class Slice;
 
 // Return an iterator that provided the union of the data in
 // children[0,n-1].  Takes ownership of the child iterators and
@@ -17,8 +20,16 @@ class Iterator;
 // The result does no duplicate suppression.  I.e., if a particular
 // key is present in K child iterators, it will be yielded K times.
 //
+// If "lower_bounds" is non-NULL, lower_bounds[i] is either empty or a key
+// that no key of children[i] is before.  A forward seek then leaves a
+// child whose bound is after the target unpositioned until the merged
+// iterator reaches the bound, so that the child is never read if the
+// caller stops before it.  The bounds must remain live while the result
+// is in use.
+//
 // REQUIRES: n >= 0
-extern Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children, int n);
+extern Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children, int n,
+                                    const Slice* lower_bounds = NULL);
 
 }  // namespace leveldb
 
@@ -9,11 +9,15 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/secondary_cache.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
@@ -22,8 +26,22 @@ struct Table::Rep
   ~Rep() 
   {
     delete filter;
+    delete full_filter;
     delete [] filter_data;
-    delete index_block;
+    if (pinned_filter != NULL)
+    {
+      options.block_cache->Release(pinned_filter);
+    }
+    if (pinned_index != NULL)
+    {
+      options.block_cache->Release(pinned_index);
+    }
+    else
+    {
+      delete index_block;
+    }
+    delete zstd_dict;
+    delete range_del_block;
   }
 
   Options options;				
@@ -31,11 +49,216 @@ struct Table::Rep
   RandomAccessFile* file;		//随机读取文件
   uint64_t cache_id;
   FilterBlockReader* filter;
+  FullFilterBlockReader* full_filter;  // Set instead of filter for full-table filters
   const char* filter_data;
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
-  Block* index_block;
+  Block* index_block;             // Top-level index if partitioned_index
+  bool partitioned_index;
+  bool partitioned_filter;        // Top-level index values also hold a filter partition handle
+  bool prefix_filter;             // The full filter also holds the prefixes of options.prefix_extractor
+  port::ZstdDictionary* zstd_dict;  // For data blocks; NULL if the table has none
+  SecondaryCache* secondary_cache;  // May be NULL
+  uint64_t file_number;             // Names the table in secondary_cache
+  Statistics* statistics;           // May be NULL
+  Block* range_del_block;           // NULL if the table has no range tombstones
+
+  // With options.cache_index_and_filter_blocks the index block and the
+  // filter live in block_cache, keyed by their offsets like data blocks,
+  // and index_block, filter and full_filter stay NULL.  A pinned table
+  // holds cache handles for them instead and points those fields into
+  // the cached values.
+  std::string cached_index_handle;  // Encoded BlockHandle; empty unless cached
+  BlockHandle cached_filter_handle;
+  enum { kNoCachedFilter, kCachedFilterBlock, kCachedFullFilter } cached_filter;
+  Cache::Handle* pinned_index;
+  Cache::Handle* pinned_filter;
 };
 
+// A filter block or filter partition held in the block cache
+struct CachedFilter
+{
+  BlockContents contents;
+  ~CachedFilter()
+  {
+    if (contents.heap_allocated)
+    {
+      delete[] contents.data.data();
+    }
+  }
+};
+
+static void DeleteBlock(void* arg, void* ignored) 
+{
+  delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value) 
+{
+  Block* block = reinterpret_cast<Block*>(value);
+  delete block;
+}
+
+static void ReleaseBlock(void* arg, void* h) 
+{
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+  cache->Release(handle);
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value)
+{
+  delete reinterpret_cast<CachedFilter*>(value);
+}
+
+// ReadBlock() that first looks for the stored block in secondary_cache
+// (which may be NULL), and offers it to secondary_cache after reading it
+// from "file" if options.fill_cache.
+static Status ReadBlockFromTiers(RandomAccessFile* file, SecondaryCache* secondary_cache, uint64_t file_number,
+                                 const ReadOptions& options, const BlockHandle& handle,
+                                 const port::ZstdDictionary* dict, BlockContents* contents)
+{
+  if (secondary_cache == NULL)
+  {
+    return ReadBlock(file, options, handle, dict, contents);
+  }
+  char key_buffer[16];
+  EncodeFixed64(key_buffer, file_number);
+  EncodeFixed64(key_buffer + 8, handle.offset());
+  Slice key(key_buffer, sizeof(key_buffer));
+  std::string raw;
+  if (secondary_cache->Lookup(key, &raw) && DecodeBlock(raw, handle, dict, contents).ok())
+  {
+    return Status::OK();
+  }
+  Status s = ReadBlock(file, options, handle, dict, contents, &raw);
+  if (s.ok() && options.fill_cache)
+  {
+    secondary_cache->Insert(key, raw);
+  }
+  return s;
+}
+
+static void RecordTick(Statistics* statistics, Statistics::Ticker ticker)
+{
+  if (statistics != NULL)
+  {
+    statistics->Record(ticker);
+  }
+}
+
+// Find the block at "handle" in block_cache (which may be NULL), reading
+// it on a miss and inserting it if options.fill_cache.  Index blocks and
+// partitions (!data_block) are inserted with high priority, and counted
+// apart from data blocks in statistics (which may be NULL).
+// On success sets *block, and *cache_handle to the handle to release, or
+// to NULL if the caller owns *block.
+static Status ReadCachedBlock(RandomAccessFile* file, SecondaryCache* secondary_cache, uint64_t file_number,
+                              Cache* block_cache, uint64_t cache_id, Statistics* statistics,
+                              const port::ZstdDictionary* dict, bool data_block,
+                              const ReadOptions& options, const BlockHandle& handle,
+                              Block** block, Cache::Handle** cache_handle)
+{
+  Status s;
+  BlockContents contents;
+  *block = NULL;
+  *cache_handle = NULL;
+  if(block_cache != NULL) 
+  {
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, cache_id);
+    EncodeFixed64(cache_key_buffer + 8, handle.offset());
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    //block的缓存(LRUCache)在查找
+    *cache_handle = block_cache->Lookup(key);
+    if (*cache_handle != NULL)
+    {
+      RecordTick(statistics, data_block ? Statistics::kBlockCacheDataHits : Statistics::kBlockCacheIndexHits);
+      *block = reinterpret_cast<Block*>(block_cache->Value(*cache_handle));
+    }
+    else
+    {
+      RecordTick(statistics, data_block ? Statistics::kBlockCacheDataMisses : Statistics::kBlockCacheIndexMisses);
+      /*
+        读取block的内容
+      */
+      s = ReadBlockFromTiers(file, secondary_cache, file_number, options, handle, dict, &contents);
+      if (s.ok())
+      {
+        *block = new Block(contents);
+        if (contents.cachable && options.fill_cache)
+        {
+          *cache_handle = block_cache->Insert(key, *block, (*block)->size(), &DeleteCachedBlock,
+                                              data_block ? Cache::kLowPriority : Cache::kHighPriority);
+        }
+      }
+    }
+  } 
+  else
+  {
+    s = ReadBlockFromTiers(file, secondary_cache, file_number, options, handle, dict, &contents);
+    if (s.ok()) 
+    {
+      *block = new Block(contents);
+    }
+  }
+  return s;
+}
+
+// Like ReadCachedBlock() for a filter block or filter partition, which
+// is cached with high priority.
+// Returns NULL on a read error; otherwise the caller must pass the
+// result to ReleaseCachedFilter().
+static CachedFilter* ReadCachedFilter(RandomAccessFile* file, Cache* block_cache, uint64_t cache_id,
+                                      Statistics* statistics,
+                                      const ReadOptions& options, const BlockHandle& handle,
+                                      Cache::Handle** cache_handle)
+{
+  CachedFilter* filter = NULL;
+  *cache_handle = NULL;
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, cache_id);
+  EncodeFixed64(cache_key_buffer + 8, handle.offset());
+  Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (block_cache != NULL)
+  {
+    *cache_handle = block_cache->Lookup(cache_key);
+    RecordTick(statistics, *cache_handle != NULL ? Statistics::kBlockCacheFilterHits
+                                                 : Statistics::kBlockCacheFilterMisses);
+  }
+  if (*cache_handle != NULL)
+  {
+    filter = reinterpret_cast<CachedFilter*>(block_cache->Value(*cache_handle));
+  }
+  else
+  {
+    filter = new CachedFilter;
+    if (!ReadBlock(file, options, handle, NULL, &filter->contents).ok())
+    {
+      filter->contents.heap_allocated = false;
+      delete filter;
+      filter = NULL;
+    }
+    else if (block_cache != NULL && filter->contents.cachable && options.fill_cache)
+    {
+      *cache_handle = block_cache->Insert(cache_key, filter, filter->contents.data.size(),
+                                          &DeleteCachedFilter, Cache::kHighPriority);
+    }
+  }
+  return filter;
+}
+
+static void ReleaseCachedFilter(Cache* block_cache, CachedFilter* filter, Cache::Handle* cache_handle)
+{
+  if (cache_handle != NULL)
+  {
+    block_cache->Release(cache_handle);
+  }
+  else
+  {
+    delete filter;
+  }
+}
+
 Status Table::Open(const Options& options, RandomAccessFile* file, uint64_t size,Table** table) 
 {
   *table = NULL;
@@ -71,7 +294,7 @@ Status Table::Open(const Options& options, RandomAccessFile* file, uint64_t size
       opt.verify_checksums = true;
     }
 	//根据index_block的BlockHandle,读取index_block
-    s = ReadBlock(file, opt, footer.index_handle(), &contents);
+    s = ReadBlock(file, opt, footer.index_handle(), NULL, &contents);
     if (s.ok()) 
 	{
       index_block = new Block(contents);
@@ -91,9 +314,39 @@ Status Table::Open(const Options& options, RandomAccessFile* file, uint64_t size
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = NULL;
     rep->filter = NULL;
+    rep->full_filter = NULL;
+    rep->partitioned_index = false;
+    rep->partitioned_filter = false;
+    rep->prefix_filter = false;
+    rep->zstd_dict = NULL;
+    rep->cached_filter = Rep::kNoCachedFilter;
+    rep->pinned_index = NULL;
+    rep->secondary_cache = NULL;
+    rep->file_number = 0;
+    rep->statistics = NULL;
+    rep->range_del_block = NULL;
+    rep->pinned_filter = NULL;
+    if (options.cache_index_and_filter_blocks && options.block_cache != NULL && contents.cachable)
+    {
+      // The block cache owns the index block from here on, and reads
+      // it again after it is evicted
+      footer.index_handle().EncodeTo(&rep->cached_index_handle);
+      char cache_key_buffer[16];
+      EncodeFixed64(cache_key_buffer, rep->cache_id);
+      EncodeFixed64(cache_key_buffer + 8, footer.index_handle().offset());
+      Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+      options.block_cache->Release(options.block_cache->Insert(cache_key, index_block, index_block->size(),
+                                                               &DeleteCachedBlock, Cache::kHighPriority));
+      rep->index_block = NULL;
+    }
 	//封装成Table
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok())
+    {
+      delete *table;
+      *table = NULL;
+    }
   } 
   else
   {
@@ -106,41 +359,143 @@ Status Table::Open(const Options& options, RandomAccessFile* file, uint64_t size
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer)
+Status Table::ReadMeta(const Footer& footer)
 {
-  if (rep_->options.filter_policy == NULL)
+  // An empty metaindex block is just its single restart point and the
+  // restart count.  Without a filter policy the only meta block we could
+  // use is a zstd dictionary, so skip the read when there cannot be one.
+  if (rep_->options.filter_policy == NULL && footer.metaindex_handle().size() <= 2 * sizeof(uint32_t))
   {
-    return;  // Do not need any metadata
+    return Status::OK();  // Do not need any metadata
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) 
   {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) 
+  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), NULL, &contents).ok()) 
   {
     // Do not propagate errors since meta info is not needed for operation
-    return;
+    return Status::OK();
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) 
+  iter->Seek(kPartitionedIndexBlockName);
+  if (iter->Valid() && iter->key() == Slice(kPartitionedIndexBlockName))
+  {
+    rep_->partitioned_index = true;
+  }
+  if (rep_->options.filter_policy != NULL && rep_->partitioned_index)
+  {
+    std::string key = kPartitionedFilterBlockPrefix;
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    rep_->partitioned_filter = (iter->Valid() && iter->key() == Slice(key));
+  }
+  else if (rep_->options.filter_policy != NULL)
+  {
+    // A table has at most one of the two filter formats
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) 
+    {
+      ReadFilter(iter->value(), false);
+    }
+    else
+    {
+      key = "fullfilter.";
+      key.append(rep_->options.filter_policy->Name());
+      iter->Seek(key);
+      if (iter->Valid() && iter->key() == Slice(key))
+      {
+        ReadFilter(iter->value(), true);
+        if (rep_->options.prefix_extractor != NULL)
+        {
+          key = kPrefixFilterPrefix;
+          key.append(rep_->options.prefix_extractor->Name());
+          iter->Seek(key);
+          rep_->prefix_filter = (iter->Valid() && iter->key() == Slice(key));
+        }
+      }
+    }
+  }
+  Status s;
+  iter->Seek(kZstdDictionaryBlockName);
+  if (iter->Valid() && iter->key() == Slice(kZstdDictionaryBlockName))
   {
-    ReadFilter(iter->value());
+    s = ReadZstdDictionary(iter->value());
+  }
+  if (s.ok())
+  {
+    iter->Seek(kRangeDeletionBlockName);
+    if (iter->Valid() && iter->key() == Slice(kRangeDeletionBlockName))
+    {
+      s = ReadRangeDeletions(iter->value());
+    }
   }
   delete iter;
   delete meta;
+  return s;
 }
 
-void Table::ReadFilter(const Slice& filter_handle_value)
+Status Table::ReadZstdDictionary(const Slice& dictionary_handle_value)
+{
+  Slice v = dictionary_handle_value;
+  BlockHandle dictionary_handle;
+  Status s = dictionary_handle.DecodeFrom(&v);
+  if (!s.ok())
+  {
+    return s;
+  }
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents block;
+  s = ReadBlock(rep_->file, opt, dictionary_handle, NULL, &block);
+  if (!s.ok())
+  {
+    return s;
+  }
+  // The digested dictionary keeps its own copy of the contents
+  rep_->zstd_dict = new port::ZstdDictionary(block.data.data(), block.data.size(), false, 0);
+  if (block.heap_allocated)
+  {
+    delete[] block.data.data();
+  }
+  if (!rep_->zstd_dict->ok())
+  {
+    delete rep_->zstd_dict;
+    rep_->zstd_dict = NULL;
+    return Status::NotSupported("cannot load zstd dictionary of table");
+  }
+  return Status::OK();
+}
+
+Status Table::ReadRangeDeletions(const Slice& range_del_handle_value)
+{
+  Slice v = range_del_handle_value;
+  BlockHandle range_del_handle;
+  Status s = range_del_handle.DecodeFrom(&v);
+  if (!s.ok())
+  {
+    return s;
+  }
+  // Unlike a filter, the tombstones are needed to read the table correctly
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents block;
+  s = ReadBlock(rep_->file, opt, range_del_handle, NULL, &block);
+  if (s.ok())
+  {
+    rep_->range_del_block = new Block(block);
+  }
+  return s;
+}
+
+void Table::ReadFilter(const Slice& filter_handle_value, bool full)
 {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
@@ -156,15 +511,37 @@ void Table::ReadFilter(const Slice& filter_handle_value)
     opt.verify_checksums = true;
   }
   BlockContents block;
-  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) 
+  if (!ReadBlock(rep_->file, opt, filter_handle, NULL, &block).ok()) 
+  {
+    return;
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  if (rep_->options.cache_index_and_filter_blocks && block_cache != NULL && block.cachable)
   {
+    CachedFilter* cached = new CachedFilter;
+    cached->contents = block;
+    char cache_key_buffer[16];
+    EncodeFixed64(cache_key_buffer, rep_->cache_id);
+    EncodeFixed64(cache_key_buffer + 8, filter_handle.offset());
+    Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+    block_cache->Release(block_cache->Insert(cache_key, cached, block.data.size(), &DeleteCachedFilter,
+                                             Cache::kHighPriority));
+    rep_->cached_filter_handle = filter_handle;
+    rep_->cached_filter = full ? Rep::kCachedFullFilter : Rep::kCachedFilterBlock;
     return;
   }
   if (block.heap_allocated) 
   {
     rep_->filter_data = block.data.data();     // Will need to delete later
   }
-  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  if (full)
+  {
+    rep_->full_filter = new FullFilterBlockReader(rep_->options.filter_policy, block.data);
+  }
+  else
+  {
+    rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  }
 }
 
 Table::~Table() 
@@ -172,30 +549,26 @@ Table::~Table()
   delete rep_;
 }
 
-static void DeleteBlock(void* arg, void* ignored) 
+// Convert an index iterator value (i.e., an encoded BlockHandle)
+// into an iterator over the contents of the corresponding block.
+Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice& index_value)
 {
-  delete reinterpret_cast<Block*>(arg);
+  return reinterpret_cast<Table*>(arg)->BlockIterator(options, index_value, true);
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value) 
+// Convert a top-level index value into an iterator over the
+// corresponding index partition.
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options, const Slice& index_value)
 {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+  return reinterpret_cast<Table*>(arg)->BlockIterator(options, index_value, false);
 }
 
-static void ReleaseBlock(void* arg, void* h) 
+Iterator* Table::BlockIterator(const ReadOptions& options, const Slice& index_value, bool data_block) const
 {
-  Cache* cache = reinterpret_cast<Cache*>(arg);
-  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
-  cache->Release(handle);
-}
-
-// Convert an index iterator value (i.e., an encoded BlockHandle)
-// into an iterator over the contents of the corresponding block.
-Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice& index_value)
-{
-  Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  // Only data blocks are compressed with the dictionary.  Index
+  // partitions are cached with high priority, like filters.
+  const port::ZstdDictionary* dict = data_block ? rep_->zstd_dict : NULL;
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = NULL;
   Cache::Handle* cache_handle = NULL;
 
@@ -207,49 +580,15 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice&
 
   if (s.ok()) 
   {
-    BlockContents contents;
-    if(block_cache != NULL) 
-	{
-      char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-      EncodeFixed64(cache_key_buffer + 8, handle.offset());
-      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-	  //block的缓存(LRUCache)在查找
-      cache_handle = block_cache->Lookup(key);
-      if (cache_handle != NULL)
-	  {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
-      }
-	  else
-	  {
-		/*
-			读取block的内容
-		*/
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
-        if (s.ok())
-		{
-          block = new Block(contents);
-          if (contents.cachable && options.fill_cache)
-		  {
-            cache_handle = block_cache->Insert(key, block, block->size(), &DeleteCachedBlock);
-          }
-        }
-      }
-    } 
-	else
-	{
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
-      if (s.ok()) 
-	  {
-        block = new Block(contents);
-      }
-    }
+    s = ReadCachedBlock(rep_->file, rep_->secondary_cache, rep_->file_number, block_cache, rep_->cache_id,
+                        rep_->statistics, dict, data_block, options, handle,
+                        &block, &cache_handle);
   }
 
   Iterator* iter;
   if (block != NULL)
   {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator);
     if (cache_handle == NULL)
 	{
       iter->RegisterCleanup(&DeleteBlock, block, NULL);
@@ -266,10 +605,274 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options, const Slice&
   return iter;
 }
 
+Iterator* Table::IndexBlockIterator(const ReadOptions& options) const
+{
+  if (rep_->index_block != NULL)
+  {
+    return rep_->index_block->NewIterator(rep_->options.comparator);
+  }
+  return BlockIterator(options, rep_->cached_index_handle, false);
+}
+
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const
+{
+  Iterator* iter = IndexBlockIterator(options);
+  if (rep_->partitioned_index)
+  {
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader, const_cast<Table*>(this), options,
+                               rep_->options.comparator);
+  }
+  return iter;
+}
+
+// Iterator of a table with a prefix filter, for prefix_same_as_start
+// reads: checks the prefix of each Seek() target against the filter
+// before searching the index block.
+class Table::PrefixSeekIterator : public Iterator
+{
+ public:
+  PrefixSeekIterator(const Table* table, const ReadOptions& options, Iterator* iter)
+      : table_(table),
+        options_(options),
+        iter_(iter),
+        filtered_(false)
+  {
+  }
+  virtual ~PrefixSeekIterator()
+  {
+    delete iter_;
+  }
+  virtual bool Valid() const
+  {
+    return !filtered_ && iter_->Valid();
+  }
+  virtual void Seek(const Slice& target)
+  {
+    filtered_ = !table_->PrefixMayMatch(options_, target);
+    if (!filtered_)
+    {
+      iter_->Seek(target);
+    }
+  }
+  virtual void SeekToFirst()
+  {
+    filtered_ = false;
+    iter_->SeekToFirst();
+  }
+  virtual void SeekToLast()
+  {
+    filtered_ = false;
+    iter_->SeekToLast();
+  }
+  virtual void Next()
+  {
+    assert(Valid());
+    iter_->Next();
+  }
+  virtual void Prev()
+  {
+    assert(Valid());
+    iter_->Prev();
+  }
+  virtual Slice key() const
+  {
+    assert(Valid());
+    return iter_->key();
+  }
+  virtual Slice value() const
+  {
+    assert(Valid());
+    return iter_->value();
+  }
+  virtual Status status() const
+  {
+    return iter_->status();
+  }
+
+ private:
+  const Table* const table_;
+  const ReadOptions options_;
+  Iterator* const iter_;
+  bool filtered_;               // The last Seek() was ruled out by the filter
+};
+
 Iterator* Table::NewIterator(const ReadOptions& options) const 
 {
-  return NewTwoLevelIterator(rep_->index_block->NewIterator(rep_->options.comparator), 
-	  &Table::BlockReader, const_cast<Table*>(this), options);
+  Iterator* iter = NewTwoLevelIterator(NewIndexIterator(options), 
+	  &Table::BlockReader, const_cast<Table*>(this), options, rep_->options.comparator);
+  if (options.prefix_same_as_start && rep_->prefix_filter)
+  {
+    iter = new PrefixSeekIterator(this, options, iter);
+  }
+  return iter;
+}
+
+bool Table::PartitionedFilterMayMatch(const ReadOptions& options, const Slice& key) const
+{
+  bool may_match = true;  // Errors are treated as potential matches
+  Iterator* top = IndexBlockIterator(options);
+  top->Seek(key);
+  BlockHandle index_handle, filter_handle;
+  Slice input;
+  if (top->Valid())
+  {
+    input = top->value();
+  }
+  if (top->Valid() && index_handle.DecodeFrom(&input).ok() && filter_handle.DecodeFrom(&input).ok())
+  {
+    Cache* block_cache = rep_->options.block_cache;
+    Cache::Handle* cache_handle = NULL;
+    CachedFilter* partition = ReadCachedFilter(rep_->file, block_cache, rep_->cache_id, rep_->statistics, options,
+                                               filter_handle, &cache_handle);
+    if (partition != NULL)
+    {
+      FullFilterBlockReader filter(rep_->options.filter_policy, partition->contents.data);
+      may_match = filter.KeyMayMatch(key);
+      ReleaseCachedFilter(block_cache, partition, cache_handle);
+    }
+  }
+  delete top;
+  return may_match;
+}
+
+bool Table::FullFilterMayMatch(const ReadOptions& options, const Slice& key) const
+{
+  if (rep_->full_filter != NULL)
+  {
+    return rep_->full_filter->KeyMayMatch(key);
+  }
+  if (rep_->cached_filter != Rep::kCachedFullFilter)
+  {
+    return true;
+  }
+  bool may_match = true;
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* cache_handle = NULL;
+  CachedFilter* cached = ReadCachedFilter(rep_->file, block_cache, rep_->cache_id, rep_->statistics, options,
+                                          rep_->cached_filter_handle, &cache_handle);
+  if (cached != NULL)
+  {
+    FullFilterBlockReader filter(rep_->options.filter_policy, cached->contents.data);
+    may_match = filter.KeyMayMatch(key);
+    ReleaseCachedFilter(block_cache, cached, cache_handle);
+  }
+  return may_match;
+}
+
+bool Table::PrefixMayMatch(const ReadOptions& options, const Slice& key) const
+{
+  const SliceTransform* prefix_extractor = rep_->options.prefix_extractor;
+  if (!rep_->prefix_filter || !prefix_extractor->InDomain(key))
+  {
+    return true;
+  }
+  if (!FullFilterMayMatch(options, prefix_extractor->Transform(key)))
+  {
+    RecordTick(rep_->statistics, Statistics::kBloomPrefixUseful);
+    return false;
+  }
+  return true;
+}
+
+bool Table::BlockFilterMayMatch(const ReadOptions& options, const Slice& index_value, const Slice& key) const
+{
+  if (rep_->filter == NULL && rep_->cached_filter != Rep::kCachedFilterBlock)
+  {
+    return true;
+  }
+  BlockHandle handle;
+  Slice input = index_value;
+  if (!handle.DecodeFrom(&input).ok())
+  {
+    return true;
+  }
+  if (rep_->filter != NULL)
+  {
+    return rep_->filter->KeyMayMatch(handle.offset(), key);
+  }
+  bool may_match = true;
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* cache_handle = NULL;
+  CachedFilter* cached = ReadCachedFilter(rep_->file, block_cache, rep_->cache_id, rep_->statistics, options,
+                                          rep_->cached_filter_handle, &cache_handle);
+  if (cached != NULL)
+  {
+    FilterBlockReader filter(rep_->options.filter_policy, cached->contents.data);
+    may_match = filter.KeyMayMatch(handle.offset(), key);
+    ReleaseCachedFilter(block_cache, cached, cache_handle);
+  }
+  return may_match;
+}
+
+void Table::PinMetaBlocks()
+{
+  Cache* block_cache = rep_->options.block_cache;
+  ReadOptions options;
+  if (!rep_->cached_index_handle.empty() && rep_->pinned_index == NULL)
+  {
+    BlockHandle handle;
+    Slice input = rep_->cached_index_handle;
+    Block* block = NULL;
+    Cache::Handle* cache_handle = NULL;
+    if (handle.DecodeFrom(&input).ok() &&
+        ReadCachedBlock(rep_->file, rep_->secondary_cache, rep_->file_number, block_cache, rep_->cache_id,
+                        rep_->statistics, NULL, false, options, handle,
+                        &block, &cache_handle).ok())
+    {
+      if (cache_handle != NULL)
+      {
+        rep_->index_block = block;
+        rep_->pinned_index = cache_handle;
+      }
+      else
+      {
+        delete block;
+      }
+    }
+  }
+  if (rep_->cached_filter != Rep::kNoCachedFilter && rep_->pinned_filter == NULL)
+  {
+    Cache::Handle* cache_handle = NULL;
+    CachedFilter* cached = ReadCachedFilter(rep_->file, block_cache, rep_->cache_id, rep_->statistics, options,
+                                            rep_->cached_filter_handle, &cache_handle);
+    if (cached != NULL && cache_handle != NULL)
+    {
+      rep_->pinned_filter = cache_handle;
+      if (rep_->cached_filter == Rep::kCachedFullFilter)
+      {
+        rep_->full_filter = new FullFilterBlockReader(rep_->options.filter_policy, cached->contents.data);
+      }
+      else
+      {
+        rep_->filter = new FilterBlockReader(rep_->options.filter_policy, cached->contents.data);
+      }
+      rep_->cached_filter = Rep::kNoCachedFilter;
+    }
+    else if (cached != NULL)
+    {
+      ReleaseCachedFilter(block_cache, cached, cache_handle);
+    }
+  }
+}
+
+void Table::UseSecondaryCache(SecondaryCache* secondary_cache, uint64_t file_number)
+{
+  rep_->secondary_cache = secondary_cache;
+  rep_->file_number = file_number;
+}
+
+void Table::UseStatistics(Statistics* statistics)
+{
+  rep_->statistics = statistics;
+}
+
+Iterator* Table::NewRangeDeletionIterator() const
+{
+  if (rep_->range_del_block == NULL)
+  {
+    return NewEmptyIterator();
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
@@ -277,18 +880,27 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void (*saver)(void*, const Slice&, const Slice&)) 
 {
   Status s;
+  if (!FullFilterMayMatch(options, k))
+  {
+    // Not found, and no need to search the index block
+    RecordTick(rep_->statistics, Statistics::kBloomUseful);
+    return s;
+  }
+  if (rep_->partitioned_filter && !PartitionedFilterMayMatch(options, k))
+  {
+    RecordTick(rep_->statistics, Statistics::kBloomUseful);
+    return s;
+  }
   //这里是index_block
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* iiter = NewIndexIterator(options);
   std::cout << "index_block seek..." << std::endl;
   iiter->Seek(k);
   if (iiter->Valid())
   {
-    Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
-    BlockHandle handle;
-    if (filter != NULL && handle.DecodeFrom(&handle_value).ok() && !filter->KeyMayMatch(handle.offset(), k))
+    if (!BlockFilterMayMatch(options, iiter->value(), k))
 	{
       // Not found
+      RecordTick(rep_->statistics, Statistics::kBloomUseful);
     } 
 	else 
 	{
@@ -312,9 +924,75 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 }
 
 
+void Table::InternalMultiGet(const ReadOptions& options, int n, const Slice* keys,
+                             void* const* args, Status* statuses,
+                             void (*saver)(void*, const Slice&, const Slice&))
+{
+  const Comparator* cmp = rep_->options.comparator;
+  Iterator* iiter = NewIndexIterator(options);
+  Iterator* block_iter = NULL;
+  std::string block_handle;    // Index entry that block_iter was read from
+  for (int i = 0; i < n; i++)
+  {
+    statuses[i] = Status::OK();
+  }
+  for (int i = 0; i < n; i++)
+  {
+    if (!FullFilterMayMatch(options, keys[i]) ||
+        (rep_->partitioned_filter && !PartitionedFilterMayMatch(options, keys[i])))
+    {
+      // Not found
+      RecordTick(rep_->statistics, Statistics::kBloomUseful);
+      continue;
+    }
+    // keys[] is sorted, so the index entry found for the previous key is
+    // still the right one as long as keys[i] does not go past it.
+    if (i == 0 || !iiter->Valid() || cmp->Compare(keys[i], iiter->key()) > 0)
+    {
+      iiter->Seek(keys[i]);
+    }
+    if (!iiter->Valid())
+    {
+      if (iiter->status().ok())
+      {
+        // keys[i] and every key after it are past the last block
+        break;
+      }
+      // Only keys[i] needed the index partition that could not be read.
+      // The error sticks to the iterator, so start over with a new one.
+      statuses[i] = iiter->status();
+      delete iiter;
+      iiter = NewIndexIterator(options);
+      continue;
+    }
+
+    if (!BlockFilterMayMatch(options, iiter->value(), keys[i]))
+    {
+      // Not found
+      RecordTick(rep_->statistics, Statistics::kBloomUseful);
+      continue;
+    }
+    if (block_iter == NULL || iiter->value() != Slice(block_handle))
+    {
+      delete block_iter;
+      block_iter = BlockReader(this, options, iiter->value());
+      block_handle = iiter->value().ToString();
+    }
+    block_iter->Seek(keys[i]);
+    if (block_iter->Valid())
+    {
+      (*saver)(args[i], block_iter->key(), block_iter->value());
+    }
+    // A block that cannot be read fails only the keys that fall in it
+    statuses[i] = block_iter->status();
+  }
+  delete block_iter;
+  delete iiter;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const 
 {
-  Iterator* index_iter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) 
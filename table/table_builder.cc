@@ -5,10 +5,14 @@
 #include "leveldb/table_builder.h"
 
 #include <assert.h>
+#include <utility>
+#include <vector>
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -17,6 +21,28 @@
 
 namespace leveldb {
 
+// Compress "raw" with "type" into *output, using "dict" for zstd if it is
+// non-NULL.  Returns false if the codec is unknown or not compiled into
+// this build.
+static bool CompressBlock(const Options& options, CompressionType type, const port::ZstdDictionary* dict, const Slice& raw, std::string* output)
+{
+  switch (type)
+  {
+    case kSnappyCompression:
+      return port::Snappy_Compress(raw.data(), raw.size(), output);
+    case kZstdCompression:
+      if (dict != NULL)
+      {
+        return dict->Compress(raw.data(), raw.size(), output);
+      }
+      return port::Zstd_Compress(options.zstd_compression_level, raw.data(), raw.size(), output);
+    case kLZ4Compression:
+      return port::LZ4_Compress(raw.data(), raw.size(), output);
+    default:
+      return false;
+  }
+}
+
 struct TableBuilder::Rep 
 {
   Options options;	             //data block的选项
@@ -30,6 +56,14 @@ struct TableBuilder::Rep
   int64_t num_entries;           //当前data_block的个数 
   bool closed;					 // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block; //根据filter数据快速定位key是否在block中
+  FullFilterBlockBuilder* full_filter_block;  // Used instead of filter_block if options.full_table_filter
+                                              // or, per partition, if options.partition_index_and_filters
+
+  // With options.partition_index_and_filters, index_block only holds
+  // the current partition and top_index_block maps the last key of each
+  // finished partition to its index (and filter) partition handles.
+  bool partitioned;
+  BlockBuilder top_index_block;
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -44,6 +78,19 @@ struct TableBuilder::Rep
   BlockHandle pending_handle;	   // Handle to add to index block 添加到index block 的data block的信息（offset， size）
   std::string compressed_output;   //压缩之后的data block，用于临时存储，写后即被清空
 
+  // While "buffering", Add() holds entries back in buffered_entries
+  // instead of building blocks.  Once buffered_bytes reaches the training
+  // budget (or the table is flushed) a zstd dictionary is trained on
+  // them and they are replayed, so every data block can use it.
+  bool buffering;
+  std::vector<std::pair<std::string, std::string> > buffered_entries;
+  size_t buffered_bytes;
+  std::string dictionary;            // Trained dictionary; empty if none
+  port::ZstdDictionary* zstd_dict;   // Digested "dictionary", or NULL
+
+  BlockBuilder range_del_block;      // Written as a meta block by Finish()
+  int64_t num_range_deletions;
+
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
         index_block_options(opt),
@@ -53,8 +100,17 @@ struct TableBuilder::Rep
         index_block(&index_block_options),
         num_entries(0),
         closed(false),
-        filter_block(opt.filter_policy == NULL ? NULL : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) 
+        filter_block(opt.filter_policy == NULL || opt.full_table_filter || opt.partition_index_and_filters ? NULL : new FilterBlockBuilder(opt.filter_policy)),
+        full_filter_block(opt.filter_policy == NULL || !(opt.full_table_filter || opt.partition_index_and_filters) ? NULL
+                          : new FullFilterBlockBuilder(opt.filter_policy, opt.partition_index_and_filters ? NULL : opt.prefix_extractor)),
+        partitioned(opt.partition_index_and_filters),
+        top_index_block(&index_block_options),
+        pending_index_entry(false),
+        buffering(opt.compression == kZstdCompression && opt.zstd_dictionary_size > 0),
+        buffered_bytes(0),
+        zstd_dict(NULL),
+        range_del_block(&options),
+        num_range_deletions(0)
   {
     index_block_options.block_restart_interval = 1;
   }
@@ -73,6 +129,8 @@ TableBuilder::~TableBuilder()
 {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
   delete rep_->filter_block;
+  delete rep_->full_filter_block;
+  delete rep_->zstd_dict;
   delete rep_;
 }
 
@@ -94,6 +152,15 @@ Status TableBuilder::ChangeOptions(const Options& options)
   return Status::OK();
 }
 
+void TableBuilder::AddRangeDeletion(const Slice& begin_key, const Slice& end)
+{
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->range_del_block.Add(begin_key, end);
+  r->num_range_deletions++;
+}
+
 //sstable必须是有序插入
 void TableBuilder::Add(const Slice& key, const Slice& value) 
 {
@@ -101,6 +168,22 @@ void TableBuilder::Add(const Slice& key, const Slice& value)
   assert(!r->closed);
   if (!ok()) return;
 
+  if (r->buffering)
+  {
+    if (!r->buffered_entries.empty())
+    {
+      assert(r->options.comparator->Compare(key, Slice(r->buffered_entries.back().first)) > 0);
+    }
+    r->buffered_entries.push_back(std::make_pair(key.ToString(), value.ToString()));
+    r->buffered_bytes += key.size() + value.size();
+    const size_t budget = (r->options.zstd_max_train_bytes > 0) ? r->options.zstd_max_train_bytes : 100 * r->options.zstd_dictionary_size;
+    if (r->buffered_bytes >= budget)
+    {
+      FinishBuffering();
+    }
+    return;
+  }
+
   //如果已经插入过数据，要保证当前插入的key > 之前最后一次插入的key 
   if (r->num_entries > 0)
   {
@@ -120,12 +203,22 @@ void TableBuilder::Add(const Slice& key, const Slice& value)
 	//将找到的last_key和data block相关信息Encode后添加到index block中
     r->index_block.Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
+    // Partitions end on an index entry, so the filter partition has
+    // seen exactly the keys of the blocks the index partition covers.
+    if (r->partitioned && r->index_block.CurrentSizeEstimate() >= r->options.metadata_block_size)
+    {
+      FinishPartition();
+    }
   }
 
   if (r->filter_block != NULL) 
   {
     r->filter_block->AddKey(key);
   }
+  else if (r->full_filter_block != NULL)
+  {
+    r->full_filter_block->AddKey(key);
+  }
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
@@ -139,6 +232,49 @@ void TableBuilder::Add(const Slice& key, const Slice& value)
   }
 }
 
+void TableBuilder::FinishBuffering()
+{
+  Rep* r = rep_;
+  assert(r->buffering);
+  r->buffering = false;
+
+  // Cut the held back entries into blocks the same way Add() would and
+  // train on those, so the dictionary matches what it will compress.
+  std::string samples;
+  std::vector<size_t> sample_sizes;
+  BlockBuilder block(&r->options);
+  for (size_t i = 0; i < r->buffered_entries.size(); i++)
+  {
+    block.Add(r->buffered_entries[i].first, r->buffered_entries[i].second);
+    if (block.CurrentSizeEstimate() >= r->options.block_size || i + 1 == r->buffered_entries.size())
+    {
+      Slice raw = block.Finish();
+      samples.append(raw.data(), raw.size());
+      sample_sizes.push_back(raw.size());
+      block.Reset();
+    }
+  }
+  if (samples.size() >= 10 * r->options.zstd_dictionary_size &&
+      port::Zstd_TrainDictionary(samples, sample_sizes, r->options.zstd_dictionary_size, &r->dictionary))
+  {
+    r->zstd_dict = new port::ZstdDictionary(r->dictionary.data(), r->dictionary.size(), true, r->options.zstd_compression_level);
+    if (!r->zstd_dict->ok())
+    {
+      delete r->zstd_dict;
+      r->zstd_dict = NULL;
+      r->dictionary.clear();
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string> > entries;
+  entries.swap(r->buffered_entries);
+  r->buffered_bytes = 0;
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    Add(entries[i].first, entries[i].second);
+  }
+}
+
 void TableBuilder::Flush() 
 {
   Rep* r = rep_;
@@ -147,6 +283,10 @@ void TableBuilder::Flush()
   {
 	return;
   }
+  if (r->buffering)
+  {
+    FinishBuffering();
+  }
   if (r->data_block.empty())
   {
 	return;
@@ -185,23 +325,25 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle)
 
   Slice block_contents;
   CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
   switch (type)
   {
     case kNoCompression:
       block_contents = raw;
       break;
 
-    case kSnappyCompression: 
+    default: 
 	{
       std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) && compressed->size() < raw.size() - (raw.size() / 8u)) 
+      // Only data blocks use the dictionary; the index and metaindex are
+      // read before it is loaded.
+      const port::ZstdDictionary* dict = (block == &r->data_block) ? r->zstd_dict : NULL;
+      if (CompressBlock(r->options, type, dict, raw, compressed) && compressed->size() < raw.size() - (raw.size() / 8u)) 
 	  {
         block_contents = *compressed;
       } 
 	  else 
 	  {
-        // Snappy not supported, or compressed less than 12.5%, so just
+        // Codec not supported, or compressed less than 12.5%, so just
         // store uncompressed form
         block_contents = raw;
         type = kNoCompression;
@@ -237,6 +379,30 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents, CompressionType ty
   }
 }
 
+void TableBuilder::FinishPartition()
+{
+  Rep* r = rep_;
+  BlockHandle index_handle, filter_handle;
+  if (ok() && r->full_filter_block != NULL)
+  {
+    WriteRawBlock(r->full_filter_block->Finish(), kNoCompression, &filter_handle);
+  }
+  if (ok())
+  {
+    WriteBlock(&r->index_block, &index_handle);
+  }
+  if (ok())
+  {
+    std::string handle_encoding;
+    index_handle.EncodeTo(&handle_encoding);
+    if (r->full_filter_block != NULL)
+    {
+      filter_handle.EncodeTo(&handle_encoding);
+    }
+    r->top_index_block.Add(r->last_key, Slice(handle_encoding));
+  }
+}
+
 Status TableBuilder::status() const 
 {
   return rep_->status;
@@ -249,19 +415,40 @@ Status TableBuilder::Finish()
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, dictionary_block_handle, range_del_block_handle, metaindex_block_handle, index_block_handle;
 
   // Write filter block
   if (ok() && r->filter_block != NULL) 
   {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_block_handle);
   }
+  else if (ok() && r->full_filter_block != NULL && !r->partitioned)
+  {
+    WriteRawBlock(r->full_filter_block->Finish(), kNoCompression, &filter_block_handle);
+  }
+
+  // Write zstd dictionary block
+  if (ok() && !r->dictionary.empty())
+  {
+    WriteRawBlock(r->dictionary, kNoCompression, &dictionary_block_handle);
+  }
+
+  // Write range deletion block.  It is left uncompressed, since it is
+  // read whole whenever the table is opened.
+  if (ok() && r->num_range_deletions > 0)
+  {
+    WriteRawBlock(r->range_del_block.Finish(), kNoCompression, &range_del_block_handle);
+  }
 
   // Write metaindex block
   if (ok())
   {
 	  //保存meta-block的索引信息；
-    BlockBuilder meta_index_block(&r->options);
+    // Meta block names are plain strings (Table::ReadMeta looks them up
+    // with BytewiseComparator), whatever comparator the data uses.
+    Options meta_index_options = r->options;
+    meta_index_options.comparator = BytewiseComparator();
+    BlockBuilder meta_index_block(&meta_index_options);
     if (r->filter_block != NULL)
 	{
       // Add mapping from "filter.Name" to location of filter data
@@ -271,6 +458,48 @@ Status TableBuilder::Finish()
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    else if (r->full_filter_block != NULL && !r->partitioned)
+    {
+      // Add mapping from "fullfilter.Name" to location of filter data
+      std::string key = "fullfilter.";
+      key.append(r->options.filter_policy->Name());
+      std::string handle_encoding;
+      filter_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(key, handle_encoding);
+    }
+    if (r->full_filter_block != NULL && !r->partitioned && r->options.prefix_extractor != NULL)
+    {
+      std::string key = kPrefixFilterPrefix;
+      key.append(r->options.prefix_extractor->Name());
+      meta_index_block.Add(key, Slice());
+    }
+    if (r->partitioned)
+    {
+      // The partitions are found through the top-level index; these
+      // entries only record the layout.
+      if (r->full_filter_block != NULL)
+      {
+        std::string key = kPartitionedFilterBlockPrefix;
+        key.append(r->options.filter_policy->Name());
+        meta_index_block.Add(key, Slice());
+      }
+      meta_index_block.Add(kPartitionedIndexBlockName, Slice());
+    }
+    if (r->num_range_deletions > 0)
+    {
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kRangeDeletionBlockName, handle_encoding);
+    }
+    if (!r->dictionary.empty())
+    {
+      // Keys must stay sorted: "filter." < "fullfilter." <
+      // "partitioned.filter." < "partitioned.index" < "prefix." <
+      // "range." < "zstd."
+      std::string handle_encoding;
+      dictionary_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kZstdDictionaryBlockName, handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -288,7 +517,21 @@ Status TableBuilder::Finish()
       r->index_block.Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
-    WriteBlock(&r->index_block, &index_block_handle);
+    if (r->partitioned)
+    {
+      if (!r->index_block.empty())
+      {
+        FinishPartition();
+      }
+      if (ok())
+      {
+        WriteBlock(&r->top_index_block, &index_block_handle);
+      }
+    }
+    else
+    {
+      WriteBlock(&r->index_block, &index_block_handle);
+    }
   }
 
   // Write footer
@@ -313,16 +556,18 @@ void TableBuilder::Abandon()
   Rep* r = rep_;
   assert(!r->closed);
   r->closed = true;
+  r->buffered_entries.clear();
 }
 
 uint64_t TableBuilder::NumEntries() const
 {
-  return rep_->num_entries;
+  return rep_->num_entries + rep_->buffered_entries.size();
 }
 
 uint64_t TableBuilder::FileSize() const 
 {
-  return rep_->offset;
+  // Entries held back for dictionary training count at their raw size
+  return rep_->offset + rep_->buffered_bytes;
 }
 
 }  // namespace leveldb
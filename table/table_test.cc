@@ -16,6 +16,7 @@
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "table/merger.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -219,6 +220,76 @@ class BlockConstructor: public Constructor {
   BlockConstructor();
 };
 
+// Spreads runs of consecutive entries over several blocks, which are
+// merged by NewMergingIterator() with the first key of each block as
+// the lower bound of its child.
+class MergerConstructor: public Constructor {
+ public:
+  explicit MergerConstructor(const Comparator* cmp)
+      : Constructor(cmp),
+        comparator_(cmp) { }
+  ~MergerConstructor() {
+    Clear();
+  }
+  virtual Status FinishImpl(const Options& options, const KVMap& data) {
+    Clear();
+    std::vector<BlockBuilder*> builders;
+    for (int i = 0; i < kNumChildren; i++) {
+      builders.push_back(new BlockBuilder(&options));
+      smallest_.push_back(std::string());
+    }
+    int n = 0;
+    for (KVMap::const_iterator it = data.begin();
+         it != data.end();
+         ++it, ++n) {
+      const int child = (n / 3) % kNumChildren;
+      if (builders[child]->empty()) {
+        smallest_[child] = it->first;
+      }
+      builders[child]->Add(it->first, it->second);
+    }
+    for (int i = 0; i < kNumChildren; i++) {
+      data_.push_back(builders[i]->Finish().ToString());
+      delete builders[i];
+    }
+    for (int i = 0; i < kNumChildren; i++) {
+      BlockContents contents;
+      contents.data = data_[i];
+      contents.cachable = false;
+      contents.heap_allocated = false;
+      blocks_.push_back(new Block(contents));
+    }
+    return Status::OK();
+  }
+  virtual Iterator* NewIterator() const {
+    Iterator* children[kNumChildren];
+    Slice lower_bounds[kNumChildren];
+    for (int i = 0; i < kNumChildren; i++) {
+      children[i] = blocks_[i]->NewIterator(comparator_);
+      lower_bounds[i] = smallest_[i];
+    }
+    return NewMergingIterator(comparator_, children, kNumChildren,
+                              lower_bounds);
+  }
+
+ private:
+  enum { kNumChildren = 5 };
+
+  void Clear() {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+      delete blocks_[i];
+    }
+    blocks_.clear();
+    data_.clear();
+    smallest_.clear();
+  }
+
+  const Comparator* comparator_;
+  std::vector<std::string> data_;
+  std::vector<std::string> smallest_;   // Empty for an empty block
+  std::vector<Block*> blocks_;
+};
+
 class TableConstructor: public Constructor {
  public:
   TableConstructor(const Comparator* cmp)
@@ -401,6 +472,7 @@ enum TestType {
   TABLE_TEST,
   BLOCK_TEST,
   MEMTABLE_TEST,
+  MERGER_TEST,
   DB_TEST
 };
 
@@ -408,6 +480,7 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool partition_index;
 };
 
 static const TestArgs kTestArgList[] = {
@@ -417,6 +490,8 @@ static const TestArgs kTestArgList[] = {
   { TABLE_TEST, true, 16 },
   { TABLE_TEST, true, 1 },
   { TABLE_TEST, true, 1024 },
+  { TABLE_TEST, false, 16, true },
+  { TABLE_TEST, true, 1, true },
 
   { BLOCK_TEST, false, 16 },
   { BLOCK_TEST, false, 1 },
@@ -429,6 +504,10 @@ static const TestArgs kTestArgList[] = {
   { MEMTABLE_TEST, false, 16 },
   { MEMTABLE_TEST, true, 16 },
 
+  { MERGER_TEST, false, 16 },
+  { MERGER_TEST, false, 1 },
+  { MERGER_TEST, true, 16 },
+
   // Do not bother with restart interval variations for DB
   { DB_TEST, false, 16 },
   { DB_TEST, true, 16 },
@@ -448,6 +527,8 @@ class Harness {
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
+    options_.partition_index_and_filters = args.partition_index;
+    options_.metadata_block_size = 64;
     if (args.reverse_compare) {
       options_.comparator = &reverse_key_comparator;
     }
@@ -461,6 +542,9 @@ class Harness {
       case MEMTABLE_TEST:
         constructor_ = new MemTableConstructor(options_.comparator);
         break;
+      case MERGER_TEST:
+        constructor_ = new MergerConstructor(options_.comparator);
+        break;
       case DB_TEST:
         constructor_ = new DBConstructor(options_.comparator);
         break;
@@ -828,6 +912,45 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
 
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitioned) {
+  TableConstructor c(BytewiseComparator());
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    c.Add(key, std::string(1000, 'x'));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.partition_index_and_filters = true;
+  options.metadata_block_size = 256;
+  c.Finish(options, &keys, &kvmap);
+
+  // Partitions are interleaved with data blocks, so offsets include
+  // the index and filter partitions written so far.
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"),           0,       0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k000500"), 500000,  515000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),    1000000, 1030000));
+
+  Iterator* iter = c.NewIterator();
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    snprintf(key, sizeof(key), "k%06d", count);
+    ASSERT_EQ(std::string(key), iter->key().ToString());
+    count++;
+  }
+  ASSERT_EQ(1000, count);
+  iter->Seek("k000777");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k000777", iter->key().ToString());
+  iter->Prev();
+  ASSERT_EQ("k000776", iter->key().ToString());
+  ASSERT_OK(iter->status());
+  delete iter;
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -862,6 +985,149 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),    4000,   6000));
 }
 
+static bool CompressionSupported(CompressionType type) {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Compress(in.data(), in.size(), &out);
+    case kZstdCompression:
+      return port::Zstd_Compress(1, in.data(), in.size(), &out);
+    case kLZ4Compression:
+      return port::LZ4_Compress(in.data(), in.size(), &out);
+    default:
+      return true;
+  }
+}
+
+TEST(TableTest, CompressionTypes) {
+  const CompressionType types[] = {
+    kNoCompression, kSnappyCompression, kZstdCompression, kLZ4Compression
+  };
+  for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+    const bool supported = CompressionSupported(types[t]);
+    if (!supported) {
+      fprintf(stderr, "compression type %d not supported; blocks are "
+              "stored uncompressed\n", static_cast<int>(types[t]));
+    }
+    Random rnd(301);
+    TableConstructor c(BytewiseComparator());
+    std::string tmp;
+    for (int i = 0; i < 20; i++) {
+      char key[10];
+      snprintf(key, sizeof(key), "k%02d", i);
+      c.Add(key, test::CompressibleString(&rnd, 0.25, 10000, &tmp));
+    }
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    Options options;
+    options.block_size = 1024;
+    options.compression = types[t];
+    options.zstd_compression_level = 3;
+    c.Finish(options, &keys, &kvmap);
+
+    // Everything reads back, whatever codec wrote it
+    Iterator* iter = c.NewIterator();
+    KVMap::const_iterator model = kvmap.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++model) {
+      ASSERT_TRUE(model != kvmap.end());
+      ASSERT_EQ(model->first, iter->key().ToString());
+      ASSERT_EQ(model->second, iter->value().ToString());
+    }
+    ASSERT_TRUE(model == kvmap.end());
+    ASSERT_OK(iter->status());
+    delete iter;
+
+    if (types[t] != kNoCompression && supported) {
+      ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 20000, 120000));
+    } else {
+      ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 200000, 210000));
+    }
+  }
+}
+
+// Small records sharing most of their bytes with their neighbours, the
+// case a per-table dictionary is meant for.
+static std::string JsonLikeRecord(Random* rnd) {
+  char buf[200];
+  const int id = rnd->Uniform(1000000);
+  snprintf(buf, sizeof(buf),
+           "{\"id\":%d,\"user\":\"user_%06d\",\"email\":\"user_%06d@example.com\","
+           "\"score\":%d,\"active\":%s}",
+           id, id, id, rnd->Uniform(1000), rnd->OneIn(2) ? "true" : "false");
+  return buf;
+}
+
+TEST(TableTest, ZstdDictionary) {
+  Random rnd(301);
+  KVMap data;
+  for (int i = 0; i < 3000; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "k%06d", i);
+    data[key] = JsonLikeRecord(&rnd);
+  }
+
+  uint64_t sizes[2];
+  for (int use_dict = 0; use_dict < 2; use_dict++) {
+    TableConstructor c(BytewiseComparator());
+    for (KVMap::const_iterator it = data.begin(); it != data.end(); ++it) {
+      c.Add(it->first, it->second);
+    }
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    Options options;
+    options.compression = kZstdCompression;
+    options.zstd_dictionary_size = use_dict ? 4096 : 0;
+    options.zstd_max_train_bytes = 100000;
+    c.Finish(options, &keys, &kvmap);
+
+    Iterator* iter = c.NewIterator();
+    KVMap::const_iterator model = kvmap.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++model) {
+      ASSERT_TRUE(model != kvmap.end());
+      ASSERT_EQ(model->first, iter->key().ToString());
+      ASSERT_EQ(model->second, iter->value().ToString());
+    }
+    ASSERT_TRUE(model == kvmap.end());
+    ASSERT_OK(iter->status());
+    delete iter;
+    sizes[use_dict] = c.ApproximateOffsetOf("xyz");
+  }
+
+  if (CompressionSupported(kZstdCompression)) {
+    // The dictionary block costs at most 4K but pays for itself
+    ASSERT_LT(sizes[1], sizes[0]);
+  } else {
+    fprintf(stderr, "zstd not supported; skipping size check\n");
+  }
+}
+
+TEST(TableTest, ZstdDictionaryTooLittleData) {
+  // Fewer than 10 * zstd_dictionary_size bytes: written without one
+  TableConstructor c(BytewiseComparator());
+  Random rnd(301);
+  for (int i = 0; i < 10; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "k%06d", i);
+    c.Add(key, JsonLikeRecord(&rnd));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.compression = kZstdCompression;
+  options.zstd_dictionary_size = 4096;
+  c.Finish(options, &keys, &kvmap);
+
+  Iterator* iter = c.NewIterator();
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(kvmap[iter->key().ToString()], iter->value().ToString());
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete iter;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
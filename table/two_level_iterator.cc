@@ -4,6 +4,7 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -18,7 +19,8 @@ typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 class TwoLevelIterator: public Iterator 
 {
  public:
-  TwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg, const ReadOptions& options);
+  TwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg,
+                   const ReadOptions& options, const Comparator* comparator);
 
   virtual ~TwoLevelIterator();
 
@@ -64,6 +66,7 @@ class TwoLevelIterator: public Iterator
   {
     if (status_.ok() && !s.ok()) status_ = s;
   }
+  bool IndexPastUpperBound() const;
   void SkipEmptyDataBlocksForward();
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
@@ -79,6 +82,7 @@ class TwoLevelIterator: public Iterator
   */
   void* arg_;
   const ReadOptions options_;
+  const Comparator* const comparator_;  // May be NULL
 
   /*
 	记录操作过程中的状态
@@ -103,10 +107,12 @@ class TwoLevelIterator: public Iterator
   std::string data_block_handle_;
 };
 
-TwoLevelIterator::TwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg, const ReadOptions& options)
+TwoLevelIterator::TwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg,
+                                   const ReadOptions& options, const Comparator* comparator)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
+      comparator_(comparator),
       index_iter_(index_iter),
       data_iter_(NULL) 
 {
@@ -153,6 +159,11 @@ void TwoLevelIterator::Next()
 {
   assert(Valid());
   data_iter_.Next();
+  if (!data_iter_.Valid() && IndexPastUpperBound())
+  {
+    // Leave index_iter_ where it is; the iterator is invalid
+    return;
+  }
   SkipEmptyDataBlocksForward();
 }
 
@@ -164,6 +175,13 @@ void TwoLevelIterator::Prev()
 }
 
 
+bool TwoLevelIterator::IndexPastUpperBound() const
+{
+  return comparator_ != NULL && options_.iterate_upper_bound != NULL &&
+         index_iter_.Valid() &&
+         comparator_->Compare(index_iter_.key(), *options_.iterate_upper_bound) >= 0;
+}
+
 void TwoLevelIterator::SkipEmptyDataBlocksForward() 
 {
   while (data_iter_.iter() == NULL || !data_iter_.Valid()) 
@@ -226,9 +244,10 @@ void TwoLevelIterator::InitDataBlock()
 
 }  // namespace
 
-Iterator* NewTwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg, const ReadOptions& options)
+Iterator* NewTwoLevelIterator(Iterator* index_iter, BlockFunction block_function, void* arg,
+                              const ReadOptions& options, const Comparator* comparator)
 {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+  return new TwoLevelIterator(index_iter, block_function, arg, options, comparator);
 }
 
 }  // namespace leveldb
@@ -4,6 +4,7 @@
 
 #include "util/arena.h"
 #include <assert.h>
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -66,6 +67,63 @@ char* Arena::AllocateAligned(size_t bytes)
   return result;
 }
 
+// Pick a shard for the calling thread.  Stacks of different threads
+// live in different pages, so hashing the page of a local variable
+// spreads threads over the shards without thread-local storage.
+static int CurrentShard(int num_shards)
+{
+  int dummy;
+  uint64_t page = reinterpret_cast<uintptr_t>(&dummy) >> 12;
+  return static_cast<int>(((page * 0x9E3779B97F4A7C15ull) >> 32) % num_shards);
+}
+
+char* Arena::AllocateConcurrent(size_t bytes)
+{
+  return AllocateFromShard(bytes, false);
+}
+
+char* Arena::AllocateAlignedConcurrent(size_t bytes)
+{
+  return AllocateFromShard(bytes, true);
+}
+
+char* Arena::AllocateFromShard(size_t bytes, bool aligned)
+{
+  assert(bytes > 0);
+  if (bytes > kBlockSize / 4)
+  {
+    // Too large to carve out of a shard chunk.  AllocateAligned() hands
+    // it its own block.
+    MutexLock l(&mu_);
+    return AllocateAligned(bytes);
+  }
+
+  Shard* shard = &shards_[CurrentShard(kNumShards)];
+  MutexLock l(&shard->mu);
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  size_t slop = 0;
+  if (aligned)
+  {
+    size_t current_mod = reinterpret_cast<uintptr_t>(shard->alloc_ptr) & (align-1);
+    slop = (current_mod == 0 ? 0 : align - current_mod);
+  }
+  if (bytes + slop > shard->alloc_bytes_remaining)
+  {
+    // We waste the remaining space in the shard's chunk.
+    {
+      MutexLock arena_lock(&mu_);
+      shard->alloc_ptr = AllocateNewBlock(kBlockSize);
+    }
+    shard->alloc_bytes_remaining = kBlockSize;
+    slop = 0;   // New blocks are always aligned
+  }
+  char* result = shard->alloc_ptr + slop;
+  shard->alloc_ptr += bytes + slop;
+  shard->alloc_bytes_remaining -= bytes + slop;
+  assert(!aligned || (reinterpret_cast<uintptr_t>(result) & (align-1)) == 0);
+  return result;
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) 
 {
   char* result = new char[block_bytes];
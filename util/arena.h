@@ -27,6 +27,12 @@ class Arena
   // Allocate memory with the normal alignment guarantees provided by malloc
   char* AllocateAligned(size_t bytes);
 
+  // Thread-safe variants of Allocate() and AllocateAligned().  Any number
+  // of threads may call these at once, but never at the same time as the
+  // unsynchronized variants above.
+  char* AllocateConcurrent(size_t bytes);
+  char* AllocateAlignedConcurrent(size_t bytes);
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   size_t MemoryUsage() const 
@@ -37,6 +43,7 @@ class Arena
  private:
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
+  char* AllocateFromShard(size_t bytes, bool aligned);
 
   // Allocation state ǰڴblockڵĿõַ
   char* alloc_ptr_;
@@ -49,6 +56,23 @@ class Arena
   // Total memory usage of the arena.
   port::AtomicPointer memory_usage_;
 
+  // Concurrent callers carve small allocations out of a chunk owned by
+  // one of several shards, picked per thread, and only take mu_ to
+  // refill a chunk.  So writers seldom contend on the same lock.
+  struct Shard
+  {
+    port::Mutex mu;
+    char* alloc_ptr;
+    size_t alloc_bytes_remaining;
+    Shard() : alloc_ptr(NULL), alloc_bytes_remaining(0) { }
+  };
+  enum { kNumShards = 8 };
+  Shard shards_[kNumShards];
+
+  // Protects the unsynchronized allocation state above while concurrent
+  // callers are active.
+  port::Mutex mu_;
+
   // No copying allowed
   Arena(const Arena&);
   void operator=(const Arena&);
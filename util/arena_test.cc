@@ -4,6 +4,9 @@
 
 #include "util/arena.h"
 
+#include <string.h>
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testharness.h"
 
@@ -61,6 +64,63 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+struct ConcurrentArenaState {
+  Arena* arena;
+  port::Mutex mu;
+  port::CondVar cv;
+  int started;
+  int done;
+  bool ok;
+
+  ConcurrentArenaState() : cv(&mu), started(0), done(0), ok(true) { }
+};
+
+static void ConcurrentAllocator(void* arg) {
+  ConcurrentArenaState* state = reinterpret_cast<ConcurrentArenaState*>(arg);
+  int id;
+  {
+    MutexLock l(&state->mu);
+    id = state->started++;
+  }
+  Random rnd(301 + id);
+  std::vector<std::pair<size_t, char*> > allocated;
+  for (int i = 0; i < 20000; i++) {
+    size_t s = rnd.OneIn(1000) ? rnd.Uniform(6000) + 1 : rnd.Uniform(100) + 1;
+    char* r = rnd.OneIn(2) ? state->arena->AllocateAlignedConcurrent(s)
+                           : state->arena->AllocateConcurrent(s);
+    memset(r, id, s);
+    allocated.push_back(std::make_pair(s, r));
+  }
+  bool ok = true;
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (size_t b = 0; b < allocated[i].first; b++) {
+      if (allocated[i].second[b] != static_cast<char>(id)) {
+        ok = false;
+      }
+    }
+  }
+  MutexLock l(&state->mu);
+  state->ok = state->ok && ok;
+  state->done++;
+  state->cv.Signal();
+}
+
+TEST(ArenaTest, Concurrent) {
+  Arena arena;
+  ConcurrentArenaState state;
+  state.arena = &arena;
+  const int kThreads = 4;
+  for (int i = 0; i < kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentAllocator, &state);
+  }
+  MutexLock l(&state.mu);
+  while (state.done < kThreads) {
+    state.cv.Wait();
+  }
+  // Every thread saw only its own pattern, so no two allocations overlap
+  ASSERT_TRUE(state.ok);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -86,10 +86,92 @@ class BloomFilterPolicy : public FilterPolicy {
     return true;
   }
 };
+
+// A blocked bloom filter: the filter is an array of 64-byte lines, a key
+// picks one line and all of its probes land inside that line, so a
+// lookup touches a single cache line instead of k_ of them.  The price
+// is a slightly higher false positive rate than BloomFilterPolicy for
+// the same number of bits per key.
+class CacheLocalBloomFilterPolicy : public FilterPolicy {
+ private:
+  static const size_t kLineBits = 512;
+  static const size_t kLineBytes = kLineBits / 8;
+
+  size_t bits_per_key_;
+  size_t k_;
+
+  // Multiplying by this odd constant remixes the hash between probes;
+  // the top 9 bits of the product select a bit within the line.
+  static uint32_t NextProbe(uint32_t h) {
+    return h * 0x9e3779b9u;
+  }
+
+ public:
+  explicit CacheLocalBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key) {
+    k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > 30) k_ = 30;
+  }
+
+  virtual const char* Name() const {
+    return "leveldb.CacheLocalBloomFilter";
+  }
+
+  virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const {
+    // Round the filter up to a whole number of lines (at least one)
+    size_t lines = (n * bits_per_key_ + kLineBits - 1) / kLineBits;
+    if (lines < 1) lines = 1;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + lines * kLineBytes, 0);
+    dst->push_back(static_cast<char>(k_));  // Remember # of probes in filter
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      const uint32_t h = BloomHash(keys[i]);
+      char* line = array + ((static_cast<uint64_t>(h) * lines) >> 32) *
+                           kLineBytes;
+      uint32_t probe = NextProbe(h);
+      for (size_t j = 0; j < k_; j++) {
+        const uint32_t bitpos = probe >> 23;
+        line[bitpos/8] |= (1 << (bitpos % 8));
+        probe = NextProbe(probe);
+      }
+    }
+  }
+
+  virtual bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const {
+    const size_t len = bloom_filter.size();
+    if (len < 2) return false;
+
+    const char* array = bloom_filter.data();
+    const size_t k = array[len-1];
+    if (k > 30 || (len - 1) % kLineBytes != 0) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+    const size_t lines = (len - 1) / kLineBytes;
+
+    const uint32_t h = BloomHash(key);
+    const char* line = array + ((static_cast<uint64_t>(h) * lines) >> 32) *
+                               kLineBytes;
+    uint32_t probe = NextProbe(h);
+    for (size_t j = 0; j < k; j++) {
+      const uint32_t bitpos = probe >> 23;
+      if ((line[bitpos/8] & (1 << (bitpos % 8))) == 0) return false;
+      probe = NextProbe(probe);
+    }
+    return true;
+  }
+};
 }
 
 const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
   return new BloomFilterPolicy(bits_per_key);
 }
 
+const FilterPolicy* NewCacheLocalBloomFilterPolicy(int bits_per_key) {
+  return new CacheLocalBloomFilterPolicy(bits_per_key);
+}
+
 }  // namespace leveldb
@@ -4,6 +4,7 @@
 
 #include "leveldb/filter_policy.h"
 
+#include "leveldb/env.h"
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/testharness.h"
@@ -18,6 +19,19 @@ static Slice Key(int i, char* buffer) {
   return Slice(buffer, sizeof(uint32_t));
 }
 
+static int NextLength(int length) {
+  if (length < 10) {
+    length += 1;
+  } else if (length < 100) {
+    length += 10;
+  } else if (length < 1000) {
+    length += 100;
+  } else {
+    length += 1000;
+  }
+  return length;
+}
+
 class BloomTest {
  private:
   const FilterPolicy* policy_;
@@ -31,6 +45,12 @@ class BloomTest {
     delete policy_;
   }
 
+  void SetPolicy(const FilterPolicy* policy) {
+    delete policy_;
+    policy_ = policy;
+    Reset();
+  }
+
   void Reset() {
     keys_.clear();
     filter_.clear();
@@ -84,73 +104,132 @@ class BloomTest {
     }
     return result / 10000.0;
   }
-};
 
-TEST(BloomTest, EmptyFilter) {
-  ASSERT_TRUE(! Matches("hello"));
-  ASSERT_TRUE(! Matches("world"));
-}
-
-TEST(BloomTest, Small) {
-  Add("hello");
-  Add("world");
-  ASSERT_TRUE(Matches("hello"));
-  ASSERT_TRUE(Matches("world"));
-  ASSERT_TRUE(! Matches("x"));
-  ASSERT_TRUE(! Matches("foo"));
-}
+  void CheckEmptyFilter() {
+    ASSERT_TRUE(! Matches("hello"));
+    ASSERT_TRUE(! Matches("world"));
+  }
 
-static int NextLength(int length) {
-  if (length < 10) {
-    length += 1;
-  } else if (length < 100) {
-    length += 10;
-  } else if (length < 1000) {
-    length += 100;
-  } else {
-    length += 1000;
+  void CheckSmall() {
+    Add("hello");
+    Add("world");
+    ASSERT_TRUE(Matches("hello"));
+    ASSERT_TRUE(Matches("world"));
+    ASSERT_TRUE(! Matches("x"));
+    ASSERT_TRUE(! Matches("foo"));
   }
-  return length;
-}
 
-TEST(BloomTest, VaryingLengths) {
-  char buffer[sizeof(int)];
+  // Filters may use at most "bits_per_key" bits per key plus "slop"
+  // bytes of fixed overhead.
+  void CheckVaryingLengths(int bits_per_key, int slop) {
+    char buffer[sizeof(int)];
+
+    // Count number of filters that significantly exceed the false
+    // positive rate
+    int mediocre_filters = 0;
+    int good_filters = 0;
 
-  // Count number of filters that significantly exceed the false positive rate
-  int mediocre_filters = 0;
-  int good_filters = 0;
+    for (int length = 1; length <= 10000; length = NextLength(length)) {
+      Reset();
+      for (int i = 0; i < length; i++) {
+        Add(Key(i, buffer));
+      }
+      Build();
 
-  for (int length = 1; length <= 10000; length = NextLength(length)) {
+      ASSERT_LE(FilterSize(),
+                static_cast<size_t>((length * bits_per_key / 8) + slop))
+          << length;
+
+      // All added keys must match
+      for (int i = 0; i < length; i++) {
+        ASSERT_TRUE(Matches(Key(i, buffer)))
+            << "Length " << length << "; key " << i;
+      }
+
+      // Check false positive rate
+      double rate = FalsePositiveRate();
+      if (kVerbose >= 1) {
+        fprintf(stderr,
+                "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                rate*100.0, length, static_cast<int>(FilterSize()));
+      }
+      ASSERT_LE(rate, 0.02);   // Must not be over 2%
+      if (rate > 0.0125) mediocre_filters++;  // Allowed, but not too often
+      else good_filters++;
+    }
+    if (kVerbose >= 1) {
+      fprintf(stderr, "Filters: %d good, %d mediocre\n",
+              good_filters, mediocre_filters);
+    }
+    ASSERT_LE(mediocre_filters, good_filters/5);
+  }
+
+  // Build one large filter and report its size, false positive rate and
+  // the cost of a negative lookup.
+  void ReportProbeCost(const char* label) {
+    const int kKeys = 1000000;
+    char buffer[sizeof(int)];
     Reset();
-    for (int i = 0; i < length; i++) {
+    for (int i = 0; i < kKeys; i++) {
       Add(Key(i, buffer));
     }
     Build();
 
-    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
-        << length;
-
-    // All added keys must match
-    for (int i = 0; i < length; i++) {
-      ASSERT_TRUE(Matches(Key(i, buffer)))
-          << "Length " << length << "; key " << i;
+    // Probe in a scattered order so consecutive lookups do not share
+    // cache lines.
+    Env* env = Env::Default();
+    int matches = 0;
+    const uint64_t start = env->NowMicros();
+    for (int i = 0; i < kKeys; i++) {
+      const int k = 1000000000 + static_cast<int>((i * 2654435761u) % kKeys);
+      if (policy_->KeyMayMatch(Key(k, buffer), filter_)) {
+        matches++;
+      }
     }
-
-    // Check false positive rate
-    double rate = FalsePositiveRate();
+    const uint64_t micros = env->NowMicros() - start;
     if (kVerbose >= 1) {
-      fprintf(stderr, "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
-              rate*100.0, length, static_cast<int>(FilterSize()));
+      fprintf(stderr, "%-18s %5.2f bits/key ; FP %5.2f%% ; %6.1f ns/probe\n",
+              label, FilterSize() * 8.0 / kKeys, matches * 100.0 / kKeys,
+              micros * 1000.0 / kKeys);
     }
-    ASSERT_LE(rate, 0.02);   // Must not be over 2%
-    if (rate > 0.0125) mediocre_filters++;  // Allowed, but not too often
-    else good_filters++;
-  }
-  if (kVerbose >= 1) {
-    fprintf(stderr, "Filters: %d good, %d mediocre\n",
-            good_filters, mediocre_filters);
+    ASSERT_LE(matches, kKeys / 50);
   }
-  ASSERT_LE(mediocre_filters, good_filters/5);
+};
+
+TEST(BloomTest, EmptyFilter) {
+  CheckEmptyFilter();
+}
+
+TEST(BloomTest, Small) {
+  CheckSmall();
+}
+
+TEST(BloomTest, VaryingLengths) {
+  CheckVaryingLengths(10, 40);
+}
+
+TEST(BloomTest, CacheLocal) {
+  SetPolicy(NewCacheLocalBloomFilterPolicy(10));
+  CheckEmptyFilter();
+  CheckSmall();
+  // Filters are rounded up to whole 64-byte lines
+  CheckVaryingLengths(10, 65);
+}
+
+TEST(BloomTest, Ribbon) {
+  SetPolicy(NewRibbonFilterPolicy(10));
+  CheckEmptyFilter();
+  CheckSmall();
+  // Smaller than a bloom filter, but never less than one 64-slot block
+  CheckVaryingLengths(8, 7 * 8 + 2);
+}
+
+TEST(BloomTest, ProbeCost) {
+  ReportProbeCost("bloom");
+  SetPolicy(NewCacheLocalBloomFilterPolicy(10));
+  ReportProbeCost("cache-local bloom");
+  SetPolicy(NewRibbonFilterPolicy(10));
+  ReportProbeCost("ribbon");
 }
 
 // Different bits-per-byte
@@ -22,6 +22,8 @@ namespace {
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
+// The list is split at a midpoint: entries after it belong to the
+// high-priority pool.
 struct LRUHandle 
 {
   void* value;
@@ -33,6 +35,7 @@ struct LRUHandle
   size_t key_length;
   uint32_t refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool in_high_pri_pool;
   char key_data[1];   // Beginning of key
 
   Slice key() const 
@@ -167,12 +170,17 @@ class LRUCache
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio)
+  {
+    capacity_ = capacity;
+    high_pri_capacity_ = static_cast<size_t>(capacity * high_pri_pool_ratio);
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -187,27 +195,36 @@ class LRUCache
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* e);
+  void LRU_InsertAtMidpoint(LRUHandle* e);
+  void MaintainPoolSize();
   void Unref(LRUHandle* e);
 
   // Initialized before use.
   size_t capacity_;
+  size_t high_pri_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_;
+  size_t high_pri_usage_;
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
+  // Newest entry outside of the high-priority pool, or &lru_ if there
+  // is none.  Entries after it form the pool.
+  LRUHandle* lru_low_pri_;
+
   HandleTable table_;
 };
 
-LRUCache::LRUCache() : usage_(0)
+LRUCache::LRUCache() : capacity_(0), high_pri_capacity_(0), usage_(0), high_pri_usage_(0)
 {
   // Make empty circular linked list
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  lru_low_pri_ = &lru_;
 }
 
 LRUCache::~LRUCache()
@@ -235,6 +252,15 @@ void LRUCache::Unref(LRUHandle* e)
 
 void LRUCache::LRU_Remove(LRUHandle* e)
 {
+  if (e == lru_low_pri_)
+  {
+    lru_low_pri_ = e->prev;
+  }
+  if (e->in_high_pri_pool)
+  {
+    high_pri_usage_ -= e->charge;
+    e->in_high_pri_pool = false;
+  }
   e->next->prev = e->prev;
   e->prev->next = e->next;
 }
@@ -246,6 +272,33 @@ void LRUCache::LRU_Append(LRUHandle* e)
   e->prev = lru_.prev;
   e->prev->next = e;
   e->next->prev = e;
+  e->in_high_pri_pool = true;
+  high_pri_usage_ += e->charge;
+  MaintainPoolSize();
+}
+
+void LRUCache::LRU_InsertAtMidpoint(LRUHandle* e)
+{
+  // Make "e" the newest entry outside of the high-priority pool
+  e->next = lru_low_pri_->next;
+  e->prev = lru_low_pri_;
+  e->prev->next = e;
+  e->next->prev = e;
+  e->in_high_pri_pool = false;
+  lru_low_pri_ = e;
+}
+
+void LRUCache::MaintainPoolSize()
+{
+  // Move the oldest entries of an overflowing pool to the midpoint
+  while (high_pri_usage_ > high_pri_capacity_)
+  {
+    LRUHandle* e = lru_low_pri_->next;
+    assert(e != &lru_ && e->in_high_pri_pool);
+    e->in_high_pri_pool = false;
+    high_pri_usage_ -= e->charge;
+    lru_low_pri_ = e;
+  }
 }
 
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) 
@@ -253,6 +306,7 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash)
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   //先移除，在放到链表的最后面
+  // An entry found again is promoted to the high-priority pool
   if (e != NULL) 
   {
     e->refs++;
@@ -269,7 +323,7 @@ void LRUCache::Release(Cache::Handle* handle)
 }
 
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value, size_t charge, 
-	void (*deleter)(const Slice& key, void* value)) 
+	void (*deleter)(const Slice& key, void* value), Cache::Priority priority) 
 {
   MutexLock l(&mutex_);
   LRUHandle* e = reinterpret_cast<LRUHandle*>(malloc(sizeof(LRUHandle)-1 + key.size()));
@@ -279,8 +333,16 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value, si
   e->key_length = key.size();
   e->hash = hash;
   e->refs = 2;  // One from LRUCache, one for the returned handle
+  e->in_high_pri_pool = false;
   memcpy(e->key_data, key.data(), key.size());
-  LRU_Append(e);
+  if (priority == Cache::kHighPriority)
+  {
+    LRU_Append(e);
+  }
+  else
+  {
+    LRU_InsertAtMidpoint(e);
+  }
   usage_ += charge;
 
   //如果返回old != NULL，删除原先那个
@@ -349,22 +411,23 @@ class ShardedLRUCache : public Cache
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity)
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
       : last_id_(0) 
   {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) 
 	{
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
 
   virtual ~ShardedLRUCache() { }
 
-  virtual Handle* Insert(const Slice& key, void* value, size_t charge, void (*deleter)(const Slice& key, void* value))
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge, void (*deleter)(const Slice& key, void* value),
+                         Priority priority)
   {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter, priority);
   }
 
   virtual Handle* Lookup(const Slice& key) 
@@ -414,7 +477,13 @@ class ShardedLRUCache : public Cache
 
 Cache* NewLRUCache(size_t capacity)
 {
-  return new ShardedLRUCache(capacity);
+  return new ShardedLRUCache(capacity, 0.0);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio)
+{
+  assert(high_pri_pool_ratio >= 0.0 && high_pri_pool_ratio <= 1.0);
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
 }
 
 }  // namespace leveldb
@@ -4,8 +4,14 @@
 
 #include "leveldb/cache.h"
 
+#include <math.h>
+#include <algorithm>
 #include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -54,9 +60,20 @@ class CacheTest {
     return r;
   }
 
-  void Insert(int key, int value, int charge = 1) {
+  void Insert(int key, int value, int charge = 1,
+              Cache::Priority priority = Cache::kLowPriority) {
     cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
-                                   &CacheTest::Deleter));
+                                   &CacheTest::Deleter, priority));
+  }
+
+  void UseHighPriPool(double ratio) {
+    delete cache_;
+    cache_ = NewLRUCache(kCacheSize, ratio);
+  }
+
+  void UseClockCache() {
+    delete cache_;
+    cache_ = NewClockCache(kCacheSize, 4, 1);
   }
 
   void Erase(int key) {
@@ -173,6 +190,278 @@ TEST(CacheTest, HeavyEntries) {
   ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
 }
 
+TEST(CacheTest, MidpointInsertion) {
+  UseHighPriPool(0.5);
+
+  // Entries found again move to the high-priority pool
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 1000+i);
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+
+  // A scan inserts many entries that are never used again
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(10000+i, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(10000));
+}
+
+TEST(CacheTest, HighPriorityInsert) {
+  UseHighPriPool(0.5);
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 1000+i, 1, Cache::kHighPriority);
+  }
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(10000+i, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+
+  // Without a pool the same scan evicts them
+  UseHighPriPool(0.0);
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 1000+i, 1, Cache::kHighPriority);
+  }
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(10000+i, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+  }
+}
+
+TEST(CacheTest, HighPriPoolOverflow) {
+  // High-priority entries beyond the pool age out like other entries
+  UseHighPriPool(0.5);
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(i, 1000+i, 1, Cache::kHighPriority);
+  }
+  ASSERT_LE(cache_->TotalCharge(), static_cast<size_t>(kCacheSize + kCacheSize/10));
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(1000 + 2*kCacheSize-1, Lookup(2*kCacheSize-1));
+}
+
+// Point lookups of keys drawn from a zipfian distribution over
+// kNumKeys keys, interleaved with scans of keys that are read once.
+// Every miss inserts the key, as a read with fill_cache would.
+// Returns the hit rate of the point lookups.
+static double ZipfianWithScansHitRate(Cache* cache) {
+  const int kNumKeys = 10000;
+  const int kLookups = 200000;
+  const int kLookupsPerScan = 500;
+  const int kScanLength = 2000;
+
+  std::vector<double> cdf(kNumKeys);
+  double sum = 0;
+  for (int i = 0; i < kNumKeys; i++) {
+    sum += 1.0 / pow(i + 1, 0.99);
+    cdf[i] = sum;
+  }
+
+  Random rnd(301);
+  int hits = 0;
+  int scanned = 0;
+  for (int n = 0; n < kLookups; n++) {
+    const double u = (rnd.Next() / 2147483647.0) * sum;
+    const int key = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    Cache::Handle* h = cache->Lookup(EncodeKey(key));
+    if (h != NULL) {
+      hits++;
+    } else {
+      h = cache->Insert(EncodeKey(key), EncodeValue(key), 1,
+                        &CacheTest::Deleter);
+    }
+    cache->Release(h);
+    if (n % kLookupsPerScan == 0) {
+      for (int i = 0; i < kScanLength; i++) {
+        const int key = kNumKeys + scanned++;
+        cache->Release(cache->Insert(EncodeKey(key), EncodeValue(key), 1,
+                                     &CacheTest::Deleter));
+      }
+    }
+  }
+  return static_cast<double>(hits) / kLookups;
+}
+
+TEST(CacheTest, ZipfianWithScansHitRate) {
+  double hit_rate[2];
+  for (int pool = 0; pool < 2; pool++) {
+    UseHighPriPool(pool ? 0.5 : 0.0);
+    hit_rate[pool] = ZipfianWithScansHitRate(cache_);
+  }
+  fprintf(stderr, "zipfian point lookups mixed with scans: "
+          "hit rate %.1f%% LRU, %.1f%% with high-priority pool\n",
+          hit_rate[0] * 100, hit_rate[1] * 100);
+  ASSERT_GT(hit_rate[1], hit_rate[0]);
+}
+
+TEST(CacheTest, ClockHitAndMiss) {
+  UseClockCache();
+  ASSERT_EQ(-1, Lookup(100));
+
+  Insert(100, 101);
+  Insert(200, 201);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(-1,  Lookup(300));
+
+  Insert(100, 102);
+  ASSERT_EQ(102, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(100, deleted_keys_[0]);
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  Erase(100);
+  ASSERT_EQ(-1,  Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(2, deleted_keys_.size());
+  Erase(100);
+  ASSERT_EQ(2, deleted_keys_.size());
+}
+
+TEST(CacheTest, ClockEntriesArePinned) {
+  UseClockCache();
+  Insert(100, 101);
+  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+  Insert(100, 102);
+  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  ASSERT_EQ(0, deleted_keys_.size());
+
+  cache_->Release(h1);
+  ASSERT_EQ(1, deleted_keys_.size());
+  ASSERT_EQ(101, deleted_values_[0]);
+
+  // Pinned entries survive eviction
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+  Erase(100);
+  ASSERT_EQ(-1, Lookup(100));
+  const size_t deleted = deleted_keys_.size();
+  cache_->Release(h2);
+  ASSERT_EQ(deleted + 1, deleted_keys_.size());
+  ASSERT_EQ(102, deleted_values_.back());
+}
+
+TEST(CacheTest, ClockEvictionPolicy) {
+  UseClockCache();
+  Insert(100, 101);
+  Insert(200, 201);
+
+  // Frequently used entry must be kept around.  Others live through at
+  // most a few sweeps of the clock hand.
+  for (int i = 0; i < 4*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+    ASSERT_EQ(101, Lookup(100));
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST(CacheTest, ClockHeavyEntries) {
+  UseClockCache();
+  int index = 0;
+  int added = 0;
+  while (added < 4*kCacheSize) {
+    const int weight = (index & 1) ? 1 : 10;
+    Insert(index, 1000+index, weight);
+    added += weight;
+    index++;
+  }
+  ASSERT_LE(cache_->TotalCharge(), static_cast<size_t>(kCacheSize + kCacheSize/10));
+  ASSERT_EQ(1000 + index-1, Lookup(index-1));
+
+  cache_->Prune();
+  ASSERT_EQ(0u, cache_->TotalCharge());
+  ASSERT_EQ(static_cast<size_t>(index), deleted_keys_.size());
+}
+
+namespace {
+
+struct ClockCacheThreadState {
+  Cache* cache;
+  int id;
+  port::Mutex mu;
+  int done;
+  port::CondVar cv;
+  bool ok;
+
+  ClockCacheThreadState() : done(0), cv(&mu), ok(true) { }
+};
+
+struct ClockCacheThreadArg {
+  ClockCacheThreadState* state;
+  int id;
+};
+
+static void CheckedDeleter(const Slice& key, void* v) {
+  ASSERT_EQ(DecodeKey(key), DecodeValue(v));
+}
+
+static void ClockCacheThreadBody(void* arg) {
+  ClockCacheThreadArg* a = reinterpret_cast<ClockCacheThreadArg*>(arg);
+  Cache* cache = a->state->cache;
+  Random rnd(1000 + a->id);
+  bool ok = true;
+  for (int i = 0; i < 200000; i++) {
+    const int key = rnd.Skewed(12);
+    switch (rnd.Uniform(10)) {
+      case 0:
+        cache->Erase(EncodeKey(key));
+        break;
+      case 1:
+      case 2:
+        cache->Release(cache->Insert(EncodeKey(key), EncodeValue(key), 1,
+                                     &CheckedDeleter));
+        break;
+      default: {
+        Cache::Handle* h = cache->Lookup(EncodeKey(key));
+        if (h != NULL) {
+          ok = ok && (DecodeValue(cache->Value(h)) == key);
+          cache->Release(h);
+        }
+        break;
+      }
+    }
+  }
+  MutexLock l(&a->state->mu);
+  a->state->ok = a->state->ok && ok;
+  a->state->done++;
+  a->state->cv.Signal();
+}
+
+}  // namespace
+
+TEST(CacheTest, ClockConcurrentAccess) {
+  const int kNumThreads = 8;
+  ClockCacheThreadState state;
+  state.cache = NewClockCache(100, 2, 1);
+  ClockCacheThreadArg args[kNumThreads];
+  for (int i = 0; i < kNumThreads; i++) {
+    args[i].state = &state;
+    args[i].id = i;
+    Env::Default()->StartThread(&ClockCacheThreadBody, &args[i]);
+  }
+  {
+    MutexLock l(&state.mu);
+    while (state.done < kNumThreads) {
+      state.cv.Wait();
+    }
+  }
+  ASSERT_TRUE(state.ok);
+  ASSERT_LE(state.cache->TotalCharge(), 100u);
+  delete state.cache;
+}
+
 TEST(CacheTest, NewId) {
   uint64_t a = cache_->NewId();
   uint64_t b = cache_->NewId();
@@ -0,0 +1,470 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Cache whose Lookup() and Release() take no locks.  Each shard is an
+// open-addressed table of slots, and the state of a slot (including the
+// reference count of its entry) is a single atomic word, so a reader
+// claims an entry with one compare-and-swap.  Insert(), Erase() and
+// eviction still serialize on a per-shard mutex, but never block
+// readers.
+//
+// Eviction sweeps a clock hand over the slots.  A hit sets the
+// countdown of an entry to the maximum, the hand decrements it, and the
+// hand evicts unreferenced entries whose countdown has reached zero.
+// High priority entries start with the maximum countdown, others with
+// one, so entries that are used once go first.
+
+#include "leveldb/cache.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "port/port.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// Slot states
+enum {
+  kEmpty = 0,         // No entry
+  kConstruction = 1,  // Owned by a writer that is filling or clearing it
+  kVisible = 2,       // Entry can be found by Lookup()
+  kInvisible = 3      // Erased or replaced entry, freed by its last Release()
+};
+
+// Layout of the state word of a slot: state, clock countdown, and the
+// reference count in the remaining high bits.
+static const int kCountdownShift = 2;
+static const int kRefsShift = 4;
+static const uintptr_t kStateMask = 3;
+static const uintptr_t kMaxCountdown = 3;
+static const uintptr_t kOneRef = static_cast<uintptr_t>(1) << kRefsShift;
+
+static inline int State(uintptr_t meta) {
+  return static_cast<int>(meta & kStateMask);
+}
+static inline uintptr_t Countdown(uintptr_t meta) {
+  return (meta >> kCountdownShift) & kMaxCountdown;
+}
+static inline uintptr_t Refs(uintptr_t meta) {
+  return meta >> kRefsShift;
+}
+static inline uintptr_t MakeMeta(int state, uintptr_t countdown, uintptr_t refs) {
+  return (refs << kRefsShift) | (countdown << kCountdownShift) | state;
+}
+
+// Fraction of the slots of a shard that may hold entries
+static const double kMaxLoadFactor = 0.75;
+
+struct ClockHandle {
+  // State word; see MakeMeta()
+  port::AtomicPointer meta;
+
+  // Number of entries whose probe sequence passes over this slot.  A
+  // lookup can stop at a slot that no entry passes.  Only changed under
+  // the shard mutex.
+  port::AtomicPointer displacements;
+
+  // Only written while the slot is kEmpty or kConstruction
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  size_t charge;
+  char* key_data;
+  size_t key_length;
+  uint32_t hash;
+  bool detached;     // Not in the table, because it had no room
+
+  void Init() {
+    meta.NoBarrier_Store(reinterpret_cast<void*>(MakeMeta(kEmpty, 0, 0)));
+    displacements.NoBarrier_Store(NULL);
+    key_data = NULL;
+    detached = false;
+  }
+
+  uintptr_t LoadMeta() const {
+    return reinterpret_cast<uintptr_t>(meta.Acquire_Load());
+  }
+
+  bool CasMeta(uintptr_t expected, uintptr_t desired) {
+    return meta.CompareAndSwap(reinterpret_cast<void*>(expected),
+                               reinterpret_cast<void*>(desired));
+  }
+
+  uintptr_t LoadDisplacements() const {
+    return reinterpret_cast<uintptr_t>(displacements.Acquire_Load());
+  }
+
+  void AddDisplacements(int delta) {
+    displacements.Release_Store(
+        reinterpret_cast<void*>(LoadDisplacements() + delta));
+  }
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+// A single shard of sharded cache.
+class ClockCacheShard {
+ public:
+  ClockCacheShard()
+      : capacity_(0), mask_(0), max_occupancy_(0), slots_(NULL),
+        usage_(0), occupancy_(0), clock_hand_(0) { }
+  ~ClockCacheShard();
+
+  // Separate from constructor so caller can easily make an array of shards
+  void Init(size_t capacity, size_t estimated_entry_charge);
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+
+  size_t TotalCharge() const {
+    MutexLock l(&mutex_);
+    return usage_;
+  }
+
+ private:
+  // Double hashing: every slot is probed once since the table size is a
+  // power of two and the step is odd.
+  uint32_t Start(uint32_t hash) const { return hash & mask_; }
+  uint32_t Step(uint32_t hash) const {
+    return ((hash * 0x9e3779b9u) >> 7) | 1;
+  }
+
+  // Drop a reference to h.  Returns true if it was the last reference
+  // to an entry that is no longer visible.
+  static bool Unref(ClockHandle* h);
+
+  // REQUIRES: mutex_ held
+  ClockHandle* FindVisible(const Slice& key, uint32_t hash);
+  void MakeInvisible(ClockHandle* h);
+  bool EvictOne();
+  void Free(ClockHandle* h);
+
+  // Initialized before use.
+  size_t capacity_;
+  uint32_t mask_;
+  size_t max_occupancy_;
+  ClockHandle* slots_;
+
+  // mutex_ protects the following state, and all state changes of a
+  // slot other than taking and dropping references.
+  mutable port::Mutex mutex_;
+  size_t usage_;
+  size_t occupancy_;      // Slots that are not kEmpty
+  uint32_t clock_hand_;
+};
+
+void ClockCacheShard::Init(size_t capacity, size_t estimated_entry_charge) {
+  capacity_ = capacity;
+  size_t entries = capacity / (estimated_entry_charge > 0 ? estimated_entry_charge : 1);
+  size_t num_slots = 16;
+  while (num_slots * kMaxLoadFactor < entries) {
+    num_slots *= 2;
+  }
+  mask_ = static_cast<uint32_t>(num_slots - 1);
+  max_occupancy_ = static_cast<size_t>(num_slots * kMaxLoadFactor);
+  slots_ = new ClockHandle[num_slots];
+  for (size_t i = 0; i < num_slots; i++) {
+    slots_[i].Init();
+  }
+}
+
+ClockCacheShard::~ClockCacheShard() {
+  if (slots_ == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i <= mask_; i++) {
+    ClockHandle* h = &slots_[i];
+    const uintptr_t meta = h->LoadMeta();
+    assert(State(meta) == kEmpty || State(meta) == kVisible);
+    assert(Refs(meta) == 0);  // Error if caller has an unreleased handle
+    if (State(meta) == kVisible) {
+      (*h->deleter)(h->key(), h->value);
+      delete[] h->key_data;
+    }
+  }
+  delete[] slots_;
+}
+
+bool ClockCacheShard::Unref(ClockHandle* h) {
+  uintptr_t meta;
+  do {
+    meta = h->LoadMeta();
+    assert(Refs(meta) > 0);
+  } while (!h->CasMeta(meta, meta - kOneRef));
+  return Refs(meta) == 1 && State(meta) == kInvisible;
+}
+
+Cache::Handle* ClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+  const uint32_t step = Step(hash);
+  uint32_t index = Start(hash);
+  for (uint32_t probes = 0; probes <= mask_; probes++) {
+    ClockHandle* h = &slots_[index];
+    uintptr_t meta = h->LoadMeta();
+    while (State(meta) == kVisible) {
+      // The entry cannot be evicted or replaced while we hold a
+      // reference, so take one before looking at its key.
+      if (!h->CasMeta(meta, meta + kOneRef)) {
+        meta = h->LoadMeta();
+        continue;
+      }
+      if (h->hash == hash && h->key() == key) {
+        // Mark as recently used; losing a race with the clock hand is fine
+        meta += kOneRef;
+        if (Countdown(meta) < kMaxCountdown) {
+          h->CasMeta(meta, MakeMeta(kVisible, kMaxCountdown, Refs(meta)));
+        }
+        return reinterpret_cast<Cache::Handle*>(h);
+      }
+      if (Unref(h)) {
+        MutexLock l(&mutex_);
+        Free(h);
+      }
+      break;
+    }
+    if (h->LoadDisplacements() == 0) {
+      break;
+    }
+    index = (index + step) & mask_;
+  }
+  return NULL;
+}
+
+void ClockCacheShard::Release(Cache::Handle* handle) {
+  ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+  if (Unref(h)) {
+    // Nobody else can reach an invisible entry without references
+    MutexLock l(&mutex_);
+    Free(h);
+  }
+}
+
+ClockHandle* ClockCacheShard::FindVisible(const Slice& key, uint32_t hash) {
+  const uint32_t step = Step(hash);
+  uint32_t index = Start(hash);
+  for (uint32_t probes = 0; probes <= mask_; probes++) {
+    ClockHandle* h = &slots_[index];
+    // Holding mutex_, so a visible entry stays as it is
+    if (State(h->LoadMeta()) == kVisible && h->hash == hash && h->key() == key) {
+      return h;
+    }
+    if (h->LoadDisplacements() == 0) {
+      break;
+    }
+    index = (index + step) & mask_;
+  }
+  return NULL;
+}
+
+void ClockCacheShard::MakeInvisible(ClockHandle* h) {
+  for (;;) {
+    const uintptr_t meta = h->LoadMeta();
+    assert(State(meta) == kVisible);
+    if (Refs(meta) == 0) {
+      if (h->CasMeta(meta, MakeMeta(kConstruction, 0, 0))) {
+        Free(h);
+        return;
+      }
+    } else if (h->CasMeta(meta, MakeMeta(kInvisible, 0, Refs(meta)))) {
+      // Freed by the last Release()
+      return;
+    }
+  }
+}
+
+bool ClockCacheShard::EvictOne() {
+  // Enough steps for the countdown of every entry to reach zero
+  const size_t max_steps = (static_cast<size_t>(mask_) + 1) * (kMaxCountdown + 1);
+  for (size_t n = 0; n < max_steps; n++) {
+    ClockHandle* h = &slots_[clock_hand_];
+    clock_hand_ = (clock_hand_ + 1) & mask_;
+    const uintptr_t meta = h->LoadMeta();
+    if (State(meta) != kVisible || Refs(meta) != 0) {
+      continue;
+    }
+    if (Countdown(meta) > 0) {
+      h->CasMeta(meta, MakeMeta(kVisible, Countdown(meta) - 1, 0));
+    } else if (h->CasMeta(meta, MakeMeta(kConstruction, 0, 0))) {
+      Free(h);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockCacheShard::Free(ClockHandle* h) {
+  (*h->deleter)(h->key(), h->value);
+  delete[] h->key_data;
+  h->key_data = NULL;
+  usage_ -= h->charge;
+  if (h->detached) {
+    delete h;
+    return;
+  }
+
+  // Undo the displacements of the entry's probe sequence
+  const uint32_t step = Step(h->hash);
+  for (uint32_t index = Start(h->hash); &slots_[index] != h; index = (index + step) & mask_) {
+    slots_[index].AddDisplacements(-1);
+  }
+  occupancy_--;
+  h->meta.Release_Store(reinterpret_cast<void*>(MakeMeta(kEmpty, 0, 0)));
+}
+
+Cache::Handle* ClockCacheShard::Insert(const Slice& key, uint32_t hash, void* value, size_t charge,
+                                       void (*deleter)(const Slice& key, void* value),
+                                       Cache::Priority priority) {
+  MutexLock l(&mutex_);
+  ClockHandle* old = FindVisible(key, hash);
+  if (old != NULL) {
+    MakeInvisible(old);
+  }
+  while ((usage_ + charge > capacity_ || occupancy_ >= max_occupancy_) && EvictOne()) {
+  }
+
+  ClockHandle* h = NULL;
+  if (occupancy_ < max_occupancy_) {
+    const uint32_t step = Step(hash);
+    uint32_t index = Start(hash);
+    while (State(slots_[index].LoadMeta()) != kEmpty) {
+      slots_[index].AddDisplacements(1);
+      index = (index + step) & mask_;
+    }
+    h = &slots_[index];
+    occupancy_++;
+  } else {
+    // Every slot is referenced: hand out an entry that no Lookup()
+    // will find, like an LRU cache over its capacity would
+    h = new ClockHandle;
+    h->Init();
+    h->detached = true;
+  }
+
+  h->value = value;
+  h->deleter = deleter;
+  h->charge = charge;
+  h->key_length = key.size();
+  h->key_data = new char[key.size()];
+  memcpy(h->key_data, key.data(), key.size());
+  h->hash = hash;
+  usage_ += charge;
+
+  const uintptr_t countdown = (priority == Cache::kHighPriority ? kMaxCountdown : 1);
+  h->meta.Release_Store(reinterpret_cast<void*>(
+      MakeMeta(h->detached ? kInvisible : kVisible, countdown, 1)));
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  ClockHandle* h = FindVisible(key, hash);
+  if (h != NULL) {
+    MakeInvisible(h);
+  }
+}
+
+void ClockCacheShard::Prune() {
+  MutexLock l(&mutex_);
+  for (uint32_t i = 0; i <= mask_; i++) {
+    ClockHandle* h = &slots_[i];
+    const uintptr_t meta = h->LoadMeta();
+    if (State(meta) == kVisible && Refs(meta) == 0 &&
+        h->CasMeta(meta, MakeMeta(kConstruction, 0, 0))) {
+      Free(h);
+    }
+  }
+}
+
+class ShardedClockCache : public Cache {
+ private:
+  ClockCacheShard* shards_;
+  int num_shard_bits_;
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  uint32_t Shard(uint32_t hash) const {
+    return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
+  }
+
+ public:
+  ShardedClockCache(size_t capacity, int num_shard_bits, size_t estimated_entry_charge)
+      : num_shard_bits_(num_shard_bits),
+        last_id_(0) {
+    const int num_shards = 1 << num_shard_bits;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    shards_ = new ClockCacheShard[num_shards];
+    for (int s = 0; s < num_shards; s++) {
+      shards_[s].Init(per_shard, estimated_entry_charge);
+    }
+  }
+
+  virtual ~ShardedClockCache() {
+    delete[] shards_;
+  }
+
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
+    const uint32_t hash = HashSlice(key);
+    return shards_[Shard(hash)].Insert(key, hash, value, charge, deleter, priority);
+  }
+  virtual Handle* Lookup(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    return shards_[Shard(hash)].Lookup(key, hash);
+  }
+  virtual void Release(Handle* handle) {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shards_[Shard(h->hash)].Release(handle);
+  }
+  virtual void Erase(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    shards_[Shard(hash)].Erase(key, hash);
+  }
+  virtual void* Value(Handle* handle) {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  virtual uint64_t NewId() {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  virtual void Prune() {
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      shards_[s].Prune();
+    }
+  }
+  virtual size_t TotalCharge() const {
+    size_t total = 0;
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      total += shards_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity) {
+  return new ShardedClockCache(capacity, 4, 4096);
+}
+
+Cache* NewClockCache(size_t capacity, int num_shard_bits,
+                     size_t estimated_entry_charge) {
+  assert(num_shard_bits >= 0 && num_shard_bits <= 20);
+  return new ShardedClockCache(capacity, num_shard_bits, estimated_entry_charge);
+}
+
+}  // namespace leveldb
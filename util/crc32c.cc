@@ -3,11 +3,13 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
 // A portable implementation of crc32c, optimized to handle
-// four bytes at a time.
+// four bytes at a time.  Extend() forwards to the hardware versions in
+// port::AcceleratedCRC32C() when the CPU supports them.
 
 #include "util/crc32c.h"
 
 #include <stdint.h>
+#include "port/port.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -283,7 +285,7 @@ static inline uint32_t LE_LOAD32(const uint8_t *p) {
   return DecodeFixed32(reinterpret_cast<const char*>(p));
 }
 
-uint32_t Extend(uint32_t crc, const char* buf, size_t size) {
+static uint32_t ExtendPortable(uint32_t crc, const char* buf, size_t size) {
   const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
   const uint8_t *e = p + size;
   uint32_t l = crc ^ 0xffffffffu;
@@ -328,5 +330,71 @@ uint32_t Extend(uint32_t crc, const char* buf, size_t size) {
   return l ^ 0xffffffffu;
 }
 
+bool IsSupported(Implementation impl) {
+  switch (impl) {
+    case kPortable:
+      return true;
+    case kSSE42:
+      return port::HasAcceleratedCRC32C(false);
+    case kSSE42Pclmul:
+      return port::HasAcceleratedCRC32C(true);
+  }
+  return false;
+}
+
+const char* ImplementationName(Implementation impl) {
+  switch (impl) {
+    case kPortable:
+      return "portable";
+    case kSSE42:
+      return "sse4.2";
+    case kSSE42Pclmul:
+      return "sse4.2+pclmul";
+  }
+  return "unknown";
+}
+
+uint32_t ExtendWith(Implementation impl,
+                    uint32_t crc, const char* buf, size_t size) {
+  switch (impl) {
+    case kSSE42:
+      return port::AcceleratedCRC32C(crc, buf, size, false);
+    case kSSE42Pclmul:
+      return port::AcceleratedCRC32C(crc, buf, size, true);
+    default:
+      return ExtendPortable(crc, buf, size);
+  }
+}
+
+// Pick the fastest supported implementation whose result agrees with the
+// portable one on a buffer long enough to exercise every code path.
+static Implementation ChooseImplementation() {
+  char buf[3 * 4096 + 3 * 256 + 13];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = static_cast<char>(i * 131 + (i >> 8));
+  }
+  const uint32_t expected = ExtendPortable(0, buf, sizeof(buf));
+  for (int i = kNumImplementations - 1; i > kPortable; i--) {
+    Implementation impl = static_cast<Implementation>(i);
+    if (IsSupported(impl) && ExtendWith(impl, 0, buf, sizeof(buf)) == expected) {
+      return impl;
+    }
+  }
+  return kPortable;
+}
+
+Implementation DefaultImplementation() {
+  static const Implementation impl = ChooseImplementation();
+  return impl;
+}
+
+uint32_t Extend(uint32_t crc, const char* buf, size_t size) {
+  static const Implementation impl = DefaultImplementation();
+  if (impl == kPortable) {
+    return ExtendPortable(crc, buf, size);
+  }
+  return port::AcceleratedCRC32C(crc, buf, size, impl == kSSE42Pclmul);
+}
+
 }  // namespace crc32c
 }  // namespace leveldb
@@ -14,8 +14,34 @@ namespace crc32c {
 // Return the crc32c of concat(A, data[0,n-1]) where init_crc is the
 // crc32c of some string A.  Extend() is often used to maintain the
 // crc32c of a stream of data.
+//
+// Extend() picks the fastest implementation this CPU supports the first
+// time it is called.
 extern uint32_t Extend(uint32_t init_crc, const char* data, size_t n);
 
+// The implementations Extend() can dispatch to.  Exposed so that tests
+// and benchmarks can run each of them directly.
+enum Implementation {
+  kPortable = 0,      // Table driven, four bytes at a time
+  kSSE42 = 1,         // SSE4.2 crc32 instruction, eight bytes at a time
+  kSSE42Pclmul = 2    // Three crc32 streams merged with PCLMULQDQ
+};
+static const int kNumImplementations = 3;
+
+// Return true iff "impl" can run on this CPU.
+extern bool IsSupported(Implementation impl);
+
+// Return a short human readable name for "impl", e.g. "sse4.2".
+extern const char* ImplementationName(Implementation impl);
+
+// Return the implementation used by Extend().
+extern Implementation DefaultImplementation();
+
+// Same as Extend(), but always uses "impl".
+// REQUIRES: IsSupported(impl)
+extern uint32_t ExtendWith(Implementation impl,
+                           uint32_t init_crc, const char* data, size_t n);
+
 // Return the crc32c of data[0,n-1]
 inline uint32_t Value(const char* data, size_t n) 
 {
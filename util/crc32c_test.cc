@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/crc32c.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -56,6 +57,54 @@ TEST(CRC, Extend) {
             Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, ImplementationsStandardResults) {
+  char buf[32];
+  for (int i = 0; i < 32; i++) {
+    buf[i] = i;
+  }
+  for (int i = 0; i < kNumImplementations; i++) {
+    Implementation impl = static_cast<Implementation>(i);
+    if (!IsSupported(impl)) {
+      fprintf(stderr, "skipping %s: not supported\n", ImplementationName(impl));
+      continue;
+    }
+    ASSERT_EQ(0x46dd794e, ExtendWith(impl, 0, buf, sizeof(buf)));
+    ASSERT_EQ(Value("hello world", 11),
+              ExtendWith(impl, ExtendWith(impl, 0, "hello ", 6), "world", 5));
+  }
+  ASSERT_TRUE(IsSupported(DefaultImplementation()));
+}
+
+TEST(CRC, ImplementationsAgree) {
+  // Random lengths, alignments and initial crcs, up to sizes that go
+  // through every stream length of the three-way loop.
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 40000; i++) {
+    data.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  for (int iter = 0; iter < 2000; iter++) {
+    const size_t offset = rnd.Uniform(16);
+    size_t n;
+    if (iter < 100) {
+      n = iter;
+    } else if (rnd.OneIn(2)) {
+      n = rnd.Uniform(4096);
+    } else {
+      n = rnd.Uniform(data.size() - offset);
+    }
+    const uint32_t init = rnd.Next();
+    const uint32_t expected = ExtendWith(kPortable, init, data.data() + offset, n);
+    for (int i = kPortable + 1; i < kNumImplementations; i++) {
+      Implementation impl = static_cast<Implementation>(i);
+      if (IsSupported(impl)) {
+        ASSERT_EQ(expected, ExtendWith(impl, init, data.data() + offset, n));
+      }
+    }
+    ASSERT_EQ(expected, Extend(init, data.data() + offset, n));
+  }
+}
+
 TEST(CRC, Mask) {
   uint32_t crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
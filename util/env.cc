@@ -16,6 +16,44 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result)
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::NewRandomAccessFileWithOptions(const std::string& fname, const FileOptions& options,
+                                           RandomAccessFile** result)
+{
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewWritableFileWithOptions(const std::string& fname, const FileOptions& options,
+                                       WritableFile** result)
+{
+  return NewWritableFile(fname, result);
+}
+
+Status Env::NewAppendableFileWithOptions(const std::string& fname, const FileOptions& options,
+                                         WritableFile** result)
+{
+  return NewAppendableFile(fname, result);
+}
+
+void Env::ScheduleWithPriority(void (*function)(void*), void* arg, Priority pri, void* tag)
+{
+  Schedule(function, arg);
+}
+
+int Env::UnSchedule(void* tag, Priority pri)
+{
+  return 0;
+}
+
+void Env::SetBackgroundThreads(int number, Priority pri)
+{
+
+}
+
+int Env::GetBackgroundThreads(Priority pri)
+{
+  return 1;
+}
+
 SequentialFile::~SequentialFile()
 {
 
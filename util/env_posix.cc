@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <assert.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -17,6 +18,7 @@
 #include <unistd.h>
 #include <deque>
 #include <set>
+#include <vector>
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
 #include "port/port.h"
@@ -111,6 +113,96 @@ class PosixRandomAccessFile: public RandomAccessFile
   }
 };
 
+// Alignment of the offsets, lengths and buffers used with O_DIRECT.
+// 4K covers the logical block size of every device we care about.
+static const size_t kDirectIOAlignment = 4096;
+
+static size_t RoundUpToAlignment(size_t n)
+{
+  return (n + kDirectIOAlignment - 1) & ~(kDirectIOAlignment - 1);
+}
+
+static char* NewAlignedBuffer(size_t size)
+{
+  void* buf = NULL;
+  if (posix_memalign(&buf, kDirectIOAlignment, size) != 0)
+  {
+	return NULL;
+  }
+  return reinterpret_cast<char*>(buf);
+}
+
+// pread() on a file opened with O_DIRECT.  Each read is widened to
+// aligned boundaries and copied out of an aligned bounce buffer.
+class PosixDirectRandomAccessFile: public RandomAccessFile
+{
+ private:
+  std::string filename_;
+  int fd_;
+
+ public:
+  PosixDirectRandomAccessFile(const std::string& fname, int fd)
+	  : filename_(fname), fd_(fd)
+  {
+
+  }
+  virtual ~PosixDirectRandomAccessFile()
+  {
+	close(fd_);
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result, char* scratch) const
+  {
+	const uint64_t aligned_offset = offset & ~static_cast<uint64_t>(kDirectIOAlignment - 1);
+	const size_t head = static_cast<size_t>(offset - aligned_offset);
+	const size_t aligned_n = RoundUpToAlignment(head + n);
+	char* buf = NewAlignedBuffer(aligned_n);
+	if (buf == NULL)
+	{
+	  *result = Slice();
+	  return IOError(filename_, ENOMEM);
+	}
+
+	Status s;
+	size_t got = 0;
+	while (got < aligned_n)
+	{
+	  ssize_t r = pread(fd_, buf + got, aligned_n - got, static_cast<off_t>(aligned_offset + got));
+	  if (r < 0)
+	  {
+		if (errno == EINTR)
+		{
+		  continue;
+		}
+		s = IOError(filename_, errno);
+		break;
+	  }
+	  if (r == 0)
+	  {
+		break;  // End of file
+	  }
+	  got += r;
+	}
+
+	size_t available = (got > head) ? got - head : 0;
+	if (available > n)
+	{
+	  available = n;
+	}
+	if (s.ok())
+	{
+	  memcpy(scratch, buf + head, available);
+	  *result = Slice(scratch, available);
+	}
+	else
+	{
+	  *result = Slice();
+	}
+	free(buf);
+	return s;
+  }
+};
+
 // Helper class to limit mmap file usage so that we do not end up
 // running out virtual memory or running into kernel performance
 // problems for very large databases.
@@ -214,8 +306,10 @@ class PosixWritableFile : public WritableFile
  private:
   std::string filename_;
   FILE* file_;
+  bool drop_cache_on_close_;
  public:
-  PosixWritableFile(const std::string& fname, FILE* f) : filename_(fname), file_(f) 
+  PosixWritableFile(const std::string& fname, FILE* f, bool drop_cache_on_close = false)
+	  : filename_(fname), file_(f), drop_cache_on_close_(drop_cache_on_close)
   {
 
   }
@@ -241,6 +335,13 @@ class PosixWritableFile : public WritableFile
   virtual Status Close()
   {
 	Status result;
+#if defined(POSIX_FADV_DONTNEED)
+	if (drop_cache_on_close_ && fflush_unlocked(file_) == 0)
+	{
+	  // Best effort: pages that are still dirty stay cached
+	  posix_fadvise(fileno(file_), 0, 0, POSIX_FADV_DONTNEED);
+	}
+#endif
 	if (fclose(file_) != 0) 
 	{
 	  result = IOError(filename_, errno);
@@ -313,6 +414,135 @@ class PosixWritableFile : public WritableFile
   }
 };
 
+// write() on a file opened with O_DIRECT.  Appends are staged in an
+// aligned buffer that is written out whenever it fills.  Sync() and
+// Close() also write a partial last block, padded to the alignment;
+// that block stays buffered and is rewritten in place by the next
+// write.  Close() truncates the padding off again.
+class PosixDirectWritableFile : public WritableFile
+{
+ private:
+  static const size_t kBufferSize = 1 << 20;
+
+  std::string filename_;
+  int fd_;
+  bool use_dsync_;
+  char* buf_;
+  size_t buf_len_;        // Bytes of buf_ holding file data
+  uint64_t buf_offset_;   // File offset of buf_[0], always aligned
+  bool buf_written_;      // buf_[0,buf_len_-1] is already on disk
+
+  // Write buf_ padded to the alignment, then drop its whole blocks
+  Status WriteBuffer()
+  {
+	if (buf_written_)
+	{
+	  return Status::OK();
+	}
+	const size_t n = RoundUpToAlignment(buf_len_);
+	memset(buf_ + buf_len_, 0, n - buf_len_);
+	size_t done = 0;
+	while (done < n)
+	{
+	  ssize_t r = pwrite(fd_, buf_ + done, n - done, static_cast<off_t>(buf_offset_ + done));
+	  if (r < 0)
+	  {
+		if (errno == EINTR)
+		{
+		  continue;
+		}
+		return IOError(filename_, errno);
+	  }
+	  done += r;
+	}
+	const size_t whole = buf_len_ & ~(kDirectIOAlignment - 1);
+	memmove(buf_, buf_ + whole, buf_len_ - whole);
+	buf_len_ -= whole;
+	buf_offset_ += whole;
+	buf_written_ = true;
+	return Status::OK();
+  }
+
+ public:
+  PosixDirectWritableFile(const std::string& fname, int fd, char* buf, bool use_dsync)
+	  : filename_(fname), fd_(fd), use_dsync_(use_dsync), buf_(buf),
+		buf_len_(0), buf_offset_(0), buf_written_(true)
+  {
+
+  }
+  ~PosixDirectWritableFile()
+  {
+	if (fd_ >= 0)
+	{
+	  // Ignoring any potential errors
+	  Close();
+	}
+	free(buf_);
+  }
+
+  static size_t BufferSize() { return kBufferSize; }
+
+  virtual Status Append(const Slice& data)
+  {
+	const char* p = data.data();
+	size_t left = data.size();
+	while (left > 0)
+	{
+	  size_t n = kBufferSize - buf_len_;
+	  if (n > left)
+	  {
+		n = left;
+	  }
+	  memcpy(buf_ + buf_len_, p, n);
+	  buf_len_ += n;
+	  buf_written_ = false;
+	  p += n;
+	  left -= n;
+	  if (buf_len_ == kBufferSize)
+	  {
+		Status s = WriteBuffer();
+		if (!s.ok())
+		{
+		  return s;
+		}
+	  }
+	}
+	return Status::OK();
+  }
+
+  virtual Status Close()
+  {
+	Status result = WriteBuffer();
+	if (result.ok() && ftruncate(fd_, static_cast<off_t>(buf_offset_ + buf_len_)) != 0)
+	{
+	  result = IOError(filename_, errno);
+	}
+	if (close(fd_) != 0 && result.ok())
+	{
+	  result = IOError(filename_, errno);
+	}
+	fd_ = -1;
+	return result;
+  }
+
+  // Partial blocks are only written by Sync() and Close(); writing
+  // them here would rewrite the tail block once per table block.
+  virtual Status Flush()
+  {
+	return Status::OK();
+  }
+
+  virtual Status Sync()
+  {
+	Status s = WriteBuffer();
+	if (s.ok() && !use_dsync_ && fdatasync(fd_) != 0)
+	{
+	  s = IOError(filename_, errno);
+	}
+	return s;
+  }
+};
+
 static int LockOrUnlock(int fd, bool lock) 
 {
   errno = 0;
@@ -353,6 +583,167 @@ class PosixLockTable
   }
 };
 
+static void PthreadCall(const char* label, int result)
+{
+  if (result != 0)
+  {
+	fprintf(stderr, "pthread %s: %s\n", label, strerror(result));
+	abort();
+  }
+}
+
+// A queue of background work drained by a resizable set of threads.
+// Threads are started lazily, on the first Schedule() call.
+class PosixThreadPool
+{
+ public:
+  PosixThreadPool() : limit_(1)
+  {
+	PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
+	PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
+  }
+
+  void Schedule(void (*function)(void*), void* arg, void* tag)
+  {
+	PthreadCall("lock", pthread_mutex_lock(&mu_));
+	StartThreadsIfNeeded();
+	queue_.push_back(BGItem());
+	queue_.back().function = function;
+	queue_.back().arg = arg;
+	queue_.back().tag = tag;
+	PthreadCall("signal", pthread_cond_signal(&bgsignal_));
+	PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+  }
+
+  int UnSchedule(void* tag)
+  {
+	PthreadCall("lock", pthread_mutex_lock(&mu_));
+	int removed = 0;
+	for (BGQueue::iterator it = queue_.begin(); it != queue_.end(); )
+	{
+	  if (it->tag == tag)
+	  {
+		it = queue_.erase(it);
+		removed++;
+	  }
+	  else
+	  {
+		++it;
+	  }
+	}
+	PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+	return removed;
+  }
+
+  void SetBackgroundThreads(int number)
+  {
+	if (number < 1)
+	{
+	  number = 1;
+	}
+	PthreadCall("lock", pthread_mutex_lock(&mu_));
+	limit_ = number;
+	if (!queue_.empty() || !threads_.empty())
+	{
+	  StartThreadsIfNeeded();
+	}
+	// Wake idle threads so that surplus ones can exit
+	PthreadCall("broadcast", pthread_cond_broadcast(&bgsignal_));
+	PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+  }
+
+  int GetBackgroundThreads()
+  {
+	PthreadCall("lock", pthread_mutex_lock(&mu_));
+	int n = limit_;
+	PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+	return n;
+  }
+
+ private:
+  struct ThreadArg
+  {
+	PosixThreadPool* pool;
+	size_t id;
+  };
+
+  // REQUIRES: mu_ is held
+  void StartThreadsIfNeeded()
+  {
+	while (threads_.size() < static_cast<size_t>(limit_))
+	{
+	  ThreadArg* arg = new ThreadArg;
+	  arg->pool = this;
+	  arg->id = threads_.size();
+	  pthread_t t;
+	  PthreadCall("create thread", pthread_create(&t, NULL, &PosixThreadPool::BGThreadWrapper, arg));
+	  PthreadCall("detach thread", pthread_detach(t));
+	  threads_.push_back(t);
+	}
+  }
+
+  // Threads leave from the back so that ids stay dense.
+  // REQUIRES: mu_ is held
+  bool IsLastSurplusThread(size_t id) const
+  {
+	return id + 1 == threads_.size() && threads_.size() > static_cast<size_t>(limit_);
+  }
+
+  // BGThread() is the body of each background thread
+  void BGThread(size_t id)
+  {
+	while (true)
+	{
+	  // Wait until there is an item that is ready to run
+	  PthreadCall("lock", pthread_mutex_lock(&mu_));
+	  while (queue_.empty() && !IsLastSurplusThread(id))
+	  {
+		PthreadCall("wait", pthread_cond_wait(&bgsignal_, &mu_));
+	  }
+	  if (IsLastSurplusThread(id))
+	  {
+		threads_.pop_back();
+		// The next surplus thread, if any, may now exit too
+		PthreadCall("broadcast", pthread_cond_broadcast(&bgsignal_));
+		PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+		return;
+	  }
+
+	  void (*function)(void*) = queue_.front().function;
+	  void* arg = queue_.front().arg;
+	  queue_.pop_front();
+
+	  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+	  (*function)(arg);
+	}
+  }
+
+  static void* BGThreadWrapper(void* arg)
+  {
+	ThreadArg* thread_arg = reinterpret_cast<ThreadArg*>(arg);
+	PosixThreadPool* pool = thread_arg->pool;
+	size_t id = thread_arg->id;
+	delete thread_arg;
+	pool->BGThread(id);
+	return NULL;
+  }
+
+  pthread_mutex_t mu_;
+  pthread_cond_t bgsignal_;
+  std::vector<pthread_t> threads_;
+  int limit_;
+
+  // Entry per Schedule() call
+  struct BGItem
+  {
+	  void* arg; 
+	  void (*function)(void*); 
+	  void* tag;
+  };
+  typedef std::deque<BGItem> BGQueue;
+  BGQueue queue_;
+};
+
 class PosixEnv : public Env 
 {
  public:
@@ -380,15 +771,38 @@ class PosixEnv : public Env
   }
 
   virtual Status NewRandomAccessFile(const std::string& fname, RandomAccessFile** result) 
+  {
+	return NewRandomAccessFileWithOptions(fname, FileOptions(), result);
+  }
+
+  virtual Status NewRandomAccessFileWithOptions(const std::string& fname, const FileOptions& options,
+												RandomAccessFile** result)
   {
 	*result = NULL;
 	Status s;
-	int fd = open(fname.c_str(), O_RDONLY);
+	int fd = -1;
+#if defined(O_DIRECT)
+	if (options.use_direct_io)
+	{
+	  fd = open(fname.c_str(), O_RDONLY | O_DIRECT);
+	  if (fd >= 0)
+	  {
+		*result = new PosixDirectRandomAccessFile(fname, fd);
+		return s;
+	  }
+	  else if (errno != EINVAL)
+	  {
+		return IOError(fname, errno);
+	  }
+	  // The file system does not support O_DIRECT; read through the cache
+	}
+#endif
+	fd = open(fname.c_str(), O_RDONLY);
 	if (fd < 0) 
 	{
 	  s = IOError(fname, errno);
 	}
-	else if (mmap_limit_.Acquire()) //判断是否还能够继续mmap，规定默认的mmap文件的个数是1000
+	else if (!options.use_direct_io && mmap_limit_.Acquire()) //判断是否还能够继续mmap，规定默认的mmap文件的个数是1000
 	{
 	  uint64_t size;
 	  s = GetFileSize(fname, &size);
@@ -419,35 +833,32 @@ class PosixEnv : public Env
 
   virtual Status NewWritableFile(const std::string& fname,
 								 WritableFile** result) {
-	Status s;
-	FILE* f = fopen(fname.c_str(), "w");
-	if (f == NULL)
-	{
-	  *result = NULL;
-	  s = IOError(fname, errno);
-	} 
-	else
-	{
-	  *result = new PosixWritableFile(fname, f);
-	}
-	return s;
+	return NewWritableFileWithOptions(fname, FileOptions(), result);
+  }
+
+  virtual Status NewWritableFileWithOptions(const std::string& fname, const FileOptions& options,
+											WritableFile** result)
+  {
+	return OpenWritableFile(fname, options, O_TRUNC, result);
   }
 
   virtual Status NewAppendableFile(const std::string& fname,
 								   WritableFile** result)
   {
-	Status s;
-	FILE* f = fopen(fname.c_str(), "a");
-	if (f == NULL) 
-	{
-	  *result = NULL;
-	  s = IOError(fname, errno);
-	}
-	else
+	return NewAppendableFileWithOptions(fname, FileOptions(), result);
+  }
+
+  virtual Status NewAppendableFileWithOptions(const std::string& fname, const FileOptions& options,
+											  WritableFile** result)
+  {
+	if (options.use_direct_io)
 	{
-	  *result = new PosixWritableFile(fname, f);
+	  // Appending would need the unaligned tail of the file read back
+	  FileOptions buffered = options;
+	  buffered.use_direct_io = false;
+	  return OpenWritableFile(fname, buffered, O_APPEND, result);
 	}
-	return s;
+	return OpenWritableFile(fname, options, O_APPEND, result);
   }
 
   virtual bool FileExists(const std::string& fname)
@@ -574,7 +985,34 @@ class PosixEnv : public Env
 	return result;
   }
 
-  virtual void Schedule(void (*function)(void*), void* arg);
+  virtual void Schedule(void (*function)(void*), void* arg)
+  {
+	ScheduleWithPriority(function, arg, LOW, NULL);
+  }
+
+  virtual void ScheduleWithPriority(void (*function)(void*), void* arg, Priority pri, void* tag)
+  {
+	assert(pri >= LOW && pri < TOTAL);
+	pools_[pri].Schedule(function, arg, tag);
+  }
+
+  virtual int UnSchedule(void* tag, Priority pri)
+  {
+	assert(pri >= LOW && pri < TOTAL);
+	return pools_[pri].UnSchedule(tag);
+  }
+
+  virtual void SetBackgroundThreads(int number, Priority pri)
+  {
+	assert(pri >= LOW && pri < TOTAL);
+	pools_[pri].SetBackgroundThreads(number);
+  }
+
+  virtual int GetBackgroundThreads(Priority pri)
+  {
+	assert(pri >= LOW && pri < TOTAL);
+	return pools_[pri].GetBackgroundThreads();
+  }
 
   virtual void StartThread(void (*function)(void* arg), void* arg);
 
@@ -632,93 +1070,68 @@ class PosixEnv : public Env
   }
 
  private:
-  void PthreadCall(const char* label, int result) 
+  // "mode" is O_TRUNC or O_APPEND
+  Status OpenWritableFile(const std::string& fname, const FileOptions& options, int mode,
+						  WritableFile** result)
   {
-	if (result != 0)
+	*result = NULL;
+	int flags = O_WRONLY | O_CREAT | mode;
+#if defined(O_DSYNC)
+	if (options.use_dsync)
 	{
-	  fprintf(stderr, "pthread %s: %s\n", label, strerror(result));
-	  abort();
+	  flags |= O_DSYNC;
 	}
+#endif
+	int fd;
+#if defined(O_DIRECT)
+	if (options.use_direct_io)
+	{
+	  fd = open(fname.c_str(), flags | O_DIRECT, 0644);
+	  if (fd >= 0)
+	  {
+		char* buf = NewAlignedBuffer(PosixDirectWritableFile::BufferSize());
+		if (buf == NULL)
+		{
+		  close(fd);
+		  return IOError(fname, ENOMEM);
+		}
+		*result = new PosixDirectWritableFile(fname, fd, buf, options.use_dsync);
+		return Status::OK();
+	  }
+	  else if (errno != EINVAL)
+	  {
+		return IOError(fname, errno);
+	  }
+	  // The file system does not support O_DIRECT; at least keep the
+	  // written pages out of the cache.
+	}
+#endif
+	fd = open(fname.c_str(), flags, 0644);
+	if (fd < 0)
+	{
+	  return IOError(fname, errno);
+	}
+	FILE* f = fdopen(fd, (mode == O_APPEND) ? "a" : "w");
+	if (f == NULL)
+	{
+	  Status s = IOError(fname, errno);
+	  close(fd);
+	  return s;
+	}
+	*result = new PosixWritableFile(fname, f, options.drop_cache_on_close || options.use_direct_io);
+	return Status::OK();
   }
 
-  // BGThread() is the body of the background thread
-  void BGThread();
-  static void* BGThreadWrapper(void* arg)
-  {
-	reinterpret_cast<PosixEnv*>(arg)->BGThread();
-	return NULL;
-  }
-
-  pthread_mutex_t mu_;
-  pthread_cond_t bgsignal_;
-  pthread_t bgthread_;
-  bool started_bgthread_;
-
-  // Entry per Schedule() call
-  struct BGItem
-  {
-	  void* arg; 
-	  void (*function)(void*); 
-  };
-  typedef std::deque<BGItem> BGQueue;
-  BGQueue queue_;
+  // One pool of background threads per Env::Priority
+  PosixThreadPool pools_[TOTAL];
 
   PosixLockTable locks_;
   MmapLimiter mmap_limit_;
 };
 
-PosixEnv::PosixEnv() : started_bgthread_(false)
-{
-  PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
-  PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
-}
-
-void PosixEnv::Schedule(void (*function)(void*), void* arg)
+PosixEnv::PosixEnv()
 {
-  PthreadCall("lock", pthread_mutex_lock(&mu_));
-
-  // Start background thread if necessary
-  /*
-	创建后台压缩进程
-  */
-  if (!started_bgthread_) 
-  {
-	started_bgthread_ = true;
-	PthreadCall("create thread", pthread_create(&bgthread_, NULL,  &PosixEnv::BGThreadWrapper, this));
-  }
-
-  // If the queue is currently empty, the background thread may currently be
-  // waiting.
-  if (queue_.empty()) 
-  {
-	PthreadCall("signal", pthread_cond_signal(&bgsignal_));
-  }
-
-  // Add to priority queue
-  queue_.push_back(BGItem());
-  queue_.back().function = function;
-  queue_.back().arg = arg;
-  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
-}
-void PosixEnv::BGThread() 
 
-{
-  while (true) 
-  {
-	// Wait until there is an item that is ready to run
-	PthreadCall("lock", pthread_mutex_lock(&mu_));
-	while (queue_.empty()) 
-	{
-	  PthreadCall("wait", pthread_cond_wait(&bgsignal_, &mu_));
-	}
-
-	void (*function)(void*) = queue_.front().function;
-	void* arg = queue_.front().arg;
-	queue_.pop_front();
-
-	PthreadCall("unlock", pthread_mutex_unlock(&mu_));
-	(*function)(arg);
-  }
 }
 
 namespace 
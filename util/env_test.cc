@@ -4,7 +4,10 @@
 
 #include "leveldb/env.h"
 
+#include <algorithm>
+
 #include "port/port.h"
+#include "util/mutexlock.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -97,6 +100,141 @@ TEST(EnvPosixTest, StartThread) {
   ASSERT_EQ(state.val, 3);
 }
 
+// Blocks the background thread that runs it until Release() is called.
+class BlockingTask {
+ public:
+  BlockingTask() : cv_(&mu_), running_(0), released_(false) { }
+
+  static void Run(void* arg) {
+    BlockingTask* task = reinterpret_cast<BlockingTask*>(arg);
+    MutexLock l(&task->mu_);
+    task->running_++;
+    task->cv_.SignalAll();
+    while (!task->released_) {
+      task->cv_.Wait();
+    }
+    task->running_--;
+    task->cv_.SignalAll();
+  }
+
+  // Wait until "n" threads are inside Run().
+  void WaitUntilRunning(int n) {
+    MutexLock l(&mu_);
+    while (running_ < n) {
+      cv_.Wait();
+    }
+  }
+
+  // Release every thread inside Run() and wait until they have left it.
+  void Release() {
+    MutexLock l(&mu_);
+    released_ = true;
+    cv_.SignalAll();
+    while (running_ > 0) {
+      cv_.Wait();
+    }
+  }
+
+ private:
+  port::Mutex mu_;
+  port::CondVar cv_;
+  int running_;
+  bool released_;
+};
+
+TEST(EnvPosixTest, PriorityPools) {
+  // A busy LOW pool must not hold up work scheduled in HIGH
+  BlockingTask low;
+  env_->ScheduleWithPriority(&BlockingTask::Run, &low, Env::LOW, NULL);
+  low.WaitUntilRunning(1);
+  BlockingTask high;
+  env_->ScheduleWithPriority(&BlockingTask::Run, &high, Env::HIGH, NULL);
+  high.WaitUntilRunning(1);
+  high.Release();
+  low.Release();
+}
+
+TEST(EnvPosixTest, UnSchedule) {
+  BlockingTask blocker;
+  env_->ScheduleWithPriority(&BlockingTask::Run, &blocker, Env::LOW, NULL);
+  blocker.WaitUntilRunning(1);
+
+  // Queue work behind the blocker, then take the tagged part back out
+  int tag;
+  port::AtomicPointer tagged(NULL);
+  port::AtomicPointer untagged(NULL);
+  for (int i = 0; i < 3; i++) {
+    env_->ScheduleWithPriority(&SetBool, &tagged, Env::LOW, &tag);
+  }
+  env_->ScheduleWithPriority(&SetBool, &untagged, Env::LOW, NULL);
+  ASSERT_EQ(0, env_->UnSchedule(&tag, Env::HIGH));
+  ASSERT_EQ(3, env_->UnSchedule(&tag, Env::LOW));
+  ASSERT_EQ(0, env_->UnSchedule(&tag, Env::LOW));
+
+  blocker.Release();
+  Env::Default()->SleepForMicroseconds(kDelayMicros);
+  ASSERT_TRUE(tagged.Acquire_Load() == NULL);
+  ASSERT_TRUE(untagged.Acquire_Load() != NULL);
+}
+
+TEST(EnvPosixTest, SetBackgroundThreads) {
+  const int old_threads = env_->GetBackgroundThreads(Env::LOW);
+  env_->SetBackgroundThreads(3, Env::LOW);
+  ASSERT_EQ(3, env_->GetBackgroundThreads(Env::LOW));
+
+  // All three tasks can only be inside Run() at once with three threads
+  BlockingTask task;
+  for (int i = 0; i < 3; i++) {
+    env_->ScheduleWithPriority(&BlockingTask::Run, &task, Env::LOW, NULL);
+  }
+  task.WaitUntilRunning(3);
+  task.Release();
+
+  env_->SetBackgroundThreads(old_threads, Env::LOW);
+  ASSERT_EQ(old_threads, env_->GetBackgroundThreads(Env::LOW));
+}
+
+TEST(EnvPosixTest, DirectIO) {
+  std::string fname;
+  ASSERT_OK(env_->GetTestDirectory(&fname));
+  fname += "/direct_io_test";
+  FileOptions options;
+  options.use_direct_io = true;
+
+  // Odd-sized appends, with a Sync() that leaves a partial block behind
+  std::string data;
+  for (int i = 0; data.size() < 3 * 1024 * 1024; i++) {
+    data.append(1 + (i * 7919) % 10000, static_cast<char>('a' + i % 26));
+  }
+  WritableFile* writable;
+  ASSERT_OK(env_->NewWritableFileWithOptions(fname, options, &writable));
+  ASSERT_OK(writable->Append(Slice(data.data(), 5000)));
+  ASSERT_OK(writable->Sync());
+  ASSERT_OK(writable->Append(Slice(data.data() + 5000, data.size() - 5000)));
+  ASSERT_OK(writable->Sync());
+  ASSERT_OK(writable->Close());
+  delete writable;
+
+  uint64_t size;
+  ASSERT_OK(env_->GetFileSize(fname, &size));
+  ASSERT_EQ(data.size(), size);
+
+  // Unaligned reads, including ones that run past the end of the file
+  RandomAccessFile* file;
+  ASSERT_OK(env_->NewRandomAccessFileWithOptions(fname, options, &file));
+  std::string scratch(20000, '\0');
+  const uint64_t offsets[] = { 0, 1, 4095, 4096, 12345, data.size() - 10 };
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    Slice result;
+    ASSERT_OK(file->Read(offsets[i], scratch.size(), &result, &scratch[0]));
+    const size_t expected = std::min<size_t>(scratch.size(), data.size() - offsets[i]);
+    ASSERT_EQ(expected, result.size());
+    ASSERT_TRUE(result == Slice(data.data() + offsets[i], expected));
+  }
+  delete file;
+  ASSERT_OK(env_->DeleteFile(fname));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -4,6 +4,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
 #include "port/port.h"
 #include "util/histogram.h"
 
@@ -41,13 +42,16 @@ void Histogram::Clear() {
   }
 }
 
+int Histogram::BucketFor(double value) {
+  // The first bucket whose limit is above value; the last one takes
+  // everything else
+  return static_cast<int>(
+      std::upper_bound(kBucketLimit, kBucketLimit + kNumBuckets - 1, value) -
+      kBucketLimit);
+}
+
 void Histogram::Add(double value) {
-  // Linear search is fast enough for our usage in db_bench
-  int b = 0;
-  while (b < kNumBuckets - 1 && kBucketLimit[b] <= value) {
-    b++;
-  }
-  buckets_[b] += 1.0;
+  buckets_[BucketFor(value)] += 1.0;
   if (min_ > value) min_ = value;
   if (max_ < value) max_ = value;
   num_++;
@@ -66,6 +70,25 @@ void Histogram::Merge(const Histogram& other) {
   }
 }
 
+void Histogram::MergeCounts(const double* counts, double min, double max,
+                            double sum) {
+  double num = 0;
+  for (int b = 0; b < kNumBuckets; b++) {
+    if (counts[b] <= 0.0) continue;
+    double left = (b == 0) ? 0 : kBucketLimit[b-1];
+    double right = (b == kNumBuckets - 1) ? max : kBucketLimit[b];
+    double mid = (left + right) / 2;
+    sum_squares_ += counts[b] * mid * mid;
+    buckets_[b] += counts[b];
+    num += counts[b];
+  }
+  if (num == 0.0) return;
+  if (min < min_) min_ = min;
+  if (max > max_) max_ = max;
+  num_ += num;
+  sum_ += sum;
+}
+
 double Histogram::Median() const {
   return Percentile(50.0);
 }
@@ -99,6 +122,8 @@ double Histogram::Average() const {
 double Histogram::StandardDeviation() const {
   if (num_ == 0.0) return 0;
   double variance = (sum_squares_ * num_ - sum_ * sum_) / (num_ * num_);
+  // Estimated squares of merged counts can undershoot slightly
+  if (variance < 0) variance = 0;
   return sqrt(variance);
 }
 
@@ -14,10 +14,21 @@ class Histogram {
   Histogram() { }
   ~Histogram() { }
 
+  enum { kNumBuckets = 154 };
+
   void Clear();
   void Add(double value);
   void Merge(const Histogram& other);
 
+  // The bucket Add() counts "value" in.
+  static int BucketFor(double value);
+
+  // Merge samples that were counted elsewhere: counts[b] of them in
+  // bucket b, with the given minimum, maximum and sum.  Their sum of
+  // squares is estimated from the midpoints of their buckets.
+  void MergeCounts(const double* counts, double min, double max, double sum);
+
+  double num() const { return num_; }
   std::string ToString() const;
 
  private:
@@ -27,7 +38,6 @@ class Histogram {
   double sum_;
   double sum_squares_;
 
-  enum { kNumBuckets = 154 };
   static const double kBucketLimit[kNumBuckets];
   double buckets_[kNumBuckets];
 
@@ -18,13 +18,31 @@ Options::Options()
       env(Env::Default()),
       info_log(NULL),
       write_buffer_size(4<<20),
+      allow_concurrent_memtable_write(false),
+      enable_pipelined_write(false),
+      enable_log_flusher(false),
       max_open_files(1000),
+      max_background_compactions(1),
+      max_subcompactions(1),
       block_cache(NULL),
       block_size(4096),
       block_restart_interval(16),
       compression(kSnappyCompression),
+      zstd_compression_level(1),
+      zstd_dictionary_size(0),
+      zstd_max_train_bytes(0),
+      use_direct_reads(false),
+      use_direct_io_for_flush_and_compaction(false),
+      use_dsync_writes(false),
       reuse_logs(false),
-      filter_policy(NULL)
+      filter_policy(NULL),
+      full_table_filter(false),
+      prefix_extractor(NULL),
+      partition_index_and_filters(false),
+      metadata_block_size(4096),
+      cache_index_and_filter_blocks(false),
+      pin_l0_filter_and_index_blocks_in_cache(false),
+      secondary_cache_size(1 << 30)
 {
 
 }
@@ -0,0 +1,242 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Ribbon filter [Dillinger,Walzer 2021] stores, for every key, an
+// r-bit result that is reproduced by XOR-ing together the r-bit slots
+// selected by a 64-bit coefficient row starting at a hashed position.
+// Building the filter solves that banded linear system over GF(2);
+// a query recomputes the row and compares.  A key that was not added
+// matches with probability 2^-r, so the filter needs only about
+// r * (1 + overhead) bits per key where a bloom filter with the same
+// false positive rate needs about 1.44 * r.
+//
+// Filter layout:
+//    [solution words: num_blocks * r fixed64]
+//    seed: uint8
+//    r: uint8
+// The solution is stored interleaved: block b holds slots [64b, 64b+64)
+// as r consecutive words, one per result bit, so a query reads at most
+// two adjacent runs of r words.
+
+#include "leveldb/filter_policy.h"
+
+#include <vector>
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// Every row covers this many consecutive slots
+static const int kCoeffBits = 64;
+
+// Extra slots per key beyond one, so that construction almost always
+// succeeds on the first seed.
+static const double kSlotOverhead = 0.06;
+
+// Number of seeds tried before giving up and emitting a filter that
+// matches everything.
+static const int kMaxSeeds = 64;
+
+static uint64_t Mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+static int Parity(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_parityll(x);
+#else
+  x ^= x >> 32;
+  x ^= x >> 16;
+  x ^= x >> 8;
+  x ^= x >> 4;
+  x ^= x >> 2;
+  x ^= x >> 1;
+  return static_cast<int>(x & 1);
+#endif
+}
+
+static int CountTrailingZeros(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+// The equation a key contributes: the slots [start, start+64) selected
+// by coeff must XOR to result.
+struct Row {
+  uint32_t start;
+  uint64_t coeff;
+  uint32_t result;
+};
+
+static void ComputeRow(const Slice& key, uint32_t seed, uint32_t num_starts,
+                       int result_bits, Row* row) {
+  const uint64_t a = Mix64((static_cast<uint64_t>(seed) << 32) |
+                           Hash(key.data(), key.size(), 0xbc9f1d34));
+  row->start = static_cast<uint32_t>(((a >> 32) * num_starts) >> 32);
+  row->coeff = Mix64(a) | 1;
+  row->result = static_cast<uint32_t>(a) & ((1u << result_bits) - 1);
+}
+
+class RibbonFilterPolicy : public FilterPolicy {
+ private:
+  int r_;
+
+  // Gaussian elimination restricted to the band: keeps at most one row
+  // per leading slot.  Returns false if the system has no solution
+  // for this seed.
+  bool Band(const Slice* keys, int n, uint32_t seed, uint32_t num_slots,
+            std::vector<uint64_t>* coeffs,
+            std::vector<uint32_t>* results) const {
+    coeffs->assign(num_slots, 0);
+    results->assign(num_slots, 0);
+    const uint32_t num_starts = num_slots - kCoeffBits + 1;
+    Row row;
+    for (int k = 0; k < n; k++) {
+      ComputeRow(keys[k], seed, num_starts, r_, &row);
+      uint32_t i = row.start;
+      uint64_t c = row.coeff;
+      uint32_t result = row.result;
+      for (;;) {
+        if ((*coeffs)[i] == 0) {
+          (*coeffs)[i] = c;
+          (*results)[i] = result;
+          break;
+        }
+        c ^= (*coeffs)[i];
+        result ^= (*results)[i];
+        if (c == 0) {
+          if (result != 0) return false;
+          break;  // Duplicate key (or full hash collision)
+        }
+        const int shift = CountTrailingZeros(c);
+        i += shift;
+        c >>= shift;
+      }
+    }
+    return true;
+  }
+
+ public:
+  explicit RibbonFilterPolicy(int bits_per_key) {
+    // Match the false positive rate of a bloom filter with the same
+    // bits_per_key: such a filter has a rate of about 2^-(0.69*bits).
+    r_ = static_cast<int>(bits_per_key * 0.69 + 0.5);
+    if (r_ < 1) r_ = 1;
+    if (r_ > 16) r_ = 16;
+  }
+
+  virtual const char* Name() const {
+    return "leveldb.RibbonFilter";
+  }
+
+  virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const {
+    if (n == 0) {
+      dst->push_back(0);
+      dst->push_back(static_cast<char>(r_));
+      return;
+    }
+
+    uint32_t num_blocks = static_cast<uint32_t>(
+        (n * (1 + kSlotOverhead) + kCoeffBits - 1) / kCoeffBits);
+
+    std::vector<uint64_t> coeffs;
+    std::vector<uint32_t> results;
+    uint32_t seed = 0;
+    for (;;) {
+      if (Band(keys, n, seed, num_blocks * kCoeffBits, &coeffs, &results)) {
+        break;
+      }
+      seed++;
+      if (seed == kMaxSeeds) {
+        // Reserved encoding: matches every key
+        dst->push_back(0);
+        dst->push_back(0);
+        return;
+      }
+      if (seed % 2 == 0) {
+        // Keep failing: add a few percent more room
+        num_blocks += num_blocks / 32 + 1;
+      }
+    }
+
+    // Back substitution, from the last slot to the first.  state[j]
+    // holds bit j of the solution for the 64 slots after slot i.
+    const uint32_t num_slots = num_blocks * kCoeffBits;
+    std::vector<uint64_t> words(num_blocks * r_, 0);
+    std::vector<uint64_t> state(r_, 0);
+    for (uint32_t i = num_slots; i-- > 0; ) {
+      const uint64_t c = coeffs[i];
+      const uint32_t result = results[i];
+      uint64_t* block = &words[(i / kCoeffBits) * r_];
+      for (int j = 0; j < r_; j++) {
+        uint64_t bit = 0;
+        if (c != 0) {
+          bit = ((result >> j) & 1) ^ Parity((c >> 1) & state[j]);
+        }
+        state[j] = (state[j] << 1) | bit;
+        block[j] |= bit << (i % kCoeffBits);
+      }
+    }
+
+    for (size_t i = 0; i < words.size(); i++) {
+      PutFixed64(dst, words[i]);
+    }
+    dst->push_back(static_cast<char>(seed));
+    dst->push_back(static_cast<char>(r_));
+  }
+
+  virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const {
+    const size_t len = filter.size();
+    if (len < 2) return false;
+
+    const char* array = filter.data();
+    const int r = static_cast<unsigned char>(array[len-1]);
+    const uint32_t seed = static_cast<unsigned char>(array[len-2]);
+    if (r == 0 || r > 16 || (len - 2) % (8 * r) != 0) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+    const uint32_t num_blocks = (len - 2) / (8 * r);
+    if (num_blocks == 0) return false;  // Empty filter
+
+    Row row;
+    ComputeRow(key, seed, num_blocks * kCoeffBits - kCoeffBits + 1, r, &row);
+    const uint32_t shift = row.start % kCoeffBits;
+    const char* lo = array + (row.start / kCoeffBits) * r * 8;
+    const char* hi = lo + r * 8;
+    for (int j = 0; j < r; j++) {
+      uint64_t slots = DecodeFixed64(lo + j * 8) >> shift;
+      if (shift != 0) {
+        slots |= DecodeFixed64(hi + j * 8) << (kCoeffBits - shift);
+      }
+      if (Parity(slots & row.coeff) != static_cast<int>((row.result >> j) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+}
+
+const FilterPolicy* NewRibbonFilterPolicy(int bits_per_key) {
+  return new RibbonFilterPolicy(bits_per_key);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,273 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/secondary_cache.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include "leveldb/env.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+struct SecondaryCache::Segment {
+  uint64_t number;
+  int refs;                  // One for segments_, one per reader or writer
+  size_t size;
+  std::string buffer;        // Contents, until written out to file
+  RandomAccessFile* file;    // NULL until written out
+  bool written;              // Whether a file was created
+  std::vector<std::string> keys;
+};
+
+SecondaryCache::SecondaryCache(Env* env, const std::string& dir,
+                               size_t capacity, FileLock* lock)
+    : env_(env),
+      dir_(dir),
+      capacity_(capacity),
+      // Aim for about 16 segment files
+      segment_size_(std::min<size_t>(std::max<size_t>(capacity / 16, 16 << 10),
+                                     16 << 20)),
+      lock_(lock),
+      next_segment_number_(1),
+      usage_(0),
+      hits_(0),
+      misses_(0),
+      inserts_(0),
+      rejects_(0),
+      evictions_(0),
+      write_errors_(0) {
+  // Remember about as many offers as the cache holds 4K blocks
+  size_t remembered = capacity / 4096;
+  if (remembered < 1024) remembered = 1024;
+  if (remembered > (1 << 20)) remembered = 1 << 20;
+  recently_offered_.resize(remembered, 0);
+  segments_.push_back(NewSegment());
+}
+
+SecondaryCache::~SecondaryCache() {
+  MutexLock l(&mutex_);
+  while (!segments_.empty()) {
+    Segment* segment = segments_.front();
+    segments_.pop_front();
+    assert(segment->refs == 1);
+    Unref(segment);
+  }
+  env_->UnlockFile(lock_);
+}
+
+Status SecondaryCache::Open(Env* env, const std::string& dir, size_t capacity,
+                            SecondaryCache** result) {
+  *result = NULL;
+  env->CreateDir(dir);  // Ignore error since directory may exist
+  // Another open cache, of this database or of another one, may be
+  // using the directory
+  FileLock* lock;
+  Status s = env->LockFile(dir + "/CACHE.LOCK", &lock);
+  if (!s.ok()) {
+    return s;
+  }
+  std::vector<std::string> children;
+  s = env->GetChildren(dir, &children);
+  if (!s.ok()) {
+    env->UnlockFile(lock);
+    return s;
+  }
+  // The index of blocks lives in memory, so left over files are useless
+  for (size_t i = 0; i < children.size(); i++) {
+    const std::string& name = children[i];
+    if (name.size() > 6 && name.compare(name.size() - 6, 6, ".cache") == 0) {
+      env->DeleteFile(dir + "/" + name);
+    }
+  }
+  *result = new SecondaryCache(env, dir, capacity, lock);
+  return Status::OK();
+}
+
+std::string SecondaryCache::SegmentFileName(uint64_t number) const {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "/%06llu.cache",
+           static_cast<unsigned long long>(number));
+  return dir_ + buf;
+}
+
+SecondaryCache::Segment* SecondaryCache::NewSegment() {
+  Segment* segment = new Segment;
+  segment->number = next_segment_number_++;
+  segment->refs = 1;
+  segment->size = 0;
+  segment->file = NULL;
+  segment->written = false;
+  segment->buffer.reserve(segment_size_);
+  return segment;
+}
+
+void SecondaryCache::Unref(Segment* segment) {
+  assert(segment->refs > 0);
+  segment->refs--;
+  if (segment->refs == 0) {
+    delete segment->file;
+    if (segment->written) {
+      env_->DeleteFile(SegmentFileName(segment->number));
+    }
+    delete segment;
+  }
+}
+
+bool SecondaryCache::Admit(const Slice& key) {
+  const uint32_t h = Hash(key.data(), key.size(), 0x5bd1e995) | 1;
+  uint32_t* slot = &recently_offered_[h % recently_offered_.size()];
+  if (*slot == h) {
+    *slot = 0;
+    return true;
+  }
+  *slot = h;
+  return false;
+}
+
+void SecondaryCache::EvictOldestSegment() {
+  Segment* segment = segments_.front();
+  segments_.pop_front();
+  for (size_t i = 0; i < segment->keys.size(); i++) {
+    std::map<std::string, Location>::iterator it = index_.find(segment->keys[i]);
+    if (it != index_.end() && it->second.segment == segment) {
+      index_.erase(it);
+      evictions_++;
+    }
+  }
+  usage_ -= segment->size;
+  Unref(segment);
+}
+
+void SecondaryCache::Insert(const Slice& key, const Slice& contents) {
+  Segment* full = NULL;
+  {
+    MutexLock l(&mutex_);
+    if (contents.size() > segment_size_ ||
+        index_.find(key.ToString()) != index_.end()) {
+      return;
+    }
+    if (!Admit(key)) {
+      rejects_++;
+      return;
+    }
+    Segment* segment = segments_.back();
+    if (segment->size + contents.size() > segment_size_) {
+      full = segment;
+      full->refs++;  // For WriteSegment() below
+      segment = NewSegment();
+      segments_.push_back(segment);
+    }
+    Location location;
+    location.segment = segment;
+    location.offset = static_cast<uint32_t>(segment->size);
+    location.size = static_cast<uint32_t>(contents.size());
+    segment->buffer.append(contents.data(), contents.size());
+    segment->size += contents.size();
+    segment->keys.push_back(key.ToString());
+    index_[key.ToString()] = location;
+    usage_ += contents.size();
+    inserts_++;
+    while (usage_ > capacity_ && segments_.size() > 1) {
+      EvictOldestSegment();
+    }
+  }
+  if (full != NULL) {
+    WriteSegment(full);
+  }
+}
+
+void SecondaryCache::WriteSegment(Segment* segment) {
+  // Nobody appends to a full segment, so its buffer can be read
+  // without the lock
+  const std::string fname = SegmentFileName(segment->number);
+  WritableFile* file;
+  Status s = env_->NewWritableFile(fname, &file);
+  if (s.ok()) {
+    s = file->Append(segment->buffer);
+    if (s.ok()) {
+      s = file->Close();
+    }
+    delete file;
+  }
+  RandomAccessFile* readable = NULL;
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &readable);
+  }
+
+  MutexLock l(&mutex_);
+  segment->written = true;
+  if (s.ok()) {
+    segment->file = readable;
+    std::string().swap(segment->buffer);
+  } else {
+    // Keep serving the segment from memory until it is evicted
+    write_errors_++;
+  }
+  Unref(segment);
+}
+
+bool SecondaryCache::Lookup(const Slice& key, std::string* contents) {
+  Segment* segment;
+  Location location;
+  {
+    MutexLock l(&mutex_);
+    std::map<std::string, Location>::iterator it = index_.find(key.ToString());
+    if (it == index_.end()) {
+      misses_++;
+      return false;
+    }
+    location = it->second;
+    segment = location.segment;
+    if (segment->file == NULL) {
+      contents->assign(segment->buffer.data() + location.offset, location.size);
+      hits_++;
+      return true;
+    }
+    segment->refs++;
+  }
+
+  contents->resize(location.size);
+  Slice result;
+  Status s = segment->file->Read(location.offset, location.size, &result,
+                                 &(*contents)[0]);
+  if (s.ok() && result.data() != contents->data()) {
+    contents->assign(result.data(), result.size());
+  }
+
+  MutexLock l(&mutex_);
+  Unref(segment);
+  if (!s.ok() || result.size() != location.size) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  return true;
+}
+
+void SecondaryCache::GetStats(std::string* stats) {
+  MutexLock l(&mutex_);
+  char buf[400];
+  snprintf(buf, sizeof(buf),
+           "hits: %llu\n"
+           "misses: %llu\n"
+           "inserts: %llu\n"
+           "rejects: %llu\n"
+           "evictions: %llu\n"
+           "write errors: %llu\n"
+           "usage: %llu\n"
+           "capacity: %llu\n",
+           static_cast<unsigned long long>(hits_),
+           static_cast<unsigned long long>(misses_),
+           static_cast<unsigned long long>(inserts_),
+           static_cast<unsigned long long>(rejects_),
+           static_cast<unsigned long long>(evictions_),
+           static_cast<unsigned long long>(write_errors_),
+           static_cast<unsigned long long>(usage_),
+           static_cast<unsigned long long>(capacity_));
+  stats->append(buf);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,108 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A second cache tier for table blocks, behind the block cache.  Blocks
+// are kept in their stored form (compressed, followed by the block
+// trailer) in files under a local directory, for databases whose files
+// live on a device that is much slower than the local one.
+//
+// Blocks are appended to an in-memory segment that is written out as one
+// file when it fills up.  When the tier outgrows its capacity the oldest
+// segment is deleted, so blocks are evicted in insertion order.
+//
+// A block is only admitted the second time it is offered while a small
+// table of recently offered blocks still remembers it, so blocks that
+// are read once (e.g. by a scan) do not push out the rest.
+//
+// Thread-safe (provides internal synchronization)
+
+#ifndef STORAGE_LEVELDB_UTIL_SECONDARY_CACHE_H_
+#define STORAGE_LEVELDB_UTIL_SECONDARY_CACHE_H_
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+
+namespace leveldb {
+
+class Env;
+class FileLock;
+
+class SecondaryCache {
+ public:
+  // Delete the files a previous instance left in "dir" (creating it if
+  // needed) and store a new cache of at most "capacity" bytes there.
+  // The cache holds a lock on "dir" while it is open, so this fails
+  // without touching the files if another cache is using "dir".
+  static Status Open(Env* env, const std::string& dir, size_t capacity,
+                     SecondaryCache** result);
+
+  // Deletes the files of the cache.
+  ~SecondaryCache();
+
+  // Offer "contents" for storage under "key".
+  void Insert(const Slice& key, const Slice& contents);
+
+  // If "key" is stored, set "*contents" to its contents and return true.
+  bool Lookup(const Slice& key, std::string* contents);
+
+  // Append a human readable description of the cache counters.
+  void GetStats(std::string* stats);
+
+ private:
+  struct Segment;
+  struct Location {
+    Segment* segment;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  SecondaryCache(Env* env, const std::string& dir, size_t capacity,
+                 FileLock* lock);
+
+  std::string SegmentFileName(uint64_t number) const;
+
+  // REQUIRES: mutex_ held
+  bool Admit(const Slice& key);
+  Segment* NewSegment();
+  void EvictOldestSegment();
+  void Unref(Segment* segment);
+
+  // Write out a full segment and switch its readers to the file
+  void WriteSegment(Segment* segment);
+
+  Env* const env_;
+  const std::string dir_;
+  const size_t capacity_;
+  const size_t segment_size_;
+  FileLock* const lock_;            // On dir_, released by the destructor
+
+  port::Mutex mutex_;
+  std::map<std::string, Location> index_;
+  std::deque<Segment*> segments_;   // Oldest first; back() takes inserts
+  uint64_t next_segment_number_;
+  size_t usage_;
+  std::vector<uint32_t> recently_offered_;  // Hashes, indexed by hash
+
+  // Counters
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t inserts_;
+  uint64_t rejects_;          // Not admitted
+  uint64_t evictions_;
+  uint64_t write_errors_;
+
+  // No copying allowed
+  SecondaryCache(const SecondaryCache&);
+  void operator=(const SecondaryCache&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_SECONDARY_CACHE_H_
@@ -0,0 +1,137 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/secondary_cache.h"
+
+#include <stdio.h>
+#include <vector>
+#include "leveldb/env.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "key%06d", i);
+  return buf;
+}
+
+static std::string Value(int i, size_t size) {
+  return std::string(size, static_cast<char>('a' + i % 26));
+}
+
+class SecondaryCacheTest {
+ public:
+  static const size_t kCapacity = 1 << 20;  // 64K segments
+  Env* env_;
+  std::string dir_;
+  SecondaryCache* cache_;
+
+  SecondaryCacheTest()
+      : env_(Env::Default()),
+        dir_(test::TmpDir() + "/secondary_cache_test"),
+        cache_(NULL) {
+    Reopen();
+  }
+
+  ~SecondaryCacheTest() {
+    delete cache_;
+  }
+
+  void Reopen() {
+    delete cache_;
+    cache_ = NULL;
+    ASSERT_OK(SecondaryCache::Open(env_, dir_, kCapacity, &cache_));
+  }
+
+  // Offer twice, so that the block is admitted
+  void Insert(int i, size_t size) {
+    cache_->Insert(Key(i), Value(i, size));
+    cache_->Insert(Key(i), Value(i, size));
+  }
+
+  std::string Lookup(int i) {
+    std::string contents;
+    if (!cache_->Lookup(Key(i), &contents)) {
+      return "NOT_FOUND";
+    }
+    return contents;
+  }
+
+  int NumFiles() {
+    std::vector<std::string> children;
+    env_->GetChildren(dir_, &children);
+    int n = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+      const std::string& name = children[i];
+      if (name.size() > 6 && name.compare(name.size() - 6, 6, ".cache") == 0) {
+        n++;
+      }
+    }
+    return n;
+  }
+};
+
+TEST(SecondaryCacheTest, AdmitOnSecondOffer) {
+  cache_->Insert(Key(1), Value(1, 100));
+  ASSERT_EQ("NOT_FOUND", Lookup(1));
+  cache_->Insert(Key(1), Value(1, 100));
+  ASSERT_EQ(Value(1, 100), Lookup(1));
+  ASSERT_EQ("NOT_FOUND", Lookup(2));
+}
+
+TEST(SecondaryCacheTest, ReadFromSegmentFiles) {
+  // Blocks in full segments are read back from their files
+  const int N = 200;
+  for (int i = 0; i < N; i++) {
+    Insert(i, 1000 + i);
+  }
+  ASSERT_GT(NumFiles(), 0);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Value(i, 1000 + i), Lookup(i));
+  }
+}
+
+TEST(SecondaryCacheTest, EvictOldestSegments) {
+  const int N = 2 * kCapacity / 4000;
+  for (int i = 0; i < N; i++) {
+    Insert(i, 4000);
+  }
+  ASSERT_LE(NumFiles(), 17);
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+  ASSERT_EQ(Value(N - 1, 4000), Lookup(N - 1));
+
+  std::string stats;
+  cache_->GetStats(&stats);
+  ASSERT_TRUE(stats.find("evictions: 0\n") == std::string::npos) << stats;
+}
+
+TEST(SecondaryCacheTest, DirectoryInUse) {
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 1000);
+  }
+  const int files = NumFiles();
+  ASSERT_GT(files, 0);
+  SecondaryCache* other = NULL;
+  ASSERT_TRUE(!SecondaryCache::Open(env_, dir_, kCapacity, &other).ok());
+  ASSERT_TRUE(other == NULL);
+  ASSERT_EQ(files, NumFiles());
+  ASSERT_EQ(Value(0, 1000), Lookup(0));
+}
+
+TEST(SecondaryCacheTest, EmptyAfterReopen) {
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 1000);
+  }
+  ASSERT_GT(NumFiles(), 0);
+  Reopen();
+  ASSERT_EQ(0, NumFiles());
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -0,0 +1,229 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/statistics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "leveldb/slice.h"
+#include "util/hash.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+static const char* kTickerNames[Statistics::kNumTickers] = {
+  "memtable-hits",
+  "memtable-misses",
+  "get-not-found",
+  "bloom-useful",
+  "bloom-useless",
+  "bloom-prefix-useful",
+  "block-cache-data-hits",
+  "block-cache-data-misses",
+  "block-cache-index-hits",
+  "block-cache-index-misses",
+  "block-cache-filter-hits",
+  "block-cache-filter-misses",
+  "bytes-read",
+  "iter-seeks",
+};
+
+static const char* kLevelTickerNames[Statistics::kNumLevelTickers] = {
+  "get-hits-at-level",
+  "bytes-read-at-level",
+};
+
+static const char* kHistogramNames[Statistics::kNumHistograms] = {
+  "get",
+  "write",
+  "write-stall",
+  "wal-sync",
+  "flush",
+  "compaction",
+  "iter-seek",
+};
+
+Statistics::Statistics(int num_levels)
+    : num_levels_(num_levels),
+      histograms_(kNumTickers + kNumLevelTickers * num_levels) {
+  // Keep every stripe on cache lines of its own
+  const size_t per_line = 64 / sizeof(void*);
+  const size_t num_counters = histograms_ + kNumHistograms * kHistogramCounters;
+  stride_ = (num_counters + per_line - 1) / per_line * per_line;
+  counters_ = new port::AtomicPointer[kNumStripes * stride_];
+  Reset();
+}
+
+Statistics::~Statistics() {
+  delete[] counters_;
+}
+
+void Statistics::Reset() {
+  for (size_t i = 0; i < kNumStripes * stride_; i++) {
+    counters_[i].NoBarrier_Store(NULL);
+  }
+}
+
+port::AtomicPointer* Statistics::Stripe() {
+  // Thread stacks are far apart, so the page of a local variable tells
+  // threads apart without any thread-local storage.
+  char here;
+  const uintptr_t page = reinterpret_cast<uintptr_t>(&here) >> 12;
+  const uint32_t stripe =
+      Hash(reinterpret_cast<const char*>(&page), sizeof(page), 0) % kNumStripes;
+  return &counters_[stripe * stride_];
+}
+
+void Statistics::Add(port::AtomicPointer* counter, uint64_t n) {
+  // Counts wrap at 2^32 where pointers are 32 bits wide
+  for (;;) {
+    void* old_value = counter->NoBarrier_Load();
+    void* new_value = reinterpret_cast<void*>(
+        reinterpret_cast<uintptr_t>(old_value) + static_cast<uintptr_t>(n));
+    if (counter->CompareAndSwap(old_value, new_value)) {
+      break;
+    }
+  }
+}
+
+void Statistics::Max(port::AtomicPointer* counter, uint64_t n) {
+  const uintptr_t value = static_cast<uintptr_t>(n);
+  for (;;) {
+    void* old_value = counter->NoBarrier_Load();
+    if (reinterpret_cast<uintptr_t>(old_value) >= value ||
+        counter->CompareAndSwap(old_value, reinterpret_cast<void*>(value))) {
+      break;
+    }
+  }
+}
+
+void Statistics::MeasureTime(HistogramType type, uint64_t micros) {
+  port::AtomicPointer* h = &Stripe()[histograms_ + type * kHistogramCounters];
+  Add(&h[Histogram::BucketFor(static_cast<double>(micros))], 1);
+  Add(&h[kHistogramSum], micros);
+  Max(&h[kHistogramMax], micros);
+  Max(&h[kHistogramMin], ~static_cast<uintptr_t>(micros));
+}
+
+uint64_t Statistics::Sum(size_t counter) const {
+  uint64_t sum = 0;
+  for (int s = 0; s < kNumStripes; s++) {
+    sum += reinterpret_cast<uintptr_t>(counters_[s * stride_ + counter].NoBarrier_Load());
+  }
+  return sum;
+}
+
+uint64_t Statistics::Max(size_t counter) const {
+  uintptr_t max = 0;
+  for (int s = 0; s < kNumStripes; s++) {
+    max = std::max(max, reinterpret_cast<uintptr_t>(
+        counters_[s * stride_ + counter].NoBarrier_Load()));
+  }
+  return max;
+}
+
+void Statistics::MergeHistogram(HistogramType type, Histogram* histogram) const {
+  const size_t base = histograms_ + type * kHistogramCounters;
+  double counts[Histogram::kNumBuckets];
+  for (int b = 0; b < Histogram::kNumBuckets; b++) {
+    counts[b] = static_cast<double>(Sum(base + b));
+  }
+  histogram->MergeCounts(counts,
+                         static_cast<double>(~static_cast<uintptr_t>(Max(base + kHistogramMin))),
+                         static_cast<double>(Max(base + kHistogramMax)),
+                         static_cast<double>(Sum(base + kHistogramSum)));
+}
+
+uint64_t Statistics::Get(Ticker ticker) const {
+  return Sum(ticker);
+}
+
+uint64_t Statistics::GetAtLevel(LevelTicker ticker, int level) const {
+  if (level < 0 || level >= num_levels_) {
+    return 0;
+  }
+  return Sum(kNumTickers + ticker * num_levels_ + level);
+}
+
+const char* Statistics::Name(Ticker ticker) {
+  return kTickerNames[ticker];
+}
+
+const char* Statistics::Name(LevelTicker ticker) {
+  return kLevelTickerNames[ticker];
+}
+
+const char* Statistics::Name(HistogramType type) {
+  return kHistogramNames[type];
+}
+
+bool Statistics::GetProperty(const Slice& name, std::string* value) const {
+  char buf[50];
+  for (int t = 0; t < kNumTickers; t++) {
+    if (name == kTickerNames[t]) {
+      snprintf(buf, sizeof(buf), "%llu",
+               static_cast<unsigned long long>(Get(static_cast<Ticker>(t))));
+      value->append(buf);
+      return true;
+    }
+  }
+  for (int t = 0; t < kNumLevelTickers; t++) {
+    Slice in = name;
+    if (in.starts_with(kLevelTickerNames[t])) {
+      in.remove_prefix(strlen(kLevelTickerNames[t]));
+      uint64_t level;
+      if (!ConsumeDecimalNumber(&in, &level) || !in.empty() ||
+          level >= static_cast<uint64_t>(num_levels_)) {
+        return false;
+      }
+      snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(
+          GetAtLevel(static_cast<LevelTicker>(t), static_cast<int>(level))));
+      value->append(buf);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Statistics::AppendJson(std::string* json) const {
+  char buf[100];
+  json->append("{");
+  for (int t = 0; t < kNumTickers; t++) {
+    snprintf(buf, sizeof(buf), "%s\"%s\": %llu", (t == 0 ? "" : ", "),
+             kTickerNames[t],
+             static_cast<unsigned long long>(Get(static_cast<Ticker>(t))));
+    json->append(buf);
+  }
+  for (int t = 0; t < kNumLevelTickers; t++) {
+    snprintf(buf, sizeof(buf), ", \"%s\": [", kLevelTickerNames[t]);
+    json->append(buf);
+    for (int level = 0; level < num_levels_; level++) {
+      snprintf(buf, sizeof(buf), "%s%llu", (level == 0 ? "" : ", "),
+               static_cast<unsigned long long>(
+                   GetAtLevel(static_cast<LevelTicker>(t), level)));
+      json->append(buf);
+    }
+    json->append("]");
+  }
+  json->append("}");
+}
+
+void Statistics::AppendHistograms(std::string* histograms) const {
+  for (int t = 0; t < kNumHistograms; t++) {
+    Histogram histogram;
+    histogram.Clear();
+    MergeHistogram(static_cast<HistogramType>(t), &histogram);
+    histograms->append("** ");
+    histograms->append(kHistogramNames[t]);
+    histograms->append(" (micros) **\n");
+    if (histogram.num() == 0.0) {
+      histograms->append("No samples\n");
+    } else {
+      histograms->append(histogram.ToString());
+    }
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,166 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Counters of where reads are served from, for tuning filters, the block
+// cache and level sizes, and latency histograms of the operations of a
+// DB.  Every counter is split into stripes, and a thread adds to the
+// stripe picked by the address of its stack, so that threads rarely
+// share the cache line of the counter they update.  Counts are summed
+// over the stripes when they are read.
+//
+// Thread-safe (provides internal synchronization)
+
+#ifndef STORAGE_LEVELDB_UTIL_STATISTICS_H_
+#define STORAGE_LEVELDB_UTIL_STATISTICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/histogram.h"
+
+namespace leveldb {
+
+class Slice;
+
+class Statistics {
+ public:
+  enum Ticker {
+    kMemtableHits,            // Gets answered by a memtable
+    kMemtableMisses,          // Gets that had to search the tables
+    kGetNotFound,             // Gets that found no value
+    kBloomUseful,             // Table probes a filter ruled out
+    kBloomUseless,            // Table probes that read a data block in vain,
+                              // including those of tables without filters
+    kBloomPrefixUseful,       // Table seeks a prefix filter ruled out
+    kBlockCacheDataHits,
+    kBlockCacheDataMisses,
+    kBlockCacheIndexHits,     // Including index partitions
+    kBlockCacheIndexMisses,
+    kBlockCacheFilterHits,    // Including filter partitions
+    kBlockCacheFilterMisses,
+    kBytesRead,               // From table files
+    kIterSeeks,               // Seek(), SeekToFirst() and SeekToLast()
+    kNumTickers
+  };
+
+  // Counters kept for every level
+  enum LevelTicker {
+    kGetHitsAtLevel,          // Gets that found a value in a table of the level
+    kBytesReadAtLevel,
+    kNumLevelTickers
+  };
+
+  // Latency histograms, in microseconds
+  enum HistogramType {
+    kGetMicros,
+    kWriteMicros,             // Including the time spent waiting for others
+    kWriteStallMicros,        // Writes delayed or stopped for compactions
+    kWalSyncMicros,           // Sync of the log for a write group
+    kFlushMicros,             // Memtable written to a table
+    kCompactionMicros,
+    kIterSeekMicros,
+    kNumHistograms
+  };
+
+  explicit Statistics(int num_levels);
+  ~Statistics();
+
+  void Record(Ticker ticker, uint64_t n = 1) {
+    Add(ticker, n);
+  }
+
+  // Does nothing for a level < 0 (i.e. unknown)
+  void RecordAtLevel(LevelTicker ticker, int level, uint64_t n = 1) {
+    if (level >= 0 && level < num_levels_) {
+      Add(kNumTickers + ticker * num_levels_ + level, n);
+    }
+  }
+
+  void MeasureTime(HistogramType type, uint64_t micros);
+
+  uint64_t Get(Ticker ticker) const;
+  uint64_t GetAtLevel(LevelTicker ticker, int level) const;
+
+  // Merge the samples of a histogram into "*histogram".
+  void MergeHistogram(HistogramType type, Histogram* histogram) const;
+
+  // Set every counter and histogram back to zero.  Counts added while
+  // this runs may or may not be kept.
+  void Reset();
+
+  // Name of a counter, e.g. "bloom-useful" or "bytes-read-at-level",
+  // or of a histogram, e.g. "get"
+  static const char* Name(Ticker ticker);
+  static const char* Name(LevelTicker ticker);
+  static const char* Name(HistogramType type);
+
+  // If "name" is the name of a ticker, or of a level ticker followed by
+  // a level, set "*value" to the count and return true.
+  bool GetProperty(const Slice& name, std::string* value) const;
+
+  // Append all counters as a JSON object.
+  void AppendJson(std::string* json) const;
+
+  // Append a human readable description of every histogram.
+  void AppendHistograms(std::string* histograms) const;
+
+ private:
+  enum { kNumStripes = 16 };
+
+  // A histogram is stored as bucket counts followed by these
+  enum {
+    kHistogramSum = Histogram::kNumBuckets,
+    kHistogramMax,
+    kHistogramMin,            // Stored as ~min, so that 0 means no samples
+    kHistogramCounters
+  };
+
+  // The counters of the stripe of the calling thread
+  port::AtomicPointer* Stripe();
+  static void Add(port::AtomicPointer* counter, uint64_t n);
+  static void Max(port::AtomicPointer* counter, uint64_t n);
+  void Add(size_t counter, uint64_t n) { Add(&Stripe()[counter], n); }
+  uint64_t Sum(size_t counter) const;
+  uint64_t Max(size_t counter) const;
+
+  const int num_levels_;
+  const size_t histograms_;         // Index of the first histogram counter
+  size_t stride_;                   // Counters per stripe, padded
+  port::AtomicPointer* counters_;   // Counts stored as pointers
+
+  // No copying allowed
+  Statistics(const Statistics&);
+  void operator=(const Statistics&);
+};
+
+// Adds the time from its construction to its destruction to a histogram
+class StopWatch {
+ public:
+  StopWatch(Env* env, Statistics* statistics, Statistics::HistogramType type)
+      : env_(env),
+        statistics_(statistics),
+        type_(type),
+        start_micros_(env->NowMicros()) {
+  }
+
+  ~StopWatch() {
+    statistics_->MeasureTime(type_, env_->NowMicros() - start_micros_);
+  }
+
+ private:
+  Env* const env_;
+  Statistics* const statistics_;
+  const Statistics::HistogramType type_;
+  const uint64_t start_micros_;
+
+  // No copying allowed
+  StopWatch(const StopWatch&);
+  void operator=(const StopWatch&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_STATISTICS_H_
@@ -0,0 +1,130 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/statistics.h"
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class StatisticsTest { };
+
+TEST(StatisticsTest, Counters) {
+  Statistics stats(3);
+  stats.Record(Statistics::kBloomUseful);
+  stats.Record(Statistics::kBloomUseful, 41);
+  stats.RecordAtLevel(Statistics::kBytesReadAtLevel, 2, 100);
+  stats.RecordAtLevel(Statistics::kBytesReadAtLevel, -1, 100);  // Ignored
+  stats.RecordAtLevel(Statistics::kBytesReadAtLevel, 3, 100);   // Ignored
+  ASSERT_EQ(42u, stats.Get(Statistics::kBloomUseful));
+  ASSERT_EQ(0u, stats.Get(Statistics::kBloomUseless));
+  ASSERT_EQ(0u, stats.GetAtLevel(Statistics::kBytesReadAtLevel, 1));
+  ASSERT_EQ(100u, stats.GetAtLevel(Statistics::kBytesReadAtLevel, 2));
+  ASSERT_EQ(0u, stats.GetAtLevel(Statistics::kGetHitsAtLevel, 2));
+}
+
+TEST(StatisticsTest, Properties) {
+  Statistics stats(3);
+  stats.Record(Statistics::kIterSeeks, 7);
+  stats.RecordAtLevel(Statistics::kGetHitsAtLevel, 1, 5);
+
+  std::string value;
+  ASSERT_TRUE(stats.GetProperty("iter-seeks", &value));
+  ASSERT_EQ("7", value);
+  value.clear();
+  ASSERT_TRUE(stats.GetProperty("get-hits-at-level1", &value));
+  ASSERT_EQ("5", value);
+  ASSERT_TRUE(!stats.GetProperty("get-hits-at-level3", &value));
+  ASSERT_TRUE(!stats.GetProperty("get-hits-at-level", &value));
+  ASSERT_TRUE(!stats.GetProperty("iter-seeks2", &value));
+
+  std::string json;
+  stats.AppendJson(&json);
+  ASSERT_TRUE(json.find("\"iter-seeks\": 7") != std::string::npos) << json;
+  ASSERT_TRUE(json.find("\"get-hits-at-level\": [0, 5, 0]") != std::string::npos)
+      << json;
+  ASSERT_EQ('}', json[json.size() - 1]);
+}
+
+TEST(StatisticsTest, Histograms) {
+  Statistics stats(1);
+  Histogram expected;
+  expected.Clear();
+  for (int i = 1; i <= 1000; i++) {
+    stats.MeasureTime(Statistics::kGetMicros, i * 7);
+    expected.Add(i * 7);
+  }
+  Histogram histogram;
+  histogram.Clear();
+  stats.MergeHistogram(Statistics::kGetMicros, &histogram);
+  ASSERT_EQ(1000, histogram.num());
+  // Everything but the standard deviation is exact
+  std::string s = histogram.ToString();
+  std::string e = expected.ToString();
+  ASSERT_EQ(e.substr(e.find('\n')), s.substr(s.find('\n')));
+
+  histogram.Clear();
+  stats.MergeHistogram(Statistics::kWriteMicros, &histogram);
+  ASSERT_EQ(0, histogram.num());
+
+  std::string text;
+  stats.AppendHistograms(&text);
+  ASSERT_TRUE(text.find("** get (micros) **\nCount: 1000 ") != std::string::npos)
+      << text;
+  ASSERT_TRUE(text.find("** write (micros) **\nNo samples\n") != std::string::npos)
+      << text;
+
+  stats.Record(Statistics::kIterSeeks);
+  stats.Reset();
+  ASSERT_EQ(0u, stats.Get(Statistics::kIterSeeks));
+  histogram.Clear();
+  stats.MergeHistogram(Statistics::kGetMicros, &histogram);
+  ASSERT_EQ(0, histogram.num());
+}
+
+namespace {
+struct ThreadState {
+  Statistics* stats;
+  port::Mutex mu;
+  port::CondVar cv;
+  int done;
+  ThreadState() : cv(&mu), done(0) { }
+};
+
+static const int kNumThreads = 8;
+static const int kAddsPerThread = 10000;
+
+static void AddThread(void* arg) {
+  ThreadState* state = reinterpret_cast<ThreadState*>(arg);
+  for (int i = 0; i < kAddsPerThread; i++) {
+    state->stats->Record(Statistics::kBytesRead, 3);
+  }
+  MutexLock l(&state->mu);
+  state->done++;
+  state->cv.SignalAll();
+}
+}  // namespace
+
+TEST(StatisticsTest, ConcurrentAdds) {
+  Statistics stats(1);
+  ThreadState state;
+  state.stats = &stats;
+  for (int i = 0; i < kNumThreads; i++) {
+    Env::Default()->StartThread(&AddThread, &state);
+  }
+  MutexLock l(&state.mu);
+  while (state.done < kNumThreads) {
+    state.cv.Wait();
+  }
+  ASSERT_EQ(static_cast<uint64_t>(3 * kNumThreads * kAddsPerThread), stats.Get(Statistics::kBytesRead));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}